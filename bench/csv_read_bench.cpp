@@ -0,0 +1,112 @@
+#include "vegaDataframe.h"
+#include "vegaCsv.h"
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+// Compares the mapped SIMD read_csv, at increasing thread counts, against the previous
+// getline/stringstream reader.
+// usage: vega_csv_bench [file.csv] [size_mb]
+// Without a file a synthetic CSV of size_mb megabytes (default 256) is generated.
+
+// type inference as read_csv did it before from_chars
+static DataType legacy_infer_data_type(const std::string& value) {
+    std::istringstream iss(value);
+    long long tmp_int;
+    if ((iss >> tmp_int) && iss.eof()) return DataType::INT;
+    iss.clear();
+    iss.str(value);
+    double tmp_double;
+    if ((iss >> tmp_double) && iss.eof()) return DataType::FLOAT;
+    return DataType::STRING;
+}
+
+// the read path read_csv used before the mapped scanner
+static std::vector<vegaColumn> legacy_read_csv(const std::string& file_name) {
+    std::ifstream input(file_name);
+    std::string line;
+    std::getline(input, line);
+    size_t column_count = split_string(line, ',').size();
+
+    std::vector<DataType> types(column_count, DataType::INT);
+    std::vector<vegaColumn> raw_columns(column_count, vegaColumn(DataType::STRING));
+    while (std::getline(input, line)) {
+        auto tokens = split_string(line, ',');
+        for (size_t i = 0; i < column_count; ++i) {
+            std::string cell = i < tokens.size() ? trim_whitespace(tokens[i]) : "";
+            raw_columns[i].append_string(cell);
+            if (!cell.empty()) types[i] = std::max(types[i], legacy_infer_data_type(cell));
+        }
+    }
+
+    std::vector<vegaColumn> columns;
+    for (size_t i = 0; i < column_count; ++i) columns.push_back(raw_columns[i].cast(types[i]));
+    return columns;
+}
+
+static void write_synthetic_csv(const std::string& file_name, size_t target_bytes) {
+    std::ofstream out(file_name);
+    out << "id,price,quantity,symbol,ratio\n";
+    std::mt19937_64 rng(42);
+    std::uniform_real_distribution<double> price(1.0, 5000.0);
+    const char* symbols[] = {"AAPL", "MSFT", "GOOG", "AMZN", "NVDA", "META"};
+
+    size_t written = 0;
+    std::string row;
+    for (size_t id = 0; written < target_bytes; ++id) {
+        row = std::to_string(id) + ',' + format_double(price(rng)) + ',' + std::to_string(rng() % 1000) + ',' +
+              symbols[rng() % 6] + ',' + (rng() % 10 == 0 ? "" : format_double(static_cast<double>(rng() % 10000) / 7.0)) + '\n';
+        out << row;
+        written += row.size();
+    }
+}
+
+template <typename Fn>
+static double best_seconds(int runs, Fn&& fn) {
+    double best = std::numeric_limits<double>::max();
+    for (int run = 0; run < runs; ++run) {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count());
+    }
+    return best;
+}
+
+int main(int argc, char** argv) {
+    std::string file_name = argc > 1 ? argv[1] : "vega_csv_bench.csv";
+    size_t size_mb = argc > 2 ? std::stoul(argv[2]) : 256;
+    bool generated = argc <= 1;
+    if (generated) write_synthetic_csv(file_name, size_mb << 20);
+
+    double gigabytes = static_cast<double>(std::filesystem::file_size(file_name)) / 1e9;
+    std::cout << "file: " << file_name << " (" << gigabytes << " GB), scanner: " << csv_scanner_name() << std::endl;
+
+    size_t legacy_rows = 0;
+    double legacy = best_seconds(1, [&] { legacy_rows = legacy_read_csv(file_name).front().size(); });
+
+    std::cout << std::fixed << std::setprecision(3)
+              << "legacy read_csv: " << legacy << " s, " << gigabytes / legacy << " GB/s, " << legacy_rows << " rows\n";
+
+    // mapped reader at 1, 2, 4, ... threads up to the core count
+    size_t rows = legacy_rows;
+    size_t cores = std::max(1u, std::thread::hardware_concurrency());
+    for (size_t threads = 1;; threads = std::min(threads * 2, cores)) {
+        size_t parsed_rows = 0;
+        double mapped = best_seconds(3, [&] {
+            vegaDataframe df;
+            vegaCsvOptions options;
+            options.num_threads = threads;
+            df.read_csv(file_name, options);
+            parsed_rows = df.num_rows();
+        });
+        if (parsed_rows != legacy_rows) rows = parsed_rows;
+        std::cout << "mapped read_csv, " << threads << " thread(s): " << mapped << " s, " << gigabytes / mapped
+                  << " GB/s, speedup " << legacy / mapped << "x" << std::endl;
+        if (threads == cores) break;
+    }
+
+    if (generated) std::filesystem::remove(file_name);
+    return rows == legacy_rows ? 0 : 1;
+}
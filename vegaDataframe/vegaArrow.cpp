@@ -0,0 +1,819 @@
+#include "vegaArrow.h"
+#include "vegaDatetime.h"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+
+// ============= FLATBUFFERS =============
+// Only what the Arrow metadata needs: tables with scalar, table, string and vector fields.
+
+// An object to encode. Tables are laid out front to back with their children after them, so
+// every offset points forward as the format requires.
+struct FbObject {
+    enum class Kind { TABLE, STRING, TABLE_VECTOR, STRUCT_VECTOR };
+
+    struct Field {
+        uint16_t id = 0;
+        size_t size = 0;
+        uint64_t value = 0;
+        std::shared_ptr<FbObject> child;
+    };
+
+    Kind kind = Kind::TABLE;
+    std::vector<Field> fields;
+    // characters of a STRING, elements of a STRUCT_VECTOR
+    std::string bytes;
+    size_t count = 0;
+    std::vector<std::shared_ptr<FbObject>> items;
+};
+using FbPtr = std::shared_ptr<FbObject>;
+
+static FbPtr fb_table() {
+    return std::make_shared<FbObject>();
+}
+
+template <typename T>
+static void fb_scalar(const FbPtr& table, uint16_t id, T value) {
+    uint64_t bits = 0;
+    std::memcpy(&bits, &value, sizeof(T));
+    table->fields.push_back({id, sizeof(T), bits, nullptr});
+}
+
+static void fb_child(const FbPtr& table, uint16_t id, FbPtr child) {
+    table->fields.push_back({id, sizeof(uint32_t), 0, std::move(child)});
+}
+
+static FbPtr fb_string(std::string_view text) {
+    auto object = std::make_shared<FbObject>();
+    object->kind = FbObject::Kind::STRING;
+    object->bytes = text;
+    return object;
+}
+
+static FbPtr fb_tables(std::vector<FbPtr> items) {
+    auto object = std::make_shared<FbObject>();
+    object->kind = FbObject::Kind::TABLE_VECTOR;
+    object->items = std::move(items);
+    return object;
+}
+
+// vector of structs made of 8-byte members, given as their raw little-endian bytes
+static FbPtr fb_structs(std::string bytes, size_t count) {
+    auto object = std::make_shared<FbObject>();
+    object->kind = FbObject::Kind::STRUCT_VECTOR;
+    object->bytes = std::move(bytes);
+    object->count = count;
+    return object;
+}
+
+class FbEncoder {
+public:
+    // the finished buffer: root offset followed by the objects, padded to 8 bytes
+    std::string finish(const FbObject& root) {
+        buffer.assign(sizeof(uint32_t), '\0');
+        size_t root_pos = place(root);
+        write_at<uint32_t>(0, static_cast<uint32_t>(root_pos));
+        pad_to(8);
+        return std::move(buffer);
+    }
+
+private:
+    void pad_to(size_t alignment) {
+        buffer.append((alignment - buffer.size() % alignment) % alignment, '\0');
+    }
+
+    template <typename T>
+    void append(T value) {
+        buffer.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    template <typename T>
+    void write_at(size_t pos, T value) {
+        std::memcpy(buffer.data() + pos, &value, sizeof(T));
+    }
+
+    // lays out an object and returns its position (where offsets to it point)
+    size_t place(const FbObject& object) {
+        switch (object.kind) {
+            case FbObject::Kind::STRING: {
+                pad_to(4);
+                size_t pos = buffer.size();
+                append<uint32_t>(static_cast<uint32_t>(object.bytes.size()));
+                buffer += object.bytes;
+                buffer.push_back('\0');
+                return pos;
+            }
+            case FbObject::Kind::STRUCT_VECTOR: {
+                // the elements after the length are 8-byte aligned
+                pad_to(4);
+                if ((buffer.size() + 4) % 8 != 0) append<uint32_t>(0);
+                size_t pos = buffer.size();
+                append<uint32_t>(static_cast<uint32_t>(object.count));
+                buffer += object.bytes;
+                return pos;
+            }
+            case FbObject::Kind::TABLE_VECTOR: {
+                pad_to(4);
+                size_t pos = buffer.size();
+                append<uint32_t>(static_cast<uint32_t>(object.items.size()));
+                size_t slots = buffer.size();
+                buffer.append(object.items.size() * sizeof(uint32_t), '\0');
+                for (size_t i = 0; i < object.items.size(); ++i) {
+                    size_t slot = slots + i * sizeof(uint32_t);
+                    size_t child = place(*object.items[i]);
+                    write_at<uint32_t>(slot, static_cast<uint32_t>(child - slot));
+                }
+                return pos;
+            }
+            case FbObject::Kind::TABLE:
+                break;
+        }
+
+        // fields after the 4-byte vtable offset, largest first so each is naturally aligned
+        std::vector<FbObject::Field> fields = object.fields;
+        std::stable_sort(fields.begin(), fields.end(), [](const auto& a, const auto& b) { return a.size > b.size; });
+        std::vector<size_t> field_offsets(fields.size());
+        size_t table_size = sizeof(int32_t);
+        uint16_t max_id = 0;
+        for (size_t i = 0; i < fields.size(); ++i) {
+            table_size = (table_size + fields[i].size - 1) / fields[i].size * fields[i].size;
+            field_offsets[i] = table_size;
+            table_size += fields[i].size;
+            max_id = std::max<uint16_t>(max_id, fields[i].id + 1);
+        }
+
+        pad_to(2);
+        size_t vtable_pos = buffer.size();
+        std::vector<uint16_t> vtable(2 + max_id, 0);
+        vtable[0] = static_cast<uint16_t>(vtable.size() * sizeof(uint16_t));
+        vtable[1] = static_cast<uint16_t>(table_size);
+        for (size_t i = 0; i < fields.size(); ++i) vtable[2 + fields[i].id] = static_cast<uint16_t>(field_offsets[i]);
+        for (uint16_t entry : vtable) append(entry);
+
+        pad_to(8);
+        size_t table_pos = buffer.size();
+        buffer.append(table_size, '\0');
+        write_at<int32_t>(table_pos, static_cast<int32_t>(table_pos - vtable_pos));
+        for (size_t i = 0; i < fields.size(); ++i) {
+            if (!fields[i].child) std::memcpy(buffer.data() + table_pos + field_offsets[i], &fields[i].value, fields[i].size);
+        }
+        for (size_t i = 0; i < fields.size(); ++i) {
+            if (!fields[i].child) continue;
+            size_t slot = table_pos + field_offsets[i];
+            size_t child = place(*fields[i].child);
+            write_at<uint32_t>(slot, static_cast<uint32_t>(child - slot));
+        }
+        return table_pos;
+    }
+
+    std::string buffer;
+};
+
+[[noreturn]] static void arrow_error(const std::string& what) {
+    throw std::runtime_error("Invalid Arrow IPC data: " + what);
+}
+
+// Read access to one table of a FlatBuffer, with every position checked against the buffer.
+class FbTable {
+public:
+    FbTable(std::string_view buffer, size_t pos) : buffer(buffer), pos(pos) {
+        check(pos, sizeof(int32_t));
+        vtable = static_cast<size_t>(static_cast<int64_t>(pos) - read<int32_t>(pos));
+        check(vtable, 2 * sizeof(uint16_t));
+        vtable_size = read<uint16_t>(vtable);
+        check(vtable, vtable_size);
+    }
+
+    // the root table of a buffer
+    static FbTable root(std::string_view buffer) {
+        if (buffer.size() < sizeof(uint32_t)) arrow_error("truncated metadata");
+        uint32_t offset;
+        std::memcpy(&offset, buffer.data(), sizeof(offset));
+        return {buffer, offset};
+    }
+
+    [[nodiscard]] bool has(uint16_t id) const { return field_pos(id) != 0; }
+
+    template <typename T>
+    [[nodiscard]] T scalar(uint16_t id, T fallback = T{}) const {
+        size_t at = field_pos(id);
+        return at == 0 ? fallback : read<T>(at);
+    }
+
+    [[nodiscard]] FbTable table(uint16_t id) const {
+        size_t at = field_pos(id);
+        if (at == 0) arrow_error("missing table field");
+        return {buffer, at + read<uint32_t>(at)};
+    }
+
+    [[nodiscard]] std::string_view string(uint16_t id) const {
+        size_t at = field_pos(id);
+        if (at == 0) return {};
+        size_t start = at + read<uint32_t>(at);
+        uint32_t length = read<uint32_t>(start);
+        check(start + sizeof(uint32_t), length);
+        return buffer.substr(start + sizeof(uint32_t), length);
+    }
+
+    // element count of a vector field (0 when absent) and the position of its first element
+    [[nodiscard]] size_t vector(uint16_t id, size_t& first) const {
+        size_t at = field_pos(id);
+        if (at == 0) return 0;
+        size_t start = at + read<uint32_t>(at);
+        first = start + sizeof(uint32_t);
+        return read<uint32_t>(start);
+    }
+
+    [[nodiscard]] FbTable vector_table(size_t first, size_t index) const {
+        size_t at = first + index * sizeof(uint32_t);
+        return {buffer, at + read<uint32_t>(at)};
+    }
+
+    template <typename T>
+    [[nodiscard]] T read(size_t at) const {
+        check(at, sizeof(T));
+        T value;
+        std::memcpy(&value, buffer.data() + at, sizeof(T));
+        return value;
+    }
+
+private:
+    void check(size_t at, size_t length) const {
+        if (at > buffer.size() || length > buffer.size() - at) arrow_error("metadata out of bounds");
+    }
+
+    [[nodiscard]] size_t field_pos(uint16_t id) const {
+        size_t entry = 4 + 2 * static_cast<size_t>(id);
+        if (entry + 2 > vtable_size) return 0;
+        uint16_t offset = read<uint16_t>(vtable + entry);
+        return offset == 0 ? 0 : pos + offset;
+    }
+
+    std::string_view buffer;
+    size_t pos;
+    size_t vtable = 0;
+    uint16_t vtable_size = 0;
+};
+
+// ============= ARROW METADATA =============
+
+static constexpr char ARROW_MAGIC[] = "ARROW1";
+static constexpr int16_t METADATA_V5 = 4;
+static constexpr uint32_t CONTINUATION = 0xFFFFFFFF;
+static constexpr size_t BODY_ALIGNMENT = 64;
+
+// MessageHeader union
+static constexpr uint8_t HEADER_SCHEMA = 1;
+static constexpr uint8_t HEADER_DICTIONARY_BATCH = 2;
+static constexpr uint8_t HEADER_RECORD_BATCH = 3;
+
+// Type union
+static constexpr uint8_t TYPE_NULL = 1;
+static constexpr uint8_t TYPE_INT = 2;
+static constexpr uint8_t TYPE_FLOATING_POINT = 3;
+static constexpr uint8_t TYPE_BINARY = 4;
+static constexpr uint8_t TYPE_UTF8 = 5;
+static constexpr uint8_t TYPE_BOOL = 6;
+static constexpr uint8_t TYPE_DATE = 8;
+static constexpr uint8_t TYPE_TIMESTAMP = 10;
+static constexpr uint8_t TYPE_LARGE_BINARY = 19;
+static constexpr uint8_t TYPE_LARGE_UTF8 = 20;
+
+// DateUnit and TimeUnit
+static constexpr int16_t DATE_UNIT_DAY = 0;
+static constexpr int16_t TIME_UNIT_NANOSECOND = 3;
+
+// FloatingPoint precision
+static constexpr int16_t PRECISION_SINGLE = 1;
+static constexpr int16_t PRECISION_DOUBLE = 2;
+
+static uint64_t align_body(uint64_t offset) {
+    return (offset + BODY_ALIGNMENT - 1) / BODY_ALIGNMENT * BODY_ALIGNMENT;
+}
+
+template <typename T>
+static void put(std::string& out, T value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+static FbPtr schema_table(const std::vector<std::string>& features, const std::vector<vegaColumn>& columns) {
+    std::vector<FbPtr> fields;
+    for (size_t i = 0; i < columns.size(); ++i) {
+        FbPtr type = fb_table();
+        uint8_t type_id = TYPE_LARGE_UTF8;
+        if (columns[i].type == DataType::INT) {
+            type_id = TYPE_INT;
+            fb_scalar<int32_t>(type, 0, 64);
+            fb_scalar<uint8_t>(type, 1, 1);
+        } else if (columns[i].type == DataType::FLOAT) {
+            type_id = TYPE_FLOATING_POINT;
+            fb_scalar<int16_t>(type, 0, PRECISION_DOUBLE);
+        } else if (columns[i].type == DataType::DATETIME) {
+            type_id = TYPE_TIMESTAMP;
+            fb_scalar<int16_t>(type, 0, TIME_UNIT_NANOSECOND);
+        }
+
+        FbPtr field = fb_table();
+        fb_child(field, 0, fb_string(features[i]));
+        fb_scalar<uint8_t>(field, 1, 1);
+        fb_scalar<uint8_t>(field, 2, type_id);
+        fb_child(field, 3, type);
+        fb_child(field, 5, fb_tables({}));
+        fields.push_back(field);
+    }
+
+    FbPtr schema = fb_table();
+    fb_scalar<int16_t>(schema, 0, 0);
+    fb_child(schema, 1, fb_tables(std::move(fields)));
+    return schema;
+}
+
+static std::string message_metadata(uint8_t header_type, FbPtr header, int64_t body_length) {
+    FbPtr message = fb_table();
+    fb_scalar<int16_t>(message, 0, METADATA_V5);
+    fb_scalar<uint8_t>(message, 1, header_type);
+    fb_child(message, 2, std::move(header));
+    fb_scalar<int64_t>(message, 3, body_length);
+    return FbEncoder().finish(*message);
+}
+
+// ============= WRITING =============
+
+// writes an encapsulated message and returns the size of its prefix and metadata
+static size_t write_message(std::ostream& out, const std::string& metadata,
+                            const std::vector<std::pair<const char*, uint64_t>>& body) {
+    std::string prefix;
+    put<uint32_t>(prefix, CONTINUATION);
+    put<int32_t>(prefix, static_cast<int32_t>(metadata.size()));
+    out.write(prefix.data(), static_cast<std::streamsize>(prefix.size()));
+    out.write(metadata.data(), static_cast<std::streamsize>(metadata.size()));
+
+    static constexpr char padding[BODY_ALIGNMENT] = {};
+    uint64_t written = 0;
+    for (const auto& [data, length] : body) {
+        uint64_t start = align_body(written);
+        out.write(padding, static_cast<std::streamsize>(start - written));
+        if (length > 0) out.write(data, static_cast<std::streamsize>(length));
+        written = start + length;
+    }
+    out.write(padding, static_cast<std::streamsize>(align_body(written) - written));
+    return prefix.size() + metadata.size();
+}
+
+void write_arrow_ipc(std::ostream& out, const std::vector<std::string>& features, const std::vector<vegaColumn>& columns,
+                     ArrowIpcFormat format) {
+    if constexpr (std::endian::native != std::endian::little) {
+        throw std::runtime_error("Arrow IPC export is only supported on little-endian hosts");
+    }
+    int64_t rows = columns.empty() ? 0 : static_cast<int64_t>(columns.front().size());
+
+    uint64_t position = 0;
+    if (format == ArrowIpcFormat::FILE) {
+        out.write(ARROW_MAGIC, 6);
+        out.write("\0\0", 2);
+        position = 8;
+    }
+
+    std::string schema_metadata = message_metadata(HEADER_SCHEMA, schema_table(features, columns), 0);
+    position += write_message(out, schema_metadata, {});
+
+    // the buffers of every column in Arrow order, straight from the column storage
+    std::vector<std::pair<const char*, uint64_t>> body;
+    std::string nodes;
+    std::string buffers;
+    uint64_t body_length = 0;
+    auto add_buffer = [&](const void* data, uint64_t length) {
+        uint64_t offset = align_body(body_length);
+        put<int64_t>(buffers, static_cast<int64_t>(offset));
+        put<int64_t>(buffers, static_cast<int64_t>(length));
+        body.emplace_back(static_cast<const char*>(data), length);
+        body_length = offset + length;
+    };
+    // CATEGORY columns are written as LargeUtf8 from a decoded copy that outlives the body
+    std::vector<vegaColumn> decoded;
+    decoded.reserve(columns.size());
+    for (const auto& source : columns) {
+        if (source.type == DataType::CATEGORY) decoded.push_back(source.cast(DataType::STRING));
+        const vegaColumn& column = source.type == DataType::CATEGORY ? decoded.back() : source;
+        size_t null_count = column.null_count();
+        put<int64_t>(nodes, rows);
+        put<int64_t>(nodes, static_cast<int64_t>(null_count));
+        // a column without nulls needs no bitmap
+        if (null_count == 0) add_buffer(nullptr, 0);
+        else add_buffer(column.validity.words.data(), column.validity.words.size() * sizeof(uint64_t));
+
+        if (column.type == DataType::INT || column.type == DataType::DATETIME) {
+            add_buffer(column.int_data.data(), column.int_data.size() * sizeof(int64_t));
+        } else if (column.type == DataType::FLOAT) {
+            add_buffer(column.float_data.data(), column.float_data.size() * sizeof(double));
+        } else {
+            add_buffer(column.string_offsets.data(), column.string_offsets.size() * sizeof(uint64_t));
+            add_buffer(column.string_data.data(), column.string_data.size());
+        }
+    }
+    body_length = align_body(body_length);
+
+    FbPtr batch = fb_table();
+    fb_scalar<int64_t>(batch, 0, rows);
+    fb_child(batch, 1, fb_structs(nodes, columns.size()));
+    fb_child(batch, 2, fb_structs(buffers, body.size()));
+    std::string batch_metadata = message_metadata(HEADER_RECORD_BATCH, batch, static_cast<int64_t>(body_length));
+    uint64_t batch_offset = position;
+    size_t batch_metadata_length = write_message(out, batch_metadata, body);
+    position += batch_metadata_length + body_length;
+
+    // end-of-stream marker
+    std::string end;
+    put<uint32_t>(end, CONTINUATION);
+    put<int32_t>(end, 0);
+    out.write(end.data(), static_cast<std::streamsize>(end.size()));
+
+    if (format == ArrowIpcFormat::FILE) {
+        std::string block;
+        put<int64_t>(block, static_cast<int64_t>(batch_offset));
+        put<int32_t>(block, static_cast<int32_t>(batch_metadata_length));
+        put<int32_t>(block, 0);
+        put<int64_t>(block, static_cast<int64_t>(body_length));
+
+        FbPtr footer = fb_table();
+        fb_scalar<int16_t>(footer, 0, METADATA_V5);
+        fb_child(footer, 1, schema_table(features, columns));
+        fb_child(footer, 2, fb_structs({}, 0));
+        fb_child(footer, 3, fb_structs(block, 1));
+        std::string footer_bytes = FbEncoder().finish(*footer);
+        out.write(footer_bytes.data(), static_cast<std::streamsize>(footer_bytes.size()));
+        std::string trailer;
+        put<int32_t>(trailer, static_cast<int32_t>(footer_bytes.size()));
+        out.write(trailer.data(), static_cast<std::streamsize>(trailer.size()));
+        out.write(ARROW_MAGIC, 6);
+    }
+    out.flush();
+}
+
+// ============= READING =============
+
+// what a schema field holds
+struct ArrowField {
+    std::string name;
+    uint8_t type = 0;
+    int32_t bit_width = 0;
+    bool is_signed = true;
+    int16_t precision = PRECISION_DOUBLE;
+    // Date and Timestamp: nanoseconds per stored unit
+    int64_t ns_per_unit = 1;
+};
+
+static std::vector<ArrowField> parse_schema(const FbTable& schema) {
+    if (schema.scalar<int16_t>(0, 0) != 0) arrow_error("big-endian data is not supported");
+
+    std::vector<ArrowField> fields;
+    size_t first = 0;
+    size_t count = schema.vector(1, first);
+    for (size_t i = 0; i < count; ++i) {
+        FbTable field = schema.vector_table(first, i);
+        ArrowField result;
+        result.name = std::string(field.string(0));
+        result.type = field.scalar<uint8_t>(2, 0);
+        if (field.has(4)) throw std::runtime_error("Dictionary-encoded Arrow field '" + result.name + "' is not supported");
+        size_t children_first = 0;
+        if (field.vector(5, children_first) > 0) {
+            throw std::runtime_error("Nested Arrow field '" + result.name + "' is not supported");
+        }
+
+        switch (result.type) {
+            case TYPE_INT: {
+                FbTable type = field.table(3);
+                result.bit_width = type.scalar<int32_t>(0, 0);
+                result.is_signed = type.scalar<uint8_t>(1, 0) != 0;
+                if (result.bit_width != 8 && result.bit_width != 16 && result.bit_width != 32 && result.bit_width != 64) {
+                    arrow_error("invalid integer width");
+                }
+                break;
+            }
+            case TYPE_FLOATING_POINT:
+                result.precision = field.table(3).scalar<int16_t>(0, 0);
+                if (result.precision != PRECISION_SINGLE && result.precision != PRECISION_DOUBLE) {
+                    throw std::runtime_error("Half-precision Arrow field '" + result.name + "' is not supported");
+                }
+                break;
+            case TYPE_DATE:
+                // DAY dates are int32, MILLISECOND (the default unit) dates int64
+                result.bit_width = field.table(3).scalar<int16_t>(0, 1) == DATE_UNIT_DAY ? 32 : 64;
+                result.ns_per_unit = result.bit_width == 32 ? NS_PER_DAY : 1'000'000;
+                break;
+            case TYPE_TIMESTAMP: {
+                // the values are UTC whatever the time zone of the field is
+                int16_t unit = field.table(3).scalar<int16_t>(0, 0);
+                if (unit < 0 || unit > TIME_UNIT_NANOSECOND) arrow_error("invalid time unit");
+                result.bit_width = 64;
+                for (int16_t u = unit; u < TIME_UNIT_NANOSECOND; ++u) result.ns_per_unit *= 1000;
+                break;
+            }
+            case TYPE_NULL: case TYPE_BOOL: case TYPE_BINARY: case TYPE_UTF8:
+            case TYPE_LARGE_BINARY: case TYPE_LARGE_UTF8:
+                break;
+            default:
+                throw std::runtime_error("Arrow type of field '" + result.name + "' is not supported");
+        }
+        fields.push_back(std::move(result));
+    }
+    return fields;
+}
+
+// element i of a little-endian buffer of T
+template <typename T>
+static T load(const char* data, size_t i) {
+    T value;
+    std::memcpy(&value, data + i * sizeof(T), sizeof(T));
+    return value;
+}
+
+template <typename T>
+static void load_ints(vegaColumn& column, const char* data, size_t rows) {
+    column.int_data.resize(rows);
+    for (size_t i = 0; i < rows; ++i) column.int_data[i] = static_cast<int64_t>(load<T>(data, i));
+}
+
+// builds the column of one field from a record batch
+static vegaColumn read_array(const ArrowField& field, size_t rows, size_t null_count,
+                             const std::vector<std::string_view>& buffers) {
+    auto need = [&](size_t index, size_t bytes) {
+        if (index >= buffers.size() || buffers[index].size() < bytes) arrow_error("buffer too small");
+        return buffers[index].data();
+    };
+
+    auto byte_count = [](size_t count, size_t width) {
+        if (width != 0 && count > std::numeric_limits<size_t>::max() / width) arrow_error("array length out of range");
+        return count * width;
+    };
+
+    vegaColumn column(DataType::INT);
+    if (field.type == TYPE_NULL) {
+        for (size_t row = 0; row < rows; ++row) column.append_null();
+        return column;
+    }
+
+    // the values buffer bounds the row count, so it is checked before anything is allocated
+    bool text = field.type != TYPE_BOOL && field.type != TYPE_INT && field.type != TYPE_DATE &&
+                field.type != TYPE_TIMESTAMP && field.type != TYPE_FLOATING_POINT;
+    bool large = field.type == TYPE_LARGE_UTF8 || field.type == TYPE_LARGE_BINARY;
+    size_t value_bytes = field.type == TYPE_BOOL ? (rows + 7) / 8
+                       : text ? byte_count(rows + 1, large ? sizeof(int64_t) : sizeof(int32_t))
+                       : field.type == TYPE_FLOATING_POINT
+                           ? byte_count(rows, field.precision == PRECISION_DOUBLE ? sizeof(double) : sizeof(float))
+                           : byte_count(rows, static_cast<size_t>(field.bit_width / 8));
+    const char* values = need(1, value_bytes);
+
+    if (null_count == 0 || buffers[0].empty()) {
+        column.validity = vegaBitmap(rows, true);
+    } else {
+        column.validity = vegaBitmap(rows);
+        std::memcpy(column.validity.words.data(), need(0, (rows + 7) / 8), (rows + 7) / 8);
+        if (rows % 64 != 0) column.validity.words.back() &= (uint64_t{1} << (rows % 64)) - 1;
+    }
+
+    switch (field.type) {
+        case TYPE_BOOL: {
+            const char* bits = values;
+            column.int_data.resize(rows);
+            for (size_t i = 0; i < rows; ++i) column.int_data[i] = (bits[i >> 3] >> (i & 7)) & 1;
+            break;
+        }
+        case TYPE_INT: {
+            const char* data = values;
+            if (field.bit_width == 64 && field.is_signed) {
+                column.int_data.resize(rows);
+                if (rows > 0) std::memcpy(column.int_data.data(), data, rows * sizeof(int64_t));
+            } else if (field.bit_width == 64) {
+                bool fits = true;
+                for (size_t i = 0; i < rows && fits; ++i) {
+                    fits = !column.validity.get(i) || load<uint64_t>(data, i) <= std::numeric_limits<int64_t>::max();
+                }
+                if (fits) {
+                    load_ints<uint64_t>(column, data, rows);
+                } else {
+                    column.type = DataType::FLOAT;
+                    column.float_data.resize(rows);
+                    for (size_t i = 0; i < rows; ++i) column.float_data[i] = static_cast<double>(load<uint64_t>(data, i));
+                }
+            } else if (field.bit_width == 32) {
+                field.is_signed ? load_ints<int32_t>(column, data, rows) : load_ints<uint32_t>(column, data, rows);
+            } else if (field.bit_width == 16) {
+                field.is_signed ? load_ints<int16_t>(column, data, rows) : load_ints<uint16_t>(column, data, rows);
+            } else {
+                field.is_signed ? load_ints<int8_t>(column, data, rows) : load_ints<uint8_t>(column, data, rows);
+            }
+            break;
+        }
+        case TYPE_DATE:
+        case TYPE_TIMESTAMP: {
+            column.type = DataType::DATETIME;
+            const char* data = values;
+            column.int_data.resize(rows);
+            for (size_t i = 0; i < rows; ++i) {
+                int64_t value = field.bit_width == 32 ? load<int32_t>(data, i) : load<int64_t>(data, i);
+                if (column.validity.get(i) && !checked_mul(value, field.ns_per_unit, column.int_data[i])) {
+                    arrow_error("timestamp out of range");
+                }
+            }
+            break;
+        }
+        case TYPE_FLOATING_POINT: {
+            column.type = DataType::FLOAT;
+            column.float_data.resize(rows);
+            if (field.precision == PRECISION_DOUBLE) {
+                if (rows > 0) std::memcpy(column.float_data.data(), values, rows * sizeof(double));
+            } else {
+                for (size_t i = 0; i < rows; ++i) column.float_data[i] = load<float>(values, i);
+            }
+            break;
+        }
+        default: {
+            column.type = DataType::STRING;
+            const char* offsets = values;
+            auto offset_at = [&](size_t i) {
+                return large ? load<int64_t>(offsets, i) : static_cast<int64_t>(load<int32_t>(offsets, i));
+            };
+            int64_t base = offset_at(0);
+            int64_t last = offset_at(rows);
+            if (base < 0 || last < base) arrow_error("invalid string offsets");
+            const char* bytes = need(2, static_cast<size_t>(last));
+
+            column.string_offsets.resize(rows + 1);
+            if (large && base == 0) {
+                std::memcpy(column.string_offsets.data(), offsets, (rows + 1) * sizeof(int64_t));
+            } else {
+                for (size_t i = 0; i <= rows; ++i) column.string_offsets[i] = static_cast<uint64_t>(offset_at(i) - base);
+            }
+            for (size_t i = 0; i < rows; ++i) {
+                if (column.string_offsets[i + 1] < column.string_offsets[i]) arrow_error("invalid string offsets");
+            }
+            column.string_data.assign(bytes + base, bytes + last);
+            break;
+        }
+    }
+
+    // null slots hold zeros (and no string bytes) and empty strings are nulls, as vegaColumn expects
+    bool needs_rebuild = false;
+    for (size_t row = 0; row < rows; ++row) {
+        if (column.type == DataType::STRING) {
+            size_t length = column.string_offsets[row + 1] - column.string_offsets[row];
+            if (length == 0) column.validity.reset(row);
+            else if (column.is_null(row)) needs_rebuild = true;
+        } else if (column.is_null(row)) {
+            if (column.has_int_data()) column.int_data[row] = 0;
+            else column.float_data[row] = 0.0;
+        }
+    }
+    if (needs_rebuild) {
+        vegaColumn rebuilt(DataType::STRING);
+        rebuilt.reserve(rows);
+        for (size_t row = 0; row < rows; ++row) {
+            if (column.is_null(row)) rebuilt.append_null();
+            else rebuilt.append_string(column.string_at(row));
+        }
+        column = std::move(rebuilt);
+    }
+    return column;
+}
+
+// appends the arrays of a record batch message to columns
+static void read_record_batch(const FbTable& batch, std::string_view body, const std::vector<ArrowField>& fields,
+                              std::vector<vegaColumn>& columns) {
+    if (batch.has(3)) throw std::runtime_error("Compressed Arrow record batches are not supported");
+
+    size_t nodes_first = 0;
+    size_t buffers_first = 0;
+    size_t node_count = batch.vector(1, nodes_first);
+    size_t buffer_count = batch.vector(2, buffers_first);
+    if (node_count != fields.size()) arrow_error("field count does not match the schema");
+
+    // every field node must have the batch's row count, or the columns would come out ragged
+    auto length = batch.scalar<int64_t>(0, 0);
+    if (length < 0) arrow_error("invalid record batch length");
+    size_t next_buffer = 0;
+    for (size_t f = 0; f < fields.size(); ++f) {
+        auto node_length = batch.read<int64_t>(nodes_first + f * 16);
+        auto node_nulls = batch.read<int64_t>(nodes_first + f * 16 + 8);
+        if (node_length != length) arrow_error("field length does not match the record batch");
+        if (node_nulls < 0 || node_nulls > node_length) arrow_error("invalid null count");
+        auto rows = static_cast<size_t>(node_length);
+        auto null_count = static_cast<size_t>(node_nulls);
+
+        size_t buffer_total = 2;
+        if (fields[f].type == TYPE_NULL) buffer_total = 0;
+        else if (fields[f].type == TYPE_BINARY || fields[f].type == TYPE_UTF8 || fields[f].type == TYPE_LARGE_BINARY ||
+                 fields[f].type == TYPE_LARGE_UTF8) {
+            buffer_total = 3;
+        }
+        if (next_buffer + buffer_total > buffer_count) arrow_error("missing buffers");
+
+        std::vector<std::string_view> buffers;
+        for (size_t b = 0; b < buffer_total; ++b, ++next_buffer) {
+            auto offset = batch.read<int64_t>(buffers_first + next_buffer * 16);
+            auto length = batch.read<int64_t>(buffers_first + next_buffer * 16 + 8);
+            if (offset < 0 || length < 0 || static_cast<uint64_t>(offset) > body.size() ||
+                static_cast<uint64_t>(length) > body.size() - static_cast<uint64_t>(offset)) {
+                arrow_error("buffer out of bounds");
+            }
+            buffers.push_back(body.substr(static_cast<size_t>(offset), static_cast<size_t>(length)));
+        }
+
+        vegaColumn part = read_array(fields[f], rows, null_count, buffers);
+        vegaColumn& column = columns[f];
+        if (column.size() == 0 && column.type != part.type) {
+            column = std::move(part);
+            continue;
+        }
+        DataType merged = common_type(column.type, part.type);
+        column.widen(merged);
+        part.widen(merged);
+        column.append_column(part);
+    }
+}
+
+// one encapsulated message at pos: its metadata and body; false at an end-of-stream marker
+static bool read_message(std::string_view data, size_t& pos, std::string_view& metadata, std::string_view& body) {
+    if (pos + 4 > data.size()) return false;
+    uint32_t length;
+    std::memcpy(&length, data.data() + pos, 4);
+    pos += 4;
+    // streams written before 0.15 have no continuation marker
+    if (length == CONTINUATION) {
+        if (pos + 4 > data.size()) arrow_error("truncated message");
+        std::memcpy(&length, data.data() + pos, 4);
+        pos += 4;
+    }
+    if (length == 0) return false;
+    if (length > data.size() - pos) arrow_error("truncated message");
+    metadata = data.substr(pos, length);
+    pos += length;
+
+    auto body_length = FbTable::root(metadata).scalar<int64_t>(3, 0);
+    if (body_length < 0 || static_cast<uint64_t>(body_length) > data.size() - pos) arrow_error("truncated message body");
+    body = data.substr(pos, static_cast<size_t>(body_length));
+    pos += static_cast<size_t>(body_length);
+    return true;
+}
+
+void read_arrow_ipc(std::string_view data, std::vector<std::string>& features, std::vector<vegaColumn>& columns) {
+    if constexpr (std::endian::native != std::endian::little) {
+        throw std::runtime_error("Arrow IPC import is only supported on little-endian hosts");
+    }
+    features.clear();
+    columns.clear();
+
+    std::vector<ArrowField> fields;
+    bool has_schema = false;
+    auto handle = [&](std::string_view metadata, std::string_view body) {
+        FbTable message = FbTable::root(metadata);
+        uint8_t header_type = message.scalar<uint8_t>(1, 0);
+        if (header_type == HEADER_SCHEMA) {
+            fields = parse_schema(message.table(2));
+            for (const auto& field : fields) features.push_back(field.name);
+            columns.assign(fields.size(), vegaColumn(DataType::INT));
+            has_schema = true;
+        } else if (header_type == HEADER_RECORD_BATCH) {
+            if (!has_schema) arrow_error("record batch before the schema");
+            read_record_batch(message.table(2), body, fields, columns);
+        } else if (header_type == HEADER_DICTIONARY_BATCH) {
+            throw std::runtime_error("Arrow dictionary batches are not supported");
+        }
+    };
+
+    std::string_view metadata;
+    std::string_view body;
+    bool is_file = data.size() >= 14 && data.substr(0, 6) == ARROW_MAGIC && data.substr(data.size() - 6) == ARROW_MAGIC;
+    if (!is_file) {
+        size_t pos = 0;
+        while (read_message(data, pos, metadata, body)) handle(metadata, body);
+        if (!has_schema) arrow_error("no schema message");
+        return;
+    }
+
+    // the footer lists the schema and the position of every record batch
+    int32_t footer_length;
+    std::memcpy(&footer_length, data.data() + data.size() - 10, 4);
+    if (footer_length <= 0 || static_cast<size_t>(footer_length) > data.size() - 18) arrow_error("invalid footer");
+    std::string_view footer_bytes = data.substr(data.size() - 10 - static_cast<size_t>(footer_length),
+                                                static_cast<size_t>(footer_length));
+    FbTable footer = FbTable::root(footer_bytes);
+    fields = parse_schema(footer.table(1));
+    for (const auto& field : fields) features.push_back(field.name);
+    columns.assign(fields.size(), vegaColumn(DataType::INT));
+    has_schema = true;
+
+    size_t first = 0;
+    if (footer.vector(2, first) > 0) throw std::runtime_error("Arrow dictionary batches are not supported");
+    size_t batch_count = footer.vector(3, first);
+    for (size_t b = 0; b < batch_count; ++b) {
+        auto offset = footer.read<int64_t>(first + b * 24);
+        if (offset < 0 || static_cast<uint64_t>(offset) >= data.size()) arrow_error("invalid record batch block");
+        auto pos = static_cast<size_t>(offset);
+        if (!read_message(data, pos, metadata, body)) arrow_error("invalid record batch block");
+        handle(metadata, body);
+    }
+}
@@ -0,0 +1,38 @@
+#ifndef VEGA_VEGAARROW_H
+#define VEGA_VEGAARROW_H
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "vegaColumn.h"
+
+// Apache Arrow IPC (columnar format version 1.0, metadata V5), implemented against the spec
+// with a minimal in-tree FlatBuffers encoder/decoder.
+//
+// The column storage already is an Arrow layout: validity words are an LSB-first bitmap,
+// INT is Int64, FLOAT is Float64 (Double), STRING is LargeUtf8 (int64 offsets followed by
+// the bytes) and DATETIME is Timestamp(NANOSECOND). Exported buffers are written straight from
+// the columns (CATEGORY columns are decoded and written as LargeUtf8), and imported buffers of
+// those types are copied into a column with one memcpy each. Other Arrow types convert:
+// Int8..UInt64 and Bool load as INT (UInt64 as FLOAT when a value exceeds the INT range),
+// Float32 as FLOAT, Utf8, Binary and LargeBinary as STRING, Date32/Date64 and Timestamps of
+// any unit (in UTC, whatever their time zone) as DATETIME and Null as an all-null column.
+// As everywhere in vegaColumn, an empty string loads as null.
+// Dictionary-encoded fields, nested types and compressed bodies are rejected.
+enum class ArrowIpcFormat {
+    // "ARROW1" magic, messages and a footer indexing them (.arrow / .feather files)
+    FILE,
+    // messages only, ended by an end-of-stream marker
+    STREAM
+};
+
+// writes the schema and one record batch holding every row
+void write_arrow_ipc(std::ostream& out, const std::vector<std::string>& features, const std::vector<vegaColumn>& columns,
+                     ArrowIpcFormat format = ArrowIpcFormat::FILE);
+// Reads every record batch of an Arrow IPC file or stream (told apart by the magic) and
+// appends them into columns. Malformed input throws std::runtime_error.
+void read_arrow_ipc(std::string_view data, std::vector<std::string>& features, std::vector<vegaColumn>& columns);
+
+#endif // VEGA_VEGAARROW_H
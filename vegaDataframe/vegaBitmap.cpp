@@ -0,0 +1,106 @@
+#include "vegaBitmap.h"
+#include <stdexcept>
+
+vegaBitmap::vegaBitmap(size_t size, bool value) {
+    resize(size, value);
+}
+
+// ============= ACCESS =============
+
+uint64_t vegaBitmap::word_mask(size_t w) const {
+    size_t tail = length & 63;
+    if (w + 1 < words.size() || tail == 0) return ~uint64_t{0};
+    return (uint64_t{1} << tail) - 1;
+}
+
+size_t vegaBitmap::count() const {
+    size_t total = 0;
+    for (uint64_t w : words) {
+        total += static_cast<size_t>(std::popcount(w));
+    }
+    return total;
+}
+
+std::vector<size_t> vegaBitmap::set_indices() const {
+    std::vector<size_t> indices;
+    indices.reserve(count());
+    for_each_set([&indices](size_t i) { indices.push_back(i); });
+    return indices;
+}
+
+// ============= MODIFICATION =============
+
+void vegaBitmap::push_back(bool value) {
+    if ((length & 63) == 0) words.push_back(0);
+    if (value) set(length);
+    length++;
+}
+
+void vegaBitmap::append(const vegaBitmap& other) {
+    size_t shift = length & 63;
+    if (shift == 0) {
+        words.insert(words.end(), other.words.begin(), other.words.end());
+    } else {
+        words.reserve((length + other.length + 63) >> 6);
+        for (uint64_t w : other.words) {
+            words.back() |= w << shift;
+            words.push_back(w >> (64 - shift));
+        }
+    }
+    length += other.length;
+    // the last pushed word is empty when the tail fitted into the previous one
+    words.resize((length + 63) >> 6);
+}
+
+void vegaBitmap::resize(size_t bits, bool value) {
+    size_t old_length = length;
+    words.resize((bits + 63) >> 6, value ? ~uint64_t{0} : 0);
+    length = bits;
+
+    // bits between the old end and the next word boundary were zero
+    if (value && bits > old_length && (old_length & 63) != 0) {
+        words[old_length >> 6] |= ~uint64_t{0} << (old_length & 63);
+    }
+    if (!words.empty()) {
+        words.back() &= word_mask(words.size() - 1);
+    }
+}
+
+void vegaBitmap::clear() {
+    words.clear();
+    length = 0;
+}
+
+// ============= BITWISE OPERATIONS =============
+
+vegaBitmap& vegaBitmap::operator&=(const vegaBitmap& other) {
+    if (other.length != length) throw std::runtime_error("Bitmap sizes do not match");
+    for (size_t w = 0; w < words.size(); ++w) words[w] &= other.words[w];
+    return *this;
+}
+
+vegaBitmap& vegaBitmap::operator|=(const vegaBitmap& other) {
+    if (other.length != length) throw std::runtime_error("Bitmap sizes do not match");
+    for (size_t w = 0; w < words.size(); ++w) words[w] |= other.words[w];
+    return *this;
+}
+
+vegaBitmap& vegaBitmap::flip() {
+    for (size_t w = 0; w < words.size(); ++w) words[w] = ~words[w] & word_mask(w);
+    return *this;
+}
+
+vegaBitmap operator&(vegaBitmap left, const vegaBitmap& right) {
+    left &= right;
+    return left;
+}
+
+vegaBitmap operator|(vegaBitmap left, const vegaBitmap& right) {
+    left |= right;
+    return left;
+}
+
+vegaBitmap operator~(vegaBitmap bitmap) {
+    bitmap.flip();
+    return bitmap;
+}
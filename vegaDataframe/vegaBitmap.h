@@ -0,0 +1,69 @@
+#ifndef VEGA_VEGABITMAP_H
+#define VEGA_VEGABITMAP_H
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Packed bit vector, 1 bit per row stored in 64-bit words (bit i lives in word i / 64).
+// Bits past size() in the last word are always kept at zero so that whole-word
+// operations and popcounts never see garbage.
+class vegaBitmap {
+public:
+    std::vector<uint64_t> words;
+    size_t length = 0;
+
+    vegaBitmap() = default;
+    explicit vegaBitmap(size_t size, bool value = false);
+
+    // ============= ACCESS =============
+    [[nodiscard]] size_t size() const { return length; }
+    [[nodiscard]] size_t word_count() const { return words.size(); }
+    [[nodiscard]] bool get(size_t i) const { return (words[i >> 6] >> (i & 63)) & 1; }
+    [[nodiscard]] uint64_t word(size_t w) const { return words[w]; }
+    // mask of the bits of word w that lie inside the bitmap
+    [[nodiscard]] uint64_t word_mask(size_t w) const;
+    // number of set bits
+    [[nodiscard]] size_t count() const;
+    [[nodiscard]] bool all() const { return count() == length; }
+    [[nodiscard]] bool none() const { return count() == 0; }
+    // positions of the set bits in increasing order
+    [[nodiscard]] std::vector<size_t> set_indices() const;
+    [[nodiscard]] size_t memory_usage() const { return words.capacity() * sizeof(uint64_t); }
+    bool operator==(const vegaBitmap& other) const = default;
+
+    // calls fn(i) for every set bit, skipping zero words
+    template <typename Fn>
+    void for_each_set(Fn&& fn) const {
+        for (size_t w = 0; w < words.size(); ++w) {
+            uint64_t bits = words[w];
+            while (bits) {
+                fn((w << 6) + static_cast<size_t>(std::countr_zero(bits)));
+                bits &= bits - 1;
+            }
+        }
+    }
+
+    // ============= MODIFICATION =============
+    void set(size_t i) { words[i >> 6] |= uint64_t{1} << (i & 63); }
+    void reset(size_t i) { words[i >> 6] &= ~(uint64_t{1} << (i & 63)); }
+    void assign(size_t i, bool value) { value ? set(i) : reset(i); }
+    void push_back(bool value);
+    // appends all bits of other, shifting whole words when this bitmap does not end on a word boundary
+    void append(const vegaBitmap& other);
+    void reserve(size_t bits) { words.reserve((bits + 63) >> 6); }
+    void resize(size_t bits, bool value = false);
+    void clear();
+
+    // ============= BITWISE OPERATIONS =============
+    vegaBitmap& operator&=(const vegaBitmap& other);
+    vegaBitmap& operator|=(const vegaBitmap& other);
+    vegaBitmap& flip();
+};
+
+vegaBitmap operator&(vegaBitmap left, const vegaBitmap& right);
+vegaBitmap operator|(vegaBitmap left, const vegaBitmap& right);
+vegaBitmap operator~(vegaBitmap bitmap);
+
+#endif // VEGA_VEGABITMAP_H
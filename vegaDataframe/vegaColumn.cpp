@@ -0,0 +1,491 @@
+#include "vegaColumn.h"
+#include "vegaDatetime.h"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <stdexcept>
+#include <unordered_map>
+
+// ============= PARSING AND FORMATTING =============
+
+// drops a leading '+', which from_chars does not take; false for an empty rest or a second sign
+static bool strip_plus(std::string_view& text) {
+    if (!text.empty() && text.front() == '+') {
+        text.remove_prefix(1);
+        if (!text.empty() && text.front() == '-') return false;
+    }
+    return !text.empty();
+}
+
+bool parse_int64(std::string_view text, int64_t& value) {
+    if (!strip_plus(text)) return false;
+    const char* end = text.data() + text.size();
+    auto [ptr, ec] = std::from_chars(text.data(), end, value);
+    return ec == std::errc() && ptr == end;
+}
+
+bool parse_double(std::string_view text, double& value) {
+    if (!strip_plus(text)) return false;
+    const char* end = text.data() + text.size();
+    auto [ptr, ec] = std::from_chars(text.data(), end, value);
+    return ec == std::errc() && ptr == end;
+}
+
+bool parse_decimal(std::string_view text, double& value) {
+    std::string_view digits = text;
+    if (!digits.empty() && (digits.front() == '+' || digits.front() == '-')) digits.remove_prefix(1);
+    if (digits.empty() || !(std::isdigit(static_cast<unsigned char>(digits.front())) || digits.front() == '.')) {
+        return false;
+    }
+    return parse_double(text, value);
+}
+
+std::string format_int64(int64_t value) {
+    char buffer[24];
+    auto [ptr, ec] = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    return std::string(buffer, ptr);
+}
+
+std::string format_double(double value) {
+    char buffer[32];
+    auto [ptr, ec] = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    return std::string(buffer, ptr);
+}
+
+CompareOp parse_compare_op(const std::string& op) {
+    static const std::unordered_map<std::string, CompareOp> ops = {
+        {"==", CompareOp::EQ}, {"!=", CompareOp::NE}, {"<", CompareOp::LT},
+        {"<=", CompareOp::LE}, {">", CompareOp::GT},  {">=", CompareOp::GE}};
+    auto it = ops.find(op);
+    if (it == ops.end()) throw std::runtime_error("Unsupported comparison operator: " + op);
+    return it->second;
+}
+
+bool compare_result(CompareOp op, int order) {
+    switch (op) {
+        case CompareOp::EQ: return order == 0;
+        case CompareOp::NE: return order != 0;
+        case CompareOp::LT: return order < 0;
+        case CompareOp::LE: return order <= 0;
+        case CompareOp::GT: return order > 0;
+        case CompareOp::GE: return order >= 0;
+    }
+    return false;
+}
+
+DataType common_type(DataType a, DataType b) {
+    if (a == b) return a;
+    if (!is_numeric_type(a) || !is_numeric_type(b)) return DataType::STRING;
+    return std::max(a, b);
+}
+
+// ============= CONSTRUCTION =============
+
+vegaColumn::vegaColumn(DataType dtype) : type(dtype) {}
+
+vegaColumn vegaColumn::from_strings(const std::vector<std::string>& values, DataType dtype) {
+    vegaColumn column(dtype);
+    column.reserve(values.size());
+    for (const auto& value : values) {
+        column.append_value(value);
+    }
+    return column;
+}
+
+// ============= ACCESS =============
+
+size_t vegaColumn::null_count() const {
+    return validity.size() - validity.count();
+}
+
+std::string_view vegaColumn::string_at(size_t row) const {
+    if (type == DataType::CATEGORY) return category(int_data[row]);
+    return {string_data.data() + string_offsets[row], string_offsets[row + 1] - string_offsets[row]};
+}
+
+double vegaColumn::numeric_at(size_t row) const {
+    return type == DataType::INT ? static_cast<double>(int_data[row]) : float_data[row];
+}
+
+std::string vegaColumn::to_string(size_t row) const {
+    if (is_null(row)) return "";
+
+    switch (type) {
+        case DataType::INT: return format_int64(int_data[row]);
+        case DataType::FLOAT: return format_double(float_data[row]);
+        case DataType::DATETIME: return format_datetime(int_data[row]);
+        default: return std::string(string_at(row));
+    }
+}
+
+void vegaColumn::format_to(size_t row, std::string& out) const {
+    if (is_null(row)) return;
+
+    char buffer[32];
+    if (type == DataType::INT) {
+        out.append(buffer, std::to_chars(buffer, buffer + sizeof(buffer), int_data[row]).ptr);
+    } else if (type == DataType::FLOAT) {
+        out.append(buffer, std::to_chars(buffer, buffer + sizeof(buffer), float_data[row]).ptr);
+    } else if (type == DataType::DATETIME) {
+        format_datetime(int_data[row], out);
+    } else {
+        out.append(string_at(row));
+    }
+}
+
+int vegaColumn::compare(size_t a, size_t b) const {
+    if (is_null(a) || is_null(b)) return static_cast<int>(!is_null(a)) - static_cast<int>(!is_null(b));
+
+    switch (type) {
+        case DataType::INT:
+        case DataType::DATETIME: return (int_data[a] > int_data[b]) - (int_data[a] < int_data[b]);
+        case DataType::FLOAT: return (float_data[a] > float_data[b]) - (float_data[a] < float_data[b]);
+        default: {
+            int cmp = string_at(a).compare(string_at(b));
+            return (cmp > 0) - (cmp < 0);
+        }
+    }
+}
+
+size_t vegaColumn::memory_usage() const {
+    return int_data.capacity() * sizeof(int64_t) +
+           float_data.capacity() * sizeof(double) +
+           string_offsets.capacity() * sizeof(uint64_t) +
+           string_data.capacity() +
+           validity.memory_usage();
+}
+
+bool vegaColumn::operator==(const vegaColumn& other) const {
+    if (type != other.type || validity != other.validity) return false;
+
+    for (size_t row = 0; row < size(); ++row) {
+        if (is_null(row)) continue;
+
+        switch (type) {
+            case DataType::INT:
+            case DataType::DATETIME:
+                if (int_data[row] != other.int_data[row]) return false;
+                break;
+            case DataType::FLOAT:
+                if (float_data[row] != other.float_data[row]) return false;
+                break;
+            default:
+                if (string_at(row) != other.string_at(row)) return false;
+        }
+    }
+    return true;
+}
+
+// ============= CATEGORIES =============
+
+std::string_view vegaColumn::category(int64_t code) const {
+    auto index = static_cast<size_t>(code);
+    return {string_data.data() + string_offsets[index], string_offsets[index + 1] - string_offsets[index]};
+}
+
+int64_t vegaColumn::find_category(std::string_view value) const {
+    if (category_index.codes.size() == category_count()) {
+        auto it = category_index.codes.find(value);
+        return it == category_index.codes.end() ? -1 : it->second;
+    }
+    for (size_t code = 0; code < category_count(); ++code) {
+        if (category(static_cast<int64_t>(code)) == value) return static_cast<int64_t>(code);
+    }
+    return -1;
+}
+
+int64_t vegaColumn::add_category(std::string_view value) {
+    auto& codes = category_index.codes;
+    if (codes.size() != category_count()) {
+        codes.clear();
+        codes.reserve(category_count());
+        for (size_t code = 0; code < category_count(); ++code) {
+            codes.emplace(category(static_cast<int64_t>(code)), static_cast<int64_t>(code));
+        }
+    }
+    auto it = codes.find(value);
+    if (it != codes.end()) return it->second;
+
+    auto code = static_cast<int64_t>(category_count());
+    string_data.insert(string_data.end(), value.begin(), value.end());
+    string_offsets.push_back(string_data.size());
+    codes.emplace(std::string(value), code);
+    return code;
+}
+
+// ============= BUILDING =============
+
+void vegaColumn::reserve(size_t rows) {
+    validity.reserve(rows);
+    if (has_int_data()) int_data.reserve(rows);
+    else if (type == DataType::FLOAT) float_data.reserve(rows);
+    else string_offsets.reserve(rows + 1);
+}
+
+void vegaColumn::append_null() {
+    validity.push_back(false);
+    if (has_int_data()) int_data.push_back(0);
+    else if (type == DataType::FLOAT) float_data.push_back(0.0);
+    else string_offsets.push_back(string_data.size());
+}
+
+void vegaColumn::append_int(int64_t value) {
+    if (type == DataType::INT || type == DataType::DATETIME) {
+        int_data.push_back(value);
+        validity.push_back(true);
+    } else if (type == DataType::FLOAT) {
+        append_float(static_cast<double>(value));
+    } else {
+        append_string(format_int64(value));
+    }
+}
+
+void vegaColumn::append_float(double value) {
+    if (type == DataType::INT) widen(DataType::FLOAT);
+
+    if (type == DataType::FLOAT) {
+        float_data.push_back(value);
+        validity.push_back(true);
+    } else {
+        append_string(format_double(value));
+    }
+}
+
+void vegaColumn::append_string(std::string_view value) {
+    if (value.empty()) {
+        append_null();
+        return;
+    }
+    if (type == DataType::CATEGORY) {
+        int_data.push_back(add_category(value));
+        validity.push_back(true);
+        return;
+    }
+    int64_t ns;
+    if (type == DataType::DATETIME && parse_datetime(value, ns)) {
+        int_data.push_back(ns);
+        validity.push_back(true);
+        return;
+    }
+    if (type != DataType::STRING) widen(DataType::STRING);
+
+    string_data.insert(string_data.end(), value.begin(), value.end());
+    string_offsets.push_back(string_data.size());
+    validity.push_back(true);
+}
+
+void vegaColumn::append_value(std::string_view cell) {
+    if (cell.empty()) {
+        append_null();
+        return;
+    }
+
+    if (type == DataType::INT) {
+        int64_t int_value;
+        if (parse_int64(cell, int_value)) {
+            append_int(int_value);
+            return;
+        }
+    }
+    // an INT column only widens for a decimal number, as type inference reads them
+    if (is_numeric()) {
+        double float_value;
+        if (type == DataType::INT ? parse_decimal(cell, float_value) : parse_double(cell, float_value)) {
+            append_float(float_value);
+            return;
+        }
+    }
+    append_string(cell);
+}
+
+void vegaColumn::append_from(const vegaColumn& other, size_t row) {
+    if (other.is_null(row)) {
+        append_null();
+        return;
+    }
+
+    switch (other.type) {
+        case DataType::INT: append_int(other.int_data[row]); break;
+        case DataType::FLOAT: append_float(other.float_data[row]); break;
+        case DataType::DATETIME:
+            if (type == DataType::DATETIME) {
+                int_data.push_back(other.int_data[row]);
+                validity.push_back(true);
+            } else {
+                append_string(other.to_string(row));
+            }
+            break;
+        default:
+            if (!is_numeric()) append_string(other.string_at(row));
+            else append_value(other.string_at(row));
+    }
+}
+
+void vegaColumn::append_column(const vegaColumn& other) {
+    if (other.type != type) throw std::runtime_error("Cannot append a column of a different type");
+
+    if (type == DataType::INT || type == DataType::DATETIME) {
+        int_data.insert(int_data.end(), other.int_data.begin(), other.int_data.end());
+    } else if (type == DataType::CATEGORY) {
+        // codes of the other column are remapped onto this dictionary
+        std::vector<int64_t> codes(other.category_count());
+        for (size_t code = 0; code < codes.size(); ++code) {
+            codes[code] = add_category(other.category(static_cast<int64_t>(code)));
+        }
+        int_data.reserve(int_data.size() + other.size());
+        for (size_t row = 0; row < other.size(); ++row) {
+            int_data.push_back(other.is_null(row) ? 0 : codes[static_cast<size_t>(other.int_data[row])]);
+        }
+    } else if (type == DataType::FLOAT) {
+        float_data.insert(float_data.end(), other.float_data.begin(), other.float_data.end());
+    } else {
+        uint64_t base = string_data.size();
+        string_offsets.reserve(string_offsets.size() + other.size());
+        for (size_t row = 1; row < other.string_offsets.size(); ++row) {
+            string_offsets.push_back(base + other.string_offsets[row]);
+        }
+        string_data.insert(string_data.end(), other.string_data.begin(), other.string_data.end());
+    }
+    validity.append(other.validity);
+}
+
+void vegaColumn::widen(DataType dtype) {
+    // a numeric type never narrows a column; CATEGORY and DATETIME are reached by conversion
+    if (dtype == type || (is_numeric_type(dtype) && (!is_numeric() || dtype < type))) return;
+
+    if (dtype == DataType::FLOAT) {
+        float_data.reserve(int_data.capacity());
+        float_data.assign(int_data.begin(), int_data.end());
+        int_data = {};
+        type = dtype;
+    } else {
+        *this = cast(dtype);
+    }
+}
+
+void vegaColumn::fill_nulls(std::string_view value) {
+    if (value.empty() || null_count() == 0) return;
+
+    // numeric columns can be patched in place when the value fits the type
+    int64_t int_value;
+    double float_value;
+    if ((type == DataType::INT && parse_int64(value, int_value)) ||
+        (type == DataType::FLOAT && parse_double(value, float_value))) {
+        // only words with a cleared bit need to be visited
+        for (size_t w = 0; w < validity.word_count(); ++w) {
+            uint64_t nulls = ~validity.word(w) & validity.word_mask(w);
+            while (nulls) {
+                size_t row = (w << 6) + static_cast<size_t>(std::countr_zero(nulls));
+                if (type == DataType::INT) int_data[row] = int_value;
+                else float_data[row] = float_value;
+                nulls &= nulls - 1;
+            }
+            validity.words[w] = validity.word_mask(w);
+        }
+        return;
+    }
+
+    vegaColumn filled(type);
+    filled.reserve(size());
+    for (size_t row = 0; row < size(); ++row) {
+        if (is_null(row)) filled.append_value(value);
+        else filled.append_from(*this, row);
+    }
+    *this = std::move(filled);
+}
+
+// ============= TRANSFORMATION =============
+
+vegaColumn vegaColumn::take(const std::vector<size_t>& indices) const {
+    vegaColumn result(type);
+    result.reserve(indices.size());
+    if (type == DataType::CATEGORY) {
+        result.string_offsets = string_offsets;
+        result.string_data = string_data;
+    }
+
+    for (size_t idx : indices) {
+        if (idx == npos) {
+            result.append_null();
+            continue;
+        }
+        result.validity.push_back(validity.get(idx));
+        if (has_int_data()) {
+            result.int_data.push_back(int_data[idx]);
+        } else if (type == DataType::FLOAT) {
+            result.float_data.push_back(float_data[idx]);
+        } else {
+            auto value = string_at(idx);
+            result.string_data.insert(result.string_data.end(), value.begin(), value.end());
+            result.string_offsets.push_back(result.string_data.size());
+        }
+    }
+    return result;
+}
+
+// truncates value toward zero; false for NaN, infinities and values outside int64
+static bool truncate_to_int64(double value, int64_t& out) {
+    double truncated = std::trunc(value);
+    if (!(truncated >= -9223372036854775808.0 && truncated < 9223372036854775808.0)) return false;
+    out = static_cast<int64_t>(truncated);
+    return true;
+}
+
+vegaColumn vegaColumn::cast(DataType dtype) const {
+    if (dtype == type) return *this;
+
+    vegaColumn result(dtype);
+    result.reserve(size());
+
+    for (size_t row = 0; row < size(); ++row) {
+        if (is_null(row)) {
+            result.append_null();
+            continue;
+        }
+
+        if (dtype == DataType::DATETIME) {
+            // numbers are taken as nanoseconds since the epoch
+            int64_t ns = 0;
+            bool converted = true;
+            if (type == DataType::INT) ns = int_data[row];
+            else if (type == DataType::FLOAT) converted = std::fabs(float_data[row]) < 9.2e18;
+            else converted = parse_datetime(string_at(row), ns);
+            if (!converted) throw std::runtime_error("Cannot convert value '" + to_string(row) + "' to datetime");
+            if (type == DataType::FLOAT) ns = static_cast<int64_t>(std::trunc(float_data[row]));
+            result.int_data.push_back(ns);
+            result.validity.push_back(true);
+        } else if (!is_numeric_type(dtype)) {
+            if (is_text()) result.append_string(string_at(row));
+            else result.append_string(to_string(row));
+        } else if (type == DataType::DATETIME) {
+            if (dtype == DataType::INT) result.append_int(int_data[row]);
+            else result.append_float(static_cast<double>(int_data[row]));
+        } else if (is_numeric()) {
+            double value = numeric_at(row);
+            int64_t int_value;
+            if (dtype == DataType::FLOAT) {
+                result.append_float(value);
+            } else if (truncate_to_int64(value, int_value)) {
+                result.append_int(int_value);
+            } else {
+                throw std::runtime_error("Cannot convert value '" + to_string(row) + "' to numeric type");
+            }
+        } else {
+            auto text = string_at(row);
+            int64_t int_value;
+            double float_value;
+            if (dtype == DataType::INT && parse_int64(text, int_value)) {
+                result.append_int(int_value);
+            } else if (dtype == DataType::FLOAT && parse_double(text, float_value)) {
+                result.append_float(float_value);
+            } else if (dtype == DataType::INT && parse_double(text, float_value) &&
+                       truncate_to_int64(float_value, int_value)) {
+                result.append_int(int_value);
+            } else {
+                throw std::runtime_error("Cannot convert value '" + std::string(text) + "' to numeric type");
+            }
+        }
+    }
+    return result;
+}
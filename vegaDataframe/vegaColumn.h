@@ -0,0 +1,161 @@
+#ifndef VEGA_VEGACOLUMN_H
+#define VEGA_VEGACOLUMN_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "vegaBitmap.h"
+
+// INT < FLOAT < STRING is the widening order; CATEGORY and DATETIME widen to STRING
+enum class DataType { INT, FLOAT, STRING, CATEGORY, DATETIME };
+
+inline bool is_numeric_type(DataType type) { return type == DataType::INT || type == DataType::FLOAT; }
+// the type a column must have to hold cells of both types
+DataType common_type(DataType a, DataType b);
+
+// comparison of a cell with a value, as used by filters and zone maps
+enum class CompareOp { EQ, NE, LT, LE, GT, GE };
+
+// Typed, contiguous storage for a single dataframe column.
+// INT columns keep their values in int_data, FLOAT columns in float_data and
+// STRING columns in one byte buffer (string_data) addressed by size() + 1 offsets.
+// CATEGORY columns keep one code per row in int_data and the distinct values (the
+// categories, in order of first appearance) in string_offsets/string_data.
+// DATETIME columns keep nanoseconds since the epoch in int_data (see vegaDatetime.h).
+// A cell is null when its validity bit is 0; an empty string is always stored as null.
+// Null slots still occupy a (zeroed) entry in the value buffer.
+class vegaColumn {
+public:
+    // row index that take() turns into a null cell
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    DataType type = DataType::STRING;
+    std::vector<int64_t> int_data;
+    std::vector<double> float_data;
+    std::vector<uint64_t> string_offsets{0};
+    std::vector<char> string_data;
+    vegaBitmap validity;
+
+    vegaColumn() = default;
+    explicit vegaColumn(DataType dtype);
+    //this function builds a column of the given type by parsing every value, widening the type if needed
+    static vegaColumn from_strings(const std::vector<std::string>& values, DataType dtype);
+
+    // ============= ACCESS =============
+    [[nodiscard]] size_t size() const { return validity.size(); }
+    [[nodiscard]] bool is_null(size_t row) const { return !validity.get(row); }
+    [[nodiscard]] size_t null_count() const;
+    [[nodiscard]] int64_t int_at(size_t row) const { return int_data[row]; }
+    [[nodiscard]] double float_at(size_t row) const { return float_data[row]; }
+    [[nodiscard]] std::string_view string_at(size_t row) const;
+    // INT and FLOAT cells as double; only valid for non-null cells of numeric columns
+    [[nodiscard]] double numeric_at(size_t row) const;
+    // textual form of a cell, "" for nulls
+    [[nodiscard]] std::string to_string(size_t row) const;
+    // appends the textual form of a cell to out without a temporary string
+    void format_to(size_t row, std::string& out) const;
+    [[nodiscard]] bool is_numeric() const { return is_numeric_type(type); }
+    // STRING and CATEGORY cells are read with string_at
+    [[nodiscard]] bool is_text() const { return type == DataType::STRING || type == DataType::CATEGORY; }
+    // INT, CATEGORY and DATETIME keep one int_data entry per row
+    [[nodiscard]] bool has_int_data() const {
+        return type == DataType::INT || type == DataType::CATEGORY || type == DataType::DATETIME;
+    }
+    // three-way comparison of two cells; nulls order before every value
+    [[nodiscard]] int compare(size_t a, size_t b) const;
+    [[nodiscard]] size_t memory_usage() const;
+    bool operator==(const vegaColumn& other) const;
+
+    // ============= CATEGORIES =============
+    [[nodiscard]] size_t category_count() const { return string_offsets.size() - 1; }
+    [[nodiscard]] std::string_view category(int64_t code) const;
+    // code of a category, -1 when the column does not hold it
+    [[nodiscard]] int64_t find_category(std::string_view value) const;
+    // code of a category, adding it when it is new
+    int64_t add_category(std::string_view value);
+
+    // calls fn(row, value) for every non-null cell of an INT or FLOAT column;
+    // fully valid 64-row words run without per-row null checks
+    template <typename Fn>
+    void for_each_numeric(Fn&& fn) const {
+        if (type == DataType::INT) {
+            for_each_valid(int_data, fn);
+        } else if (type == DataType::FLOAT) {
+            for_each_valid(float_data, fn);
+        }
+    }
+
+    // ============= BUILDING =============
+    void reserve(size_t rows);
+    void append_null();
+    // DATETIME columns take the value as nanoseconds since the epoch
+    void append_int(int64_t value);
+    void append_float(double value);
+    void append_string(std::string_view value);
+    // parses a cell according to the column type; widens INT -> FLOAT -> STRING when it does not fit
+    void append_value(std::string_view cell);
+    // copies one cell of another column, widening this column if the other one is wider
+    void append_from(const vegaColumn& other, size_t row);
+    // appends every cell of a column of the same type
+    void append_column(const vegaColumn& other);
+    void widen(DataType dtype);
+    // replaces every null cell with the parsed value
+    void fill_nulls(std::string_view value);
+
+    // ============= TRANSFORMATION =============
+    // gathers the given rows into a new column; npos entries become nulls
+    [[nodiscard]] vegaColumn take(const std::vector<size_t>& indices) const;
+    [[nodiscard]] vegaColumn cast(DataType dtype) const;
+
+private:
+    // category -> code, rebuilt on demand (a copy starts empty)
+    struct CategoryIndex {
+        struct Hash {
+            using is_transparent = void;
+            size_t operator()(std::string_view value) const { return std::hash<std::string_view>{}(value); }
+        };
+        std::unordered_map<std::string, int64_t, Hash, std::equal_to<>> codes;
+
+        CategoryIndex() = default;
+        CategoryIndex(const CategoryIndex&) {}
+        CategoryIndex(CategoryIndex&&) noexcept = default;
+        CategoryIndex& operator=(const CategoryIndex&) { codes.clear(); return *this; }
+        CategoryIndex& operator=(CategoryIndex&&) noexcept = default;
+    };
+    CategoryIndex category_index;
+
+    template <typename T, typename Fn>
+    void for_each_valid(const std::vector<T>& values, Fn& fn) const {
+        for (size_t w = 0; w < validity.word_count(); ++w) {
+            uint64_t bits = validity.word(w);
+            size_t base = w << 6;
+            if (bits == ~uint64_t{0}) {
+                for (size_t row = base; row < base + 64; ++row) fn(row, static_cast<double>(values[row]));
+                continue;
+            }
+            while (bits) {
+                size_t row = base + static_cast<size_t>(std::countr_zero(bits));
+                fn(row, static_cast<double>(values[row]));
+                bits &= bits - 1;
+            }
+        }
+    }
+};
+
+// ============= PARSING AND FORMATTING =============
+bool parse_int64(std::string_view text, int64_t& value);
+bool parse_double(std::string_view text, double& value);
+// parse_double without the nan and inf spellings: type inference only takes decimal numbers
+// for FLOAT, so such cells keep a column STRING
+bool parse_decimal(std::string_view text, double& value);
+std::string format_int64(int64_t value);
+std::string format_double(double value);
+// "==", "!=", "<", "<=", ">", ">="; anything else throws
+CompareOp parse_compare_op(const std::string& op);
+// applies op to a three-way comparison result (negative, zero or positive)
+bool compare_result(CompareOp op, int order);
+
+#endif // VEGA_VEGACOLUMN_H
@@ -0,0 +1,355 @@
+#include "vegaCompare.h"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "vegaDatetime.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE4_2__)
+#include <nmmintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// ============= COMPARE KERNELS =============
+
+template <CompareOp Op, typename T>
+static bool compare_one(T a, T b) {
+    if constexpr (Op == CompareOp::EQ) return a == b;
+    else if constexpr (Op == CompareOp::NE) return a != b;
+    else if constexpr (Op == CompareOp::LT) return a < b;
+    else if constexpr (Op == CompareOp::LE) return a <= b;
+    else if constexpr (Op == CompareOp::GT) return a > b;
+    else return a >= b;
+}
+
+// the right operand at position i: an array element or the broadcast scalar
+template <typename T>
+static T right_at(const T* right, size_t i) {
+    return right[i];
+}
+
+template <typename T>
+static T right_at(T right, size_t) {
+    return right;
+}
+
+// bits of positions [begin, begin + count), count <= 64
+template <CompareOp Op, typename T, typename Right>
+static uint64_t scalar_word(const T* left, Right right, size_t begin, size_t count) {
+    uint64_t bits = 0;
+    for (size_t i = 0; i < count; ++i) {
+        bits |= static_cast<uint64_t>(compare_one<Op>(left[begin + i], right_at(right, begin + i))) << i;
+    }
+    return bits;
+}
+
+#if defined(__AVX2__)
+static __m256i load_int64(const int64_t* values, size_t i) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i));
+}
+
+static __m256i load_int64(int64_t value, size_t) {
+    return _mm256_set1_epi64x(value);
+}
+
+static __m256d load_double(const double* values, size_t i) {
+    return _mm256_loadu_pd(values + i);
+}
+
+static __m256d load_double(double value, size_t) {
+    return _mm256_set1_pd(value);
+}
+
+// AVX2 has == and > on int64; the other operators swap or negate them
+template <CompareOp Op, typename Right>
+static uint64_t int64_word(const int64_t* left, Right right, size_t begin) {
+    uint64_t bits = 0;
+    for (size_t i = 0; i < 64; i += 4) {
+        __m256i a = load_int64(left, begin + i);
+        __m256i b = load_int64(right, begin + i);
+        __m256i hits;
+        if constexpr (Op == CompareOp::EQ || Op == CompareOp::NE) hits = _mm256_cmpeq_epi64(a, b);
+        else if constexpr (Op == CompareOp::GT || Op == CompareOp::LE) hits = _mm256_cmpgt_epi64(a, b);
+        else hits = _mm256_cmpgt_epi64(b, a);
+        auto lanes = static_cast<uint64_t>(_mm256_movemask_pd(_mm256_castsi256_pd(hits)));
+        if constexpr (Op == CompareOp::NE || Op == CompareOp::LE || Op == CompareOp::GE) lanes ^= 0xF;
+        bits |= lanes << i;
+    }
+    return bits;
+}
+
+template <CompareOp Op, typename Right>
+static uint64_t double_word(const double* left, Right right, size_t begin) {
+    // ordered predicates, except != which holds for NaN as in C++
+    constexpr int predicate = Op == CompareOp::EQ ? _CMP_EQ_OQ
+                            : Op == CompareOp::NE ? _CMP_NEQ_UQ
+                            : Op == CompareOp::LT ? _CMP_LT_OQ
+                            : Op == CompareOp::LE ? _CMP_LE_OQ
+                            : Op == CompareOp::GT ? _CMP_GT_OQ
+                                                  : _CMP_GE_OQ;
+    uint64_t bits = 0;
+    for (size_t i = 0; i < 64; i += 4) {
+        __m256d hits = _mm256_cmp_pd(load_double(left, begin + i), load_double(right, begin + i), predicate);
+        bits |= static_cast<uint64_t>(_mm256_movemask_pd(hits)) << i;
+    }
+    return bits;
+}
+#elif defined(__SSE2__)
+#if defined(__SSE4_2__)
+static __m128i load_int64(const int64_t* values, size_t i) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i));
+}
+
+static __m128i load_int64(int64_t value, size_t) {
+    return _mm_set1_epi64x(value);
+}
+
+template <CompareOp Op, typename Right>
+static uint64_t int64_word(const int64_t* left, Right right, size_t begin) {
+    uint64_t bits = 0;
+    for (size_t i = 0; i < 64; i += 2) {
+        __m128i a = load_int64(left, begin + i);
+        __m128i b = load_int64(right, begin + i);
+        __m128i hits;
+        if constexpr (Op == CompareOp::EQ || Op == CompareOp::NE) hits = _mm_cmpeq_epi64(a, b);
+        else if constexpr (Op == CompareOp::GT || Op == CompareOp::LE) hits = _mm_cmpgt_epi64(a, b);
+        else hits = _mm_cmpgt_epi64(b, a);
+        auto lanes = static_cast<uint64_t>(_mm_movemask_pd(_mm_castsi128_pd(hits)));
+        if constexpr (Op == CompareOp::NE || Op == CompareOp::LE || Op == CompareOp::GE) lanes ^= 0x3;
+        bits |= lanes << i;
+    }
+    return bits;
+}
+#else
+// SSE2 has no 64-bit integer compare
+template <CompareOp Op, typename Right>
+static uint64_t int64_word(const int64_t* left, Right right, size_t begin) {
+    return scalar_word<Op>(left, right, begin, 64);
+}
+#endif
+
+static __m128d load_double(const double* values, size_t i) {
+    return _mm_loadu_pd(values + i);
+}
+
+static __m128d load_double(double value, size_t) {
+    return _mm_set1_pd(value);
+}
+
+template <CompareOp Op, typename Right>
+static uint64_t double_word(const double* left, Right right, size_t begin) {
+    uint64_t bits = 0;
+    for (size_t i = 0; i < 64; i += 2) {
+        __m128d a = load_double(left, begin + i);
+        __m128d b = load_double(right, begin + i);
+        __m128d hits;
+        if constexpr (Op == CompareOp::EQ) hits = _mm_cmpeq_pd(a, b);
+        else if constexpr (Op == CompareOp::NE) hits = _mm_cmpneq_pd(a, b);
+        else if constexpr (Op == CompareOp::LT) hits = _mm_cmplt_pd(a, b);
+        else if constexpr (Op == CompareOp::LE) hits = _mm_cmple_pd(a, b);
+        else if constexpr (Op == CompareOp::GT) hits = _mm_cmpgt_pd(a, b);
+        else hits = _mm_cmpge_pd(a, b);
+        bits |= static_cast<uint64_t>(_mm_movemask_pd(hits)) << i;
+    }
+    return bits;
+}
+#else
+template <CompareOp Op, typename Right>
+static uint64_t int64_word(const int64_t* left, Right right, size_t begin) {
+    return scalar_word<Op>(left, right, begin, 64);
+}
+
+template <CompareOp Op, typename Right>
+static uint64_t double_word(const double* left, Right right, size_t begin) {
+    return scalar_word<Op>(left, right, begin, 64);
+}
+#endif
+
+template <CompareOp Op, typename T, typename Right>
+static void compare_words(const T* left, Right right, size_t count, uint64_t* out) {
+    size_t full = count / 64;
+    for (size_t w = 0; w < full; ++w) {
+        if constexpr (std::is_same_v<T, int64_t>) out[w] = int64_word<Op>(left, right, w * 64);
+        else out[w] = double_word<Op>(left, right, w * 64);
+    }
+    if (count % 64 != 0) out[full] = scalar_word<Op>(left, right, full * 64, count % 64);
+}
+
+// instantiates the kernel per operator so that the comparison is a compile-time constant
+template <typename T, typename Right>
+static void compare_dispatch(CompareOp op, const T* left, Right right, size_t count, uint64_t* out) {
+    switch (op) {
+        case CompareOp::EQ: compare_words<CompareOp::EQ>(left, right, count, out); break;
+        case CompareOp::NE: compare_words<CompareOp::NE>(left, right, count, out); break;
+        case CompareOp::LT: compare_words<CompareOp::LT>(left, right, count, out); break;
+        case CompareOp::LE: compare_words<CompareOp::LE>(left, right, count, out); break;
+        case CompareOp::GT: compare_words<CompareOp::GT>(left, right, count, out); break;
+        case CompareOp::GE: compare_words<CompareOp::GE>(left, right, count, out); break;
+    }
+}
+
+void compare_int64(CompareOp op, const int64_t* left, const int64_t* right, size_t count, uint64_t* out) {
+    compare_dispatch(op, left, right, count, out);
+}
+
+void compare_int64(CompareOp op, const int64_t* left, int64_t value, size_t count, uint64_t* out) {
+    compare_dispatch(op, left, value, count, out);
+}
+
+void compare_double(CompareOp op, const double* left, const double* right, size_t count, uint64_t* out) {
+    compare_dispatch(op, left, right, count, out);
+}
+
+void compare_double(CompareOp op, const double* left, double value, size_t count, uint64_t* out) {
+    compare_dispatch(op, left, value, count, out);
+}
+
+const char* compare_kernel_name() {
+#if defined(__AVX2__)
+    return "avx2";
+#elif defined(__SSE4_2__)
+    return "sse4.2";
+#elif defined(__SSE2__)
+    return "sse2";
+#else
+    return "scalar";
+#endif
+}
+
+// ============= SCALAR COMPARISONS =============
+
+vegaCompareValue::vegaCompareValue(CompareOp op, std::string_view text, DataType dtype) : op(op) {
+    if (dtype == DataType::DATETIME) {
+        has_int = parse_datetime(text, int_value) || parse_int64(text, int_value);
+        return;
+    }
+    has_int = parse_int64(text, int_value);
+    has_number = parse_double(text, number);
+}
+
+bool vegaCompareValue::matches_int(int64_t cell) const {
+    if (has_int) return compare_values(op, cell, int_value);
+    if (has_number) return compare_values(op, static_cast<double>(cell), number);
+    return op == CompareOp::NE;
+}
+
+bool vegaCompareValue::matches_double(double cell) const {
+    if (has_number) return compare_values(op, cell, number);
+    return op == CompareOp::NE;
+}
+
+// ============= COLUMN COMPARISONS =============
+
+// INT columns compared as doubles are converted in blocks of this many rows (a multiple of 64)
+static constexpr size_t COMPARE_BLOCK_ROWS = 2048;
+
+// numeric values of rows [begin, begin + count) as doubles, converted into buffer when needed
+static const double* doubles_at(const vegaColumn& column, size_t begin, size_t count, double* buffer) {
+    if (column.type == DataType::FLOAT) return column.float_data.data() + begin;
+    const int64_t* values = column.int_data.data() + begin;
+    for (size_t i = 0; i < count; ++i) buffer[i] = static_cast<double>(values[i]);
+    return buffer;
+}
+
+// packs test(row) for every row into a bitmap
+template <typename Test>
+static vegaBitmap pack_rows(size_t rows, const Test& test) {
+    vegaBitmap result(rows);
+    for (size_t w = 0; w < result.word_count(); ++w) {
+        uint64_t bits = 0;
+        size_t count = std::min<size_t>(64, rows - w * 64);
+        for (size_t i = 0; i < count; ++i) bits |= static_cast<uint64_t>(test(w * 64 + i)) << i;
+        result.words[w] = bits;
+    }
+    return result;
+}
+
+vegaBitmap compare_columns(const vegaColumn& left, CompareOp op, const vegaColumn& right) {
+    size_t rows = left.size();
+    if (right.size() != rows) {
+        throw std::runtime_error("Cannot compare columns of " + std::to_string(rows) + " and " +
+                                 std::to_string(right.size()) + " rows");
+    }
+
+    vegaBitmap result(rows);
+    bool int_pair = left.type == right.type && (left.type == DataType::INT || left.type == DataType::DATETIME);
+    if (int_pair) {
+        compare_int64(op, left.int_data.data(), right.int_data.data(), rows, result.words.data());
+    } else if (left.type == DataType::FLOAT && right.type == DataType::FLOAT) {
+        compare_double(op, left.float_data.data(), right.float_data.data(), rows, result.words.data());
+    } else if (left.is_numeric() && right.is_numeric()) {
+        std::vector<double> left_buffer(COMPARE_BLOCK_ROWS);
+        std::vector<double> right_buffer(COMPARE_BLOCK_ROWS);
+        for (size_t begin = 0; begin < rows; begin += COMPARE_BLOCK_ROWS) {
+            size_t count = std::min(COMPARE_BLOCK_ROWS, rows - begin);
+            compare_double(op, doubles_at(left, begin, count, left_buffer.data()),
+                           doubles_at(right, begin, count, right_buffer.data()), count,
+                           result.words.data() + begin / 64);
+        }
+    } else if (left.is_text() && right.is_text()) {
+        result = pack_rows(rows, [&](size_t row) {
+            return !left.is_null(row) && !right.is_null(row) &&
+                   compare_result(op, left.string_at(row).compare(right.string_at(row)));
+        });
+    } else {
+        result = pack_rows(rows, [&](size_t row) {
+            return !left.is_null(row) && !right.is_null(row) &&
+                   compare_result(op, left.to_string(row).compare(right.to_string(row)));
+        });
+    }
+    result &= left.validity;
+    result &= right.validity;
+    return result;
+}
+
+vegaBitmap compare_scalar(const vegaColumn& column, CompareOp op, std::string_view value) {
+    size_t rows = column.size();
+    // null tests only need the validity bits
+    if (value.empty()) {
+        if (op == CompareOp::EQ) return ~column.validity;
+        if (op == CompareOp::NE) return column.validity;
+        return vegaBitmap(rows);
+    }
+
+    vegaBitmap result(rows);
+    if (column.type == DataType::CATEGORY) {
+        // categories are compared once and the rows are matched on their codes
+        std::vector<char> hits(column.category_count());
+        for (size_t code = 0; code < hits.size(); ++code) {
+            hits[code] = compare_result(op, column.category(static_cast<int64_t>(code)).compare(value));
+        }
+        result = pack_rows(rows, [&](size_t row) {
+            return !column.is_null(row) && hits[static_cast<size_t>(column.int_data[row])];
+        });
+    } else if (column.type == DataType::STRING) {
+        result = pack_rows(rows, [&](size_t row) {
+            return !column.is_null(row) && compare_result(op, column.string_at(row).compare(value));
+        });
+    } else {
+        // read as in matching_rows and the encoded kernels
+        vegaCompareValue literal(op, value, column.type);
+        bool numeric = column.is_numeric() && literal.has_number;
+
+        if ((column.type == DataType::INT || column.type == DataType::DATETIME) && literal.has_int) {
+            compare_int64(op, column.int_data.data(), literal.int_value, rows, result.words.data());
+        } else if (column.type == DataType::FLOAT && numeric) {
+            compare_double(op, column.float_data.data(), literal.number, rows, result.words.data());
+        } else if (numeric) {
+            std::vector<double> buffer(COMPARE_BLOCK_ROWS);
+            for (size_t begin = 0; begin < rows; begin += COMPARE_BLOCK_ROWS) {
+                size_t count = std::min(COMPARE_BLOCK_ROWS, rows - begin);
+                compare_double(op, doubles_at(column, begin, count, buffer.data()), literal.number, count,
+                               result.words.data() + begin / 64);
+            }
+        } else if (op == CompareOp::NE) {
+            // a numeric or datetime cell never equals a value of another kind
+            result = column.validity;
+        }
+    }
+    result &= column.validity;
+    return result;
+}
@@ -0,0 +1,66 @@
+#ifndef VEGA_VEGACOMPARE_H
+#define VEGA_VEGACOMPARE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include "vegaBitmap.h"
+#include "vegaColumn.h"
+
+// ============= COMPARE KERNELS =============
+// Packed comparisons: bit i of out (word i / 64) is "left[i] op right[i]", or "left[i] op value",
+// for i < count; the bits past count in the last word are zero. Whole words of 64 values are
+// compared with AVX2 (4 lanes), SSE4.2 for int64 / SSE2 for doubles (2 lanes), whichever the
+// compiler targets, and the tail with scalar code. Doubles compare like C++: a NaN is only
+// unequal.
+void compare_int64(CompareOp op, const int64_t* left, const int64_t* right, size_t count, uint64_t* out);
+void compare_int64(CompareOp op, const int64_t* left, int64_t value, size_t count, uint64_t* out);
+void compare_double(CompareOp op, const double* left, const double* right, size_t count, uint64_t* out);
+void compare_double(CompareOp op, const double* left, double value, size_t count, uint64_t* out);
+// "avx2", "sse4.2", "sse2" (doubles only, int64 is scalar) or "scalar"
+const char* compare_kernel_name();
+
+// ============= SCALAR COMPARISONS =============
+// "a op b" as the compare kernels evaluate it: a NaN only satisfies !=
+template <typename T>
+bool compare_values(CompareOp op, T a, T b) {
+    switch (op) {
+        case CompareOp::EQ: return a == b;
+        case CompareOp::NE: return a != b;
+        case CompareOp::LT: return a < b;
+        case CompareOp::LE: return a <= b;
+        case CompareOp::GT: return a > b;
+        case CompareOp::GE: return a >= b;
+    }
+    return false;
+}
+
+// The value of "cell op value" for the cells of a numeric or DATETIME column of type dtype, read
+// the same way by filter_rows, the encoded kernels and CSV pushdown: a DATETIME column takes a
+// timestamp or an integer count of nanoseconds, INT and FLOAT columns a number (compared exactly
+// with INT cells when it is an integer). A cell never equals a value that is none of these.
+struct vegaCompareValue {
+    CompareOp op;
+    bool has_int = false;
+    bool has_number = false;
+    int64_t int_value = 0;
+    double number = 0.0;
+
+    vegaCompareValue(CompareOp op, std::string_view text, DataType dtype);
+    // for a non-null INT or DATETIME cell
+    [[nodiscard]] bool matches_int(int64_t cell) const;
+    // for a non-null FLOAT cell
+    [[nodiscard]] bool matches_double(double cell) const;
+};
+
+// ============= COLUMN COMPARISONS =============
+// Rows where "left op right" holds; a row with a null on either side never matches. INT/INT and
+// DATETIME/DATETIME compare their int64 values, other numeric pairs as doubles, text pairs as
+// strings and any other pair by the text of the cells. The columns must have the same length.
+vegaBitmap compare_columns(const vegaColumn& left, CompareOp op, const vegaColumn& right);
+// Rows where "cell op value" holds, matched like vegaDataframe::filter_rows: vegaCompareValue on
+// numeric and DATETIME columns, text otherwise; an empty value matches nulls with == and
+// non-nulls with !=.
+vegaBitmap compare_scalar(const vegaColumn& column, CompareOp op, std::string_view value);
+
+#endif // VEGA_VEGACOMPARE_H
@@ -0,0 +1,140 @@
+#include "vegaCompression.h"
+#include "vegaDataframe.h"
+#include <boost/iostreams/device/file.hpp>
+#include <boost/iostreams/filter/bzip2.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filter/zstd.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <cctype>
+#include <fstream>
+
+namespace io = boost::iostreams;
+
+// ============= CODEC SELECTION =============
+
+Compression compression_from_extension(const std::string& file_name) {
+    std::string extension = std::filesystem::path(file_name).extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    if (extension == ".gz" || extension == ".gzip") return Compression::GZIP;
+    if (extension == ".bz2") return Compression::BZIP2;
+    if (extension == ".zst" || extension == ".zstd") return Compression::ZSTD;
+    return Compression::NONE;
+}
+
+Compression resolve_compression(const std::string& file_name, Compression compression) {
+    return compression == Compression::AUTO ? compression_from_extension(file_name) : compression;
+}
+
+std::string strip_compression_extension(const std::string& file_name) {
+    if (compression_from_extension(file_name) == Compression::NONE) return file_name;
+    return std::filesystem::path(file_name).replace_extension().string();
+}
+
+// pushes the decompressor or compressor of a codec onto a filtering stream
+template <typename Stream>
+static void push_codec(Stream& stream, Compression compression, bool compress) {
+    switch (compression) {
+        case Compression::GZIP:
+            compress ? stream.push(io::gzip_compressor()) : stream.push(io::gzip_decompressor());
+            break;
+        case Compression::BZIP2:
+            compress ? stream.push(io::bzip2_compressor()) : stream.push(io::bzip2_decompressor());
+            break;
+        case Compression::ZSTD:
+            compress ? stream.push(io::zstd_compressor()) : stream.push(io::zstd_decompressor());
+            break;
+        default:
+            break;
+    }
+}
+
+// ============= DECOMPRESSION =============
+
+vegaDecompressBuffer::vegaDecompressBuffer(const std::string& file_name, Compression compression,
+                                           size_t block_size, size_t max_blocks)
+    : max_blocks(std::max<size_t>(1, max_blocks)) {
+    // open on the calling thread so a missing file throws here
+    std::ifstream probe(file_name, std::ios::binary);
+    if (!probe) throw FILE_ERROR("Cannot open file: " + file_name);
+    probe.close();
+
+    compression = resolve_compression(file_name, compression);
+    worker = std::thread(&vegaDecompressBuffer::decompress, this, file_name, compression, block_size);
+}
+
+vegaDecompressBuffer::~vegaDecompressBuffer() {
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        stopping = true;
+    }
+    queue_changed.notify_all();
+    worker.join();
+}
+
+void vegaDecompressBuffer::decompress(const std::string& file_name, Compression compression, size_t block_size) {
+    try {
+        io::filtering_istream input;
+        push_codec(input, compression, false);
+        input.push(io::file_source(file_name, std::ios::binary));
+        // codec errors would otherwise just end the stream
+        input.exceptions(std::ios::badbit);
+
+        while (true) {
+            std::vector<char> block(block_size);
+            input.read(block.data(), static_cast<std::streamsize>(block.size()));
+            block.resize(static_cast<size_t>(input.gcount()));
+            if (block.empty()) break;
+
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            queue_changed.wait(lock, [this] { return blocks.size() < max_blocks || stopping; });
+            if (stopping) return;
+            blocks.push_back(std::move(block));
+            queue_changed.notify_all();
+        }
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        failure = std::current_exception();
+    }
+
+    std::lock_guard<std::mutex> lock(queue_mutex);
+    finished = true;
+    queue_changed.notify_all();
+}
+
+vegaDecompressBuffer::int_type vegaDecompressBuffer::underflow() {
+    if (gptr() < egptr()) return traits_type::to_int_type(*gptr());
+
+    std::unique_lock<std::mutex> lock(queue_mutex);
+    queue_changed.wait(lock, [this] { return !blocks.empty() || finished; });
+    if (blocks.empty()) {
+        if (failure) std::rethrow_exception(failure);
+        return traits_type::eof();
+    }
+
+    current = std::move(blocks.front());
+    blocks.pop_front();
+    queue_changed.notify_all();
+    setg(current.data(), current.data(), current.data() + current.size());
+    return traits_type::to_int_type(*gptr());
+}
+
+// ============= COMPRESSION =============
+
+std::unique_ptr<std::ostream> open_output_stream(const std::string& file_name, Compression compression,
+                                                 bool append) {
+    compression = resolve_compression(file_name, compression);
+    std::ios::openmode mode = append ? std::ios::binary | std::ios::app : std::ios::binary;
+    if (compression == Compression::NONE) {
+        auto file = std::make_unique<std::ofstream>(file_name, mode);
+        if (!*file) throw FILE_ERROR("Cannot create output file: " + file_name);
+        return file;
+    }
+
+    io::file_sink sink(file_name, mode);
+    if (!sink.is_open()) throw FILE_ERROR("Cannot create output file: " + file_name);
+    auto stream = std::make_unique<io::filtering_ostream>();
+    push_codec(*stream, compression, true);
+    stream->push(sink);
+    return stream;
+}
@@ -0,0 +1,63 @@
+#ifndef VEGA_VEGACOMPRESSION_H
+#define VEGA_VEGACOMPRESSION_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Codec of an input or output file; AUTO picks it from the extension (.gz, .bz2, .zst)
+enum class Compression { AUTO, NONE, GZIP, BZIP2, ZSTD };
+
+Compression compression_from_extension(const std::string& file_name);
+// AUTO resolved through the file extension, anything else unchanged
+Compression resolve_compression(const std::string& file_name, Compression compression);
+// file name without a compression extension ("data.csv.gz" -> "data.csv")
+std::string strip_compression_extension(const std::string& file_name);
+
+// Stream buffer over a compressed file. A background thread decompresses blocks into a
+// bounded queue (max_blocks of block_size bytes) and the reader consumes them, so
+// decompression overlaps with parsing and nothing is written to a temporary file.
+// Decompression errors are rethrown on the reading side.
+class vegaDecompressBuffer : public std::streambuf {
+public:
+    vegaDecompressBuffer(const std::string& file_name, Compression compression,
+                         size_t block_size = size_t{1} << 20, size_t max_blocks = 8);
+    // stops the background thread even when the input was not read to the end
+    ~vegaDecompressBuffer() override;
+    vegaDecompressBuffer(const vegaDecompressBuffer&) = delete;
+    vegaDecompressBuffer& operator=(const vegaDecompressBuffer&) = delete;
+
+protected:
+    int_type underflow() override;
+
+private:
+    void decompress(const std::string& file_name, Compression compression, size_t block_size);
+
+    std::mutex queue_mutex;
+    std::condition_variable queue_changed;
+    std::deque<std::vector<char>> blocks;
+    size_t max_blocks;
+    bool finished = false;
+    bool stopping = false;
+    std::exception_ptr failure;
+    // block currently exposed through the get area
+    std::vector<char> current;
+    std::thread worker;
+};
+
+// Output stream writing file_name through the given codec; the data is fully flushed and
+// the codec trailer written when the stream is destroyed. With append the output goes after
+// the existing content (a new gzip/bzip2/zstd member, which readers treat as one stream).
+std::unique_ptr<std::ostream> open_output_stream(const std::string& file_name,
+                                                 Compression compression = Compression::AUTO,
+                                                 bool append = false);
+
+#endif // VEGA_VEGACOMPRESSION_H
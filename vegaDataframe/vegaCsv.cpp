@@ -0,0 +1,694 @@
+#include "vegaCsv.h"
+#include "vegaCompare.h"
+#include "vegaDataframe.h"
+#include <atomic>
+#include <charconv>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define VEGA_HAS_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// ============= MAPPED FILE =============
+
+vegaMappedFile::vegaMappedFile(const std::string& path) {
+#ifdef VEGA_HAS_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw FILE_ERROR("Cannot open file: " + path);
+
+    struct stat file_stat {};
+    if (::fstat(fd, &file_stat) != 0) {
+        ::close(fd);
+        throw FILE_ERROR("Cannot stat file: " + path);
+    }
+    mapped_size = static_cast<size_t>(file_stat.st_size);
+    if (mapped_size > 0) {
+        void* address = ::mmap(nullptr, mapped_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (address == MAP_FAILED) throw FILE_ERROR("Cannot map file: " + path);
+        ::madvise(address, mapped_size, MADV_SEQUENTIAL);
+        mapped_data = static_cast<const char*>(address);
+    } else {
+        ::close(fd);
+    }
+#else
+    std::ifstream file(path, std::ios::binary);
+    if (!file) throw FILE_ERROR("Cannot open file: " + path);
+    fallback_buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    mapped_data = fallback_buffer.data();
+    mapped_size = fallback_buffer.size();
+#endif
+}
+
+vegaMappedFile::~vegaMappedFile() {
+#ifdef VEGA_HAS_MMAP
+    if (mapped_data != nullptr) {
+        ::munmap(const_cast<char*>(mapped_data), mapped_size);
+    }
+#endif
+}
+
+#ifdef VEGA_HAS_MMAP
+static size_t page_size() {
+    static const size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    return page;
+}
+#endif
+
+void vegaMappedFile::prefetch(size_t offset, size_t length) const {
+#ifdef VEGA_HAS_MMAP
+    // every page touching the range; the kernel rounds the length up
+    size_t begin = offset / page_size() * page_size();
+    size_t end = std::min(offset + length, mapped_size);
+    if (mapped_data != nullptr && begin < end) {
+        ::madvise(const_cast<char*>(mapped_data) + begin, end - begin, MADV_WILLNEED);
+    }
+#endif
+}
+
+void vegaMappedFile::release(size_t offset, size_t length) const {
+#ifdef VEGA_HAS_MMAP
+    // only pages lying completely inside the range
+    size_t begin = (offset + page_size() - 1) / page_size() * page_size();
+    size_t end = std::min(offset + length, mapped_size) / page_size() * page_size();
+    if (mapped_data != nullptr && begin < end) {
+        ::madvise(const_cast<char*>(mapped_data) + begin, end - begin, MADV_DONTNEED);
+    }
+#endif
+}
+
+// ============= CSV SCANNING =============
+
+// structural and quote bits of a full 64-byte block
+static uint64_t block_structural_mask(const char* block, char delimiter, uint64_t& quotes) {
+#if defined(__AVX2__)
+    const __m256i delimiters = _mm256_set1_epi8(delimiter);
+    const __m256i newlines = _mm256_set1_epi8('\n');
+    const __m256i quote_chars = _mm256_set1_epi8('"');
+    uint64_t mask = 0;
+    quotes = 0;
+    for (int half = 0; half < 2; ++half) {
+        __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + half * 32));
+        __m256i hits = _mm256_or_si256(_mm256_cmpeq_epi8(bytes, delimiters), _mm256_cmpeq_epi8(bytes, newlines));
+        mask |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(hits))) << (half * 32);
+        quotes |= static_cast<uint64_t>(static_cast<uint32_t>(
+                      _mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, quote_chars)))) << (half * 32);
+    }
+    return mask;
+#elif defined(__SSE2__)
+    const __m128i delimiters = _mm_set1_epi8(delimiter);
+    const __m128i newlines = _mm_set1_epi8('\n');
+    const __m128i quote_chars = _mm_set1_epi8('"');
+    uint64_t mask = 0;
+    quotes = 0;
+    for (int quarter = 0; quarter < 4; ++quarter) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + quarter * 16));
+        __m128i hits = _mm_or_si128(_mm_cmpeq_epi8(bytes, delimiters), _mm_cmpeq_epi8(bytes, newlines));
+        mask |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(hits))) << (quarter * 16);
+        quotes |= static_cast<uint64_t>(static_cast<uint16_t>(
+                      _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, quote_chars)))) << (quarter * 16);
+    }
+    return mask;
+#else
+    uint64_t mask = 0;
+    quotes = 0;
+    for (int i = 0; i < 64; ++i) {
+        if (block[i] == delimiter || block[i] == '\n') mask |= uint64_t{1} << i;
+        if (block[i] == '"') quotes |= uint64_t{1} << i;
+    }
+    return mask;
+#endif
+}
+
+uint64_t csv_structural_mask(const char* block, size_t length, char delimiter, uint64_t& quotes) {
+    if (length >= 64) return block_structural_mask(block, delimiter, quotes);
+
+    // copy the tail so the vector loads never read past the end of the buffer
+    char padded[64] = {};
+    std::memcpy(padded, block, length);
+    uint64_t in_range = (uint64_t{1} << length) - 1;
+    uint64_t mask = block_structural_mask(padded, delimiter, quotes) & in_range;
+    quotes &= in_range;
+    return mask;
+}
+
+const char* csv_scanner_name() {
+#if defined(__AVX2__)
+    return "avx2";
+#elif defined(__SSE2__)
+    return "sse2";
+#else
+    return "scalar";
+#endif
+}
+
+std::string_view trim_view(std::string_view text) {
+    size_t start = text.find_first_not_of(" \t\r\n");
+    if (start == std::string_view::npos) return {};
+    size_t end = text.find_last_not_of(" \t\r\n");
+    return text.substr(start, end - start + 1);
+}
+
+std::string_view csv_field_value(std::string_view field, std::string& scratch) {
+    std::string_view value = trim_view(field);
+    if (value.size() < 2 || value.front() != '"' || value.back() != '"') return value;
+
+    value = value.substr(1, value.size() - 2);
+    size_t escaped = value.find("\"\"");
+    if (escaped == std::string_view::npos) return value;
+
+    scratch.assign(value.data(), escaped);
+    for (size_t i = escaped; i < value.size(); ++i) {
+        scratch.push_back(value[i]);
+        if (value[i] == '"' && i + 1 < value.size() && value[i + 1] == '"') ++i;
+    }
+    return scratch;
+}
+
+// ============= CSV PARSING =============
+
+vegaCsvFilter::vegaCsvFilter(size_t field, const vegaCsvPredicate& predicate, bool fixed, DataType type)
+    : field(field), text(predicate.value), fixed(fixed), type(type) {
+    op = parse_compare_op(predicate.op);
+
+    // a DATETIME value is compared as a timestamp, see vegaCompareValue
+    vegaCompareValue value(op, text, fixed ? type : DataType::INT);
+    has_int = value.has_int;
+    has_float = value.has_number;
+    int_value = value.int_value;
+    float_value = value.number;
+    if (fixed && type == DataType::DATETIME && !text.empty() && !has_int) {
+        throw std::runtime_error("Cannot convert value '" + text + "' to datetime");
+    }
+    if (fixed && is_numeric_type(type) && !text.empty() && !has_float) {
+        throw std::runtime_error("Cannot convert value '" + text + "' to " + data_type_to_string(type));
+    }
+}
+
+bool vegaCsvFilter::matches(std::string_view cell) const {
+    if (text.empty() || cell.empty()) {
+        if (op == Op::EQ) return text.empty() && cell.empty();
+        if (op == Op::NE) return text.empty() != cell.empty();
+        return false;
+    }
+
+    // numbers compare as the kernels do (a NaN only satisfies !=); without a dtype override a
+    // cell is only a number when inference would read it as one
+    if (fixed && type == DataType::DATETIME) {
+        int64_t cell_value;
+        return parse_datetime(cell, cell_value) && compare_values(op, cell_value, int_value);
+    }
+    bool numeric = fixed ? is_numeric_type(type) : has_float;
+    if (numeric) {
+        int64_t int_cell;
+        double float_cell;
+        if ((!fixed || type == DataType::INT) && has_int && parse_int64(cell, int_cell)) {
+            return compare_values(op, int_cell, int_value);
+        }
+        if (fixed ? parse_double(cell, float_cell) : parse_decimal(cell, float_cell)) {
+            return compare_values(op, float_cell, float_value);
+        }
+        if (fixed) return false;
+    }
+    return compare_result(op, cell.compare(text));
+}
+
+vegaCsvProjection vegaCsvProjection::all(size_t field_count) {
+    vegaCsvProjection projection;
+    projection.fields.resize(field_count);
+    std::iota(projection.fields.begin(), projection.fields.end(), 0);
+    projection.types.assign(field_count, DataType::INT);
+    projection.fixed.assign(field_count, false);
+    return projection;
+}
+
+vegaCsvProjection vegaCsvProjection::from_options(const std::vector<std::string>& header,
+                                                  const vegaCsvOptions& options) {
+    std::vector<bool> selected(header.size(), options.usecols.empty() && options.usecols_index.empty());
+    for (const auto& name : options.usecols) {
+        auto it = std::find(header.begin(), header.end(), name);
+        if (it == header.end()) throw std::runtime_error("Column not found in CSV header: " + name);
+        for (; it != header.end(); it = std::find(it + 1, header.end(), name)) {
+            selected[it - header.begin()] = true;
+        }
+    }
+    for (size_t index : options.usecols_index) {
+        if (index >= header.size()) throw std::runtime_error("Column index out of range: " + std::to_string(index));
+        selected[index] = true;
+    }
+
+    vegaCsvProjection projection;
+    size_t overrides = 0;
+    for (size_t field = 0; field < header.size(); ++field) {
+        // fields without a header name have never been loaded
+        if (!selected[field] || header[field].empty()) continue;
+
+        auto dtype = options.dtype.find(header[field]);
+        bool fixed = dtype != options.dtype.end();
+        overrides += fixed;
+        projection.fields.push_back(field);
+        projection.types.push_back(fixed ? dtype->second : DataType::INT);
+        projection.fixed.push_back(fixed);
+    }
+    for (const auto& predicate : options.filters) {
+        auto it = std::find(header.begin(), header.end(), predicate.column);
+        if (it == header.end()) throw std::runtime_error("Column not found in CSV header: " + predicate.column);
+        auto dtype = options.dtype.find(predicate.column);
+        bool fixed = dtype != options.dtype.end();
+        projection.filters.emplace_back(it - header.begin(), predicate, fixed, fixed ? dtype->second : DataType::STRING);
+    }
+    if (overrides < options.dtype.size()) {
+        for (const auto& [name, type] : options.dtype) {
+            bool loaded = std::any_of(projection.fields.begin(), projection.fields.end(),
+                                      [&](size_t field) { return header[field] == name; });
+            if (!loaded) throw std::runtime_error("dtype given for a column that is not loaded: " + name);
+        }
+    }
+    return projection;
+}
+
+bool vegaCsvProjection::accepts(const std::vector<std::string_view>& row, std::string& scratch) const {
+    for (const auto& filter : filters) {
+        std::string_view cell = filter.field < row.size() ? csv_field_value(row[filter.field], scratch) : std::string_view{};
+        if (!filter.matches(cell)) return false;
+    }
+    return true;
+}
+
+void vegaCsvProjection::infer_types(std::string_view text, char delimiter, size_t rows) {
+    if (rows == 0 || std::all_of(fixed.begin(), fixed.end(), [](bool f) { return f; })) return;
+
+    std::string scratch;
+    size_t sampled = 0;
+    scan_csv_rows(text, delimiter, [&](const std::vector<std::string_view>& row) {
+        for (size_t i = 0; i < fields.size(); ++i) {
+            if (fixed[i] || types[i] == DataType::STRING || fields[i] >= row.size()) continue;
+            std::string_view cell = csv_field_value(row[fields[i]], scratch);
+            if (!cell.empty()) types[i] = std::max(types[i], infer_data_type(cell));
+        }
+        return ++sampled < rows;
+    });
+}
+
+size_t parse_csv_header(std::string_view text, char delimiter, std::vector<std::string>& header) {
+    std::string scratch;
+    return scan_csv_rows(text, delimiter, [&](const std::vector<std::string_view>& fields) {
+        for (std::string_view field : fields) {
+            header.emplace_back(csv_field_value(field, scratch));
+        }
+        return false;
+    });
+}
+
+size_t csv_complete_rows_end(std::string_view text, char delimiter) {
+    const char* data = text.data();
+    size_t end = 0;
+    uint64_t quoted_carry = 0;
+    for (size_t block = 0; block < text.size(); block += 64) {
+        uint64_t quotes;
+        uint64_t mask = csv_structural_mask(data + block, std::min<size_t>(64, text.size() - block), delimiter, quotes);
+        if (quotes | quoted_carry) {
+            uint64_t quoted = prefix_xor(quotes) ^ quoted_carry;
+            mask &= ~quoted;
+            quoted_carry = uint64_t{0} - (quoted >> 63);
+        }
+        while (mask) {
+            size_t pos = block + static_cast<size_t>(std::countr_zero(mask));
+            mask &= mask - 1;
+            if (data[pos] == '\n') end = pos + 1;
+        }
+    }
+    return end;
+}
+
+size_t skip_csv_rows(std::string_view text, char delimiter, size_t rows) {
+    if (rows == 0) return 0;
+    size_t seen = 0;
+    return scan_csv_rows(text, delimiter, [&](const std::vector<std::string_view>&) { return ++seen < rows; });
+}
+
+// the first `rows` accepted cells of one field, kept as text
+static vegaColumn reread_as_strings(std::string_view text, char delimiter, const vegaCsvProjection& projection,
+                                    size_t index, size_t rows) {
+    vegaColumn strings(DataType::STRING);
+    if (rows == 0) return strings;
+
+    std::string scratch;
+    strings.reserve(rows);
+    scan_csv_rows(text, delimiter, [&](const std::vector<std::string_view>& fields) {
+        if (!projection.accepts(fields, scratch)) return true;
+        strings.append_string(index < fields.size() ? csv_field_value(fields[index], scratch) : std::string_view{});
+        return strings.size() < rows;
+    });
+    return strings;
+}
+
+// appends a cell to a column whose type was fixed by a dtype override
+static void append_fixed_cell(vegaColumn& column, std::string_view cell) {
+    int64_t int_value;
+    double float_value;
+    if (column.type == DataType::INT && parse_int64(cell, int_value)) {
+        column.append_int(int_value);
+    } else if (column.type == DataType::FLOAT && parse_double(cell, float_value)) {
+        column.append_float(float_value);
+    } else if (column.type == DataType::DATETIME && parse_datetime(cell, int_value)) {
+        column.int_data.push_back(int_value);
+        column.validity.push_back(true);
+    } else if (column.is_text()) {
+        column.append_string(cell);
+    } else {
+        throw std::runtime_error("Cannot convert value '" + std::string(cell) + "' to " +
+                                 data_type_to_string(column.type));
+    }
+}
+
+// rough row count from the newlines in the first megabyte
+static size_t estimate_rows(std::string_view text) {
+    size_t sample = std::min<size_t>(text.size(), 1 << 20);
+    if (sample == 0) return 0;
+    size_t newlines = static_cast<size_t>(std::count(text.data(), text.data() + sample, '\n'));
+    return (newlines + 1) * (text.size() / sample);
+}
+
+std::vector<vegaColumn> parse_csv_rows(std::string_view text, char delimiter, const vegaCsvProjection& projection) {
+    std::vector<vegaColumn> columns;
+    columns.reserve(projection.size());
+    // a filtered load only grows with the rows it keeps
+    size_t expected_rows = projection.filters.empty() ? estimate_rows(text) : 0;
+    for (DataType type : projection.types) {
+        columns.emplace_back(type);
+        columns.back().reserve(expected_rows);
+    }
+
+    std::string scratch;
+    scan_csv_rows(text, delimiter, [&](const std::vector<std::string_view>& fields) {
+        if (!projection.accepts(fields, scratch)) return true;
+        for (size_t i = 0; i < projection.size(); ++i) {
+            vegaColumn& column = columns[i];
+            size_t field = projection.fields[i];
+            std::string_view cell = field < fields.size() ? csv_field_value(fields[field], scratch) : std::string_view{};
+            if (cell.empty()) {
+                column.append_null();
+                continue;
+            }
+            if (projection.fixed[i]) {
+                append_fixed_cell(column, cell);
+                continue;
+            }
+
+            if (column.type == DataType::STRING) {
+                column.append_string(cell);
+                continue;
+            }
+            int64_t int_value;
+            if (column.type == DataType::INT && parse_int64(cell, int_value)) {
+                column.append_int(int_value);
+                continue;
+            }
+            double float_value;
+            if (parse_decimal(cell, float_value)) {
+                column.append_float(float_value);
+                continue;
+            }
+
+            // numeric parsing would lose the text of earlier cells, so fetch them again
+            column = reread_as_strings(text, delimiter, projection, field, column.size());
+            column.append_string(cell);
+        }
+        return true;
+    });
+    return columns;
+}
+
+// ============= PARALLEL PARSING =============
+
+std::vector<size_t> split_csv_chunks(std::string_view text, size_t chunk_count) {
+    std::vector<size_t> bounds{0};
+    if (chunk_count > 1 && text.size() >= chunk_count) {
+        size_t step = text.size() / chunk_count;
+
+        // quote parity at each nominal cut; ranges are counted independently
+        std::vector<size_t> quotes(chunk_count - 1);
+        parallel_for(quotes.size(), quotes.size(), [&](size_t c) {
+            const char* begin = text.data() + c * step;
+            quotes[c] = static_cast<size_t>(std::count(begin, begin + step, '"'));
+        });
+
+        bool in_quotes = false;
+        for (size_t c = 1; c < chunk_count; ++c) {
+            in_quotes ^= (quotes[c - 1] & 1) != 0;
+
+            // the range ends after the first newline outside quotes
+            size_t pos = c * step;
+            bool quoted = in_quotes;
+            while (pos < text.size() && (quoted || text[pos] != '\n')) {
+                if (text[pos] == '"') quoted = !quoted;
+                ++pos;
+            }
+            size_t cut = std::min(pos + 1, text.size());
+            if (cut > bounds.back() && cut < text.size()) bounds.push_back(cut);
+        }
+    }
+    bounds.push_back(text.size());
+    return bounds;
+}
+
+// Concatenates the columns parsed from consecutive pieces of text, column by column. A piece
+// narrower than the merged type is widened, or re-read as text when the merged type is STRING.
+static std::vector<vegaColumn> stitch_chunks(std::vector<std::vector<vegaColumn>>& chunks,
+                                             const std::vector<std::string_view>& texts, char delimiter,
+                                             const vegaCsvProjection& projection, size_t num_threads) {
+    std::vector<vegaColumn> columns(projection.size());
+    parallel_for(projection.size(), num_threads, [&](size_t i) {
+        DataType merged = projection.types[i];
+        size_t total_rows = 0;
+        for (const auto& chunk : chunks) {
+            merged = common_type(merged, chunk[i].type);
+            total_rows += chunk[i].size();
+        }
+
+        vegaColumn column(merged);
+        column.reserve(total_rows);
+        for (size_t c = 0; c < chunks.size(); ++c) {
+            vegaColumn& part = chunks[c][i];
+            if (part.type != merged) {
+                if (merged == DataType::STRING) {
+                    part = reread_as_strings(texts[c], delimiter, projection, projection.fields[i], part.size());
+                } else {
+                    part.widen(merged);
+                }
+            }
+            column.append_column(part);
+            part = vegaColumn();
+        }
+        columns[i] = std::move(column);
+    });
+    return columns;
+}
+
+std::vector<vegaColumn> parse_csv_parallel(std::string_view text, char delimiter, const vegaCsvProjection& projection,
+                                           size_t num_threads) {
+    if (num_threads == 0) num_threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+    size_t chunk_count = std::clamp<size_t>(text.size() / MIN_CHUNK_BYTES, 1, num_threads);
+    if (chunk_count == 1) return parse_csv_rows(text, delimiter, projection);
+
+    std::vector<size_t> bounds = split_csv_chunks(text, chunk_count);
+    chunk_count = bounds.size() - 1;
+    auto chunk_text = [&](size_t c) { return text.substr(bounds[c], bounds[c + 1] - bounds[c]); };
+
+    std::vector<std::vector<vegaColumn>> chunks(chunk_count);
+    parallel_for(chunk_count, num_threads, [&](size_t c) {
+        chunks[c] = parse_csv_rows(chunk_text(c), delimiter, projection);
+    });
+
+    std::vector<std::string_view> texts(chunk_count);
+    for (size_t c = 0; c < chunk_count; ++c) texts[c] = chunk_text(c);
+    return stitch_chunks(chunks, texts, delimiter, projection, num_threads);
+}
+
+// ============= STREAMED PARSING =============
+
+std::vector<vegaColumn> read_csv_stream(std::istream& input, const vegaCsvOptions& options,
+                                        std::vector<std::string>& features) {
+    // errors of the underlying buffer (e.g. a corrupt archive) surface as their own exceptions
+    input.exceptions(std::ios::badbit);
+
+    char delimiter = options.delimiter;
+    vegaCsvProjection projection;
+    bool header_done = false;
+    size_t rows_to_skip = options.skiprows;
+    size_t rows_left = options.nrows;
+
+    std::vector<std::unique_ptr<std::string>> pieces;
+    std::vector<std::vector<vegaColumn>> chunks;
+
+    // counts up to `limit` rows at the start of text and returns the offset after them
+    auto take_rows = [delimiter](std::string_view text, size_t limit, size_t& counted) -> size_t {
+        counted = 0;
+        if (limit == 0) return 0;
+        return scan_csv_rows(text, delimiter, [&](const std::vector<std::string_view>&) { return ++counted < limit; });
+    };
+
+    // text holds complete rows only
+    auto consume = [&](std::string_view text) {
+        if (!header_done) {
+            std::vector<std::string> header;
+            text.remove_prefix(parse_csv_header(text, delimiter, header));
+            projection = vegaCsvProjection::from_options(header, options);
+            for (size_t field : projection.fields) features.push_back(header[field]);
+            header_done = true;
+        }
+
+        size_t counted;
+        text.remove_prefix(take_rows(text, rows_to_skip, counted));
+        rows_to_skip -= counted;
+        if (rows_to_skip > 0 || rows_left == 0 || text.empty()) return;
+
+        if (rows_left != std::numeric_limits<size_t>::max()) {
+            text = text.substr(0, take_rows(text, rows_left, counted));
+            rows_left -= counted;
+        }
+        if (chunks.empty()) projection.infer_types(text, delimiter, options.infer_rows);
+
+        pieces.push_back(std::make_unique<std::string>(text));
+        chunks.push_back(parse_csv_rows(*pieces.back(), delimiter, projection));
+    };
+
+    std::string pending;
+    std::vector<char> block(size_t{1} << 20);
+    bool at_end = false;
+    while (!at_end && (rows_left > 0 || !header_done)) {
+        input.read(block.data(), static_cast<std::streamsize>(block.size()));
+        pending.append(block.data(), static_cast<size_t>(input.gcount()));
+        at_end = input.eof();
+        if (pending.size() < MIN_CHUNK_BYTES && !at_end) continue;
+
+        size_t end = at_end ? pending.size() : csv_complete_rows_end(pending, delimiter);
+        if (end == 0) continue;
+        consume(std::string_view(pending).substr(0, end));
+        pending.erase(0, end);
+    }
+    if (!header_done) return {};
+
+    std::vector<std::string_view> texts;
+    for (const auto& piece : pieces) texts.emplace_back(*piece);
+    size_t num_threads = options.num_threads == 0 ? std::max<size_t>(1, std::thread::hardware_concurrency())
+                                                  : options.num_threads;
+    return stitch_chunks(chunks, texts, delimiter, projection, num_threads);
+}
+
+// ============= BLOCK WRITING =============
+
+void write_row_blocks(std::ostream& out, size_t rows, size_t num_threads,
+                      const std::function<void(std::string&, size_t, size_t)>& format_block) {
+    size_t block_count = (rows + WRITE_BLOCK_ROWS - 1) / WRITE_BLOCK_ROWS;
+    if (num_threads == 0) num_threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+
+    // one round formats a few blocks per thread; the previous round is written meanwhile
+    size_t round_blocks = num_threads * 2;
+    std::vector<std::string> formatting(round_blocks);
+    std::vector<std::string> writing(round_blocks);
+    std::future<void> written;
+    for (size_t first = 0; first < block_count; first += round_blocks) {
+        size_t count = std::min(round_blocks, block_count - first);
+        parallel_for(count, num_threads, [&](size_t b) {
+            size_t begin = (first + b) * WRITE_BLOCK_ROWS;
+            formatting[b].clear();
+            format_block(formatting[b], begin, std::min(rows, begin + WRITE_BLOCK_ROWS));
+        });
+
+        if (written.valid()) written.get();
+        std::swap(formatting, writing);
+        written = std::async(std::launch::async, [&out, &writing, count] {
+            for (size_t b = 0; b < count; ++b) {
+                out.write(writing[b].data(), static_cast<std::streamsize>(writing[b].size()));
+            }
+        });
+    }
+    if (written.valid()) written.get();
+    out.flush();
+}
+
+// ============= CSV WRITING =============
+
+void append_csv_field(std::string& out, std::string_view text, char sep) {
+    bool needs_quotes = !text.empty() && trim_view(text).size() != text.size();
+    for (size_t i = 0; i < text.size() && !needs_quotes; ++i) {
+        char c = text[i];
+        needs_quotes = c == sep || c == '"' || c == '\n' || c == '\r';
+    }
+    if (!needs_quotes) {
+        out.append(text);
+        return;
+    }
+
+    out.push_back('"');
+    for (char c : text) {
+        if (c == '"') out.push_back('"');
+        out.push_back(c);
+    }
+    out.push_back('"');
+}
+
+// formats rows [begin, end) into out
+static void format_csv_block(std::string& out, const std::vector<vegaColumn>& columns,
+                             const vegaCsvWriteOptions& options, size_t begin, size_t end) {
+    char buffer[24];
+    // buffers are reused across rounds, so this only allocates for the first blocks
+    out.reserve((end - begin) * (columns.size() + options.index) * 8);
+    for (size_t row = begin; row < end; ++row) {
+        if (options.index) {
+            out.append(buffer, std::to_chars(buffer, buffer + sizeof(buffer), row).ptr);
+            out.push_back(options.sep);
+        }
+        for (size_t i = 0; i < columns.size(); ++i) {
+            if (i > 0) out.push_back(options.sep);
+            const vegaColumn& column = columns[i];
+            if (column.is_text() && !column.is_null(row)) {
+                append_csv_field(out, column.string_at(row), options.sep);
+            } else {
+                column.format_to(row, out);
+            }
+        }
+        out.push_back('\n');
+    }
+}
+
+void write_csv(std::ostream& out, const std::vector<std::string>& features, const std::vector<vegaColumn>& columns,
+               const vegaCsvWriteOptions& options) {
+    if (options.header) {
+        std::string header;
+        if (options.index) {
+            header += "index";
+            header.push_back(options.sep);
+        }
+        for (size_t i = 0; i < features.size(); ++i) {
+            if (i > 0) header.push_back(options.sep);
+            append_csv_field(header, features[i], options.sep);
+        }
+        header.push_back('\n');
+        out.write(header.data(), static_cast<std::streamsize>(header.size()));
+    }
+
+    size_t rows = columns.empty() ? 0 : columns.front().size();
+    write_row_blocks(out, rows, options.num_threads, [&](std::string& buffer, size_t begin, size_t end) {
+        format_csv_block(buffer, columns, options, begin, end);
+    });
+}
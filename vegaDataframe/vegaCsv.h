@@ -0,0 +1,300 @@
+#ifndef VEGA_VEGACSV_H
+#define VEGA_VEGACSV_H
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <istream>
+#include <ostream>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "vegaColumn.h"
+#include "vegaCompression.h"
+
+// Options of vegaDataframe::to_csv
+struct vegaCsvWriteOptions {
+    bool index = false;
+    char sep = ',';
+    Compression compression = Compression::AUTO;
+    // adds the rows to an existing file; the header is then only written into a new or empty file
+    bool append = false;
+    bool header = true;
+    // formatting threads, 0 uses every core
+    size_t num_threads = 0;
+};
+
+// Row filter evaluated while a CSV file is tokenized, e.g. {"price", ">=", "10"}.
+// op is one of ==, !=, <, <=, >, >=. An empty value tests for null with == and != and
+// null cells fail every other comparison. Cells compare by the column's dtype override
+// when it has one; otherwise a cell and value that both parse as numbers compare
+// numerically and anything else compares as text. Numbers compare like the compare kernels
+// (vegaCompare.h): a NaN cell only satisfies !=.
+struct vegaCsvPredicate {
+    std::string column;
+    std::string op;
+    std::string value;
+};
+
+// Options of vegaDataframe::read_csv
+struct vegaCsvOptions {
+    char delimiter = ',';
+    // columns to load by header name and/or by field position; both empty loads every column.
+    // Loaded columns keep their file order, the other fields are only tokenized past.
+    std::vector<std::string> usecols;
+    std::vector<size_t> usecols_index;
+    // data rows (after the header) to skip, then the most data rows to load
+    size_t skiprows = 0;
+    size_t nrows = std::numeric_limits<size_t>::max();
+    // fixed column types by name; these columns are not inferred and cells that do not
+    // parse as the given type are an error
+    std::unordered_map<std::string, DataType> dtype;
+    // rows sampled up front to pick the starting type of every inferred column (0 samples
+    // nothing); later cells that do not fit still widen the column. Columns with a dtype
+    // override are never sampled, so a dtype for every loaded column skips inference.
+    size_t infer_rows = 1000;
+    // inferred STRING columns whose distinct values number at most this fraction of their
+    // non-null cells load as CATEGORY (0 keeps them STRING); a CATEGORY dtype override
+    // always applies
+    double category_threshold = 0.0;
+    // rows failing any predicate are dropped before their cells are parsed;
+    // skiprows and nrows count rows before filtering
+    std::vector<vegaCsvPredicate> filters;
+    // parser threads, 0 uses every core
+    size_t num_threads = 0;
+    // input codec, see vegaCompression.h; compressed input is streamed instead of mapped
+    Compression compression = Compression::AUTO;
+    // reuse the zone maps saved in <file>.zonemap when it matches the file, and save them there
+    // after a load of the whole file with inferred types
+    bool zone_map_sidecar = true;
+};
+
+// A vegaCsvPredicate bound to a field, with its value parsed once
+struct vegaCsvFilter {
+    using Op = CompareOp;
+
+    size_t field = 0;
+    Op op = Op::EQ;
+    std::string text;
+    bool has_int = false;
+    bool has_float = false;
+    int64_t int_value = 0;
+    double float_value = 0.0;
+    // dtype override of the field, if any
+    bool fixed = false;
+    DataType type = DataType::STRING;
+
+    vegaCsvFilter(size_t field, const vegaCsvPredicate& predicate, bool fixed, DataType type);
+    // true when the (unquoted, trimmed) cell passes the filter
+    [[nodiscard]] bool matches(std::string_view cell) const;
+};
+
+// Which fields of a row are loaded and how, in output order
+struct vegaCsvProjection {
+    std::vector<size_t> fields;
+    // starting type of every loaded column
+    std::vector<DataType> types;
+    // true where the type comes from a dtype override and never widens
+    std::vector<bool> fixed;
+    // every filter must match for a row to be loaded
+    std::vector<vegaCsvFilter> filters;
+
+    // every field, all inferred
+    static vegaCsvProjection all(size_t field_count);
+    // resolves usecols, dtype and filters against the header names; unknown names or positions throw
+    static vegaCsvProjection from_options(const std::vector<std::string>& header, const vegaCsvOptions& options);
+    // raises the types of inferred columns to what the first `rows` rows of text hold,
+    // ignoring the filters
+    void infer_types(std::string_view text, char delimiter, size_t rows);
+    [[nodiscard]] size_t size() const { return fields.size(); }
+    // true when the raw fields of a row pass every filter
+    [[nodiscard]] bool accepts(const std::vector<std::string_view>& row, std::string& scratch) const;
+};
+
+// Read-only memory mapping of a whole file. Falls back to reading the file into
+// memory on platforms without mmap. An empty file maps to an empty view.
+class vegaMappedFile {
+public:
+    explicit vegaMappedFile(const std::string& path);
+    ~vegaMappedFile();
+    vegaMappedFile(const vegaMappedFile&) = delete;
+    vegaMappedFile& operator=(const vegaMappedFile&) = delete;
+
+    [[nodiscard]] const char* data() const { return mapped_data; }
+    [[nodiscard]] size_t size() const { return mapped_size; }
+    [[nodiscard]] std::string_view view() const { return {mapped_data, mapped_size}; }
+    // hints that [offset, offset + length) will be read soon / is no longer needed, so the
+    // pages of a streamed file do not accumulate; no-ops without mmap
+    void prefetch(size_t offset, size_t length) const;
+    void release(size_t offset, size_t length) const;
+
+private:
+    const char* mapped_data = nullptr;
+    size_t mapped_size = 0;
+    std::vector<char> fallback_buffer;
+};
+
+// ============= CSV SCANNING =============
+// bit i is set when block[i] is the delimiter or '\n'; bit i of quotes is set when block[i]
+// is '"'. Only the first `length` (<= 64) bytes are examined. Uses AVX2 or SSE2 when the
+// build enables them, a scalar loop otherwise.
+uint64_t csv_structural_mask(const char* block, size_t length, char delimiter, uint64_t& quotes);
+// name of the scanner compiled in ("avx2", "sse2" or "scalar")
+const char* csv_scanner_name();
+// strips spaces, tabs and carriage returns from both ends
+std::string_view trim_view(std::string_view text);
+// Trimmed value of a raw field. A quoted field loses its surrounding quotes and has "" turned
+// into "; scratch holds the unescaped text when needed, so the view lives until its next use.
+std::string_view csv_field_value(std::string_view field, std::string& scratch);
+
+// bit i of the result is the xor of bits 0..i, which marks the bytes between an opening
+// quote and its closing quote
+inline uint64_t prefix_xor(uint64_t bits) {
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+    return bits;
+}
+
+// Splits text into rows of fields (RFC 4180) and calls on_row(fields) for every non-blank row.
+// Delimiters and newlines inside quotes are masked out per block, so blocks without quotes
+// take the same path as before. Fields are raw views into text, see csv_field_value.
+// on_row returns false to stop scanning early.
+// Returns the number of bytes consumed (the end of the last row handed to on_row).
+template <typename Fn>
+size_t scan_csv_rows(std::string_view text, char delimiter, Fn&& on_row) {
+    std::vector<std::string_view> fields;
+    const char* data = text.data();
+    size_t size = text.size();
+    size_t field_start = 0;
+    // all ones while the previous block ended inside quotes
+    uint64_t quoted_carry = 0;
+
+    auto finish_row = [&]() {
+        bool blank = fields.size() == 1 && trim_view(fields[0]).empty();
+        bool keep_going = blank || on_row(fields);
+        fields.clear();
+        return keep_going;
+    };
+
+    for (size_t block = 0; block < size; block += 64) {
+        uint64_t quotes;
+        uint64_t mask = csv_structural_mask(data + block, std::min<size_t>(64, size - block), delimiter, quotes);
+        if (quotes | quoted_carry) {
+            uint64_t quoted = prefix_xor(quotes) ^ quoted_carry;
+            mask &= ~quoted;
+            quoted_carry = uint64_t{0} - (quoted >> 63);
+        }
+        while (mask) {
+            size_t pos = block + static_cast<size_t>(std::countr_zero(mask));
+            mask &= mask - 1;
+            fields.emplace_back(data + field_start, pos - field_start);
+            field_start = pos + 1;
+            if (data[pos] == '\n' && !finish_row()) return field_start;
+        }
+    }
+    if (field_start < size || !fields.empty()) {
+        fields.emplace_back(data + field_start, size - field_start);
+        finish_row();
+    }
+    return size;
+}
+
+// ============= PARALLELISM =============
+// smallest range worth handing to its own thread
+inline constexpr size_t MIN_CHUNK_BYTES = size_t{4} << 20;
+
+// runs fn(0) ... fn(count - 1) on up to num_threads threads, the calling thread included;
+// the first exception thrown by a task is rethrown once all threads have joined
+template <typename Fn>
+void parallel_for(size_t count, size_t num_threads, Fn&& fn) {
+    num_threads = std::min(num_threads, count);
+    if (num_threads <= 1) {
+        for (size_t i = 0; i < count; ++i) fn(i);
+        return;
+    }
+
+    std::atomic<size_t> next{0};
+    std::exception_ptr failure;
+    std::mutex failure_mutex;
+    auto worker = [&] {
+        for (size_t i = next++; i < count; i = next++) {
+            try {
+                fn(i);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(failure_mutex);
+                if (!failure) failure = std::current_exception();
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(num_threads - 1);
+    for (size_t t = 1; t < num_threads; ++t) threads.emplace_back(worker);
+    worker();
+    for (auto& thread : threads) thread.join();
+    if (failure) std::rethrow_exception(failure);
+}
+
+// rows formatted into one buffer by one task of write_row_blocks
+inline constexpr size_t WRITE_BLOCK_ROWS = 16384;
+
+// Writes rows [0, rows) in order, formatted block by block with format_block(buffer, begin, end)
+// on up to num_threads threads (0 uses every core) into reused buffers. A writer thread writes
+// one round of blocks while the next round is formatted.
+void write_row_blocks(std::ostream& out, size_t rows, size_t num_threads,
+                      const std::function<void(std::string&, size_t, size_t)>& format_block);
+
+// ============= CSV PARSING =============
+// names of the first row, one per field; returns the offset just past the header line
+size_t parse_csv_header(std::string_view text, char delimiter, std::vector<std::string>& header);
+// offset just past the first `rows` rows of text (text.size() when it has fewer)
+size_t skip_csv_rows(std::string_view text, char delimiter, size_t rows);
+// offset just past the last newline outside quotes, 0 when text holds no complete row
+size_t csv_complete_rows_end(std::string_view text, char delimiter);
+// Parses every row of text straight into the typed columns of the projection. Inferred
+// columns start as INT and widen to FLOAT or STRING as cells require; a column that turns
+// into STRING re-reads its earlier cells so the original text is kept. Missing trailing
+// cells are null.
+std::vector<vegaColumn> parse_csv_rows(std::string_view text, char delimiter, const vegaCsvProjection& projection);
+
+// ============= PARALLEL PARSING =============
+// Byte offsets that cut text into at most chunk_count ranges at record boundaries:
+// {0, ..., text.size()}. A newline inside a quoted field never ends a range.
+std::vector<size_t> split_csv_chunks(std::string_view text, size_t chunk_count);
+// Parses the chunks of split_csv_chunks on up to num_threads threads (0 = one per core)
+// and stitches the per-chunk columns together, widening each to the widest chunk type.
+// Chunks are at least a few megabytes, so small inputs stay on the calling thread.
+std::vector<vegaColumn> parse_csv_parallel(std::string_view text, char delimiter, const vegaCsvProjection& projection,
+                                           size_t num_threads = 0);
+
+// ============= STREAMED PARSING =============
+// Reads CSV text that cannot be mapped (e.g. a vegaDecompressBuffer) with the options of
+// read_csv. Complete rows are parsed piece by piece while the stream keeps producing, and
+// the pieces are stitched at the end; their text is kept until then for the re-read of
+// columns that widen to STRING. Stores the loaded column names in features.
+std::vector<vegaColumn> read_csv_stream(std::istream& input, const vegaCsvOptions& options,
+                                        std::vector<std::string>& features);
+
+// ============= CSV WRITING =============
+// appends a field, quoted (RFC 4180) when it holds the separator, a quote, a line break or
+// surrounding whitespace the reader would trim
+void append_csv_field(std::string& out, std::string_view text, char sep);
+// Writes the header (when options.header) and every row. Blocks of rows are formatted with
+// to_chars into large buffers on worker threads and written in order on another thread while
+// the next blocks are formatted.
+void write_csv(std::ostream& out, const std::vector<std::string>& features, const std::vector<vegaColumn>& columns,
+               const vegaCsvWriteOptions& options);
+
+#endif // VEGA_VEGACSV_H
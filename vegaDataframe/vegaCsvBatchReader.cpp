@@ -0,0 +1,97 @@
+#include "vegaCsvBatchReader.h"
+
+vegaCsvBatchReader::vegaCsvBatchReader(const std::string& file_name, size_t batch_rows, const vegaCsvOptions& options)
+    : options(options), batch_rows(batch_rows) {
+    if (batch_rows == 0) throw std::runtime_error("Batch size must be positive");
+    is_csv_file_valid(file_name);
+
+    file = std::make_unique<vegaMappedFile>(file_name);
+    std::string_view text = file->view();
+
+    std::vector<std::string> header;
+    size_t begin = parse_csv_header(text, options.delimiter, header);
+    projection = vegaCsvProjection::from_options(header, options);
+    for (size_t field : projection.fields) {
+        data_features.push_back(header[field]);
+    }
+    settled = projection.fixed;
+
+    begin += skip_csv_rows(text.substr(begin), options.delimiter, options.skiprows);
+    body_end = text.size();
+    if (options.nrows != std::numeric_limits<size_t>::max()) {
+        body_end = begin + skip_csv_rows(text.substr(begin), options.delimiter, options.nrows);
+    }
+    projection.infer_types(text.substr(begin, body_end - begin), options.delimiter, options.infer_rows);
+    schedule(begin);
+}
+
+vegaCsvBatchReader::~vegaCsvBatchReader() {
+    // the background parse reads the mapping, so it has to finish first
+    if (pending.valid()) pending.wait();
+}
+
+vegaCsvBatchReader::Batch vegaCsvBatchReader::read_batch(size_t begin, const vegaCsvProjection& batch_projection) const {
+    std::string_view text = file->view().substr(begin, body_end - begin);
+    text = text.substr(0, skip_csv_rows(text, options.delimiter, batch_rows));
+
+    Batch batch;
+    batch.begin = begin;
+    batch.end = begin + text.size();
+    batch.columns = parse_csv_parallel(text, options.delimiter, batch_projection, options.num_threads);
+    return batch;
+}
+
+void vegaCsvBatchReader::schedule(size_t begin) {
+    if (begin >= body_end) {
+        pending = {};
+        return;
+    }
+    // start reading ahead about one batch worth of bytes
+    if (last_batch_bytes > 0) file->prefetch(begin, last_batch_bytes);
+    pending = std::async(std::launch::async, [this, begin, batch_projection = projection] {
+        return read_batch(begin, batch_projection);
+    });
+}
+
+void vegaCsvBatchReader::conform(Batch& batch) {
+    for (size_t i = 0; i < batch.columns.size(); ++i) {
+        vegaColumn& column = batch.columns[i];
+        if (!settled[i]) {
+            if (column.null_count() < column.size()) {
+                projection.types[i] = column.type;
+                settled[i] = true;
+            }
+            continue;
+        }
+
+        DataType expected = projection.types[i];
+        if (column.type < expected) {
+            column.widen(expected);
+        } else if (column.type > expected) {
+            throw std::runtime_error("Column '" + data_features[i] + "' holds " + data_type_to_string(column.type) +
+                                     " values in a later batch but its batch schema is " +
+                                     data_type_to_string(expected) + "; pass a dtype override for it");
+        }
+    }
+}
+
+bool vegaCsvBatchReader::next(vegaDataframe& batch) {
+    while (pending.valid()) {
+        Batch result = pending.get();
+        conform(result);
+        last_batch_bytes = result.end - result.begin;
+        schedule(result.end);
+        file->release(result.begin, result.end - result.begin);
+
+        size_t rows = result.columns.empty() ? 0 : result.columns.front().size();
+        if (rows == 0) continue;
+
+        batch = vegaDataframe();
+        batch.data_features = data_features;
+        batch.data_columns = std::move(result.columns);
+        batch.update_stats_after_modification();
+        total_rows += rows;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,89 @@
+#ifndef VEGA_VEGACSVBATCHREADER_H
+#define VEGA_VEGACSVBATCHREADER_H
+
+#include <future>
+#include <iterator>
+#include <memory>
+#include "vegaDataframe.h"
+
+// Streams a CSV file as vegaDataframe batches of at most batch_rows rows, so files larger
+// than memory can be aggregated, filtered or written out batch by batch. While the caller
+// works on one batch the next one is parsed on a background thread, and the pages of
+// consumed batches are handed back to the OS.
+//
+// The schema (names and column types) comes from the dtype overrides, the infer_rows sample
+// and the first batch; a column that is still all-null takes the type of the first batch
+// where it has values.
+// Every later batch has exactly the schema types: narrower cells are widened and a cell that
+// needs a wider type throws, in which case a dtype override fixes the column.
+//
+// usecols, skiprows, nrows and filters behave as in read_csv; batch_rows counts rows
+// before filtering and batches left empty by the filters are skipped.
+//
+//     vegaCsvBatchReader reader("big.csv", 1'000'000);
+//     for (vegaDataframe& batch : reader) total += batch.sum("amount");
+class vegaCsvBatchReader {
+public:
+    vegaCsvBatchReader(const std::string& file_name, size_t batch_rows, const vegaCsvOptions& options = {});
+    ~vegaCsvBatchReader();
+    vegaCsvBatchReader(const vegaCsvBatchReader&) = delete;
+    vegaCsvBatchReader& operator=(const vegaCsvBatchReader&) = delete;
+
+    // moves the next batch into batch; false once the input is exhausted
+    bool next(vegaDataframe& batch);
+    [[nodiscard]] const std::vector<std::string>& features() const { return data_features; }
+    // column types so far; all-null columns may still widen once
+    [[nodiscard]] const std::vector<DataType>& schema() const { return projection.types; }
+    [[nodiscard]] size_t rows_read() const { return total_rows; }
+
+    // ============= ITERATION =============
+    class iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = vegaDataframe;
+        using difference_type = std::ptrdiff_t;
+
+        iterator() = default;
+        explicit iterator(vegaCsvBatchReader* reader) : reader(reader) { ++*this; }
+        vegaDataframe& operator*() const { return reader->current; }
+        vegaDataframe* operator->() const { return &reader->current; }
+        iterator& operator++() {
+            if (!reader->next(reader->current)) reader = nullptr;
+            return *this;
+        }
+        bool operator==(const iterator& other) const { return reader == other.reader; }
+
+    private:
+        vegaCsvBatchReader* reader = nullptr;
+    };
+    iterator begin() { return iterator(this); }
+    iterator end() { return iterator(); }
+
+private:
+    // parsed columns of one batch and the byte range it covered
+    struct Batch {
+        std::vector<vegaColumn> columns;
+        size_t begin = 0;
+        size_t end = 0;
+    };
+
+    Batch read_batch(size_t begin, const vegaCsvProjection& batch_projection) const;
+    void schedule(size_t begin);
+    // widens the batch to the schema, settling all-null schema columns on the way
+    void conform(Batch& batch);
+
+    std::unique_ptr<vegaMappedFile> file;
+    vegaCsvOptions options;
+    size_t batch_rows;
+    size_t body_end = 0;
+    std::vector<std::string> data_features;
+    vegaCsvProjection projection;
+    // false while a schema column has only seen nulls
+    std::vector<bool> settled;
+    size_t total_rows = 0;
+    size_t last_batch_bytes = 0;
+    std::future<Batch> pending;
+    vegaDataframe current;
+};
+
+#endif // VEGA_VEGACSVBATCHREADER_H
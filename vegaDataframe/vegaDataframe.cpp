@@ -1,8 +1,13 @@
 #include "vegaDataframe.h"
+#include "vegaCompare.h"
+#include "vegaView.h"
+#include <charconv>
 #include <fstream>
 #include <sstream>
 #include <chrono>
 #include <ranges>
+#include <unordered_set>
+#include <array>
 // #include <ctime>
 
 // ============= UTILITY FUNCTIONS =============
@@ -16,7 +21,8 @@ bool is_csv_file_valid(const std::string & file_name) {
     if (!std::filesystem::exists(file_path) || !std::filesystem::is_regular_file(file_path)) {
         throw FILE_ERROR("File does not exist or it is not a regular file: " + file_name);
     }
-    if (file_path.extension() != ".csv") {
+    // data.csv.gz and friends are CSV files too
+    if (std::filesystem::path(strip_compression_extension(file_name)).extension() != ".csv") {
         throw FILE_ERROR("Provided file is not a CSV file: " + file_name);
     }
     return true;
@@ -27,26 +33,20 @@ std::string data_type_to_string(DataType dt) {
         case DataType::INT: return "int";
         case DataType::FLOAT: return "float";
         case DataType::STRING: return "string";
+        case DataType::CATEGORY: return "category";
+        case DataType::DATETIME: return "datetime";
         default: return "unknown";
     }
 }
 
-DataType infer_data_type(const std::string& value) {
+DataType infer_data_type(std::string_view value) {
     if (value.empty()) return DataType::STRING;
 
-    std::istringstream iss(value);
-    long long tmp_int;
-    if ((iss >> tmp_int) && iss.eof()) {
-        return DataType::INT;
-    }
-
-    iss.clear();
-    iss.str(value);
-    double tmp_double;
-    if ((iss >> tmp_double) && iss.eof()) {
-        return DataType::FLOAT;
-    }
-
+    // from_chars is locale-free and never allocates
+    int64_t int_value;
+    if (parse_int64(value, int_value)) return DataType::INT;
+    double float_value;
+    if (parse_decimal(value, float_value)) return DataType::FLOAT;
     return DataType::STRING;
 }
 
@@ -71,18 +71,20 @@ std::string join_strings(const std::vector<std::string>& strings, const std::str
 }
 
 double safe_stod(const std::string& str, double default_val) {
-    try {
-        return std::stod(str);
-    } catch (...) {
-        return default_val;
-    }
+    // like std::stod: leading whitespace is skipped and the longest numeric prefix is used
+    size_t start = str.find_first_not_of(" \t\r\n\f\v");
+    if (start == std::string::npos) return default_val;
+    if (str[start] == '+') ++start;
+
+    double value;
+    const char* begin = str.data() + start;
+    auto [ptr, ec] = std::from_chars(begin, str.data() + str.size(), value);
+    return ec == std::errc() ? value : default_val;
 }
 
 bool is_numeric(const std::string& str) {
-    if (str.empty()) return false;
-    std::istringstream iss(str);
-    double d;
-    return (iss >> d) && iss.eof();
+    double value;
+    return parse_double(str, value);
 }
 
 std::string trim_whitespace(const std::string& str) {
@@ -92,6 +94,76 @@ std::string trim_whitespace(const std::string& str) {
     return str.substr(start, end - start + 1);
 }
 
+// values of a numeric column with nulls replaced by null_value
+static std::vector<double> column_as_doubles(const vegaColumn& column, double null_value) {
+    std::vector<double> values(column.size(), null_value);
+    column.for_each_numeric([&values](size_t row, double value) { values[row] = value; });
+    return values;
+}
+
+// text of a cell without copying STRING cells; numeric cells are formatted into buffer
+static std::string_view cell_text(const vegaColumn& column, size_t row, std::string& buffer) {
+    if (column.is_text()) {
+        return column.is_null(row) ? std::string_view() : column.string_at(row);
+    }
+    buffer = column.to_string(row);
+    return buffer;
+}
+
+// non-null cells per code of a CATEGORY column
+static std::vector<size_t> category_counts(const vegaColumn& column) {
+    std::vector<size_t> counts(column.category_count(), 0);
+    for (size_t row = 0; row < column.size(); ++row) {
+        if (!column.is_null(row)) counts[static_cast<size_t>(column.int_data[row])]++;
+    }
+    return counts;
+}
+
+// linear interpolation of the nulls that lie between two valid cells
+static vegaColumn interpolate_linear(const vegaColumn& column) {
+    vegaColumn result(column.type);
+    result.reserve(column.size());
+
+    size_t prev_idx = vegaColumn::npos;
+    size_t next_idx = 0;
+    for (size_t i = 0; i < column.size(); ++i) {
+        if (!column.is_null(i)) {
+            result.append_from(column, i);
+            prev_idx = i;
+            continue;
+        }
+
+        if (next_idx <= i) {
+            next_idx = i + 1;
+            while (next_idx < column.size() && column.is_null(next_idx)) ++next_idx;
+        }
+
+        if (prev_idx != vegaColumn::npos && next_idx < column.size()) {
+            double prev_val = column.numeric_at(prev_idx);
+            double next_val = column.numeric_at(next_idx);
+            double ratio = static_cast<double>(i - prev_idx) / (next_idx - prev_idx);
+            result.append_float(prev_val + ratio * (next_val - prev_val));
+        } else {
+            result.append_null();
+        }
+    }
+    return result;
+}
+
+// source row for every row after forward (or backward) filling nulls
+static std::vector<size_t> fill_sources(const vegaColumn& column, bool forward) {
+    size_t n = column.size();
+    std::vector<size_t> sources(n);
+    size_t last_valid = vegaColumn::npos;
+
+    for (size_t k = 0; k < n; ++k) {
+        size_t row = forward ? k : n - 1 - k;
+        if (!column.is_null(row)) last_valid = row;
+        sources[row] = (column.is_null(row) && last_valid != vegaColumn::npos) ? last_valid : row;
+    }
+    return sources;
+}
+
 // ============= VEGADATAFRAME HELPER METHODS =============
 
 size_t vegaDataframe::find_column_index(const std::string& col_name) const {
@@ -101,30 +173,86 @@ size_t vegaDataframe::find_column_index(const std::string& col_name) const {
     return std::distance(data_features.begin(), it);
 }
 
+size_t vegaDataframe::num_rows() const {
+    return data_columns.rows();
+}
+
+std::vector<std::string> vegaDataframe::get_row(size_t row) const {
+    std::vector<std::string> values;
+    values.reserve(data_columns.size());
+    for (const auto& column : data_columns) {
+        values.push_back(column.to_string(row));
+    }
+    return values;
+}
+
+void vegaDataframe::init_columns() {
+    data_columns.clear();
+    for (DataType dt : column_types) {
+        data_columns.emplace_back(dt);
+    }
+}
+
+void vegaDataframe::append_row(const std::vector<std::string>& row) {
+    for (size_t col = 0; col < data_columns.size(); ++col) {
+        uint64_t version = data_columns.version(col);
+        data_columns[col].append_value(col < row.size() ? std::string_view(row[col]) : std::string_view());
+        zone_map.carry_over(col, version, data_columns.version(col));
+    }
+}
+
+vegaDataframe vegaDataframe::take_rows(const std::vector<size_t>& row_indices) const {
+    vegaDataframe result;
+    result.data_features = data_features;
+    result.column_types = column_types;
+    result.data_columns.reserve(data_columns.size());
+
+    for (size_t col = 0; col < data_columns.size(); ++col) {
+        result.data_columns.push_back(data_columns.take(col, row_indices));
+    }
+
+    result.update_stats_after_modification();
+    return result;
+}
+
 void vegaDataframe::update_stats_after_modification() {
     size_t column_count = data_features.size();
     non_null_counts.assign(column_count, 0);
-    null_positions.assign(column_count, std::vector<size_t>{});
+    column_types.resize(column_count, DataType::STRING);
 
-    for (size_t row = 0; row < data_values.size(); ++row) {
-        for (size_t col = 0; col < column_count && col < data_values[row].size(); ++col) {
-            if (data_values[row][col].empty()) {
-                null_positions[col].push_back(row);
-            } else {
-                non_null_counts[col]++;
-            }
-        }
+    for (size_t col = 0; col < column_count && col < data_columns.size(); ++col) {
+        column_types[col] = data_columns.type(col);
+        non_null_counts[col] = data_columns.validity(col).count();
+    }
+    zone_map.clear();
+    column_summaries.reset(data_columns.size());
+}
+
+const vegaZoneMap& vegaDataframe::zone_maps() const {
+    zone_map.update(data_columns);
+    return zone_map;
+}
+
+void vegaDataframe::load_zone_map(const std::string& source_file, bool save_sidecar) {
+    uint64_t stamp = vegaZoneMap::file_stamp(source_file);
+    std::string sidecar = vegaZoneMap::sidecar_path(source_file);
+    if (stamp != 0 && zone_map.load(sidecar, stamp, data_features, data_columns)) return;
+
+    zone_map.update(data_columns);
+    if (!save_sidecar || stamp == 0) return;
+    try {
+        zone_map.save(sidecar, stamp, data_features);
+    } catch (const FILE_ERROR&) {
+        // a read-only location only costs the rebuild next time
     }
 }
 
 void vegaDataframe::print_memory_usage() const {
     size_t total_memory = 0;
 
-    // Calculate memory for data_values
-    for (const auto& row : data_values) {
-        for (const auto& cell : row) {
-            total_memory += cell.size();
-        }
+    // Calculate memory for data_columns
+    for (size_t col = 0; col < data_columns.size(); ++col) {
+        total_memory += data_columns.memory_usage(col);
     }
 
     // Add metadata memory
@@ -135,139 +263,185 @@ void vegaDataframe::print_memory_usage() const {
     std::cout << "Memory usage: " << total_memory << " bytes (" << total_memory / 1024.0 << " KB)" << std::endl;
 }
 
+size_t vegaDataframe::encode_columns(size_t num_threads) {
+    std::vector<uint64_t> versions;
+    for (size_t col = 0; col < data_columns.size(); ++col) versions.push_back(data_columns.version(col));
+    size_t saved = data_columns.encode_all(num_threads);
+    // encoding keeps the cells, so the zone maps stay valid
+    for (size_t col = 0; col < data_columns.size(); ++col) zone_map.carry_over(col, versions[col], data_columns.version(col));
+    return saved;
+}
+
+void vegaDataframe::decode_columns() {
+    data_columns.decode_all();
+}
+
+std::vector<Encoding> vegaDataframe::encodings() const {
+    std::vector<Encoding> result;
+    for (size_t col = 0; col < data_columns.size(); ++col) result.push_back(data_columns.encoding(col));
+    return result;
+}
+
+size_t vegaDataframe::infer_categories(double max_unique_ratio) {
+    std::vector<size_t> candidates;
+    for (size_t col = 0; col < data_columns.size(); ++col) {
+        if (data_columns.type(col) == DataType::STRING) candidates.push_back(col);
+    }
+
+    // the const store decodes safely from several threads
+    const vegaColumnStore& store = data_columns;
+    std::vector<char> convert(data_columns.size(), 0);
+    parallel_for(candidates.size(), std::max<size_t>(1, std::thread::hardware_concurrency()), [&](size_t c) {
+        const vegaColumn& column = store[candidates[c]];
+        size_t non_null = column.size() - column.null_count();
+        auto limit = static_cast<size_t>(max_unique_ratio * static_cast<double>(non_null));
+        if (non_null == 0 || limit == 0) return;
+
+        // stops as soon as the column has too many distinct values
+        std::unordered_set<std::string_view> seen;
+        for (size_t row = 0; row < column.size(); ++row) {
+            if (!column.is_null(row) && seen.insert(column.string_at(row)).second && seen.size() > limit) return;
+        }
+        convert[candidates[c]] = 1;
+    });
+
+    size_t converted = 0;
+    for (size_t col = 0; col < data_columns.size(); ++col) {
+        if (!convert[col]) continue;
+        data_columns[col] = data_columns[col].cast(DataType::CATEGORY);
+        column_types[col] = DataType::CATEGORY;
+        converted++;
+    }
+    if (converted > 0) zone_map.clear();
+    return converted;
+}
+
 void vegaDataframe::validate_dataframe() const {
     if (data_features.size() != column_types.size()) {
         throw std::runtime_error("DataFrame validation failed: features and types size mismatch");
     }
+    if (data_columns.size() != data_features.size()) {
+        throw std::runtime_error("DataFrame validation failed: features and columns size mismatch");
+    }
 
-    for (const auto& row : data_values) {
-        if (row.size() > data_features.size()) {
-            throw std::runtime_error("DataFrame validation failed: row has more columns than features");
+    for (size_t col = 0; col < data_columns.size(); ++col) {
+        if (data_columns.validity(col).size() != num_rows()) {
+            throw std::runtime_error("DataFrame validation failed: columns have different lengths");
         }
     }
 }
 
 // ============= CORE DATAFRAME OPERATIONS =============
 
-void vegaDataframe::read_csv(const std::string & FILE_NAME) {
+void vegaDataframe::read_csv(const std::string & FILE_NAME, const vegaCsvOptions& options) {
     is_csv_file_valid(FILE_NAME);
 
-    std::ifstream input_csv_file(FILE_NAME);
-    if (!input_csv_file) throw FILE_ERROR("Cannot open file: " + FILE_NAME);
-
     data_features.clear();
-    data_values.clear();
+    data_columns.clear();
     non_null_counts.clear();
     column_types.clear();
-    null_positions.clear();
-
-    std::string header_line;
-    if (std::getline(input_csv_file, header_line)) {
-        auto tokens = split_string(header_line, ',');
-        for (auto& token : tokens) {
-            token = trim_whitespace(token);
-            if (!token.empty()) {
-                data_features.push_back(token);
-            }
-        }
+    // only a load of every row and column with inferred types matches a saved sidecar
+    bool whole_file = options.usecols.empty() && options.usecols_index.empty() && options.skiprows == 0 &&
+                      options.nrows == std::numeric_limits<size_t>::max() && options.dtype.empty() &&
+                      options.filters.empty();
+
+    // compressed files are decompressed on a background thread and parsed as they stream in
+    if (resolve_compression(FILE_NAME, options.compression) != Compression::NONE) {
+        vegaDecompressBuffer buffer(FILE_NAME, options.compression);
+        std::istream input(&buffer);
+        data_columns = read_csv_stream(input, options, data_features);
+        update_stats_after_modification();
+        if (options.category_threshold > 0) infer_categories(options.category_threshold);
+        load_zone_map(FILE_NAME, options.zone_map_sidecar && whole_file);
+        return;
     }
 
-    size_t column_count = data_features.size();
-    non_null_counts.resize(column_count, 0);
-    column_types.assign(column_count, DataType::INT);
-    null_positions.resize(column_count);
-
-    size_t row_index = 0;
-    std::string data_line;
+    // the file is mapped and scanned in place, see vegaCsv.h
+    vegaMappedFile file(FILE_NAME);
+    std::string_view text = file.view();
 
-    while (std::getline(input_csv_file, data_line)) {
-        auto row_tokens = split_string(data_line, ',');
-        std::vector<std::string> data_row;
-
-        for (size_t i = 0; i < column_count; ++i) {
-            std::string cell = (i < row_tokens.size()) ? trim_whitespace(row_tokens[i]) : "";
-            data_row.push_back(cell);
-
-            if (cell.empty()) {
-                null_positions[i].push_back(row_index);
-            } else {
-                non_null_counts[i]++;
-                DataType inferred_type = infer_data_type(cell);
-                if (inferred_type > column_types[i]) {
-                    column_types[i] = inferred_type;
-                }
-            }
-        }
-
-        data_values.push_back(std::move(data_row));
-        row_index++;
+    std::vector<std::string> header;
+    text.remove_prefix(parse_csv_header(text, options.delimiter, header));
+    vegaCsvProjection projection = vegaCsvProjection::from_options(header, options);
+    for (size_t field : projection.fields) {
+        data_features.push_back(header[field]);
     }
-}
 
-void vegaDataframe::read_json(const std::string & FILE_NAME) {
-    std::ifstream file(FILE_NAME);
-    if (!file) throw FILE_ERROR("Cannot open JSON file: " + FILE_NAME);
-
-    // Simple JSON parsing for array of objects
-    std::string line;
-    bool first_object = true;
-
-    while (std::getline(file, line)) {
-        line = trim_whitespace(line);
-        if (line.empty() || line == "[" || line == "]") continue;
-
-        if (line.back() == ',') line.pop_back();
-
-        // Parse JSON object (simplified)
-        if (line.front() == '{' && line.back() == '}') {
-            line = line.substr(1, line.length() - 2);
-            auto pairs = split_string(line, ',');
+    // row limits only cut the byte range, skipped rows are tokenized but never parsed
+    text.remove_prefix(skip_csv_rows(text, options.delimiter, options.skiprows));
+    if (options.nrows != std::numeric_limits<size_t>::max()) {
+        text = text.substr(0, skip_csv_rows(text, options.delimiter, options.nrows));
+    }
+    projection.infer_types(text, options.delimiter, options.infer_rows);
 
-            std::vector<std::string> row;
-            for (const auto& pair : pairs) {
-                auto kv = split_string(pair, ':');
-                if (kv.size() == 2) {
-                    std::string key = trim_whitespace(kv[0]);
-                    std::string value = trim_whitespace(kv[1]);
+    data_columns = parse_csv_parallel(text, options.delimiter, projection, options.num_threads);
+    update_stats_after_modification();
+    if (options.category_threshold > 0) infer_categories(options.category_threshold);
+    load_zone_map(FILE_NAME, options.zone_map_sidecar && whole_file);
+}
 
-                    // Remove quotes
-                    if (key.front() == '"' && key.back() == '"') {
-                        key = key.substr(1, key.length() - 2);
-                    }
-                    if (value.front() == '"' && value.back() == '"') {
-                        value = value.substr(1, value.length() - 2);
-                    }
+void vegaDataframe::read_json(const std::string & FILE_NAME, Compression compression) {
+    vegaJsonOptions options;
+    options.compression = compression;
+    read_json(FILE_NAME, options);
+}
 
-                    if (first_object) {
-                        data_features.push_back(key);
-                    }
-                    row.push_back(value);
-                }
-            }
+void vegaDataframe::read_json(const std::string & FILE_NAME, const vegaJsonOptions& options) {
+    vegaJsonColumns parsed;
+    if (resolve_compression(FILE_NAME, options.compression) != Compression::NONE) {
+        vegaDecompressBuffer buffer(FILE_NAME, options.compression);
+        std::istream input(&buffer);
+        parsed = read_json_stream(input);
+    } else {
+        vegaMappedFile file(FILE_NAME);
+        parsed = parse_json_parallel(file.view(), options.num_threads);
+    }
 
-            if (first_object) {
-                column_types.assign(data_features.size(), DataType::STRING);
-                non_null_counts.resize(data_features.size(), 0);
-                null_positions.resize(data_features.size());
-                first_object = false;
-            }
+    data_features = std::move(parsed.features);
+    data_columns = std::move(parsed.columns);
+    update_stats_after_modification();
+    zone_map.update(data_columns);
+}
 
-            data_values.push_back(row);
-        }
+void vegaDataframe::read_vega(const std::string & FILE_NAME, const std::vector<std::string>& usecols) {
+    vegaFileReader reader(FILE_NAME);
+    std::vector<size_t> indices;
+    if (usecols.empty()) {
+        indices.resize(reader.features().size());
+        std::iota(indices.begin(), indices.end(), 0);
+    } else {
+        for (const auto& name : usecols) indices.push_back(reader.find_column(name));
     }
 
+    data_features.clear();
+    data_columns.assign(indices.size(), vegaColumn());
+    for (size_t index : indices) data_features.push_back(reader.features()[index]);
+    // encoded columns stay encoded in memory
+    parallel_for(indices.size(), std::max<size_t>(1, std::thread::hardware_concurrency()), [&](size_t i) {
+        data_columns.set_encoded(i, reader.encoded_column(indices[i]));
+    });
+    update_stats_after_modification();
+    zone_map.update(data_columns);
+}
+
+void vegaDataframe::read_arrow_ipc(const std::string & FILE_NAME) {
+    vegaMappedFile file(FILE_NAME);
+    std::vector<vegaColumn> columns;
+    ::read_arrow_ipc(file.view(), data_features, columns);
+    data_columns = std::move(columns);
     update_stats_after_modification();
+    zone_map.update(data_columns);
 }
 
 void vegaDataframe::info() const {
     std::cout << "<class 'vegaDataframe'>\n";
-    std::cout << "RangeIndex: " << data_values.size()
-              << " entries, 0 to " << (data_values.empty() ? 0 : data_values.size() - 1) << "\n";
+    std::cout << "RangeIndex: " << num_rows()
+              << " entries, 0 to " << (num_rows() == 0 ? 0 : num_rows() - 1) << "\n";
     std::cout << "Data columns (total " << data_features.size() << " columns):\n";
     std::cout << " #   Column           Non-Null Count  Dtype     Null Count\n";
 
     for (size_t col = 0; col < data_features.size(); ++col) {
-        size_t null_count = null_positions[col].size();
+        size_t null_count = num_rows() - non_null_counts[col];
 
         std::cout << std::setw(2) << col << "  "
                   << std::setw(15) << data_features[col] << "   "
@@ -276,13 +450,18 @@ void vegaDataframe::info() const {
                   << std::setw(10) << null_count << "\n";
     }
 
-    size_t int_count = 0, float_count = 0, string_count = 0;
+    size_t int_count = 0, float_count = 0, string_count = 0, category_count = 0, datetime_count = 0;
     for (DataType dt : column_types) {
         if (dt == DataType::INT) int_count++;
         else if (dt == DataType::FLOAT) float_count++;
         else if (dt == DataType::STRING) string_count++;
+        else if (dt == DataType::CATEGORY) category_count++;
+        else if (dt == DataType::DATETIME) datetime_count++;
     }
-    std::cout << "dtypes: int(" << int_count << "), float(" << float_count << "), string(" << string_count << ")\n";
+    std::cout << "dtypes: int(" << int_count << "), float(" << float_count << "), string(" << string_count << ")";
+    if (category_count > 0) std::cout << ", category(" << category_count << ")";
+    if (datetime_count > 0) std::cout << ", datetime(" << datetime_count << ")";
+    std::cout << "\n";
 }
 
 void vegaDataframe::describe() const {
@@ -291,36 +470,30 @@ void vegaDataframe::describe() const {
               << std::setw(10) << "Std" << std::setw(10) << "Min" << std::setw(10) << "25%"
               << std::setw(10) << "50%" << std::setw(10) << "75%" << std::setw(10) << "Max" << "\n";
 
+    // one fused pass per column, reused until the column changes
     for (size_t i = 0; i < data_features.size(); ++i) {
-        if (column_types[i] != DataType::STRING) {
-            const std::string& col_name = data_features[i];
-            try {
-                double mean_val = mean(col_name);
-                double std_val = std_dev(col_name);
-                double min_val = min(col_name);
-                double max_val = max(col_name);
-
-                std::vector<double> q = {0.25, 0.5, 0.75};
-                auto quantiles = quantile(col_name, q);
-
-                std::cout << std::setw(15) << col_name
-                          << std::setw(10) << non_null_counts[i]
-                          << std::setw(10) << std::fixed << std::setprecision(2) << mean_val
-                          << std::setw(10) << std::fixed << std::setprecision(2) << std_val
-                          << std::setw(10) << std::fixed << std::setprecision(2) << min_val
-                          << std::setw(10) << std::fixed << std::setprecision(2) << quantiles[0]
-                          << std::setw(10) << std::fixed << std::setprecision(2) << quantiles[1]
-                          << std::setw(10) << std::fixed << std::setprecision(2) << quantiles[2]
-                          << std::setw(10) << std::fixed << std::setprecision(2) << max_val << "\n";
-            } catch (...) {
-                std::cout << std::setw(15) << col_name << "   (error computing stats)\n";
-            }
+        if (!is_numeric_type(column_types[i])) continue;
+        const std::string& col_name = data_features[i];
+        const vegaColumnSummary& summary = column_summary(i, true);
+        if (summary.count <= 1) {
+            std::cout << std::setw(15) << col_name << "   (error computing stats)\n";
+            continue;
         }
+
+        std::cout << std::setw(15) << col_name
+                  << std::setw(10) << summary.count
+                  << std::setw(10) << std::fixed << std::setprecision(2) << summary.mean()
+                  << std::setw(10) << std::fixed << std::setprecision(2) << std::sqrt(summary.variance())
+                  << std::setw(10) << std::fixed << std::setprecision(2) << summary.min
+                  << std::setw(10) << std::fixed << std::setprecision(2) << summary.quartiles[0]
+                  << std::setw(10) << std::fixed << std::setprecision(2) << summary.quartiles[1]
+                  << std::setw(10) << std::fixed << std::setprecision(2) << summary.quartiles[2]
+                  << std::setw(10) << std::fixed << std::setprecision(2) << summary.max << "\n";
     }
 }
 
 void vegaDataframe::head(size_t n) const {
-    size_t row_count = std::min(n, data_values.size());
+    size_t row_count = std::min(n, num_rows());
 
     if (row_count == 0) {
         std::cout << "No data rows to display.\n";
@@ -333,19 +506,15 @@ void vegaDataframe::head(size_t n) const {
     std::cout << "\n";
 
     for (size_t i = 0; i < row_count; ++i) {
-        const auto& row = data_values[i];
-        for (size_t j = 0; j < data_features.size(); ++j) {
-            if (j < row.size())
-                std::cout << std::setw(15) << row[j] << " ";
-            else
-                std::cout << std::setw(15) << "" << " ";
+        for (const auto& column : data_columns) {
+            std::cout << std::setw(15) << column.to_string(i) << " ";
         }
         std::cout << "\n";
     }
 }
 
 void vegaDataframe::tail(size_t n) const {
-    size_t row_count = std::min(n, data_values.size());
+    size_t row_count = std::min(n, num_rows());
     if (row_count == 0) {
         std::cout << "No data rows to display\n";
         return;
@@ -356,14 +525,10 @@ void vegaDataframe::tail(size_t n) const {
     }
     std::cout << "\n";
 
-    size_t start_idx = data_values.size() - row_count;
-    for (size_t i = start_idx; i < data_values.size(); ++i) {
-        const auto& row = data_values[i];
-        for (size_t j = 0; j < data_features.size(); ++j) {
-            if (j < row.size())
-                std::cout << std::setw(15) << row[j] << " ";
-            else
-                std::cout << std::setw(15) << "" << " ";
+    size_t start_idx = num_rows() - row_count;
+    for (size_t i = start_idx; i < num_rows(); ++i) {
+        for (const auto& column : data_columns) {
+            std::cout << std::setw(15) << column.to_string(i) << " ";
         }
         std::cout << "\n";
     }
@@ -372,7 +537,7 @@ void vegaDataframe::tail(size_t n) const {
 // ============= SHAPE AND STRUCTURE OPERATIONS =============
 
 std::pair<size_t, size_t> vegaDataframe::shape() const {
-    return {data_values.size(), data_features.size()};
+    return {num_rows(), data_features.size()};
 }
 
 std::vector<DataType> vegaDataframe::dtypes() const {
@@ -381,20 +546,32 @@ std::vector<DataType> vegaDataframe::dtypes() const {
 
 std::vector<size_t> vegaDataframe::isnull() const {
     std::vector<size_t> null_counts;
-    for (const auto& positions : null_positions) {
-        null_counts.push_back(positions.size());
+    for (size_t col = 0; col < data_columns.size(); ++col) {
+        null_counts.push_back(num_rows() - data_columns.validity(col).count());
     }
     return null_counts;
 }
 
 std::vector<size_t> vegaDataframe::notnull() const {
-    return non_null_counts;
+    std::vector<size_t> valid_counts;
+    for (size_t col = 0; col < data_columns.size(); ++col) {
+        valid_counts.push_back(data_columns.validity(col).count());
+    }
+    return valid_counts;
+}
+
+vegaBitmap vegaDataframe::isnull(const std::string& col_name) const {
+    return ~data_columns.validity(find_column_index(col_name));
+}
+
+vegaBitmap vegaDataframe::notnull(const std::string& col_name) const {
+    return data_columns.validity(find_column_index(col_name));
 }
 
 size_t vegaDataframe::count_nulls() const {
     size_t total = 0;
-    for (const auto& positions : null_positions) {
-        total += positions.size();
+    for (size_t col = 0; col < data_columns.size(); ++col) {
+        total += num_rows() - data_columns.validity(col).count();
     }
     return total;
 }
@@ -402,10 +579,8 @@ size_t vegaDataframe::count_nulls() const {
 size_t vegaDataframe::memory_usage() const {
     size_t total_memory = 0;
 
-    for (const auto& row : data_values) {
-        for (const auto& cell : row) {
-            total_memory += cell.capacity();
-        }
+    for (size_t col = 0; col < data_columns.size(); ++col) {
+        total_memory += data_columns.memory_usage(col);
     }
 
     total_memory += data_features.size() * sizeof(std::string);
@@ -427,58 +602,39 @@ std::vector<std::string> vegaDataframe::get_column(size_t col_index) const {
         throw std::runtime_error("Column index out of range");
     }
 
+    const vegaColumn& data_column = data_columns[col_index];
     std::vector<std::string> column;
-    for (const auto& row : data_values) {
-        if (col_index < row.size()) {
-            column.push_back(row[col_index]);
-        } else {
-            column.push_back("");
-        }
+    column.reserve(data_column.size());
+    for (size_t row = 0; row < data_column.size(); ++row) {
+        column.push_back(data_column.to_string(row));
     }
     return column;
 }
 
 void vegaDataframe::add_column(const std::string& col_name, const std::vector<std::string>& values) {
-    if (values.size() != data_values.size())
+    if (values.size() != num_rows())
         throw std::runtime_error("Column size does not match number of rows");
 
     data_features.push_back(col_name);
     column_types.push_back(DataType::STRING);
-    non_null_counts.push_back(0);
-    null_positions.push_back(std::vector<size_t>{});
-
-    size_t col_idx = data_features.size() - 1;
-    for (size_t i = 0; i < data_values.size(); ++i) {
-        data_values[i].push_back(values[i]);
-        if (values[i].empty()) {
-            null_positions[col_idx].push_back(i);
-        } else {
-            non_null_counts[col_idx]++;
-        }
-    }
+    data_columns.push_back(vegaColumn::from_strings(values, DataType::STRING));
+    non_null_counts.push_back(data_columns.back().validity.count());
+    column_summaries.insert(data_columns.size() - 1);
 }
 
 void vegaDataframe::insert_column(size_t pos, const std::string& col_name, const std::vector<std::string>& values) {
     if (pos > data_features.size()) {
         throw std::runtime_error("Insert position out of range");
     }
-    if (values.size() != data_values.size()) {
+    if (values.size() != num_rows()) {
         throw std::runtime_error("Column size does not match number of rows");
     }
 
     data_features.insert(data_features.begin() + pos, col_name);
     column_types.insert(column_types.begin() + pos, DataType::STRING);
-    non_null_counts.insert(non_null_counts.begin() + pos, 0);
-    null_positions.insert(null_positions.begin() + pos, std::vector<size_t>{});
-
-    for (size_t i = 0; i < data_values.size(); ++i) {
-        data_values[i].insert(data_values[i].begin() + pos, values[i]);
-        if (values[i].empty()) {
-            null_positions[pos].push_back(i);
-        } else {
-            non_null_counts[pos]++;
-        }
-    }
+    data_columns.insert(data_columns.begin() + pos, vegaColumn::from_strings(values, DataType::STRING));
+    non_null_counts.insert(non_null_counts.begin() + pos, data_columns[pos].validity.count());
+    column_summaries.insert(pos);
 }
 
 void vegaDataframe::drop_column(const std::string& col_name) {
@@ -487,13 +643,8 @@ void vegaDataframe::drop_column(const std::string& col_name) {
     data_features.erase(data_features.begin() + col_idx);
     column_types.erase(column_types.begin() + col_idx);
     non_null_counts.erase(non_null_counts.begin() + col_idx);
-    null_positions.erase(null_positions.begin() + col_idx);
-
-    for (auto& row : data_values) {
-        if (col_idx < row.size()) {
-            row.erase(row.begin() + col_idx);
-        }
-    }
+    data_columns.erase(data_columns.begin() + col_idx);
+    column_summaries.erase(col_idx);
 }
 
 void vegaDataframe::drop_columns(const std::vector<std::string>& col_names) {
@@ -520,157 +671,327 @@ std::vector<std::string> vegaDataframe::columns() const {
 // ============= ROW OPERATIONS =============
 
 vegaDataframe vegaDataframe::filter_rows(const std::string& col_name, const std::string& value) const {
-    size_t col_idx = find_column_index(col_name);
+    return filter_rows(col_name, "==", value);
+}
+
+vegaDataframe vegaDataframe::filter_rows(const std::string& col_name, const std::string& op,
+                                         const std::string& value) const {
+    return take_rows(matching_rows(find_column_index(col_name), parse_compare_op(op), value));
+}
+
+std::vector<size_t> vegaDataframe::matching_rows(size_t col_idx, CompareOp op, const std::string& value) const {
+    // encoded columns are scanned without decoding and skip by their own run/block ranges
+    if (const vegaEncodedColumn* encoded = data_columns.encoded(col_idx)) {
+        if (!value.empty()) return encoded->matching_rows(op, value);
+        std::vector<size_t> matches;
+        if (op != CompareOp::EQ && op != CompareOp::NE) return matches;
+        vegaBitmap selected = op == CompareOp::EQ ? ~encoded->validity() : encoded->validity();
+        selected.for_each_set([&matches](size_t row) { matches.push_back(row); });
+        return matches;
+    }
+    const vegaColumn& column = data_columns[col_idx];
+    const vegaZoneMap& zones = zone_maps();
+    std::vector<size_t> matches;
+
+    // null tests only need the validity bits
+    if (value.empty()) {
+        if (op != CompareOp::EQ && op != CompareOp::NE) return matches;
+        bool want_null = op == CompareOp::EQ;
+        for (size_t g = 0; g < zones.group_count(); ++g) {
+            auto [begin, end] = zones.group_range(g);
+            size_t nulls = zones.stats(col_idx, g).null_count;
+            if ((want_null && nulls == 0) || (!want_null && nulls == end - begin)) continue;
+            for (size_t row = begin; row < end; ++row) {
+                if (column.is_null(row) == want_null) matches.push_back(row);
+            }
+        }
+        return matches;
+    }
+
+    // categories are compared once and the rows are matched on their codes
+    if (column.type == DataType::CATEGORY) {
+        std::vector<char> hits(column.category_count(), 0);
+        if (op == CompareOp::EQ || op == CompareOp::NE) {
+            int64_t code = column.find_category(value);
+            hits.assign(hits.size(), op == CompareOp::NE);
+            if (code >= 0) hits[static_cast<size_t>(code)] = op == CompareOp::EQ;
+        } else {
+            for (size_t code = 0; code < hits.size(); ++code) {
+                hits[code] = compare_result(op, column.category(static_cast<int64_t>(code)).compare(value));
+            }
+        }
+        if (std::find(hits.begin(), hits.end(), 1) == hits.end()) return matches;
 
-    return filter_rows([col_idx, value](const std::vector<std::string>& row) {
-        return col_idx < row.size() && row[col_idx] == value;
-    });
+        for (size_t g = 0; g < zones.group_count(); ++g) {
+            if (!zones.has_values(col_idx, g)) continue;
+            auto [begin, end] = zones.group_range(g);
+            for (size_t row = begin; row < end; ++row) {
+                if (!column.is_null(row) && hits[static_cast<size_t>(column.int_data[row])]) matches.push_back(row);
+            }
+        }
+        return matches;
+    }
+
+    // numbers and timestamps are read as vegaCompareValue and compared by the compare kernels,
+    // so a NaN cell only satisfies != as in query and compare
+    vegaCompareValue literal(op, value, column.type);
+    bool exact = (column.type == DataType::INT || column.type == DataType::DATETIME) && literal.has_int;
+    bool numeric = column.is_numeric() && literal.has_number;
+    std::vector<uint64_t> hits;
+    std::vector<double> buffer;
+
+    for (size_t g = 0; g < zones.group_count(); ++g) {
+        // integers are pruned on their exact range, doubles round beyond 2^53
+        if (exact ? !zones.may_match(col_idx, g, op, literal.int_value)
+                  : numeric ? !zones.may_match(col_idx, g, op, literal.number) : !zones.has_values(col_idx, g)) {
+            continue;
+        }
+        auto [begin, end] = zones.group_range(g);
+        size_t count = end - begin;
+
+        if (exact || numeric) {
+            hits.resize((count + 63) / 64);
+            if (exact) {
+                compare_int64(op, column.int_data.data() + begin, literal.int_value, count, hits.data());
+            } else if (column.type == DataType::FLOAT) {
+                compare_double(op, column.float_data.data() + begin, literal.number, count, hits.data());
+            } else {
+                buffer.resize(count);
+                for (size_t i = 0; i < count; ++i) buffer[i] = static_cast<double>(column.int_data[begin + i]);
+                compare_double(op, buffer.data(), literal.number, count, hits.data());
+            }
+            for (size_t w = 0; w < hits.size(); ++w) {
+                for (uint64_t bits = hits[w]; bits; bits &= bits - 1) {
+                    size_t row = begin + (w << 6) + static_cast<size_t>(std::countr_zero(bits));
+                    if (!column.is_null(row)) matches.push_back(row);
+                }
+            }
+        } else if (column.type == DataType::STRING) {
+            for (size_t row = begin; row < end; ++row) {
+                if (!column.is_null(row) && compare_result(op, column.string_at(row).compare(value))) {
+                    matches.push_back(row);
+                }
+            }
+        } else if (op == CompareOp::NE) {
+            // a numeric or datetime cell never equals a value of another kind
+            for (size_t row = begin; row < end; ++row) {
+                if (!column.is_null(row)) matches.push_back(row);
+            }
+        }
+    }
+    return matches;
 }
 
 vegaDataframe vegaDataframe::filter_rows(const std::function<bool(const std::vector<std::string>&)>& condition) const {
-    vegaDataframe result;
-    result.data_features = data_features;
-    result.column_types = column_types;
+    std::vector<size_t> matches;
 
-    for (const auto& row : data_values) {
-        if (condition(row)) {
-            result.data_values.push_back(row);
+    for (size_t row = 0; row < num_rows(); ++row) {
+        if (condition(get_row(row))) {
+            matches.push_back(row);
         }
     }
 
-    result.update_stats_after_modification();
-    return result;
+    return take_rows(matches);
+}
+
+vegaDataframe vegaDataframe::filter_rows(const vegaBitmap& mask) const {
+    return view().filter_rows(mask).materialize();
 }
 
 vegaDataframe vegaDataframe::query(const std::string& expression) const {
-    // Simple query implementation - can be extended for complex expressions
-    auto tokens = split_string(expression, ' ');
-    if (tokens.size() >= 3) {
-        std::string col_name = tokens[0];
-        std::string op = tokens[1];
-        std::string value = tokens[2];
+    return take_rows(query_mask(expression).set_indices());
+}
 
-        if (op == "==") {
-            return filter_rows(col_name, value);
-        }
-        // Add more operators as needed
+vegaBitmap vegaDataframe::query_mask(const std::string& expression) const {
+    return vegaQuery(expression, data_features, data_columns).evaluate();
+}
+
+void vegaDataframe::append_rows(const vegaDataframe& other) {
+    if (data_features.empty() && data_columns.empty()) {
+        *this = other;
+        return;
+    }
+    if (other.data_features != data_features) {
+        throw std::runtime_error("Cannot append rows of a dataframe with different columns");
     }
 
-    return *this; // Return copy if query cannot be parsed
+    for (size_t col = 0; col < data_columns.size(); ++col) {
+        uint64_t version = data_columns.version(col);
+        vegaColumn& column = data_columns[col];
+        const vegaColumn& part = other.data_columns[col];
+        column.widen(common_type(column.type, part.type));
+        if (part.type == column.type) {
+            column.append_column(part);
+        } else {
+            vegaColumn widened = part;
+            widened.widen(column.type);
+            column.append_column(widened);
+        }
+        // the zone maps extend over the appended rows; a widened column gets a new type and is recomputed
+        zone_map.carry_over(col, version, data_columns.version(col));
+        column_types[col] = column.type;
+        non_null_counts[col] += other.non_null_counts[col];
+    }
 }
 
 void vegaDataframe::drop_row(size_t row_index) {
-    if (row_index >= data_values.size())
-        throw std::runtime_error("Row index out of range");
-
-    data_values.erase(data_values.begin() + row_index);
-    update_stats_after_modification();
+    drop_rows({row_index});
 }
 
 void vegaDataframe::drop_rows(const std::vector<size_t>& row_indices) {
-    std::vector<size_t> sorted_indices = row_indices;
-    std::sort(sorted_indices.rbegin(), sorted_indices.rend()); // Sort in descending order
+    std::vector<bool> dropped(num_rows(), false);
+    for (size_t idx : row_indices) {
+        if (idx >= num_rows())
+            throw std::runtime_error("Row index out of range");
+        dropped[idx] = true;
+    }
+
+    std::vector<size_t> kept;
+    for (size_t row = 0; row < dropped.size(); ++row) {
+        if (!dropped[row]) kept.push_back(row);
+    }
 
-    for (size_t idx : sorted_indices) {
-        drop_row(idx);
+    for (auto& column : data_columns) {
+        column = column.take(kept);
     }
+    update_stats_after_modification();
 }
 
 vegaDataframe vegaDataframe::sample(size_t n, bool replace) const {
-    vegaDataframe result;
-    result.data_features = data_features;
-    result.column_types = column_types;
-
-    if (n >= data_values.size() && !replace) {
-        result = *this;
-        return result;
+    if (n >= num_rows() && !replace) {
+        return *this;
     }
 
     std::random_device rd;
     std::mt19937 gen(rd());
+    std::vector<size_t> indices;
 
     if (replace) {
-        std::uniform_int_distribution<> dis(0, data_values.size() - 1);
+        std::uniform_int_distribution<size_t> dis(0, num_rows() - 1);
         for (size_t i = 0; i < n; ++i) {
-            size_t idx = dis(gen);
-            result.data_values.push_back(data_values[idx]);
+            indices.push_back(dis(gen));
         }
     } else {
-        std::vector<size_t> indices(data_values.size());
+        indices.resize(num_rows());
         std::iota(indices.begin(), indices.end(), 0);
         std::ranges::shuffle(indices, gen);
+        indices.resize(n);
+    }
 
-        for (size_t i = 0; i < n; ++i) {
-            result.data_values.push_back(data_values[indices[i]]);
+    return take_rows(indices);
+}
+
+// (value, row) pairs of the parsable cells of a column
+static std::vector<std::pair<double, size_t>> numeric_cells(const vegaColumn& column) {
+    std::vector<std::pair<double, size_t>> values_with_indices;
+
+    if (column.is_numeric()) {
+        column.for_each_numeric([&values_with_indices](size_t row, double value) {
+            values_with_indices.emplace_back(value, row);
+        });
+    } else if (column.type == DataType::DATETIME) {
+        for (size_t row = 0; row < column.size(); ++row) {
+            if (!column.is_null(row)) values_with_indices.emplace_back(static_cast<double>(column.int_data[row]), row);
+        }
+    } else {
+        for (size_t row = 0; row < column.size(); ++row) {
+            double value;
+            if (!column.is_null(row) && parse_double(column.string_at(row), value)) {
+                values_with_indices.emplace_back(value, row);
+            }
         }
     }
+    return values_with_indices;
+}
 
-    result.update_stats_after_modification();
-    return result;
+// Rows of the n largest (or smallest) cells of a numeric column, best first. Row groups are
+// visited from the most promising bound on and the scan stops once no remaining group can
+// beat the n-th value kept so far.
+static std::vector<size_t> top_numeric_rows(const vegaColumn& column, const vegaZoneMap& zones, size_t col_idx,
+                                            size_t n, bool largest) {
+    // true when a is a better value than b
+    auto better = [largest](double a, double b) { return largest ? a > b : a < b; };
+    auto bound = [&](size_t g) {
+        const vegaColumnStats& stats = zones.stats(col_idx, g);
+        return largest ? stats.max : stats.min;
+    };
+
+    std::vector<size_t> order;
+    for (size_t g = 0; g < zones.group_count(); ++g) {
+        if (zones.stats(col_idx, g).has_range) order.push_back(g);
+    }
+    std::ranges::sort(order, [&](size_t a, size_t b) { return better(bound(a), bound(b)); });
+
+    // heap of the kept cells with the worst one on top
+    auto worse_first = [&](const auto& a, const auto& b) { return better(a.first, b.first); };
+    std::vector<std::pair<double, size_t>> kept;
+    for (size_t g : order) {
+        if (n == 0 || (kept.size() == n && better(kept.front().first, bound(g)))) break;
+        auto [begin, end] = zones.group_range(g);
+        for (size_t row = begin; row < end; ++row) {
+            if (column.is_null(row)) continue;
+            double value = column.numeric_at(row);
+            if (std::isnan(value)) continue;
+            if (kept.size() < n) {
+                kept.emplace_back(value, row);
+                std::ranges::push_heap(kept, worse_first);
+            } else if (better(value, kept.front().first)) {
+                std::ranges::pop_heap(kept, worse_first);
+                kept.back() = {value, row};
+                std::ranges::push_heap(kept, worse_first);
+            }
+        }
+    }
+
+    std::ranges::sort(kept, [&](const auto& a, const auto& b) {
+        return better(a.first, b.first) || (a.first == b.first && a.second < b.second);
+    });
+    std::vector<size_t> rows;
+    for (const auto& cell : kept) rows.push_back(cell.second);
+    return rows;
 }
 
 vegaDataframe vegaDataframe::nlargest(size_t n, const std::string& col_name) const {
     size_t col_idx = find_column_index(col_name);
+    if (data_columns[col_idx].is_numeric()) {
+        return take_rows(top_numeric_rows(data_columns[col_idx], zone_maps(), col_idx, n, true));
+    }
 
     // Create vector of (value, row_index) pairs
-    std::vector<std::pair<double, size_t>> values_with_indices;
-    for (size_t i = 0; i < data_values.size(); ++i) {
-        if (col_idx < data_values[i].size() && !data_values[i][col_idx].empty()) {
-            try {
-                double val = std::stod(data_values[i][col_idx]);
-                values_with_indices.push_back({val, i});
-            } catch (...) {}
-        }
-    }
+    auto values_with_indices = numeric_cells(data_columns[col_idx]);
 
-    // Sort by value in descending order
-    std::ranges::sort(values_with_indices,
+    // Order the first n by value in descending order
+    size_t count = std::min(n, values_with_indices.size());
+    std::partial_sort(values_with_indices.begin(), values_with_indices.begin() + count, values_with_indices.end(),
                       [](const auto& a, const auto& b) { return a.first > b.first; });
 
-    // Create result dataframe
-    vegaDataframe result;
-    result.data_features = data_features;
-    result.column_types = column_types;
-
-    size_t count = std::min(n, values_with_indices.size());
+    std::vector<size_t> rows;
     for (size_t i = 0; i < count; ++i) {
-        size_t row_idx = values_with_indices[i].second;
-        result.data_values.push_back(data_values[row_idx]);
+        rows.push_back(values_with_indices[i].second);
     }
 
-    result.update_stats_after_modification();
-    return result;
+    return take_rows(rows);
 }
 
 vegaDataframe vegaDataframe::nsmallest(size_t n, const std::string& col_name) const {
     size_t col_idx = find_column_index(col_name);
-
-    std::vector<std::pair<double, size_t>> values_with_indices;
-    for (size_t i = 0; i < data_values.size(); ++i) {
-        if (col_idx < data_values[i].size() && !data_values[i][col_idx].empty()) {
-            try {
-                double val = std::stod(data_values[i][col_idx]);
-                values_with_indices.push_back({val, i});
-            } catch (...) {}
-        }
+    if (data_columns[col_idx].is_numeric()) {
+        return take_rows(top_numeric_rows(data_columns[col_idx], zone_maps(), col_idx, n, false));
     }
 
-    // Sort by value in ascending order
-    std::ranges::sort(values_with_indices,
-                      [](const auto& a, const auto& b) { return a.first < b.first; });
-
-    vegaDataframe result;
-    result.data_features = data_features;
-    result.column_types = column_types;
+    auto values_with_indices = numeric_cells(data_columns[col_idx]);
 
+    // Order the first n by value in ascending order
     size_t count = std::min(n, values_with_indices.size());
+    std::partial_sort(values_with_indices.begin(), values_with_indices.begin() + count, values_with_indices.end(),
+                      [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    std::vector<size_t> rows;
     for (size_t i = 0; i < count; ++i) {
-        size_t row_idx = values_with_indices[i].second;
-        result.data_values.push_back(data_values[row_idx]);
+        rows.push_back(values_with_indices[i].second);
     }
 
-    result.update_stats_after_modification();
-    return result;
+    return take_rows(rows);
 }
 
 // ============= INDEXING AND SELECTION =============
@@ -678,35 +999,23 @@ vegaDataframe vegaDataframe::nsmallest(size_t n, const std::string& col_name) co
 vegaDataframe vegaDataframe::loc(const std::vector<size_t>& rows, const std::vector<std::string>& cols) const {
     vegaDataframe result;
 
-    // Set up columns
-    for (const auto& col_name : cols) {
-        result.data_features.push_back(col_name);
-    }
-
     // Get column indices
     std::vector<size_t> col_indices;
     for (const auto& col_name : cols) {
         col_indices.push_back(find_column_index(col_name));
     }
 
-    // Copy data types for selected columns
-    for (size_t col_idx : col_indices) {
-        result.column_types.push_back(column_types[col_idx]);
+    // Keep only rows that exist
+    std::vector<size_t> row_indices;
+    for (size_t row_idx : rows) {
+        if (row_idx < num_rows()) row_indices.push_back(row_idx);
     }
 
     // Copy selected rows and columns
-    for (size_t row_idx : rows) {
-        if (row_idx < data_values.size()) {
-            std::vector<std::string> new_row;
-            for (size_t col_idx : col_indices) {
-                if (col_idx < data_values[row_idx].size()) {
-                    new_row.push_back(data_values[row_idx][col_idx]);
-                } else {
-                    new_row.push_back("");
-                }
-            }
-            result.data_values.push_back(new_row);
-        }
+    for (size_t col_idx : col_indices) {
+        result.data_features.push_back(data_features[col_idx]);
+        result.column_types.push_back(column_types[col_idx]);
+        result.data_columns.push_back(data_columns[col_idx].take(row_indices));
     }
 
     result.update_stats_after_modification();
@@ -716,26 +1025,17 @@ vegaDataframe vegaDataframe::loc(const std::vector<size_t>& rows, const std::vec
 vegaDataframe vegaDataframe::iloc(const std::vector<size_t>& rows, const std::vector<size_t>& cols) const {
     vegaDataframe result;
 
-    // Set up columns
+    std::vector<size_t> row_indices;
+    for (size_t row_idx : rows) {
+        if (row_idx < num_rows()) row_indices.push_back(row_idx);
+    }
+
+    // Copy selected rows and columns
     for (size_t col_idx : cols) {
         if (col_idx < data_features.size()) {
             result.data_features.push_back(data_features[col_idx]);
             result.column_types.push_back(column_types[col_idx]);
-        }
-    }
-
-    // Copy selected rows and columns
-    for (size_t row_idx : rows) {
-        if (row_idx < data_values.size()) {
-            std::vector<std::string> new_row;
-            for (size_t col_idx : cols) {
-                if (col_idx < data_values[row_idx].size()) {
-                    new_row.push_back(data_values[row_idx][col_idx]);
-                } else {
-                    new_row.push_back("");
-                }
-            }
-            result.data_values.push_back(new_row);
+            result.data_columns.push_back(data_columns[col_idx].take(row_indices));
         }
     }
 
@@ -749,80 +1049,157 @@ std::string vegaDataframe::at(size_t row, const std::string& col) const {
 }
 
 std::string vegaDataframe::iat(size_t row, size_t col) const {
-    if (row >= data_values.size()) {
+    if (row >= num_rows()) {
         throw std::runtime_error("Row index out of range");
     }
     if (col >= data_features.size()) {
         throw std::runtime_error("Column index out of range");
     }
 
-    if (col < data_values[row].size()) {
-        return data_values[row][col];
-    } else {
-        return "";
-    }
+    return data_columns[col].to_string(row);
 }
 
 // ============= STATISTICAL OPERATIONS =============
 
-double vegaDataframe::mean(const std::string& col_name) const {
-    size_t col_idx = find_column_index(col_name);
+// quantiles of values with linear interpolation between the closest ranks, found by selecting
+// the needed ranks in increasing order instead of sorting; reorders values
+static std::vector<double> select_quantiles(std::vector<double>& values, const std::vector<double>& q) {
+    for (double quantile : q) {
+        if (quantile < 0.0 || quantile > 1.0) {
+            throw std::runtime_error("Quantile must be between 0 and 1");
+        }
+    }
 
-    if (column_types[col_idx] == DataType::STRING)
-        throw std::runtime_error("Cannot compute mean for string column");
+    std::vector<size_t> order(q.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::ranges::sort(order, [&q](size_t a, size_t b) { return q[a] < q[b]; });
 
-    double sum = 0;
-    size_t count = 0;
+    // every rank below the last selected one lies before it
+    std::vector<double> result(q.size());
+    auto selected = values.begin();
+    for (size_t k : order) {
+        double pos = q[k] * (values.size() - 1);
+        size_t lower = static_cast<size_t>(std::floor(pos));
+        size_t upper = static_cast<size_t>(std::ceil(pos));
+
+        auto nth = values.begin() + lower;
+        std::nth_element(selected, nth, values.end());
+        selected = nth;
 
-    for (const auto& row : data_values) {
-        if (col_idx < row.size() && !row[col_idx].empty()) {
-            try {
-                sum += std::stod(row[col_idx]);
-                count++;
-            } catch (...) {}
+        if (lower == upper) {
+            result[k] = *nth;
+        } else {
+            double weight = pos - lower;
+            result[k] = *nth * (1 - weight) + *std::min_element(nth + 1, values.end()) * weight;
         }
     }
+    return result;
+}
 
-    if (count == 0) throw std::runtime_error("No valid values to compute mean");
-    return sum / count;
+vegaSummaryCache::vegaSummaryCache(const vegaSummaryCache& other) {
+    *this = other;
 }
 
-double vegaDataframe::median(const std::string& col_name) const {
-    size_t col_idx = find_column_index(col_name);
+vegaSummaryCache::vegaSummaryCache(vegaSummaryCache&& other) noexcept {
+    *this = std::move(other);
+}
 
-    if (column_types[col_idx] == DataType::STRING)
-        throw std::runtime_error("Cannot compute median for string column");
+vegaSummaryCache& vegaSummaryCache::operator=(const vegaSummaryCache& other) {
+    if (this == &other) return *this;
+    // the source may be filled by a const reader of its frame meanwhile
+    std::lock_guard<std::mutex> lock(other.mutex);
+    entries = other.entries;
+    return *this;
+}
+
+vegaSummaryCache& vegaSummaryCache::operator=(vegaSummaryCache&& other) noexcept {
+    entries = std::move(other.entries);
+    other.entries.clear();
+    return *this;
+}
+
+void vegaSummaryCache::reset(size_t columns) {
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.assign(columns, vegaColumnSummary());
+}
+
+void vegaSummaryCache::insert(size_t column) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (column <= entries.size()) entries.insert(entries.begin() + static_cast<ptrdiff_t>(column), vegaColumnSummary());
+}
 
+void vegaSummaryCache::erase(size_t column) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (column < entries.size()) entries.erase(entries.begin() + static_cast<ptrdiff_t>(column));
+}
+
+bool vegaSummaryCache::find(size_t column, uint64_t version, bool with_quartiles, vegaColumnSummary& summary) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (column >= entries.size()) return false;
+    const vegaColumnSummary& entry = entries[column];
+    if (entry.version != version || (with_quartiles && !entry.has_quartiles)) return false;
+    summary = entry;
+    return true;
+}
+
+void vegaSummaryCache::store(size_t column, const vegaColumnSummary& summary) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (column < entries.size()) entries[column] = summary;
+}
+
+vegaColumnSummary vegaDataframe::column_summary(size_t col_idx, bool with_quartiles) const {
+    uint64_t version = data_columns.version(col_idx);
+    vegaColumnSummary fresh;
+    if (column_summaries.find(col_idx, version, with_quartiles, fresh)) return fresh;
+
+    // the values are only kept when the quartiles are wanted
+    fresh.version = version;
+    double running_mean = 0;
     std::vector<double> values;
-    for (const auto& row : data_values) {
-        if (col_idx < row.size() && !row[col_idx].empty()) {
-            try {
-                values.push_back(std::stod(row[col_idx]));
-            } catch (...) {}
-        }
+    data_columns[col_idx].for_each_numeric([&](size_t, double value) {
+        fresh.count++;
+        fresh.sum += value;
+        double delta = value - running_mean;
+        running_mean += delta / static_cast<double>(fresh.count);
+        fresh.m2 += delta * (value - running_mean);
+        fresh.min = std::min(fresh.min, value);
+        fresh.max = std::max(fresh.max, value);
+        if (with_quartiles) values.push_back(value);
+    });
+
+    fresh.has_quartiles = with_quartiles;
+    if (with_quartiles && !values.empty()) {
+        std::vector<double> quartiles = select_quantiles(values, {0.25, 0.5, 0.75});
+        std::copy(quartiles.begin(), quartiles.end(), fresh.quartiles);
     }
+    column_summaries.store(col_idx, fresh);
+    return fresh;
+}
 
-    if (values.empty()) throw std::runtime_error("No valid values to compute median");
+double vegaDataframe::mean(const std::string& col_name) const {
+    size_t col_idx = find_column_index(col_name);
 
-    std::ranges::sort(values);
-    size_t n = values.size();
+    if (!is_numeric_type(column_types[col_idx]))
+        throw std::runtime_error("Cannot compute mean for string column");
 
-    if (n % 2 == 0) {
-        return (values[n/2 - 1] + values[n/2]) / 2.0;
-    } else {
-        return values[n/2];
-    }
+    const vegaColumnSummary& summary = column_summary(col_idx);
+    if (summary.count == 0) throw std::runtime_error("No valid values to compute mean");
+    return summary.mean();
 }
 
-std::string vegaDataframe::mode(const std::string& col_name) const {
+double vegaDataframe::median(const std::string& col_name) const {
     size_t col_idx = find_column_index(col_name);
 
-    std::map<std::string, size_t> counts;
-    for (const auto& row : data_values) {
-        if (col_idx < row.size() && !row[col_idx].empty()) {
-            counts[row[col_idx]]++;
-        }
-    }
+    if (!is_numeric_type(column_types[col_idx]))
+        throw std::runtime_error("Cannot compute median for string column");
+
+    const vegaColumnSummary& summary = column_summary(col_idx, true);
+    if (summary.count == 0) throw std::runtime_error("No valid values to compute median");
+    return summary.quartiles[1];
+}
+
+std::string vegaDataframe::mode(const std::string& col_name) const {
+    std::map<std::string, size_t> counts = value_counts(col_name);
 
     if (counts.empty()) throw std::runtime_error("No valid values to compute mode");
 
@@ -833,111 +1210,59 @@ std::string vegaDataframe::mode(const std::string& col_name) const {
 }
 
 double vegaDataframe::std_dev(const std::string& col_name) const {
+    return std::sqrt(variance(col_name));
+}
+
+double vegaDataframe::variance(const std::string& col_name) const {
     size_t col_idx = find_column_index(col_name);
 
-    if (column_types[col_idx] == DataType::STRING)
+    if (!is_numeric_type(column_types[col_idx]))
         throw std::runtime_error("Cannot compute standard deviation for string column");
 
-    double mean_val = mean(col_name);
-    double sum_squared_diff = 0;
-    size_t count = 0;
-
-    for (const auto& row : data_values) {
-        if (col_idx < row.size() && !row[col_idx].empty()) {
-            try {
-                double val = std::stod(row[col_idx]);
-                sum_squared_diff += (val - mean_val) * (val - mean_val);
-                count++;
-            } catch (...) {}
-        }
-    }
-
-    if (count <= 1) throw std::runtime_error("Need at least 2 values to compute standard deviation");
-    return std::sqrt(sum_squared_diff / (count - 1));
-}
-
-double vegaDataframe::variance(const std::string& col_name) const {
-    double std_val = std_dev(col_name);
-    return std_val * std_val;
+    const vegaColumnSummary& summary = column_summary(col_idx);
+    if (summary.count <= 1) throw std::runtime_error("Need at least 2 values to compute standard deviation");
+    return summary.variance();
 }
 
 double vegaDataframe::min(const std::string& col_name) const {
     size_t col_idx = find_column_index(col_name);
 
-    if (column_types[col_idx] == DataType::STRING)
+    if (!is_numeric_type(column_types[col_idx]))
         throw std::runtime_error("Cannot compute min for string column");
 
-    double min_val = std::numeric_limits<double>::max();
-    bool found = false;
-
-    for (const auto& row : data_values) {
-        if (col_idx < row.size() && !row[col_idx].empty()) {
-            try {
-                double val = std::stod(row[col_idx]);
-                min_val = std::min(min_val, val);
-                found = true;
-            } catch (...) {}
-        }
-    }
-
-    if (!found) throw std::runtime_error("No valid values to compute min");
-    return min_val;
+    const vegaColumnSummary& summary = column_summary(col_idx);
+    if (summary.count == 0) throw std::runtime_error("No valid values to compute min");
+    return summary.min;
 }
 
 double vegaDataframe::max(const std::string& col_name) const {
     size_t col_idx = find_column_index(col_name);
 
-    if (column_types[col_idx] == DataType::STRING)
+    if (!is_numeric_type(column_types[col_idx]))
         throw std::runtime_error("Cannot compute max for string column");
 
-    double max_val = std::numeric_limits<double>::lowest();
-    bool found = false;
-
-    for (const auto& row : data_values) {
-        if (col_idx < row.size() && !row[col_idx].empty()) {
-            try {
-                double val = std::stod(row[col_idx]);
-                max_val = std::max(max_val, val);
-                found = true;
-            } catch (...) {}
-        }
-    }
-
-    if (!found) throw std::runtime_error("No valid values to compute max");
-    return max_val;
+    const vegaColumnSummary& summary = column_summary(col_idx);
+    if (summary.count == 0) throw std::runtime_error("No valid values to compute max");
+    return summary.max;
 }
 
 double vegaDataframe::sum(const std::string& col_name) const {
     size_t col_idx = find_column_index(col_name);
 
-    if (column_types[col_idx] == DataType::STRING)
+    if (!is_numeric_type(column_types[col_idx]))
         throw std::runtime_error("Cannot compute sum for string column");
-
-    double total = 0;
-    for (const auto& row : data_values) {
-        if (col_idx < row.size() && !row[col_idx].empty()) {
-            try {
-                total += std::stod(row[col_idx]);
-            } catch (...) {}
-        }
-    }
-    return total;
+    if (const vegaEncodedColumn* encoded = data_columns.encoded(col_idx)) return encoded->sum();
+    return column_summary(col_idx).sum;
 }
 
 double vegaDataframe::prod(const std::string& col_name) const {
     size_t col_idx = find_column_index(col_name);
 
-    if (column_types[col_idx] == DataType::STRING)
+    if (!is_numeric_type(column_types[col_idx]))
         throw std::runtime_error("Cannot compute product for string column");
 
     double product = 1.0;
-    for (const auto& row : data_values) {
-        if (col_idx < row.size() && !row[col_idx].empty()) {
-            try {
-                product *= std::stod(row[col_idx]);
-            } catch (...) {}
-        }
-    }
+    data_columns[col_idx].for_each_numeric([&product](size_t, double value) { product *= value; });
     return product;
 }
 
@@ -953,11 +1278,20 @@ size_t vegaDataframe::nunique(const std::string& col_name) const {
 
 std::map<std::string, size_t> vegaDataframe::value_counts(const std::string& col_name) const {
     size_t col_idx = find_column_index(col_name);
+    if (const vegaEncodedColumn* encoded = data_columns.encoded(col_idx)) return encoded->value_counts();
+    const vegaColumn& column = data_columns[col_idx];
 
     std::map<std::string, size_t> counts;
-    for (const auto& row : data_values) {
-        if (col_idx < row.size() && !row[col_idx].empty()) {
-            counts[row[col_idx]]++;
+    if (column.type == DataType::CATEGORY) {
+        std::vector<size_t> code_counts = category_counts(column);
+        for (size_t code = 0; code < code_counts.size(); ++code) {
+            if (code_counts[code] > 0) counts.emplace(column.category(static_cast<int64_t>(code)), code_counts[code]);
+        }
+        return counts;
+    }
+    for (size_t row = 0; row < column.size(); ++row) {
+        if (!column.is_null(row)) {
+            counts[column.to_string(row)]++;
         }
     }
     return counts;
@@ -966,41 +1300,24 @@ std::map<std::string, size_t> vegaDataframe::value_counts(const std::string& col
 std::vector<double> vegaDataframe::quantile(const std::string& col_name, const std::vector<double>& q) const {
     size_t col_idx = find_column_index(col_name);
 
-    if (column_types[col_idx] == DataType::STRING)
+    if (!is_numeric_type(column_types[col_idx]))
         throw std::runtime_error("Cannot compute quantiles for string column");
 
     std::vector<double> values;
-    for (const auto& row : data_values) {
-        if (col_idx < row.size() && !row[col_idx].empty()) {
-            try {
-                values.push_back(std::stod(row[col_idx]));
-            } catch (...) {}
-        }
-    }
+    data_columns[col_idx].for_each_numeric([&values](size_t, double value) { values.push_back(value); });
 
     if (values.empty()) throw std::runtime_error("No valid values to compute quantiles");
+    return select_quantiles(values, q);
+}
 
-    std::ranges::sort(values);
-    std::vector<double> result;
-
-    for (double quantile : q) {
-        if (quantile < 0.0 || quantile > 1.0) {
-            throw std::runtime_error("Quantile must be between 0 and 1");
-        }
-
-        double pos = quantile * (values.size() - 1);
-        size_t lower = static_cast<size_t>(std::floor(pos));
-        size_t upper = static_cast<size_t>(std::ceil(pos));
-
-        if (lower == upper) {
-            result.push_back(values[lower]);
-        } else {
-            double weight = pos - lower;
-            result.push_back(values[lower] * (1 - weight) + values[upper] * weight);
+// values of two numeric columns on the rows where both are non-null
+static void paired_values(const vegaColumn& x, const vegaColumn& y, std::vector<double>& x_vals, std::vector<double>& y_vals) {
+    for (size_t row = 0; row < x.size() && row < y.size(); ++row) {
+        if (!x.is_null(row) && !y.is_null(row)) {
+            x_vals.push_back(x.numeric_at(row));
+            y_vals.push_back(y.numeric_at(row));
         }
     }
-
-    return result;
 }
 
 std::map<std::string, double> vegaDataframe::corr() const {
@@ -1009,7 +1326,7 @@ std::map<std::string, double> vegaDataframe::corr() const {
     // Get all numeric columns
     std::vector<std::string> numeric_cols;
     for (size_t i = 0; i < data_features.size(); ++i) {
-        if (column_types[i] != DataType::STRING) {
+        if (is_numeric_type(column_types[i])) {
             numeric_cols.push_back(data_features[i]);
         }
     }
@@ -1023,40 +1340,26 @@ std::map<std::string, double> vegaDataframe::corr() const {
                 correlations[key] = 1.0;
             } else {
                 // Calculate Pearson correlation coefficient
-                try {
-                    std::vector<double> x_vals, y_vals;
-                    size_t x_idx = find_column_index(numeric_cols[i]);
-                    size_t y_idx = find_column_index(numeric_cols[j]);
-
-                    for (const auto& row : data_values) {
-                        if (x_idx < row.size() && y_idx < row.size() &&
-                            !row[x_idx].empty() && !row[y_idx].empty()) {
-                            try {
-                                x_vals.push_back(std::stod(row[x_idx]));
-                                y_vals.push_back(std::stod(row[y_idx]));
-                            } catch (...) {}
-                        }
-                    }
+                std::vector<double> x_vals, y_vals;
+                paired_values(data_columns[find_column_index(numeric_cols[i])],
+                              data_columns[find_column_index(numeric_cols[j])], x_vals, y_vals);
+
+                if (x_vals.size() > 1) {
+                    double x_mean = std::accumulate(x_vals.begin(), x_vals.end(), 0.0) / x_vals.size();
+                    double y_mean = std::accumulate(y_vals.begin(), y_vals.end(), 0.0) / y_vals.size();
 
-                    if (x_vals.size() > 1) {
-                        double x_mean = std::accumulate(x_vals.begin(), x_vals.end(), 0.0) / x_vals.size();
-                        double y_mean = std::accumulate(y_vals.begin(), y_vals.end(), 0.0) / y_vals.size();
-
-                        double numerator = 0.0, x_sq_sum = 0.0, y_sq_sum = 0.0;
-                        for (size_t k = 0; k < x_vals.size(); ++k) {
-                            double x_diff = x_vals[k] - x_mean;
-                            double y_diff = y_vals[k] - y_mean;
-                            numerator += x_diff * y_diff;
-                            x_sq_sum += x_diff * x_diff;
-                            y_sq_sum += y_diff * y_diff;
-                        }
-
-                        double denominator = std::sqrt(x_sq_sum * y_sq_sum);
-                        correlations[key] = (denominator > 0) ? numerator / denominator : 0.0;
-                    } else {
-                        correlations[key] = 0.0;
+                    double numerator = 0.0, x_sq_sum = 0.0, y_sq_sum = 0.0;
+                    for (size_t k = 0; k < x_vals.size(); ++k) {
+                        double x_diff = x_vals[k] - x_mean;
+                        double y_diff = y_vals[k] - y_mean;
+                        numerator += x_diff * y_diff;
+                        x_sq_sum += x_diff * x_diff;
+                        y_sq_sum += y_diff * y_diff;
                     }
-                } catch (...) {
+
+                    double denominator = std::sqrt(x_sq_sum * y_sq_sum);
+                    correlations[key] = (denominator > 0) ? numerator / denominator : 0.0;
+                } else {
                     correlations[key] = 0.0;
                 }
             }
@@ -1071,7 +1374,7 @@ std::map<std::string, double> vegaDataframe::cov() const {
 
     std::vector<std::string> numeric_cols;
     for (size_t i = 0; i < data_features.size(); ++i) {
-        if (column_types[i] != DataType::STRING) {
+        if (is_numeric_type(column_types[i])) {
             numeric_cols.push_back(data_features[i]);
         }
     }
@@ -1080,34 +1383,20 @@ std::map<std::string, double> vegaDataframe::cov() const {
         for (size_t j = i; j < numeric_cols.size(); ++j) {
             std::string key = numeric_cols[i] + "_" + numeric_cols[j];
 
-            try {
-                std::vector<double> x_vals, y_vals;
-                size_t x_idx = find_column_index(numeric_cols[i]);
-                size_t y_idx = find_column_index(numeric_cols[j]);
-
-                for (const auto& row : data_values) {
-                    if (x_idx < row.size() && y_idx < row.size() &&
-                        !row[x_idx].empty() && !row[y_idx].empty()) {
-                        try {
-                            x_vals.push_back(std::stod(row[x_idx]));
-                            y_vals.push_back(std::stod(row[y_idx]));
-                        } catch (...) {}
-                    }
-                }
+            std::vector<double> x_vals, y_vals;
+            paired_values(data_columns[find_column_index(numeric_cols[i])],
+                          data_columns[find_column_index(numeric_cols[j])], x_vals, y_vals);
 
-                if (x_vals.size() > 1) {
-                    double x_mean = std::accumulate(x_vals.begin(), x_vals.end(), 0.0) / x_vals.size();
-                    double y_mean = std::accumulate(y_vals.begin(), y_vals.end(), 0.0) / y_vals.size();
+            if (x_vals.size() > 1) {
+                double x_mean = std::accumulate(x_vals.begin(), x_vals.end(), 0.0) / x_vals.size();
+                double y_mean = std::accumulate(y_vals.begin(), y_vals.end(), 0.0) / y_vals.size();
 
-                    double covariance = 0.0;
-                    for (size_t k = 0; k < x_vals.size(); ++k) {
-                        covariance += (x_vals[k] - x_mean) * (y_vals[k] - y_mean);
-                    }
-                    covariances[key] = covariance / (x_vals.size() - 1);
-                } else {
-                    covariances[key] = 0.0;
+                double covariance = 0.0;
+                for (size_t k = 0; k < x_vals.size(); ++k) {
+                    covariance += (x_vals[k] - x_mean) * (y_vals[k] - y_mean);
                 }
-            } catch (...) {
+                covariances[key] = covariance / (x_vals.size() - 1);
+            } else {
                 covariances[key] = 0.0;
             }
         }
@@ -1119,31 +1408,19 @@ std::map<std::string, double> vegaDataframe::cov() const {
 // ============= MISSING DATA HANDLING =============
 
 vegaDataframe vegaDataframe::dropna(const std::string& how) const {
-    vegaDataframe result;
-    result.data_features = data_features;
-    result.column_types = column_types;
-
-    for (const auto& row : data_values) {
-        bool has_null = false;
-        bool all_null = true;
-
-        for (const auto& cell : row) {
-            if (cell.empty()) {
-                has_null = true;
-            } else {
-                all_null = false;
-            }
-        }
+    // "any" keeps rows valid in every column, "all" keeps rows valid in at least one;
+    // both are whole-word ANDs / ORs of the validity bitmaps
+    vegaBitmap kept(num_rows(), how == "any");
 
-        if (how == "any" && !has_null) {
-            result.data_values.push_back(row);
-        } else if (how == "all" && !all_null) {
-            result.data_values.push_back(row);
+    for (const auto& column : data_columns) {
+        if (how == "any") {
+            kept &= column.validity;
+        } else if (how == "all") {
+            kept |= column.validity;
         }
     }
 
-    result.update_stats_after_modification();
-    return result;
+    return take_rows(kept.set_indices());
 }
 
 void vegaDataframe::fillna_with_imputer(const std::string& col_name, Imputer& imputer) {
@@ -1153,44 +1430,19 @@ void vegaDataframe::fillna_with_imputer(const std::string& col_name, Imputer& im
 void vegaDataframe::fillna_value(const std::string& col_name, const std::string& value) {
     size_t col_idx = find_column_index(col_name);
 
-    for (auto& row : data_values) {
-        if (col_idx < row.size() && row[col_idx].empty()) {
-            row[col_idx] = value;
-        }
-    }
+    data_columns[col_idx].fill_nulls(value);
 
     update_stats_after_modification();
 }
 
 void vegaDataframe::fillna_method(const std::string& col_name, const std::string& method) {
     size_t col_idx = find_column_index(col_name);
+    vegaColumn& column = data_columns[col_idx];
 
     if (method == "ffill" || method == "pad") {
-        std::string last_valid = "";
-        for (auto& row : data_values) {
-            if (col_idx < row.size()) {
-                if (row[col_idx].empty()) {
-                    if (!last_valid.empty()) {
-                        row[col_idx] = last_valid;
-                    }
-                } else {
-                    last_valid = row[col_idx];
-                }
-            }
-        }
+        column = column.take(fill_sources(column, true));
     } else if (method == "bfill" || method == "backfill") {
-        std::string next_valid = "";
-        for (int i = static_cast<int>(data_values.size()) - 1; i >= 0; --i) {
-            if (col_idx < data_values[i].size()) {
-                if (data_values[i][col_idx].empty()) {
-                    if (!next_valid.empty()) {
-                        data_values[i][col_idx] = next_valid;
-                    }
-                } else {
-                    next_valid = data_values[i][col_idx];
-                }
-            }
-        }
+        column = column.take(fill_sources(column, false));
     }
 
     update_stats_after_modification();
@@ -1200,50 +1452,12 @@ vegaDataframe vegaDataframe::interpolate(const std::string& col_name, const std:
     vegaDataframe result = *this;
     size_t col_idx = find_column_index(col_name);
 
-    if (column_types[col_idx] == DataType::STRING) {
+    if (!is_numeric_type(column_types[col_idx])) {
         throw std::runtime_error("Cannot interpolate string column");
     }
 
     if (method == "linear") {
-        // Simple linear interpolation
-        for (size_t i = 1; i < result.data_values.size() - 1; ++i) {
-            if (col_idx < result.data_values[i].size() && result.data_values[i][col_idx].empty()) {
-                // Find previous and next non-empty values
-                double prev_val = 0, next_val = 0;
-                size_t prev_idx = 0, next_idx = 0;
-                bool found_prev = false, found_next = false;
-
-                // Find previous value
-                for (int j = static_cast<int>(i) - 1; j >= 0; --j) {
-                    if (col_idx < result.data_values[j].size() && !result.data_values[j][col_idx].empty()) {
-                        try {
-                            prev_val = std::stod(result.data_values[j][col_idx]);
-                            prev_idx = j;
-                            found_prev = true;
-                            break;
-                        } catch (...) {}
-                    }
-                }
-
-                // Find next value
-                for (size_t j = i + 1; j < result.data_values.size(); ++j) {
-                    if (col_idx < result.data_values[j].size() && !result.data_values[j][col_idx].empty()) {
-                        try {
-                            next_val = std::stod(result.data_values[j][col_idx]);
-                            next_idx = j;
-                            found_next = true;
-                            break;
-                        } catch (...) {}
-                    }
-                }
-
-                if (found_prev && found_next) {
-                    double ratio = static_cast<double>(i - prev_idx) / (next_idx - prev_idx);
-                    double interpolated = prev_val + ratio * (next_val - prev_val);
-                    result.data_values[i][col_idx] = std::to_string(interpolated);
-                }
-            }
-        }
+        result.data_columns[col_idx] = interpolate_linear(data_columns[col_idx]);
     }
 
     result.update_stats_after_modification();
@@ -1253,20 +1467,7 @@ vegaDataframe vegaDataframe::interpolate(const std::string& col_name, const std:
 // ============= SORTING OPERATIONS =============
 
 void vegaDataframe::sort_values(const std::string& col_name, bool ascending) {
-    size_t col_idx = find_column_index(col_name);
-
-    std::ranges::sort(data_values,
-                      [col_idx, ascending](const std::vector<std::string>& a, const std::vector<std::string>& b) {
-                          if (col_idx >= a.size() || col_idx >= b.size()) return false;
-
-                          if (ascending) {
-                              return a[col_idx] < b[col_idx];
-                          } else {
-                              return a[col_idx] > b[col_idx];
-                          }
-                      });
-
-    update_stats_after_modification();
+    sort_values(std::vector<std::string>{col_name}, std::vector<bool>{ascending});
 }
 
 void vegaDataframe::sort_values(const std::vector<std::string>& col_names, const std::vector<bool>& ascending) {
@@ -1279,22 +1480,23 @@ void vegaDataframe::sort_values(const std::vector<std::string>& col_names, const
         col_indices.push_back(find_column_index(col_name));
     }
 
-    std::ranges::sort(data_values,
-                      [&col_indices, &ascending](const std::vector<std::string>& a, const std::vector<std::string>& b) {
-                          for (size_t i = 0; i < col_indices.size(); ++i) {
-                              size_t col_idx = col_indices[i];
-                              if (col_idx >= a.size() || col_idx >= b.size()) continue;
+    std::vector<size_t> order(num_rows());
+    std::iota(order.begin(), order.end(), 0);
 
-                              if (a[col_idx] != b[col_idx]) {
-                                  if (ascending[i]) {
-                                      return a[col_idx] < b[col_idx];
-                                  } else {
-                                      return a[col_idx] > b[col_idx];
-                                  }
-                              }
-                          }
-                          return false;
-                      });
+    std::ranges::stable_sort(order,
+                             [this, &col_indices, &ascending](size_t a, size_t b) {
+                                 for (size_t i = 0; i < col_indices.size(); ++i) {
+                                     int cmp = data_columns[col_indices[i]].compare(a, b);
+                                     if (cmp != 0) {
+                                         return ascending[i] ? cmp < 0 : cmp > 0;
+                                     }
+                                 }
+                                 return false;
+                             });
+
+    for (auto& column : data_columns) {
+        column = column.take(order);
+    }
 
     update_stats_after_modification();
 }
@@ -1302,7 +1504,11 @@ void vegaDataframe::sort_values(const std::vector<std::string>& col_names, const
 void vegaDataframe::sort_index(bool ascending) {
     // Since we don't have explicit index, sort by row order
     if (!ascending) {
-        std::ranges::reverse(data_values);
+        std::vector<size_t> order(num_rows());
+        std::iota(order.rbegin(), order.rend(), 0);
+        for (auto& column : data_columns) {
+            column = column.take(order);
+        }
     }
     update_stats_after_modification();
 }
@@ -1310,27 +1516,19 @@ void vegaDataframe::sort_index(bool ascending) {
 vegaDataframe vegaDataframe::rank(const std::string& col_name, const std::string& method) const {
     size_t col_idx = find_column_index(col_name);
 
-    if (column_types[col_idx] == DataType::STRING) {
+    if (!is_numeric_type(column_types[col_idx])) {
         throw std::runtime_error("Cannot rank string column");
     }
 
     // Create vector of (value, original_index) pairs
-    std::vector<std::pair<double, size_t>> values_with_indices;
-    for (size_t i = 0; i < data_values.size(); ++i) {
-        if (col_idx < data_values[i].size() && !data_values[i][col_idx].empty()) {
-            try {
-                double val = std::stod(data_values[i][col_idx]);
-                values_with_indices.push_back({val, i});
-            } catch (...) {}
-        }
-    }
+    auto values_with_indices = numeric_cells(data_columns[col_idx]);
 
     // Sort by value
     std::ranges::sort(values_with_indices);
 
     // Create result dataframe
     vegaDataframe result = *this;
-    std::vector<std::string> rank_column(data_values.size(), "");
+    std::vector<std::string> rank_column(num_rows(), "");
 
     // Assign ranks
     for (size_t i = 0; i < values_with_indices.size(); ++i) {
@@ -1342,42 +1540,30 @@ vegaDataframe vegaDataframe::rank(const std::string& col_name, const std::string
     return result;
 }
 
-// Continue with the remaining implementations...
-// This is Part 1 of the implementation file. Due to length constraints,
-// I'll need to create additional parts for the remaining functions.
-
 // ============= IMPUTER IMPLEMENTATIONS =============
 
 void MeanImputer::impute(vegaDataframe& df, const std::string& column) {
     size_t col_idx = df.find_column_index(column);
 
-    if (df.column_types[col_idx] == DataType::STRING)
+    if (!is_numeric_type(df.column_types[col_idx]))
         throw std::runtime_error("Mean imputation only applicable to numeric columns");
 
     double sum = 0.0;
     size_t count = 0;
-    for (const auto& row : df.data_values) {
-        if (col_idx < row.size() && !row[col_idx].empty()) {
-            try {
-                sum += std::stod(row[col_idx]);
-                count++;
-            } catch (...) {}
-        }
-    }
+    df.data_columns[col_idx].for_each_numeric([&](size_t, double value) {
+        sum += value;
+        count++;
+    });
 
     if (count == 0) return;
 
     double mean = sum / count;
     std::string mean_str = std::to_string(mean);
 
-    for (auto& row : df.data_values) {
-        if (col_idx < row.size() && row[col_idx].empty()) {
-            row[col_idx] = mean_str;
-        }
-    }
+    df.data_columns[col_idx].fill_nulls(mean_str);
 
-    df.null_positions[col_idx].clear();
-    df.non_null_counts[col_idx] = df.data_values.size();
+    df.column_types[col_idx] = df.data_columns[col_idx].type;
+    df.non_null_counts[col_idx] = df.data_columns[col_idx].validity.count();
 
     std::cout << "Mean imputation performed on column '" << column << "' with value: " << mean_str << "\n";
 }
@@ -1385,17 +1571,11 @@ void MeanImputer::impute(vegaDataframe& df, const std::string& column) {
 void MedianImputer::impute(vegaDataframe& df, const std::string& column) {
     size_t col_idx = df.find_column_index(column);
 
-    if (df.column_types[col_idx] == DataType::STRING)
+    if (!is_numeric_type(df.column_types[col_idx]))
         throw std::runtime_error("Median imputation only applicable to numeric columns");
 
     std::vector<double> values;
-    for (const auto& row : df.data_values) {
-        if (col_idx < row.size() && !row[col_idx].empty()) {
-            try {
-                values.push_back(std::stod(row[col_idx]));
-            } catch (...) {}
-        }
-    }
+    df.data_columns[col_idx].for_each_numeric([&values](size_t, double value) { values.push_back(value); });
 
     if (values.empty()) return;
 
@@ -1411,14 +1591,10 @@ void MedianImputer::impute(vegaDataframe& df, const std::string& column) {
 
     std::string median_str = std::to_string(median);
 
-    for (auto& row : df.data_values) {
-        if (col_idx < row.size() && row[col_idx].empty()) {
-            row[col_idx] = median_str;
-        }
-    }
+    df.data_columns[col_idx].fill_nulls(median_str);
 
-    df.null_positions[col_idx].clear();
-    df.non_null_counts[col_idx] = df.data_values.size();
+    df.column_types[col_idx] = df.data_columns[col_idx].type;
+    df.non_null_counts[col_idx] = df.data_columns[col_idx].validity.count();
 
     std::cout << "Median imputation performed on column '" << column << "' with value: " << median_str << "\n";
 }
@@ -1426,12 +1602,7 @@ void MedianImputer::impute(vegaDataframe& df, const std::string& column) {
 void ModeImputer::impute(vegaDataframe& df, const std::string& column) {
     size_t col_idx = df.find_column_index(column);
 
-    std::map<std::string, size_t> counts;
-    for (const auto& row : df.data_values) {
-        if (col_idx < row.size() && !row[col_idx].empty()) {
-            counts[row[col_idx]]++;
-        }
-    }
+    auto counts = df.value_counts(column);
 
     if (counts.empty()) return;
 
@@ -1440,14 +1611,10 @@ void ModeImputer::impute(vegaDataframe& df, const std::string& column) {
 
     std::string mode_value = max_elem->first;
 
-    for (auto& row : df.data_values) {
-        if (col_idx < row.size() && row[col_idx].empty()) {
-            row[col_idx] = mode_value;
-        }
-    }
+    df.data_columns[col_idx].fill_nulls(mode_value);
 
-    df.null_positions[col_idx].clear();
-    df.non_null_counts[col_idx] = df.data_values.size();
+    df.column_types[col_idx] = df.data_columns[col_idx].type;
+    df.non_null_counts[col_idx] = df.data_columns[col_idx].validity.count();
 
     std::cout << "Mode imputation performed on column '" << column << "' with value: '" << mode_value << "'\n";
 }
@@ -1455,34 +1622,19 @@ void ModeImputer::impute(vegaDataframe& df, const std::string& column) {
 void ConstantImputer::impute(vegaDataframe& df, const std::string& column) {
     size_t col_idx = df.find_column_index(column);
 
-    for (auto& row : df.data_values) {
-        if (col_idx < row.size() && row[col_idx].empty()) {
-            row[col_idx] = fill_value;
-        }
-    }
+    df.data_columns[col_idx].fill_nulls(fill_value);
 
-    df.null_positions[col_idx].clear();
-    df.non_null_counts[col_idx] = df.data_values.size();
+    df.column_types[col_idx] = df.data_columns[col_idx].type;
+    df.non_null_counts[col_idx] = df.data_columns[col_idx].validity.count();
 
     std::cout << "Constant imputation performed on column '" << column << "' with value: '" << fill_value << "'\n";
 }
 
 void ForwardFillImputer::impute(vegaDataframe& df, const std::string& column) {
     size_t col_idx = df.find_column_index(column);
+    vegaColumn& data_column = df.data_columns[col_idx];
 
-    std::string last_valid_value = "";
-
-    for (auto& row : df.data_values) {
-        if (col_idx < row.size()) {
-            if (row[col_idx].empty()) {
-                if (!last_valid_value.empty()) {
-                    row[col_idx] = last_valid_value;
-                }
-            } else {
-                last_valid_value = row[col_idx];
-            }
-        }
-    }
+    data_column = data_column.take(fill_sources(data_column, true));
 
     df.update_stats_after_modification();
     std::cout << "Forward fill imputation performed on column '" << column << "'\n";
@@ -1490,26 +1642,9 @@ void ForwardFillImputer::impute(vegaDataframe& df, const std::string& column) {
 
 void BackwardFillImputer::impute(vegaDataframe& df, const std::string& column) {
     size_t col_idx = df.find_column_index(column);
+    vegaColumn& data_column = df.data_columns[col_idx];
 
-    std::vector<std::string> next_valid(df.data_values.size(), "");
-    std::string next_valid_value = "";
-
-    for (int i = static_cast<int>(df.data_values.size()) - 1; i >= 0; --i) {
-        if (col_idx < df.data_values[i].size()) {
-            if (!df.data_values[i][col_idx].empty()) {
-                next_valid_value = df.data_values[i][col_idx];
-            }
-            next_valid[i] = next_valid_value;
-        }
-    }
-
-    for (size_t i = 0; i < df.data_values.size(); ++i) {
-        if (col_idx < df.data_values[i].size() && df.data_values[i][col_idx].empty()) {
-            if (!next_valid[i].empty()) {
-                df.data_values[i][col_idx] = next_valid[i];
-            }
-        }
-    }
+    data_column = data_column.take(fill_sources(data_column, false));
 
     df.update_stats_after_modification();
     std::cout << "Backward fill imputation performed on column '" << column << "'\n";
@@ -1518,47 +1653,11 @@ void BackwardFillImputer::impute(vegaDataframe& df, const std::string& column) {
 void LinearInterpolationImputer::impute(vegaDataframe& df, const std::string& column) {
     size_t col_idx = df.find_column_index(column);
 
-    if (df.column_types[col_idx] == DataType::STRING) {
+    if (!is_numeric_type(df.column_types[col_idx])) {
         throw std::runtime_error("Cannot interpolate string column");
     }
 
-    for (size_t i = 1; i < df.data_values.size() - 1; ++i) {
-        if (col_idx < df.data_values[i].size() && df.data_values[i][col_idx].empty()) {
-            double prev_val = 0, next_val = 0;
-            size_t prev_idx = 0, next_idx = 0;
-            bool found_prev = false, found_next = false;
-
-            // Find previous value
-            for (int j = static_cast<int>(i) - 1; j >= 0; --j) {
-                if (col_idx < df.data_values[j].size() && !df.data_values[j][col_idx].empty()) {
-                    try {
-                        prev_val = std::stod(df.data_values[j][col_idx]);
-                        prev_idx = j;
-                        found_prev = true;
-                        break;
-                    } catch (...) {}
-                }
-            }
-
-            // Find next value
-            for (size_t j = i + 1; j < df.data_values.size(); ++j) {
-                if (col_idx < df.data_values[j].size() && !df.data_values[j][col_idx].empty()) {
-                    try {
-                        next_val = std::stod(df.data_values[j][col_idx]);
-                        next_idx = j;
-                        found_next = true;
-                        break;
-                    } catch (...) {}
-                }
-            }
-
-            if (found_prev && found_next) {
-                double ratio = static_cast<double>(i - prev_idx) / (next_idx - prev_idx);
-                double interpolated = prev_val + ratio * (next_val - prev_val);
-                df.data_values[i][col_idx] = std::to_string(interpolated);
-            }
-        }
-    }
+    df.data_columns[col_idx] = interpolate_linear(df.data_columns[col_idx]);
 
     df.update_stats_after_modification();
     std::cout << "Linear interpolation performed on column '" << column << "'\n";
@@ -1568,21 +1667,32 @@ void LinearInterpolationImputer::impute(vegaDataframe& df, const std::string& co
 
 std::map<std::string, vegaDataframe> vegaDataframe::groupby(const std::string& col_name) const {
     size_t col_idx = find_column_index(col_name);
-    std::map<std::string, vegaDataframe> groups;
+    const vegaColumn& column = data_columns[col_idx];
 
-    for (const auto& row : data_values) {
-        if (col_idx < row.size()) {
-            std::string key = row[col_idx];
-            if (!groups.contains(key)) {
-                groups[key].data_features = data_features;
-                groups[key].column_types = column_types;
+    std::map<std::string, std::vector<size_t>> group_rows;
+    if (column.type == DataType::CATEGORY) {
+        // rows are bucketed by code and each bucket is keyed once
+        std::vector<std::vector<size_t>> code_rows(column.category_count());
+        std::vector<size_t> null_rows;
+        for (size_t row = 0; row < column.size(); ++row) {
+            if (column.is_null(row)) null_rows.push_back(row);
+            else code_rows[static_cast<size_t>(column.int_data[row])].push_back(row);
+        }
+        if (!null_rows.empty()) group_rows.emplace("", std::move(null_rows));
+        for (size_t code = 0; code < code_rows.size(); ++code) {
+            if (!code_rows[code].empty()) {
+                group_rows.emplace(column.category(static_cast<int64_t>(code)), std::move(code_rows[code]));
             }
-            groups[key].data_values.push_back(row);
+        }
+    } else {
+        for (size_t row = 0; row < column.size(); ++row) {
+            group_rows[column.to_string(row)].push_back(row);
         }
     }
 
-    for (auto &val: groups | std::views::values) {
-        val.update_stats_after_modification();
+    std::map<std::string, vegaDataframe> groups;
+    for (const auto& [key, rows] : group_rows) {
+        groups.emplace(key, take_rows(rows));
     }
 
     return groups;
@@ -1594,27 +1704,19 @@ std::map<std::vector<std::string>, vegaDataframe> vegaDataframe::groupby(const s
         col_indices.push_back(find_column_index(col_name));
     }
 
-    std::map<std::vector<std::string>, vegaDataframe> groups;
+    std::map<std::vector<std::string>, std::vector<size_t>> group_rows;
 
-    for (const auto& row : data_values) {
+    for (size_t row = 0; row < num_rows(); ++row) {
         std::vector<std::string> key;
         for (size_t col_idx : col_indices) {
-            if (col_idx < row.size()) {
-                key.push_back(row[col_idx]);
-            } else {
-                key.push_back("");
-            }
+            key.push_back(data_columns[col_idx].to_string(row));
         }
-
-        if (!groups.contains(key)) {
-            groups[key].data_features = data_features;
-            groups[key].column_types = column_types;
-        }
-        groups[key].data_values.push_back(row);
+        group_rows[key].push_back(row);
     }
 
-    for (auto &val: groups | std::views::values) {
-        val.update_stats_after_modification();
+    std::map<std::vector<std::string>, vegaDataframe> groups;
+    for (const auto& [key, rows] : group_rows) {
+        groups.emplace(key, take_rows(rows));
     }
 
     return groups;
@@ -1628,6 +1730,7 @@ vegaDataframe vegaDataframe::aggregate(const std::map<std::string, std::string>&
         result.data_features.push_back(pair.first + "_" + pair.second);
         result.column_types.push_back(DataType::FLOAT);
     }
+    result.init_columns();
 
     // Calculate aggregations
     std::vector<std::string> agg_row;
@@ -1656,7 +1759,149 @@ vegaDataframe vegaDataframe::aggregate(const std::map<std::string, std::string>&
         }
     }
 
-    result.data_values.push_back(agg_row);
+    result.append_row(agg_row);
+    result.update_stats_after_modification();
+    return result;
+}
+
+// running aggregates of one resample bucket; std uses Welford's update
+struct BucketStats {
+    size_t count = 0;
+    double sum = 0;
+    double mean = 0;
+    double m2 = 0;
+    double min = 0;
+    double max = 0;
+    double first = 0;
+    double last = 0;
+
+    void add(double value) {
+        if (count == 0) {
+            min = max = first = value;
+        } else {
+            min = std::min(min, value);
+            max = std::max(max, value);
+        }
+        last = value;
+        sum += value;
+        ++count;
+        double delta = value - mean;
+        mean += delta / static_cast<double>(count);
+        m2 += delta * (value - mean);
+    }
+};
+
+static constexpr std::array<std::string_view, 8> RESAMPLE_FUNCS = {"mean", "sum", "min", "max", "count", "std",
+                                                                   "first", "last"};
+
+vegaDataframe vegaDataframe::resample(const std::string& time_col, const std::string& rule,
+                                      const std::map<std::string, std::string>& agg_funcs) const {
+    size_t time_idx = find_column_index(time_col);
+    if (data_columns[time_idx].type != DataType::DATETIME) {
+        return to_datetime(time_col).resample(time_col, rule, agg_funcs);
+    }
+
+    int64_t width;
+    if (!parse_duration(rule, width)) throw std::runtime_error("Invalid resample rule: " + rule);
+
+    std::vector<size_t> agg_indices;
+    for (const auto& [col_name, func_name] : agg_funcs) {
+        size_t col_idx = find_column_index(col_name);
+        if (std::find(RESAMPLE_FUNCS.begin(), RESAMPLE_FUNCS.end(), func_name) == RESAMPLE_FUNCS.end())
+            throw std::runtime_error("Unknown aggregation function: " + func_name);
+        if (func_name != "count" && !is_numeric_type(column_types[col_idx]))
+            throw std::runtime_error("Cannot compute " + func_name + " for non-numeric column '" + col_name + "'");
+        agg_indices.push_back(col_idx);
+    }
+
+    // bucket slot of every row (npos for a null time) and the bucket number of every slot.
+    // While the times are sorted a new bucket only ever follows the last one; the first step
+    // backwards indexes the slots seen so far and continues with hashing.
+    const vegaColumn& times = data_columns[time_idx];
+    std::vector<size_t> row_slot(times.size(), vegaColumn::npos);
+    std::vector<int64_t> slot_bucket;
+    std::unordered_map<int64_t, size_t> bucket_slot;
+    bool sorted = true;
+    times.validity.for_each_set([&](size_t row) {
+        int64_t ns = times.int_data[row];
+        int64_t bucket = ns / width - (ns % width < 0);
+        if (!slot_bucket.empty() && slot_bucket.back() == bucket) {
+            row_slot[row] = slot_bucket.size() - 1;
+            return;
+        }
+        if (sorted && (slot_bucket.empty() || bucket > slot_bucket.back())) {
+            row_slot[row] = slot_bucket.size();
+            slot_bucket.push_back(bucket);
+            return;
+        }
+        if (sorted) {
+            sorted = false;
+            for (size_t slot = 0; slot < slot_bucket.size(); ++slot) bucket_slot.emplace(slot_bucket[slot], slot);
+        }
+        auto [it, inserted] = bucket_slot.emplace(bucket, slot_bucket.size());
+        if (inserted) slot_bucket.push_back(bucket);
+        row_slot[row] = it->second;
+    });
+
+    // slots in bucket order
+    std::vector<size_t> order(slot_bucket.size());
+    std::iota(order.begin(), order.end(), 0);
+    if (!sorted) {
+        std::sort(order.begin(), order.end(),
+                  [&slot_bucket](size_t a, size_t b) { return slot_bucket[a] < slot_bucket[b]; });
+    }
+
+    vegaDataframe result;
+    result.data_features.push_back(time_col);
+    result.column_types.push_back(DataType::DATETIME);
+    for (const auto& [col_name, func_name] : agg_funcs) {
+        result.data_features.push_back(col_name + "_" + func_name);
+        result.column_types.push_back(func_name == "count" ? DataType::INT : DataType::FLOAT);
+    }
+    result.init_columns();
+
+    vegaColumn& starts = result.data_columns[0];
+    starts.reserve(order.size());
+    for (size_t slot : order) {
+        int64_t start;
+        if (!checked_mul(slot_bucket[slot], width, start))
+            throw std::runtime_error("Resample bucket out of the datetime range");
+        starts.append_int(start);
+    }
+
+    size_t agg = 0;
+    for (const auto& [col_name, func_name] : agg_funcs) {
+        const vegaColumn& column = data_columns[agg_indices[agg]];
+        vegaColumn& out = result.data_columns[++agg];
+        out.reserve(order.size());
+
+        if (func_name == "count") {
+            std::vector<int64_t> counts(slot_bucket.size(), 0);
+            column.validity.for_each_set([&](size_t row) {
+                if (row_slot[row] != vegaColumn::npos) counts[row_slot[row]]++;
+            });
+            for (size_t slot : order) out.append_int(counts[slot]);
+            continue;
+        }
+
+        std::vector<BucketStats> stats(slot_bucket.size());
+        column.for_each_numeric([&](size_t row, double value) {
+            if (row_slot[row] != vegaColumn::npos) stats[row_slot[row]].add(value);
+        });
+        for (size_t slot : order) {
+            const BucketStats& bucket = stats[slot];
+            if (bucket.count == 0 && func_name != "sum") out.append_null();
+            else if (func_name == "mean") out.append_float(bucket.mean);
+            else if (func_name == "sum") out.append_float(bucket.sum);
+            else if (func_name == "min") out.append_float(bucket.min);
+            else if (func_name == "max") out.append_float(bucket.max);
+            else if (func_name == "first") out.append_float(bucket.first);
+            else if (func_name == "last") out.append_float(bucket.last);
+            else if (bucket.count < 2) out.append_null();
+            else out.append_float(std::sqrt(bucket.m2 / static_cast<double>(bucket.count - 1)));
+        }
+    }
+
     result.update_stats_after_modification();
     return result;
 }
@@ -1666,21 +1911,40 @@ vegaDataframe vegaDataframe::aggregate(const std::map<std::string, std::string>&
 void vegaDataframe::label_encode(const std::string& col_name) {
     size_t col_idx = find_column_index(col_name);
 
-    if (column_types[col_idx] != DataType::STRING)
-        throw std::runtime_error("Label encoding applies only to string columns");
+    if (!data_columns[col_idx].is_text())
+        throw std::runtime_error("Label encoding applies only to string and category columns");
 
-    std::unordered_map<std::string, int> label_map;
+    const vegaColumn& column = data_columns[col_idx];
     int next_label = 0;
-
-    for (auto& row : data_values) {
-        if (col_idx < row.size() && !row[col_idx].empty()) {
-            if (!label_map.contains(row[col_idx])) {
-                label_map[row[col_idx]] = next_label++;
+    vegaColumn encoded(DataType::INT);
+    encoded.reserve(column.size());
+    // category codes are relabelled in order of first appearance, as strings are, so codes of
+    // categories that no longer occur are neither labels nor counted
+    if (column.type == DataType::CATEGORY) {
+        std::vector<int64_t> code_labels(column.category_count(), -1);
+        for (size_t row = 0; row < column.size(); ++row) {
+            if (column.is_null(row)) {
+                encoded.append_null();
+                continue;
+            }
+            int64_t& label = code_labels[static_cast<size_t>(column.int_data[row])];
+            if (label < 0) label = next_label++;
+            encoded.append_int(label);
+        }
+    } else {
+        std::unordered_map<std::string_view, int> label_map;
+        for (size_t row = 0; row < column.size(); ++row) {
+            if (column.is_null(row)) {
+                encoded.append_null();
+                continue;
             }
-            row[col_idx] = std::to_string(label_map[row[col_idx]]);
+            auto [it, inserted] = label_map.try_emplace(column.string_at(row), next_label);
+            if (inserted) next_label++;
+            encoded.append_int(it->second);
         }
     }
 
+    data_columns[col_idx] = std::move(encoded);
     column_types[col_idx] = DataType::INT;
     std::cout << "Label encoding applied on column '" << col_name << "' with " << next_label << " categories.\n";
 }
@@ -1688,13 +1952,22 @@ void vegaDataframe::label_encode(const std::string& col_name) {
 vegaDataframe vegaDataframe::one_hot_encode(const std::string& col_name) const {
     size_t col_idx = find_column_index(col_name);
 
-    if (column_types[col_idx] != DataType::STRING)
-        throw std::runtime_error("One-hot encoding applies only to string columns");
+    if (!data_columns[col_idx].is_text())
+        throw std::runtime_error("One-hot encoding applies only to string and category columns");
 
+    const vegaColumn& column = data_columns[col_idx];
+    bool category = column.type == DataType::CATEGORY;
     std::set<std::string> unique_values;
-    for (const auto& row : data_values) {
-        if (col_idx < row.size() && !row[col_idx].empty()) {
-            unique_values.insert(row[col_idx]);
+    if (category) {
+        std::vector<size_t> code_counts = category_counts(column);
+        for (size_t code = 0; code < code_counts.size(); ++code) {
+            if (code_counts[code] > 0) unique_values.emplace(column.category(static_cast<int64_t>(code)));
+        }
+    } else {
+        for (size_t row = 0; row < column.size(); ++row) {
+            if (!column.is_null(row)) {
+                unique_values.insert(std::string(column.string_at(row)));
+            }
         }
     }
 
@@ -1703,9 +1976,10 @@ vegaDataframe vegaDataframe::one_hot_encode(const std::string& col_name) const {
     for (const std::string& value : unique_values) {
         std::string new_col_name = col_name + "_" + value;
         std::vector<std::string> new_col_values;
+        int64_t code = category ? column.find_category(value) : -1;
 
-        for (const auto& row : data_values) {
-            if (col_idx < row.size() && row[col_idx] == value) {
+        for (size_t row = 0; row < column.size(); ++row) {
+            if (!column.is_null(row) && (category ? column.int_data[row] == code : column.string_at(row) == value)) {
                 new_col_values.push_back("1");
             } else {
                 new_col_values.push_back("0");
@@ -1731,12 +2005,14 @@ vegaDataframe vegaDataframe::get_dummies(const std::vector<std::string>& col_nam
 
 void vegaDataframe::apply_function(const std::string& col_name, const std::function<std::string(const std::string&)>& func) {
     size_t col_idx = find_column_index(col_name);
+    const vegaColumn& column = data_columns[col_idx];
 
-    for (auto& row : data_values) {
-        if (col_idx < row.size()) {
-            row[col_idx] = func(row[col_idx]);
-        }
+    vegaColumn mapped(column.type);
+    mapped.reserve(column.size());
+    for (size_t row = 0; row < column.size(); ++row) {
+        mapped.append_value(func(column.to_string(row)));
     }
+    data_columns[col_idx] = std::move(mapped);
 
     update_stats_after_modification();
 }
@@ -1744,15 +2020,19 @@ void vegaDataframe::apply_function(const std::string& col_name, const std::funct
 vegaDataframe vegaDataframe::map_values(const std::string& col_name, const std::map<std::string, std::string>& mapping) const {
     vegaDataframe result = *this;
     size_t col_idx = find_column_index(col_name);
-
-    for (auto& row : result.data_values) {
-        if (col_idx < row.size()) {
-            auto it = mapping.find(row[col_idx]);
-            if (it != mapping.end()) {
-                row[col_idx] = it->second;
-            }
+    const vegaColumn& column = data_columns[col_idx];
+
+    vegaColumn mapped(column.type);
+    mapped.reserve(column.size());
+    for (size_t row = 0; row < column.size(); ++row) {
+        auto it = mapping.find(column.to_string(row));
+        if (it != mapping.end()) {
+            mapped.append_value(it->second);
+        } else {
+            mapped.append_from(column, row);
         }
     }
+    result.data_columns[col_idx] = std::move(mapped);
 
     result.update_stats_after_modification();
     return result;
@@ -1763,15 +2043,13 @@ vegaDataframe vegaDataframe::map_values(const std::string& col_name, const std::
 vegaDataframe vegaDataframe::str_contains(const std::string& col_name, const std::string& pattern) const {
     vegaDataframe result = *this;
     size_t col_idx = find_column_index(col_name);
+    const vegaColumn& column = data_columns[col_idx];
 
     std::vector<std::string> contains_col;
-    for (const auto& row : data_values) {
-        if (col_idx < row.size()) {
-            bool contains = row[col_idx].find(pattern) != std::string::npos;
-            contains_col.push_back(contains ? "True" : "False");
-        } else {
-            contains_col.push_back("False");
-        }
+    std::string buffer;
+    for (size_t row = 0; row < column.size(); ++row) {
+        bool contains = cell_text(column, row, buffer).find(pattern) != std::string_view::npos;
+        contains_col.push_back(contains ? "True" : "False");
     }
 
     result.add_column(col_name + "_contains", contains_col);
@@ -1781,15 +2059,13 @@ vegaDataframe vegaDataframe::str_contains(const std::string& col_name, const std
 vegaDataframe vegaDataframe::str_startswith(const std::string& col_name, const std::string& prefix) const {
     vegaDataframe result = *this;
     size_t col_idx = find_column_index(col_name);
+    const vegaColumn& column = data_columns[col_idx];
 
     std::vector<std::string> startswith_col;
-    for (const auto& row : data_values) {
-        if (col_idx < row.size()) {
-            bool starts = row[col_idx].substr(0, prefix.length()) == prefix;
-            startswith_col.push_back(starts ? "True" : "False");
-        } else {
-            startswith_col.push_back("False");
-        }
+    std::string buffer;
+    for (size_t row = 0; row < column.size(); ++row) {
+        bool starts = cell_text(column, row, buffer).starts_with(prefix);
+        startswith_col.push_back(starts ? "True" : "False");
     }
 
     result.add_column(col_name + "_startswith", startswith_col);
@@ -1799,18 +2075,13 @@ vegaDataframe vegaDataframe::str_startswith(const std::string& col_name, const s
 vegaDataframe vegaDataframe::str_endswith(const std::string& col_name, const std::string& suffix) const {
     vegaDataframe result = *this;
     size_t col_idx = find_column_index(col_name);
+    const vegaColumn& column = data_columns[col_idx];
 
     std::vector<std::string> endswith_col;
-    for (const auto& row : data_values) {
-        if (col_idx < row.size()) {
-            bool ends = false;
-            if (row[col_idx].length() >= suffix.length()) {
-                ends = row[col_idx].substr(row[col_idx].length() - suffix.length()) == suffix;
-            }
-            endswith_col.push_back(ends ? "True" : "False");
-        } else {
-            endswith_col.push_back("False");
-        }
+    std::string buffer;
+    for (size_t row = 0; row < column.size(); ++row) {
+        bool ends = cell_text(column, row, buffer).ends_with(suffix);
+        endswith_col.push_back(ends ? "True" : "False");
     }
 
     result.add_column(col_name + "_endswith", endswith_col);
@@ -1820,18 +2091,22 @@ vegaDataframe vegaDataframe::str_endswith(const std::string& col_name, const std
 vegaDataframe vegaDataframe::str_replace(const std::string& col_name, const std::string& pattern, const std::string& replacement) const {
     vegaDataframe result = *this;
     size_t col_idx = find_column_index(col_name);
+    const vegaColumn& column = data_columns[col_idx];
 
-    for (auto& row : result.data_values) {
-        if (col_idx < row.size()) {
-            std::string& cell = row[col_idx];
-            size_t pos = 0;
-            while ((pos = cell.find(pattern, pos)) != std::string::npos) {
-                cell.replace(pos, pattern.length(), replacement);
-                pos += replacement.length();
-            }
+    vegaColumn replaced(column.type);
+    replaced.reserve(column.size());
+    for (size_t row = 0; row < column.size(); ++row) {
+        std::string cell = column.to_string(row);
+        size_t pos = 0;
+        while (!pattern.empty() && (pos = cell.find(pattern, pos)) != std::string::npos) {
+            cell.replace(pos, pattern.length(), replacement);
+            pos += replacement.length();
         }
+        replaced.append_value(cell);
     }
+    result.data_columns[col_idx] = std::move(replaced);
 
+    result.update_stats_after_modification();
     return result;
 }
 
@@ -1839,10 +2114,12 @@ vegaDataframe vegaDataframe::str_upper(const std::string& col_name) const {
     vegaDataframe result = *this;
     size_t col_idx = find_column_index(col_name);
 
-    for (auto& row : result.data_values) {
-        if (col_idx < row.size()) {
-            std::ranges::transform(row[col_idx], row[col_idx].begin(), ::toupper);
-        }
+    // numeric cells have no letters to convert, string bytes are converted in place
+    if (result.data_columns[col_idx].is_text()) {
+        vegaColumn& column = result.data_columns[col_idx];
+        std::ranges::transform(column.string_data, column.string_data.begin(), ::toupper);
+        // categories that now coincide are merged
+        if (column.type == DataType::CATEGORY) column = column.cast(DataType::STRING).cast(DataType::CATEGORY);
     }
 
     return result;
@@ -1852,10 +2129,10 @@ vegaDataframe vegaDataframe::str_lower(const std::string& col_name) const {
     vegaDataframe result = *this;
     size_t col_idx = find_column_index(col_name);
 
-    for (auto& row : result.data_values) {
-        if (col_idx < row.size()) {
-            std::ranges::transform(row[col_idx], row[col_idx].begin(), ::tolower);
-        }
+    if (result.data_columns[col_idx].is_text()) {
+        vegaColumn& column = result.data_columns[col_idx];
+        std::ranges::transform(column.string_data, column.string_data.begin(), ::tolower);
+        if (column.type == DataType::CATEGORY) column = column.cast(DataType::STRING).cast(DataType::CATEGORY);
     }
 
     return result;
@@ -1864,11 +2141,23 @@ vegaDataframe vegaDataframe::str_lower(const std::string& col_name) const {
 vegaDataframe vegaDataframe::str_strip(const std::string& col_name) const {
     vegaDataframe result = *this;
     size_t col_idx = find_column_index(col_name);
-
-    for (auto& row : result.data_values) {
-        if (col_idx < row.size()) {
-            row[col_idx] = trim_whitespace(row[col_idx]);
+    const vegaColumn& column = data_columns[col_idx];
+
+    if (column.is_text()) {
+        vegaColumn stripped(column.type);
+        stripped.reserve(column.size());
+        for (size_t row = 0; row < column.size(); ++row) {
+            std::string_view cell = column.is_null(row) ? std::string_view() : column.string_at(row);
+            size_t start = cell.find_first_not_of(" \t\r\n");
+            if (start == std::string_view::npos) {
+                stripped.append_null();
+            } else {
+                size_t end = cell.find_last_not_of(" \t\r\n");
+                stripped.append_string(cell.substr(start, end - start + 1));
+            }
         }
+        result.data_columns[col_idx] = std::move(stripped);
+        result.update_stats_after_modification();
     }
 
     return result;
@@ -1876,14 +2165,12 @@ vegaDataframe vegaDataframe::str_strip(const std::string& col_name) const {
 
 std::vector<size_t> vegaDataframe::str_len(const std::string& col_name) const {
     size_t col_idx = find_column_index(col_name);
+    const vegaColumn& column = data_columns[col_idx];
 
     std::vector<size_t> lengths;
-    for (const auto& row : data_values) {
-        if (col_idx < row.size()) {
-            lengths.push_back(row[col_idx].length());
-        } else {
-            lengths.push_back(0);
-        }
+    std::string buffer;
+    for (size_t row = 0; row < column.size(); ++row) {
+        lengths.push_back(cell_text(column, row, buffer).length());
     }
 
     return lengths;
@@ -1891,86 +2178,60 @@ std::vector<size_t> vegaDataframe::str_len(const std::string& col_name) const {
 
 // ============= MERGING AND JOINING =============
 
-vegaDataframe vegaDataframe::merge(const vegaDataframe& other, const std::string& left_col, const std::string& right_col, const std::string& how) const {
-    size_t left_col_idx = find_column_index(left_col);
-    size_t right_col_idx = other.find_column_index(right_col);
-
+// result of joining the rows of two dataframes; a right row of npos yields nulls
+static vegaDataframe gather_join(const vegaDataframe& left, const vegaDataframe& right,
+                                 const std::vector<size_t>& left_rows, const std::vector<size_t>& right_rows,
+                                 const std::vector<size_t>& right_skip) {
     vegaDataframe result;
 
-    // Combine feature names
-    result.data_features = data_features;
-    for (const auto& feature : other.data_features) {
-        if (feature != right_col) {  // Avoid duplicate join column
-            result.data_features.push_back(feature);
-        }
+    for (size_t i = 0; i < left.data_features.size(); ++i) {
+        result.data_features.push_back(left.data_features[i]);
+        result.data_columns.push_back(left.data_columns[i].take(left_rows));
     }
 
-    // Combine column types
-    result.column_types = column_types;
-    for (size_t i = 0; i < other.column_types.size(); ++i) {
-        if (i != right_col_idx) {
-            result.column_types.push_back(other.column_types[i]);
+    for (size_t i = 0; i < right.data_features.size(); ++i) {
+        if (std::ranges::find(right_skip, i) == right_skip.end()) {  // Avoid duplicate join column
+            result.data_features.push_back(right.data_features[i]);
+            result.data_columns.push_back(right.data_columns[i].take(right_rows));
         }
     }
 
-    if (how == "inner") {
-        // Inner join
-        for (const auto& left_row : data_values) {
-            if (left_col_idx < left_row.size()) {
-                std::string join_key = left_row[left_col_idx];
-
-                for (const auto& right_row : other.data_values) {
-                    if (right_col_idx < right_row.size() && right_row[right_col_idx] == join_key) {
-                        std::vector<std::string> merged_row = left_row;
-
-                        for (size_t i = 0; i < right_row.size(); ++i) {
-                            if (i != right_col_idx) {
-                                merged_row.push_back(right_row[i]);
-                            }
-                        }
-
-                        result.data_values.push_back(merged_row);
-                    }
-                }
-            }
-        }
-    } else if (how == "left") {
-        // Left join
-        for (const auto& left_row : data_values) {
-            std::string join_key = (left_col_idx < left_row.size()) ? left_row[left_col_idx] : "";
-            bool found_match = false;
+    result.update_stats_after_modification();
+    return result;
+}
+
+vegaDataframe vegaDataframe::merge(const vegaDataframe& other, const std::string& left_col, const std::string& right_col, const std::string& how) const {
+    size_t left_col_idx = find_column_index(left_col);
+    size_t right_col_idx = other.find_column_index(right_col);
 
-            for (const auto& right_row : other.data_values) {
-                if (right_col_idx < right_row.size() && right_row[right_col_idx] == join_key) {
-                    std::vector<std::string> merged_row = left_row;
+    // Hash the right join column once
+    std::unordered_map<std::string, std::vector<size_t>> right_index;
+    const vegaColumn& right_key = other.data_columns[right_col_idx];
+    for (size_t row = 0; row < right_key.size(); ++row) {
+        right_index[right_key.to_string(row)].push_back(row);
+    }
 
-                    for (size_t i = 0; i < right_row.size(); ++i) {
-                        if (i != right_col_idx) {
-                            merged_row.push_back(right_row[i]);
-                        }
-                    }
+    std::vector<size_t> left_rows, right_rows;
+    const vegaColumn& left_key = data_columns[left_col_idx];
 
-                    result.data_values.push_back(merged_row);
-                    found_match = true;
+    if (how == "inner" || how == "left") {
+        for (size_t row = 0; row < left_key.size(); ++row) {
+            auto it = right_index.find(left_key.to_string(row));
+            if (it != right_index.end()) {
+                for (size_t right_row : it->second) {
+                    left_rows.push_back(row);
+                    right_rows.push_back(right_row);
                 }
-            }
-
-            if (!found_match) {
-                std::vector<std::string> merged_row = left_row;
+            } else if (how == "left") {
                 // Add empty values for right table columns
-                for (size_t i = 0; i < other.data_features.size(); ++i) {
-                    if (i != right_col_idx) {
-                        merged_row.push_back("");
-                    }
-                }
-                result.data_values.push_back(merged_row);
+                left_rows.push_back(row);
+                right_rows.push_back(vegaColumn::npos);
             }
         }
     }
     // Add more join types (right, outer) as needed
 
-    result.update_stats_after_modification();
-    return result;
+    return gather_join(*this, other, left_rows, right_rows, {right_col_idx});
 }
 
 vegaDataframe vegaDataframe::merge(const vegaDataframe& other, const std::vector<std::string>& on, const std::string& how) const {
@@ -1982,61 +2243,34 @@ vegaDataframe vegaDataframe::merge(const vegaDataframe& other, const std::vector
         right_col_indices.push_back(other.find_column_index(col_name));
     }
 
-    vegaDataframe result;
-    result.data_features = data_features;
-
-    // Add columns from right table (excluding join columns)
-    for (size_t i = 0; i < other.data_features.size(); ++i) {
-        if (std::ranges::find(right_col_indices, i) == right_col_indices.end()) {
-            result.data_features.push_back(other.data_features[i]);
-        }
-    }
+    std::vector<size_t> left_rows, right_rows;
 
-    result.column_types = column_types;
-    for (size_t i = 0; i < other.column_types.size(); ++i) {
-        if (std::ranges::find(right_col_indices, i) == right_col_indices.end()) {
-            result.column_types.push_back(other.column_types[i]);
+    if (how == "inner") {
+        std::map<std::vector<std::string>, std::vector<size_t>> right_index;
+        for (size_t row = 0; row < other.num_rows(); ++row) {
+            std::vector<std::string> right_key;
+            for (size_t col_idx : right_col_indices) {
+                right_key.push_back(other.data_columns[col_idx].to_string(row));
+            }
+            right_index[right_key].push_back(row);
         }
-    }
 
-    if (how == "inner") {
-        for (const auto& left_row : data_values) {
+        for (size_t row = 0; row < num_rows(); ++row) {
             std::vector<std::string> left_key;
             for (size_t col_idx : left_col_indices) {
-                if (col_idx < left_row.size()) {
-                    left_key.push_back(left_row[col_idx]);
-                } else {
-                    left_key.push_back("");
-                }
+                left_key.push_back(data_columns[col_idx].to_string(row));
             }
 
-            for (const auto& right_row : other.data_values) {
-                std::vector<std::string> right_key;
-                for (size_t col_idx : right_col_indices) {
-                    if (col_idx < right_row.size()) {
-                        right_key.push_back(right_row[col_idx]);
-                    } else {
-                        right_key.push_back("");
-                    }
-                }
-
-                if (left_key == right_key) {
-                    std::vector<std::string> merged_row = left_row;
-
-                    for (size_t i = 0; i < right_row.size(); ++i) {
-                        if (std::ranges::find(right_col_indices, i) == right_col_indices.end()) {
-                            merged_row.push_back(right_row[i]);
-                        }
-                    }
-
-                    result.data_values.push_back(merged_row);
-                }
+            auto it = right_index.find(left_key);
+            if (it == right_index.end()) continue;
+            for (size_t right_row : it->second) {
+                left_rows.push_back(row);
+                right_rows.push_back(right_row);
             }
         }
     }
 
-    result.update_stats_after_modification();
-    return result;
+    return gather_join(*this, other, left_rows, right_rows, right_col_indices);
 }
 
 vegaDataframe vegaDataframe::concat(const std::vector<vegaDataframe>& dataframes, int axis, bool ignore_index) {
@@ -2057,8 +2291,12 @@ vegaDataframe vegaDataframe::concat(const std::vector<vegaDataframe>& dataframes
             }
 
             // Append rows
-            for (const auto& row : df.data_values) {
-                result.data_values.push_back(row);
+            for (size_t col = 0; col < result.data_columns.size(); ++col) {
+                const vegaColumn& source = df.data_columns[col];
+                result.data_columns[col].reserve(result.data_columns[col].size() + source.size());
+                for (size_t row = 0; row < source.size(); ++row) {
+                    result.data_columns[col].append_from(source, row);
+                }
             }
         }
     } else if (axis == 1) {
@@ -2067,62 +2305,38 @@ vegaDataframe vegaDataframe::concat(const std::vector<vegaDataframe>& dataframes
             const auto& df = dataframes[i];
 
             // Check if row counts match
-            if (df.data_values.size() != result.data_values.size()) {
+            if (df.num_rows() != result.num_rows()) {
                 throw std::runtime_error("Row counts don't match for horizontal concatenation");
             }
 
-            // Append column names
-            for (const auto& feature : df.data_features) {
-                result.data_features.push_back(feature);
-            }
-
-            // Append column types
-            for (const auto& type : df.column_types) {
-                result.column_types.push_back(type);
-            }
-
-            // Append column data
-            for (size_t row_idx = 0; row_idx < result.data_values.size(); ++row_idx) {
-                for (size_t col_idx = 0; col_idx < df.data_values[row_idx].size(); ++col_idx) {
-                    result.data_values[row_idx].push_back(df.data_values[row_idx][col_idx]);
-                }
+            // Append column names, types and data
+            for (size_t col = 0; col < df.data_features.size(); ++col) {
+                result.data_features.push_back(df.data_features[col]);
+                result.column_types.push_back(df.column_types[col]);
+                result.data_columns.push_back(df.data_columns[col]);
             }
         }
     }
 
     result.update_stats_after_modification();
-    return result;
-}
-
-vegaDataframe vegaDataframe::join(const vegaDataframe& other, const std::string& how) const {
-    // Simple index-based join (assumes matching row indices)
-    vegaDataframe result = *this;
-
-    // Add columns from other dataframe
-    for (const auto& feature : other.data_features) {
-        result.data_features.push_back(feature);
-    }
-
-    for (const auto& type : other.column_types) {
-        result.column_types.push_back(type);
-    }
+    return result;
+}
 
-    // Join data row by row
-    size_t min_rows = std::min(data_values.size(), other.data_values.size());
+vegaDataframe vegaDataframe::join(const vegaDataframe& other, const std::string& how) const {
+    // Simple index-based join (assumes matching row indices)
+    vegaDataframe result = *this;
 
-    for (size_t i = 0; i < min_rows; ++i) {
-        for (size_t j = 0; j < other.data_values[i].size(); ++j) {
-            result.data_values[i].push_back(other.data_values[i][j]);
-        }
+    // Rows missing from the other dataframe are filled with nulls
+    std::vector<size_t> other_rows(num_rows());
+    for (size_t i = 0; i < other_rows.size(); ++i) {
+        other_rows[i] = (i < other.num_rows()) ? i : vegaColumn::npos;
     }
 
-    // Handle remaining rows based on join type
-    if (how == "left" && data_values.size() > other.data_values.size()) {
-        for (size_t i = min_rows; i < data_values.size(); ++i) {
-            for (size_t j = 0; j < other.data_features.size(); ++j) {
-                result.data_values[i].push_back("");
-            }
-        }
+    // Add columns from other dataframe
+    for (size_t col = 0; col < other.data_features.size(); ++col) {
+        result.data_features.push_back(other.data_features[col]);
+        result.column_types.push_back(other.column_types[col]);
+        result.data_columns.push_back(other.data_columns[col].take(other_rows));
     }
 
     result.update_stats_after_modification();
@@ -2132,7 +2346,7 @@ vegaDataframe vegaDataframe::join(const vegaDataframe& other, const std::string&
 // ============= DUPLICATE HANDLING =============
 
 std::vector<bool> vegaDataframe::duplicated(const std::vector<std::string>& subset, bool keep_first) const {
-    std::vector<bool> is_duplicate(data_values.size(), false);
+    std::vector<bool> is_duplicate(num_rows(), false);
     std::set<std::vector<std::string>> seen_combinations;
 
     std::vector<size_t> check_columns;
@@ -2148,47 +2362,20 @@ std::vector<bool> vegaDataframe::duplicated(const std::vector<std::string>& subs
         }
     }
 
-    for (size_t row_idx = 0; row_idx < data_values.size(); ++row_idx) {
-        const auto& row = data_values[row_idx];
+    // With keep_first == false the last occurrence is kept, so rows are visited backwards
+    size_t n = num_rows();
+    for (size_t k = 0; k < n; ++k) {
+        size_t row_idx = keep_first ? k : n - 1 - k;
         std::vector<std::string> key;
 
         for (size_t col_idx : check_columns) {
-            if (col_idx < row.size()) {
-                key.push_back(row[col_idx]);
-            } else {
-                key.push_back("");
-            }
+            key.push_back(data_columns[col_idx].to_string(row_idx));
         }
 
         if (seen_combinations.contains(key)) {
             is_duplicate[row_idx] = true;
         } else {
-            seen_combinations.insert(key);
-        }
-    }
-
-    if (!keep_first) {
-        // Mark first occurrence as duplicate instead of subsequent ones
-        seen_combinations.clear();
-        std::fill(is_duplicate.begin(), is_duplicate.end(), false);
-
-        for (int row_idx = static_cast<int>(data_values.size()) - 1; row_idx >= 0; --row_idx) {
-            const auto& row = data_values[row_idx];
-            std::vector<std::string> key;
-
-            for (size_t col_idx : check_columns) {
-                if (col_idx < row.size()) {
-                    key.push_back(row[col_idx]);
-                } else {
-                    key.emplace_back("");
-                }
-            }
-
-            if (seen_combinations.contains(key)) {
-                is_duplicate[row_idx] = true;
-            } else {
-                seen_combinations.insert(key);
-            }
+            seen_combinations.insert(std::move(key));
         }
     }
 
@@ -2198,18 +2385,14 @@ std::vector<bool> vegaDataframe::duplicated(const std::vector<std::string>& subs
 vegaDataframe vegaDataframe::drop_duplicates(const std::vector<std::string>& subset, bool keep_first) const {
     auto duplicate_mask = duplicated(subset, keep_first);
 
-    vegaDataframe result;
-    result.data_features = data_features;
-    result.column_types = column_types;
-
-    for (size_t i = 0; i < data_values.size(); ++i) {
+    std::vector<size_t> kept;
+    for (size_t i = 0; i < duplicate_mask.size(); ++i) {
         if (!duplicate_mask[i]) {
-            result.data_values.push_back(data_values[i]);
+            kept.push_back(i);
         }
     }
 
-    result.update_stats_after_modification();
-    return result;
+    return take_rows(kept);
 }
 
 // ============= RESHAPING OPERATIONS =============
@@ -2218,24 +2401,21 @@ vegaDataframe vegaDataframe::transpose() const {
     vegaDataframe result;
 
     // Transpose: rows become columns, columns become rows
-    result.data_features.resize(data_values.size());
-    for (size_t i = 0; i < data_values.size(); ++i) {
+    result.data_features.resize(num_rows());
+    for (size_t i = 0; i < num_rows(); ++i) {
         result.data_features[i] = "row_" + std::to_string(i);
     }
 
     result.column_types.assign(result.data_features.size(), DataType::STRING);
+    result.init_columns();
 
     // Create transposed data
-    for (size_t col = 0; col < data_features.size(); ++col) {
-        std::vector<std::string> new_row;
-        for (size_t row = 0; row < data_values.size(); ++row) {
-            if (col < data_values[row].size()) {
-                new_row.push_back(data_values[row][col]);
-            } else {
-                new_row.push_back("");
-            }
+    for (size_t row = 0; row < num_rows(); ++row) {
+        vegaColumn& target = result.data_columns[row];
+        target.reserve(data_columns.size());
+        for (const auto& column : data_columns) {
+            target.append_string(column.to_string(row));
         }
-        result.data_values.push_back(new_row);
     }
 
     result.update_stats_after_modification();
@@ -2247,22 +2427,30 @@ vegaDataframe vegaDataframe::copy() const {
 }
 
 bool vegaDataframe::empty() const {
-    return data_values.empty() || data_features.empty();
+    return num_rows() == 0 || data_features.empty();
 }
 
 bool vegaDataframe::equals(const vegaDataframe& other) const {
     return data_features == other.data_features &&
-           data_values == other.data_values &&
+           data_columns == other.data_columns &&
            column_types == other.column_types;
 }
 
 std::vector<std::string> vegaDataframe::unique(const std::string& col_name) const {
     size_t col_idx = find_column_index(col_name);
+    const vegaColumn& column = data_columns[col_idx];
 
     std::set<std::string> unique_set;
-    for (const auto& row : data_values) {
-        if (col_idx < row.size() && !row[col_idx].empty()) {
-            unique_set.insert(row[col_idx]);
+    if (column.type == DataType::CATEGORY) {
+        std::vector<size_t> code_counts = category_counts(column);
+        for (size_t code = 0; code < code_counts.size(); ++code) {
+            if (code_counts[code] > 0) unique_set.emplace(column.category(static_cast<int64_t>(code)));
+        }
+    } else {
+        for (size_t row = 0; row < column.size(); ++row) {
+            if (!column.is_null(row)) {
+                unique_set.insert(column.to_string(row));
+            }
         }
     }
 
@@ -2271,69 +2459,48 @@ std::vector<std::string> vegaDataframe::unique(const std::string& col_name) cons
 
 // ============= EXPORT OPERATIONS =============
 
-void vegaDataframe::to_csv(const std::string& filename, bool index, char sep) const {
-    std::ofstream file(filename);
-    if (!file) throw FILE_ERROR("Cannot create output file: " + filename);
-
-    // Write header
-    if (index) {
-        file << "index" << sep;
-    }
-
-    for (size_t i = 0; i < data_features.size(); ++i) {
-        file << data_features[i];
-        if (i < data_features.size() - 1) file << sep;
-    }
-    file << "\n";
-
-    // Write data
-    for (size_t row_idx = 0; row_idx < data_values.size(); ++row_idx) {
-        const auto& row = data_values[row_idx];
-
-        if (index) {
-            file << row_idx << sep;
-        }
+void vegaDataframe::to_csv(const std::string& filename, bool index, char sep, Compression compression) const {
+    vegaCsvWriteOptions options;
+    options.index = index;
+    options.sep = sep;
+    options.compression = compression;
+    to_csv(filename, options);
+}
 
-        for (size_t i = 0; i < row.size(); ++i) {
-            file << row[i];
-            if (i < row.size() - 1) file << sep;
-        }
-        file << "\n";
+void vegaDataframe::to_csv(const std::string& filename, const vegaCsvWriteOptions& options) const {
+    vegaCsvWriteOptions write_options = options;
+    if (options.append) {
+        std::error_code error;
+        auto existing_size = std::filesystem::file_size(filename, error);
+        write_options.header = options.header && (error || existing_size == 0);
     }
 
-    std::cout << "DataFrame exported to: " << filename << "\n";
+    auto output = open_output_stream(filename, options.compression, options.append);
+    write_csv(*output, data_features, data_columns, write_options);
+    if (!*output) throw FILE_ERROR("Cannot write output file: " + filename);
 }
 
-void vegaDataframe::to_json(const std::string& filename) const {
-    std::ofstream file(filename);
-    if (!file) throw FILE_ERROR("Cannot create JSON file: " + filename);
-
-    file << "[\n";
-    for (size_t row_idx = 0; row_idx < data_values.size(); ++row_idx) {
-        const auto& row = data_values[row_idx];
-        file << "  {\n";
-
-        for (size_t col_idx = 0; col_idx < data_features.size(); ++col_idx) {
-            file << "    \"" << data_features[col_idx] << "\": ";
-
-            std::string value = (col_idx < row.size()) ? row[col_idx] : "";
-            if (column_types[col_idx] == DataType::STRING) {
-                file << "\"" << value << "\"";
-            } else {
-                file << (value.empty() ? "null" : value);
-            }
+void vegaDataframe::to_json(const std::string& filename, Compression compression) const {
+    vegaJsonWriteOptions options;
+    options.compression = compression;
+    to_json(filename, options);
+}
 
-            if (col_idx < data_features.size() - 1) file << ",";
-            file << "\n";
-        }
+void vegaDataframe::to_json(const std::string& filename, const vegaJsonWriteOptions& options) const {
+    auto output = open_output_stream(filename, options.compression);
+    write_json(*output, data_features, data_columns, options);
+    if (!*output) throw FILE_ERROR("Cannot write output file: " + filename);
+}
 
-        file << "  }";
-        if (row_idx < data_values.size() - 1) file << ",";
-        file << "\n";
-    }
-    file << "]\n";
+void vegaDataframe::to_vega(const std::string& filename) const {
+    write_vega_file(filename, data_features, data_columns);
+}
 
-    std::cout << "DataFrame exported to JSON: " << filename << "\n";
+void vegaDataframe::to_arrow_ipc(const std::string& filename, ArrowIpcFormat format) const {
+    std::ofstream file(filename, std::ios::binary);
+    if (!file) throw FILE_ERROR("Cannot create Arrow file: " + filename);
+    write_arrow_ipc(file, data_features, data_columns, format);
+    if (!file) throw FILE_ERROR("Cannot write output file: " + filename);
 }
 
 void vegaDataframe::to_html(const std::string& filename) const {
@@ -2353,11 +2520,10 @@ void vegaDataframe::to_html(const std::string& filename) const {
     file << "</tr>\n";
 
     // Data rows
-    for (const auto& row : data_values) {
+    for (size_t row = 0; row < num_rows(); ++row) {
         file << "<tr>\n";
-        for (size_t i = 0; i < data_features.size(); ++i) {
-            std::string value = (i < row.size()) ? row[i] : "";
-            file << "<td>" << value << "</td>\n";
+        for (const auto& column : data_columns) {
+            file << "<td>" << column.to_string(row) << "</td>\n";
         }
         file << "</tr>\n";
     }
@@ -2371,24 +2537,13 @@ void vegaDataframe::to_html(const std::string& filename) const {
 std::vector<double> vegaDataframe::rolling_mean(const std::string& col_name, size_t window) const {
     size_t col_idx = find_column_index(col_name);
 
-    if (column_types[col_idx] == DataType::STRING)
+    if (!is_numeric_type(column_types[col_idx]))
         throw std::runtime_error("Cannot compute rolling mean for string column");
 
     std::vector<double> result;
-    std::vector<double> values;
 
     // Extract numeric values
-    for (const auto& row : data_values) {
-        if (col_idx < row.size() && !row[col_idx].empty()) {
-            try {
-                values.push_back(std::stod(row[col_idx]));
-            } catch (...) {
-                values.push_back(std::numeric_limits<double>::quiet_NaN());
-            }
-        } else {
-            values.push_back(std::numeric_limits<double>::quiet_NaN());
-        }
-    }
+    std::vector<double> values = column_as_doubles(data_columns[col_idx], std::numeric_limits<double>::quiet_NaN());
 
     // Calculate rolling mean
     for (size_t i = 0; i < values.size(); ++i) {
@@ -2413,23 +2568,11 @@ std::vector<double> vegaDataframe::rolling_mean(const std::string& col_name, siz
 std::vector<double> vegaDataframe::rolling_sum(const std::string& col_name, size_t window) const {
     size_t col_idx = find_column_index(col_name);
 
-    if (column_types[col_idx] == DataType::STRING)
+    if (!is_numeric_type(column_types[col_idx]))
         throw std::runtime_error("Cannot compute rolling sum for string column");
 
     std::vector<double> result;
-    std::vector<double> values;
-
-    for (const auto& row : data_values) {
-        if (col_idx < row.size() && !row[col_idx].empty()) {
-            try {
-                values.push_back(std::stod(row[col_idx]));
-            } catch (...) {
-                values.push_back(0.0);
-            }
-        } else {
-            values.push_back(0.0);
-        }
-    }
+    std::vector<double> values = column_as_doubles(data_columns[col_idx], 0.0);
 
     for (size_t i = 0; i < values.size(); ++i) {
         if (i < window - 1) {
@@ -2449,23 +2592,11 @@ std::vector<double> vegaDataframe::rolling_sum(const std::string& col_name, size
 std::vector<double> vegaDataframe::rolling_std(const std::string& col_name, size_t window) const {
     size_t col_idx = find_column_index(col_name);
 
-    if (column_types[col_idx] == DataType::STRING)
+    if (!is_numeric_type(column_types[col_idx]))
         throw std::runtime_error("Cannot compute rolling std for string column");
 
     std::vector<double> result;
-    std::vector<double> values;
-
-    for (const auto& row : data_values) {
-        if (col_idx < row.size() && !row[col_idx].empty()) {
-            try {
-                values.push_back(std::stod(row[col_idx]));
-            } catch (...) {
-                values.push_back(std::numeric_limits<double>::quiet_NaN());
-            }
-        } else {
-            values.push_back(std::numeric_limits<double>::quiet_NaN());
-        }
-    }
+    std::vector<double> values = column_as_doubles(data_columns[col_idx], std::numeric_limits<double>::quiet_NaN());
 
     for (size_t i = 0; i < values.size(); ++i) {
         if (i < window - 1) {
@@ -2507,26 +2638,20 @@ std::vector<double> vegaDataframe::rolling_std(const std::string& col_name, size
 std::vector<double> vegaDataframe::expanding_mean(const std::string& col_name) const {
     size_t col_idx = find_column_index(col_name);
 
-    if (column_types[col_idx] == DataType::STRING)
+    if (!is_numeric_type(column_types[col_idx]))
         throw std::runtime_error("Cannot compute expanding mean for string column");
 
+    const vegaColumn& column = data_columns[col_idx];
     std::vector<double> result;
     double running_sum = 0.0;
     size_t running_count = 0;
 
-    for (const auto& row : data_values) {
-        if (col_idx < row.size() && !row[col_idx].empty()) {
-            try {
-                double value = std::stod(row[col_idx]);
-                running_sum += value;
-                running_count++;
-                result.push_back(running_sum / running_count);
-            } catch (...) {
-                result.push_back(running_count > 0 ? running_sum / running_count : std::numeric_limits<double>::quiet_NaN());
-            }
-        } else {
-            result.push_back(running_count > 0 ? running_sum / running_count : std::numeric_limits<double>::quiet_NaN());
+    for (size_t row = 0; row < column.size(); ++row) {
+        if (!column.is_null(row)) {
+            running_sum += column.numeric_at(row);
+            running_count++;
         }
+        result.push_back(running_count > 0 ? running_sum / running_count : std::numeric_limits<double>::quiet_NaN());
     }
 
     return result;
@@ -2535,17 +2660,16 @@ std::vector<double> vegaDataframe::expanding_mean(const std::string& col_name) c
 std::vector<double> vegaDataframe::cumsum(const std::string& col_name) const {
     size_t col_idx = find_column_index(col_name);
 
-    if (column_types[col_idx] == DataType::STRING)
+    if (!is_numeric_type(column_types[col_idx]))
         throw std::runtime_error("Cannot compute cumulative sum for string column");
 
+    const vegaColumn& column = data_columns[col_idx];
     std::vector<double> result;
     double cumulative = 0.0;
 
-    for (const auto& row : data_values) {
-        if (col_idx < row.size() && !row[col_idx].empty()) {
-            try {
-                cumulative += std::stod(row[col_idx]);
-            } catch (...) {}
+    for (size_t row = 0; row < column.size(); ++row) {
+        if (!column.is_null(row)) {
+            cumulative += column.numeric_at(row);
         }
         result.push_back(cumulative);
     }
@@ -2556,17 +2680,16 @@ std::vector<double> vegaDataframe::cumsum(const std::string& col_name) const {
 std::vector<double> vegaDataframe::cumprod(const std::string& col_name) const {
     size_t col_idx = find_column_index(col_name);
 
-    if (column_types[col_idx] == DataType::STRING)
+    if (!is_numeric_type(column_types[col_idx]))
         throw std::runtime_error("Cannot compute cumulative product for string column");
 
+    const vegaColumn& column = data_columns[col_idx];
     std::vector<double> result;
     double cumulative = 1.0;
 
-    for (const auto& row : data_values) {
-        if (col_idx < row.size() && !row[col_idx].empty()) {
-            try {
-                cumulative *= std::stod(row[col_idx]);
-            } catch (...) {}
+    for (size_t row = 0; row < column.size(); ++row) {
+        if (!column.is_null(row)) {
+            cumulative *= column.numeric_at(row);
         }
         result.push_back(cumulative);
     }
@@ -2577,24 +2700,13 @@ std::vector<double> vegaDataframe::cumprod(const std::string& col_name) const {
 std::vector<double> vegaDataframe::pct_change(const std::string& col_name, size_t periods) const {
     size_t col_idx = find_column_index(col_name);
 
-    if (column_types[col_idx] == DataType::STRING)
+    if (!is_numeric_type(column_types[col_idx]))
         throw std::runtime_error("Cannot compute percent change for string column");
 
     std::vector<double> result;
-    std::vector<double> values;
 
     // Extract values
-    for (const auto& row : data_values) {
-        if (col_idx < row.size() && !row[col_idx].empty()) {
-            try {
-                values.push_back(std::stod(row[col_idx]));
-            } catch (...) {
-                values.push_back(std::numeric_limits<double>::quiet_NaN());
-            }
-        } else {
-            values.push_back(std::numeric_limits<double>::quiet_NaN());
-        }
-    }
+    std::vector<double> values = column_as_doubles(data_columns[col_idx], std::numeric_limits<double>::quiet_NaN());
 
     // Calculate percent change
     for (size_t i = 0; i < values.size(); ++i) {
@@ -2617,396 +2729,276 @@ std::vector<double> vegaDataframe::pct_change(const std::string& col_name, size_
 
 // ============= DATETIME OPERATIONS =============
 
+// rows parsed per task by to_datetime
+static constexpr size_t DATETIME_PARSE_ROWS = 1 << 16;
+
+// parses every cell of a STRING or CATEGORY column with parse(text, ns)
+template <typename Parse>
+static vegaColumn parse_datetime_column(const vegaColumn& column, const Parse& parse) {
+    auto fail = [](std::string_view text) {
+        throw std::runtime_error("Cannot convert value '" + std::string(text) + "' to datetime");
+    };
+    vegaColumn result(DataType::DATETIME);
+    result.validity = column.validity;
+    result.int_data.assign(column.size(), 0);
+
+    // each category is parsed once
+    if (column.type == DataType::CATEGORY) {
+        std::vector<int64_t> category_ns(column.category_count(), 0);
+        std::vector<char> parsed(column.category_count(), 0);
+        for (size_t code = 0; code < category_ns.size(); ++code) {
+            parsed[code] = parse(column.category(static_cast<int64_t>(code)), category_ns[code]);
+        }
+        column.validity.for_each_set([&](size_t row) {
+            auto code = static_cast<size_t>(column.int_data[row]);
+            if (!parsed[code]) fail(column.category(column.int_data[row]));
+            result.int_data[row] = category_ns[code];
+        });
+        return result;
+    }
+
+    size_t tasks = (column.size() + DATETIME_PARSE_ROWS - 1) / DATETIME_PARSE_ROWS;
+    parallel_for(tasks, std::max<size_t>(1, std::thread::hardware_concurrency()), [&](size_t task) {
+        size_t end = std::min(column.size(), (task + 1) * DATETIME_PARSE_ROWS);
+        for (size_t row = task * DATETIME_PARSE_ROWS; row < end; ++row) {
+            if (!column.is_null(row) && !parse(column.string_at(row), result.int_data[row])) fail(column.string_at(row));
+        }
+    });
+    return result;
+}
+
 vegaDataframe vegaDataframe::to_datetime(const std::string& col_name, const std::string& format) const {
     vegaDataframe result = *this;
     size_t col_idx = find_column_index(col_name);
-
-    // Simple datetime conversion (basic implementation)
-    for (auto& row : result.data_values) {
-        if (col_idx < row.size() && !row[col_idx].empty()) {
-            // This is a simplified implementation
-            // In a full implementation, you'd use a proper datetime parsing library
-            std::string& date_str = row[col_idx];
-            // For now, just validate it looks like a date
-            if (date_str.find('-') != std::string::npos || date_str.find('/') != std::string::npos) {
-                // Keep as is - already looks like a date
-            }
-        }
+    const vegaColumn& column = data_columns[col_idx];
+
+    if (column.type == DataType::DATETIME) return result;
+    if (!column.is_text()) {
+        result.data_columns[col_idx] = column.cast(DataType::DATETIME);
+    } else if (format.empty()) {
+        result.data_columns[col_idx] = parse_datetime_column(column, [](std::string_view text, int64_t& ns) {
+            return parse_datetime(text, ns);
+        });
+    } else {
+        vegaDatetimeFormat parser(format);
+        result.data_columns[col_idx] = parse_datetime_column(column, [&parser](std::string_view text, int64_t& ns) {
+            return parser.parse(text, ns);
+        });
     }
-
-    result.column_types[col_idx] = DataType::STRING; // Would be DateTime in full implementation
+    result.column_types[col_idx] = DataType::DATETIME;
+    result.zone_map.clear();
     return result;
 }
 
-std::vector<int> vegaDataframe::dt_year(const std::string& col_name) const {
+std::vector<int> vegaDataframe::dt_field(const std::string& col_name, DatetimeField field) const {
     size_t col_idx = find_column_index(col_name);
-    std::vector<int> years;
-
-    for (const auto& row : data_values) {
-        if (col_idx < row.size() && !row[col_idx].empty()) {
-            std::string date_str = row[col_idx];
-            // Simple year extraction (assumes YYYY-MM-DD or YYYY/MM/DD format)
-            if (date_str.length() >= 4) {
-                try {
-                    int year = std::stoi(date_str.substr(0, 4));
-                    years.push_back(year);
-                } catch (...) {
-                    years.push_back(0);
-                }
-            } else {
-                years.push_back(0);
-            }
-        } else {
-            years.push_back(0);
+    const vegaColumn& column = data_columns[col_idx];
+    std::vector<int> values(column.size(), 0);
+
+    if (column.type == DataType::DATETIME) {
+        extract_datetime_field(column.int_data.data(), column.size(), field, values.data());
+    } else {
+        std::vector<int64_t> timestamps(column.size(), 0);
+        std::vector<char> parsed(column.size(), 0);
+        std::string buffer;
+        for (size_t row = 0; row < column.size(); ++row) {
+            parsed[row] = !column.is_null(row) && parse_datetime(cell_text(column, row, buffer), timestamps[row]);
         }
+        extract_datetime_field(timestamps.data(), timestamps.size(), field, values.data());
+        for (size_t row = 0; row < column.size(); ++row) {
+            if (!parsed[row]) values[row] = 0;
+        }
+        return values;
     }
 
-    return years;
+    for (size_t row = 0; row < column.size(); ++row) {
+        if (column.is_null(row)) values[row] = 0;
+    }
+    return values;
 }
 
-std::vector<int> vegaDataframe::dt_month(const std::string& col_name) const {
-    size_t col_idx = find_column_index(col_name);
-    std::vector<int> months;
-
-    for (const auto& row : data_values) {
-        if (col_idx < row.size() && !row[col_idx].empty()) {
-            std::string date_str = row[col_idx];
-            // Extract month (assumes YYYY-MM-DD or YYYY/MM/DD format)
-            size_t first_sep = date_str.find_first_of("-/");
-            if (first_sep != std::string::npos && first_sep + 3 <= date_str.length()) {
-                try {
-                    int month = std::stoi(date_str.substr(first_sep + 1, 2));
-                    months.push_back(month);
-                } catch (...) {
-                    months.push_back(0);
-                }
-            } else {
-                months.push_back(0);
-            }
-        } else {
-            months.push_back(0);
-        }
-    }
+std::vector<int> vegaDataframe::dt_year(const std::string& col_name) const {
+    return dt_field(col_name, DatetimeField::YEAR);
+}
 
-    return months;
+std::vector<int> vegaDataframe::dt_month(const std::string& col_name) const {
+    return dt_field(col_name, DatetimeField::MONTH);
 }
 
 std::vector<int> vegaDataframe::dt_day(const std::string& col_name) const {
-    size_t col_idx = find_column_index(col_name);
-    std::vector<int> days;
-
-    for (const auto& row : data_values) {
-        if (col_idx < row.size() && !row[col_idx].empty()) {
-            std::string date_str = row[col_idx];
-            // Extract day (assumes YYYY-MM-DD or YYYY/MM/DD format)
-            size_t first_sep = date_str.find_first_of("-/");
-            if (first_sep != std::string::npos) {
-                size_t second_sep = date_str.find_first_of("-/", first_sep + 1);
-                if (second_sep != std::string::npos && second_sep + 3 <= date_str.length()) {
-                    try {
-                        int day = std::stoi(date_str.substr(second_sep + 1, 2));
-                        days.push_back(day);
-                    } catch (...) {
-                        days.push_back(0);
-                    }
-                } else {
-                    days.push_back(0);
-                }
-            } else {
-                days.push_back(0);
-            }
-        } else {
-            days.push_back(0);
-        }
-    }
+    return dt_field(col_name, DatetimeField::DAY);
+}
 
-    return days;
+std::vector<int> vegaDataframe::dt_hour(const std::string& col_name) const {
+    return dt_field(col_name, DatetimeField::HOUR);
 }
 
 std::vector<int> vegaDataframe::dt_dayofweek(const std::string& col_name) const {
-    // Simplified implementation - would need proper date parsing in production
-    std::vector<int> dayofweek(data_values.size(), 0);
-
-    // This would require a proper datetime library to implement correctly
-    // For now, return placeholder values
-    for (size_t i = 0; i < data_values.size(); ++i) {
-        dayofweek[i] = i % 7; // Placeholder: cycle through 0-6
-    }
-
-    return dayofweek;
+    return dt_field(col_name, DatetimeField::WEEKDAY);
 }
 
 // ============= ARITHMETIC OPERATIONS =============
 
-vegaDataframe vegaDataframe::add(const vegaDataframe& other) const {
-    if (shape() != other.shape()) {
-        throw std::runtime_error("DataFrames must have same shape for arithmetic operations");
-    }
-
-    vegaDataframe result = *this;
-
-    for (size_t i = 0; i < data_values.size(); ++i) {
-        for (size_t j = 0; j < data_values[i].size(); ++j) {
-            if (j < other.data_values[i].size() &&
-                column_types[j] != DataType::STRING &&
-                other.column_types[j] != DataType::STRING) {
-                try {
-                    double val1 = safe_stod(data_values[i][j]);
-                    double val2 = safe_stod(other.data_values[i][j]);
-                    result.data_values[i][j] = std::to_string(val1 + val2);
-                } catch (...) {
-                    result.data_values[i][j] = "";
-                }
-            }
+// element-wise op over two numeric columns; INT stays INT when keep_int is set, nulls propagate
+template <typename Op>
+static vegaColumn combine_numeric(const vegaColumn& left, const vegaColumn& right, bool keep_int, Op op) {
+    bool int_result = keep_int && left.type == DataType::INT && right.type == DataType::INT;
+    vegaColumn result(int_result ? DataType::INT : DataType::FLOAT);
+    result.reserve(left.size());
+
+    for (size_t row = 0; row < left.size(); ++row) {
+        if (left.is_null(row) || right.is_null(row)) {
+            result.append_null();
+        } else if (int_result) {
+            result.append_int(op(left.int_data[row], right.int_data[row]));
+        } else {
+            result.append_float(op(left.numeric_at(row), right.numeric_at(row)));
         }
     }
-
     return result;
 }
 
-vegaDataframe vegaDataframe::subtract(const vegaDataframe& other) const {
-    if (shape() != other.shape()) {
+// applies op to every numeric column of a copy of the dataframe
+template <typename Op>
+static vegaDataframe combine_frames(const vegaDataframe& self, const vegaDataframe& other, bool keep_int, Op op) {
+    if (self.shape() != other.shape()) {
         throw std::runtime_error("DataFrames must have same shape for arithmetic operations");
     }
 
-    vegaDataframe result = *this;
+    vegaDataframe result = self;
 
-    for (size_t i = 0; i < data_values.size(); ++i) {
-        for (size_t j = 0; j < data_values[i].size(); ++j) {
-            if (j < other.data_values[i].size() &&
-                column_types[j] != DataType::STRING &&
-                other.column_types[j] != DataType::STRING) {
-                try {
-                    double val1 = safe_stod(data_values[i][j]);
-                    double val2 = safe_stod(other.data_values[i][j]);
-                    result.data_values[i][j] = std::to_string(val1 - val2);
-                } catch (...) {
-                    result.data_values[i][j] = "";
-                }
-            }
+    for (size_t j = 0; j < self.data_columns.size(); ++j) {
+        if (is_numeric_type(self.column_types[j]) && is_numeric_type(other.column_types[j])) {
+            result.data_columns[j] = combine_numeric(self.data_columns[j], other.data_columns[j], keep_int, op);
         }
     }
 
+    result.update_stats_after_modification();
     return result;
 }
 
-vegaDataframe vegaDataframe::multiply(const vegaDataframe& other) const {
-    if (shape() != other.shape()) {
-        throw std::runtime_error("DataFrames must have same shape for arithmetic operations");
-    }
-
-    vegaDataframe result = *this;
+vegaDataframe vegaDataframe::add(const vegaDataframe& other) const {
+    return combine_frames(*this, other, true, [](auto a, auto b) { return a + b; });
+}
 
-    for (size_t i = 0; i < data_values.size(); ++i) {
-        for (size_t j = 0; j < data_values[i].size(); ++j) {
-            if (j < other.data_values[i].size() &&
-                column_types[j] != DataType::STRING &&
-                other.column_types[j] != DataType::STRING) {
-                try {
-                    double val1 = safe_stod(data_values[i][j]);
-                    double val2 = safe_stod(other.data_values[i][j]);
-                    result.data_values[i][j] = std::to_string(val1 * val2);
-                } catch (...) {
-                    result.data_values[i][j] = "";
-                }
-            }
-        }
-    }
+vegaDataframe vegaDataframe::subtract(const vegaDataframe& other) const {
+    return combine_frames(*this, other, true, [](auto a, auto b) { return a - b; });
+}
 
-    return result;
+vegaDataframe vegaDataframe::multiply(const vegaDataframe& other) const {
+    return combine_frames(*this, other, true, [](auto a, auto b) { return a * b; });
 }
 
 vegaDataframe vegaDataframe::divide(const vegaDataframe& other) const {
-    if (shape() != other.shape()) {
-        throw std::runtime_error("DataFrames must have same shape for arithmetic operations");
-    }
+    return combine_frames(*this, other, false, [](auto a, auto b) {
+        return b != 0.0 ? a / b : std::numeric_limits<double>::infinity();
+    });
+}
 
-    vegaDataframe result = *this;
+// applies op(cell, value) to every numeric column; INT columns stay INT when value is integral
+template <typename Op>
+static vegaDataframe combine_scalar(const vegaDataframe& self, double value, Op op) {
+    vegaDataframe result = self;
+    bool integral = std::trunc(value) == value && std::abs(value) < 9.0e15;
 
-    for (size_t i = 0; i < data_values.size(); ++i) {
-        for (size_t j = 0; j < data_values[i].size(); ++j) {
-            if (j < other.data_values[i].size() &&
-                column_types[j] != DataType::STRING &&
-                other.column_types[j] != DataType::STRING) {
-                try {
-                    double val1 = safe_stod(data_values[i][j]);
-                    double val2 = safe_stod(other.data_values[i][j]);
-                    if (val2 != 0.0) {
-                        result.data_values[i][j] = std::to_string(val1 / val2);
-                    } else {
-                        result.data_values[i][j] = "inf";
-                    }
-                } catch (...) {
-                    result.data_values[i][j] = "";
-                }
+    for (size_t j = 0; j < self.data_columns.size(); ++j) {
+        const vegaColumn& column = self.data_columns[j];
+        if (!column.is_numeric()) continue;
+
+        vegaColumn combined(integral ? column.type : DataType::FLOAT);
+        combined.reserve(column.size());
+        for (size_t row = 0; row < column.size(); ++row) {
+            if (column.is_null(row)) {
+                combined.append_null();
+            } else if (combined.type == DataType::INT) {
+                combined.append_int(op(column.int_data[row], static_cast<int64_t>(value)));
+            } else {
+                combined.append_float(op(column.numeric_at(row), value));
             }
         }
+        result.data_columns[j] = std::move(combined);
     }
 
+    result.update_stats_after_modification();
     return result;
 }
 
 vegaDataframe vegaDataframe::add_scalar(double value) const {
-    vegaDataframe result = *this;
-
-    for (size_t i = 0; i < data_values.size(); ++i) {
-        for (size_t j = 0; j < data_values[i].size(); ++j) {
-            if (column_types[j] != DataType::STRING) {
-                try {
-                    double val = safe_stod(data_values[i][j]);
-                    result.data_values[i][j] = std::to_string(val + value);
-                } catch (...) {
-                    result.data_values[i][j] = data_values[i][j];
-                }
-            }
-        }
-    }
-
-    return result;
+    return combine_scalar(*this, value, [](auto a, auto b) { return a + b; });
 }
 
 vegaDataframe vegaDataframe::multiply_scalar(double value) const {
-    vegaDataframe result = *this;
-
-    for (size_t i = 0; i < data_values.size(); ++i) {
-        for (size_t j = 0; j < data_values[i].size(); ++j) {
-            if (column_types[j] != DataType::STRING) {
-                try {
-                    double val = safe_stod(data_values[i][j]);
-                    result.data_values[i][j] = std::to_string(val * value);
-                } catch (...) {
-                    result.data_values[i][j] = data_values[i][j];
-                }
-            }
-        }
-    }
-
-    return result;
+    return combine_scalar(*this, value, [](auto a, auto b) { return a * b; });
 }
 
 // ============= COMPARISON OPERATIONS =============
 
-std::vector<std::vector<bool>> vegaDataframe::eq(const vegaDataframe& other) const {
-    if (shape() != other.shape()) {
+// one mask per column of "left op right"
+static std::vector<vegaBitmap> compare_frames(const vegaDataframe& left, CompareOp op, const vegaDataframe& right) {
+    if (left.shape() != right.shape()) {
         throw std::runtime_error("DataFrames must have same shape for comparison");
     }
 
-    std::vector<std::vector<bool>> result(data_values.size());
-
-    for (size_t i = 0; i < data_values.size(); ++i) {
-        result[i].resize(data_values[i].size());
-        for (size_t j = 0; j < data_values[i].size(); ++j) {
-            if (j < other.data_values[i].size()) {
-                result[i][j] = (data_values[i][j] == other.data_values[i][j]);
-            } else {
-                result[i][j] = false;
-            }
-        }
+    std::vector<vegaBitmap> masks;
+    masks.reserve(left.data_columns.size());
+    for (size_t j = 0; j < left.data_columns.size(); ++j) {
+        masks.push_back(compare_columns(left.data_columns[j], op, right.data_columns[j]));
     }
-
-    return result;
+    return masks;
 }
 
-std::vector<std::vector<bool>> vegaDataframe::ne(const vegaDataframe& other) const {
-    auto eq_result = eq(other);
-
-    for (auto& row : eq_result) {
-        for (auto val : row) {
-            val = !val;
-        }
-    }
-
-    return eq_result;
+std::vector<vegaBitmap> vegaDataframe::eq(const vegaDataframe& other) const {
+    return compare_frames(*this, CompareOp::EQ, other);
 }
 
-std::vector<std::vector<bool>> vegaDataframe::lt(const vegaDataframe& other) const {
-    if (shape() != other.shape()) {
-        throw std::runtime_error("DataFrames must have same shape for comparison");
-    }
-
-    std::vector<std::vector<bool>> result(data_values.size());
-
-    for (size_t i = 0; i < data_values.size(); ++i) {
-        result[i].resize(data_values[i].size());
-        for (size_t j = 0; j < data_values[i].size(); ++j) {
-            if (j < other.data_values[i].size() &&
-                column_types[j] != DataType::STRING &&
-                other.column_types[j] != DataType::STRING) {
-                try {
-                    double val1 = safe_stod(data_values[i][j]);
-                    double val2 = safe_stod(other.data_values[i][j]);
-                    result[i][j] = (val1 < val2);
-                } catch (...) {
-                    result[i][j] = false;
-                }
-            } else {
-                result[i][j] = (data_values[i][j] < other.data_values[i][j]);
-            }
-        }
-    }
-
-    return result;
+std::vector<vegaBitmap> vegaDataframe::ne(const vegaDataframe& other) const {
+    // the complement of eq, so that pairs involving a null are unequal
+    std::vector<vegaBitmap> masks = eq(other);
+    for (auto& mask : masks) mask.flip();
+    return masks;
 }
 
-std::vector<std::vector<bool>> vegaDataframe::le(const vegaDataframe& other) const {
-    auto lt_result = lt(other);
-    auto eq_result = eq(other);
-
-    for (size_t i = 0; i < lt_result.size(); ++i) {
-        for (size_t j = 0; j < lt_result[i].size(); ++j) {
-            lt_result[i][j] = lt_result[i][j] || eq_result[i][j];
-        }
-    }
-
-    return lt_result;
+std::vector<vegaBitmap> vegaDataframe::lt(const vegaDataframe& other) const {
+    return compare_frames(*this, CompareOp::LT, other);
 }
 
-std::vector<std::vector<bool>> vegaDataframe::gt(const vegaDataframe& other) const {
-    auto le_result = le(other);
-
-    for (auto& row : le_result) {
-        for (auto val : row) {
-            val = !val;
-        }
-    }
+std::vector<vegaBitmap> vegaDataframe::le(const vegaDataframe& other) const {
+    return compare_frames(*this, CompareOp::LE, other);
+}
 
-    return le_result;
+std::vector<vegaBitmap> vegaDataframe::gt(const vegaDataframe& other) const {
+    return compare_frames(*this, CompareOp::GT, other);
 }
 
-std::vector<std::vector<bool>> vegaDataframe::ge(const vegaDataframe& other) const {
-    auto lt_result = lt(other);
+std::vector<vegaBitmap> vegaDataframe::ge(const vegaDataframe& other) const {
+    return compare_frames(*this, CompareOp::GE, other);
+}
 
-    for (auto& row : lt_result) {
-        for (auto val : row) {
-            val = !val;
-        }
-    }
+vegaBitmap vegaDataframe::compare(const std::string& col_name, const std::string& op, const std::string& value) const {
+    return compare_scalar(data_columns[find_column_index(col_name)], parse_compare_op(op), value);
+}
 
-    return lt_result;
+vegaBitmap vegaDataframe::compare_columns(const std::string& left_col, const std::string& op,
+                                          const std::string& right_col) const {
+    return ::compare_columns(data_columns[find_column_index(left_col)], parse_compare_op(op),
+                             data_columns[find_column_index(right_col)]);
 }
 
 // ============= ADDITIONAL UTILITY OPERATIONS =============
 
 vegaDataframe vegaDataframe::where(const std::function<bool(const std::vector<std::string>&)>& condition, const std::string& other) const {
-    vegaDataframe result = *this;
-
-    for (size_t i = 0; i < data_values.size(); ++i) {
-        if (!condition(data_values[i])) {
-            // Replace entire row with 'other' value
-            for (auto& cell : result.data_values[i]) {
-                cell = other;
-            }
-        }
-    }
+    return view().where(condition, other);
+}
 
-    return result;
+vegaDataframe vegaDataframe::where(const vegaBitmap& mask, const std::string& other) const {
+    return view().where(mask, other);
 }
 
 vegaDataframe vegaDataframe::astype(const std::string& col_name, DataType dtype) {
     size_t col_idx = find_column_index(col_name);
+    data_columns[col_idx] = data_columns[col_idx].cast(dtype);
     column_types[col_idx] = dtype;
 
-    // Could add conversion logic here if needed
     return *this;
 }
 
@@ -3016,7 +3008,7 @@ vegaDataframe vegaDataframe::reset_index(bool drop) const {
     if (!drop) {
         // Add index column
         std::vector<std::string> index_col;
-        for (size_t i = 0; i < data_values.size(); ++i) {
+        for (size_t i = 0; i < num_rows(); ++i) {
             index_col.push_back(std::to_string(i));
         }
         result.insert_column(0, "index", index_col);
@@ -3049,9 +3041,9 @@ void vegaDataframe::to_excel(const std::string& filename) const {
 
 vegaDataframe vegaDataframe::pivot_table(const std::string& values, const std::string& index, const std::string& columns) const {
     // Simplified pivot table implementation
-    size_t values_idx = find_column_index(values);
-    size_t index_idx = find_column_index(index);
-    size_t columns_idx = find_column_index(columns);
+    const vegaColumn& values_col = data_columns[find_column_index(values)];
+    const vegaColumn& index_col = data_columns[find_column_index(index)];
+    const vegaColumn& columns_col = data_columns[find_column_index(columns)];
 
     vegaDataframe result;
 
@@ -3067,6 +3059,24 @@ vegaDataframe vegaDataframe::pivot_table(const std::string& values, const std::s
 
     result.column_types.assign(result.data_features.size(), DataType::FLOAT);
     result.column_types[0] = DataType::STRING; // Index column
+    result.init_columns();
+
+    // Aggregate every row into its (index, column) cell in one pass
+    std::map<std::pair<std::string, std::string>, std::pair<double, size_t>> cells;
+    for (size_t row = 0; row < values_col.size(); ++row) {
+        if (values_col.is_null(row) || index_col.is_null(row) || columns_col.is_null(row)) continue;
+
+        double value;
+        if (values_col.is_numeric()) {
+            value = values_col.numeric_at(row);
+        } else if (!values_col.is_text() || !parse_double(values_col.string_at(row), value)) {
+            continue;
+        }
+
+        auto& cell = cells[{index_col.to_string(row), columns_col.to_string(row)}];
+        cell.first += value;
+        cell.second++;
+    }
 
     // Create pivot data
     for (const auto& idx_val : index_unique) {
@@ -3074,28 +3084,15 @@ vegaDataframe vegaDataframe::pivot_table(const std::string& values, const std::s
         result_row.push_back(idx_val);
 
         for (const auto& col_val : columns_unique) {
-            double sum = 0.0;
-            size_t count = 0;
-
-            // Find matching rows and aggregate
-            for (const auto& row : data_values) {
-                if (index_idx < row.size() && columns_idx < row.size() && values_idx < row.size() &&
-                    row[index_idx] == idx_val && row[columns_idx] == col_val) {
-                    try {
-                        sum += std::stod(row[values_idx]);
-                        count++;
-                    } catch (...) {}
-                }
-            }
-
-            if (count > 0) {
-                result_row.push_back(std::to_string(sum / count)); // Mean aggregation
+            auto it = cells.find({idx_val, col_val});
+            if (it != cells.end()) {
+                result_row.push_back(std::to_string(it->second.first / it->second.second)); // Mean aggregation
             } else {
                 result_row.push_back("");
             }
         }
 
-        result.data_values.push_back(result_row);
+        result.append_row(result_row);
     }
 
     result.update_stats_after_modification();
@@ -3110,14 +3107,17 @@ vegaDataframe vegaDataframe::melt(const std::vector<std::string>& id_vars, const
     vegaDataframe result;
 
     // Set up result columns
+    std::vector<size_t> id_indices;
     for (const auto& id_var : id_vars) {
+        id_indices.push_back(find_column_index(id_var));
         result.data_features.push_back(id_var);
-        result.column_types.push_back(column_types[find_column_index(id_var)]);
+        result.column_types.push_back(column_types[id_indices.back()]);
     }
     result.data_features.push_back("variable");
     result.data_features.push_back("value");
     result.column_types.push_back(DataType::STRING);
     result.column_types.push_back(DataType::STRING);
+    result.init_columns();
 
     // Determine which columns to melt
     std::vector<std::string> cols_to_melt = value_vars;
@@ -3130,31 +3130,24 @@ vegaDataframe vegaDataframe::melt(const std::vector<std::string>& id_vars, const
         }
     }
 
-    // Create melted data
-    for (const auto& row : data_values) {
-        for (const auto& col_to_melt : cols_to_melt) {
-            std::vector<std::string> result_row;
+    std::vector<size_t> melt_indices;
+    for (const auto& col_to_melt : cols_to_melt) {
+        melt_indices.push_back(find_column_index(col_to_melt));
+    }
 
+    // Create melted data
+    vegaColumn& variable_col = result.data_columns[id_indices.size()];
+    vegaColumn& value_col = result.data_columns[id_indices.size() + 1];
+    for (size_t row = 0; row < num_rows(); ++row) {
+        for (size_t m = 0; m < melt_indices.size(); ++m) {
             // Add id_var values
-            for (const auto& id_var : id_vars) {
-                size_t id_idx = find_column_index(id_var);
-                if (id_idx < row.size()) {
-                    result_row.push_back(row[id_idx]);
-                } else {
-                    result_row.push_back("");
-                }
+            for (size_t k = 0; k < id_indices.size(); ++k) {
+                result.data_columns[k].append_from(data_columns[id_indices[k]], row);
             }
 
             // Add variable name and value
-            result_row.push_back(col_to_melt);
-            size_t val_idx = find_column_index(col_to_melt);
-            if (val_idx < row.size()) {
-                result_row.push_back(row[val_idx]);
-            } else {
-                result_row.push_back("");
-            }
-
-            result.data_values.push_back(result_row);
+            variable_col.append_string(cols_to_melt[m]);
+            value_col.append_string(data_columns[melt_indices[m]].to_string(row));
         }
     }
 
@@ -3167,20 +3160,13 @@ vegaDataframe vegaDataframe::stack() const {
     vegaDataframe result;
     result.data_features = {"level_0", "level_1", "value"};
     result.column_types = {DataType::INT, DataType::STRING, DataType::STRING};
+    result.init_columns();
 
-    for (size_t row_idx = 0; row_idx < data_values.size(); ++row_idx) {
+    for (size_t row_idx = 0; row_idx < num_rows(); ++row_idx) {
         for (size_t col_idx = 0; col_idx < data_features.size(); ++col_idx) {
-            std::vector<std::string> stacked_row;
-            stacked_row.push_back(std::to_string(row_idx));
-            stacked_row.push_back(data_features[col_idx]);
-
-            if (col_idx < data_values[row_idx].size()) {
-                stacked_row.push_back(data_values[row_idx][col_idx]);
-            } else {
-                stacked_row.push_back("");
-            }
-
-            result.data_values.push_back(stacked_row);
+            result.data_columns[0].append_int(static_cast<int64_t>(row_idx));
+            result.data_columns[1].append_string(data_features[col_idx]);
+            result.data_columns[2].append_string(data_columns[col_idx].to_string(row_idx));
         }
     }
 
@@ -3195,20 +3181,11 @@ vegaDataframe vegaDataframe::unstack() const {
 }
 
 vegaDataframe vegaDataframe::reindex(const std::vector<size_t>& new_index) const {
-    vegaDataframe result;
-    result.data_features = data_features;
-    result.column_types = column_types;
-
+    // Out-of-bounds indices become empty rows
+    std::vector<size_t> rows;
     for (size_t idx : new_index) {
-        if (idx < data_values.size()) {
-            result.data_values.push_back(data_values[idx]);
-        } else {
-            // Add empty row for out-of-bounds indices
-            std::vector<std::string> empty_row(data_features.size(), "");
-            result.data_values.push_back(empty_row);
-        }
+        rows.push_back(idx < num_rows() ? idx : vegaColumn::npos);
     }
 
-    result.update_stats_after_modification();
-    return result;
-}
\ No newline at end of file
+    return take_rows(rows);
+}
@@ -17,16 +17,71 @@
 #include <limits>
 #include <regex>
 #include <functional>
+#include <mutex>
+#include "vegaColumn.h"
+#include "vegaDatetime.h"
+#include "vegaCsv.h"
+#include "vegaJson.h"
+#include "vegaEncoding.h"
+#include "vegaExpr.h"
+#include "vegaFormat.h"
+#include "vegaArrow.h"
 
 class FILE_ERROR : public std::runtime_error {
 public:
     explicit FILE_ERROR(const std::string & error_message);
 };
 
-enum class DataType { INT, FLOAT, STRING };
-
 // Forward declaration
 class vegaDataframe;
+class vegaLazyFrame;
+class vegaFrameView;
+
+// Statistics of the non-null cells of a numeric column, computed in one pass (see
+// vegaDataframe::column_summary)
+struct vegaColumnSummary {
+    // vegaColumnStore::version of the column they describe, 0 when not computed
+    uint64_t version = 0;
+    size_t count = 0;
+    double sum = 0;
+    // sum of squared deviations from the mean, accumulated with Welford's method
+    double m2 = 0;
+    double min = std::numeric_limits<double>::infinity();
+    double max = -std::numeric_limits<double>::infinity();
+    // 25%, 50% and 75% quantiles, set when has_quartiles
+    bool has_quartiles = false;
+    double quartiles[3] = {0, 0, 0};
+
+    [[nodiscard]] double mean() const { return sum / static_cast<double>(count); }
+    // sample variance
+    [[nodiscard]] double variance() const { return m2 / static_cast<double>(count - 1); }
+};
+
+// column_summary results by column position. Entries are added and removed with the columns
+// (reset when the frame is rebuilt) and are looked up and stored under a mutex, so several
+// threads may compute summaries of the same frame at once.
+class vegaSummaryCache {
+public:
+    vegaSummaryCache() = default;
+    vegaSummaryCache(const vegaSummaryCache& other);
+    vegaSummaryCache(vegaSummaryCache&& other) noexcept;
+    vegaSummaryCache& operator=(const vegaSummaryCache& other);
+    vegaSummaryCache& operator=(vegaSummaryCache&& other) noexcept;
+
+    // one empty entry per column
+    void reset(size_t columns);
+    void insert(size_t column);
+    void erase(size_t column);
+    // true with the entry of a column when it was computed at version (and with the quartiles
+    // when with_quartiles)
+    bool find(size_t column, uint64_t version, bool with_quartiles, vegaColumnSummary& summary) const;
+    // no effect for a column without an entry
+    void store(size_t column, const vegaColumnSummary& summary);
+
+private:
+    mutable std::mutex mutex;
+    std::vector<vegaColumnSummary> entries;
+};
 
 // Abstract base class for imputation strategies
 class Imputer {
@@ -38,16 +93,32 @@ public:
 class vegaDataframe {
 public:
     std::vector<std::string> data_features;
-    std::vector<std::vector<std::string>> data_values;
+    // one typed column per feature, see vegaColumn.h; columns may be held encoded (see
+    // encode_columns) and are then decoded on first access by code without an encoded kernel
+    vegaColumnStore data_columns;
     std::vector<size_t> non_null_counts;
     std::vector<DataType> column_types;
-    std::vector<std::vector<size_t>> null_positions;
+    // per-row-group statistics used to skip scans, see zone_maps()
+    mutable vegaZoneMap zone_map;
+    // per-column statistics, see column_summary()
+    mutable vegaSummaryCache column_summaries;
 
     // ============= CORE DATAFRAME OPERATIONS =============
-    //this function reads data from the csv file using input stream of the fle
-    void read_csv(const std::string & FILE_NAME);
-    //this function reads data from the json file using input stream of the file
-    void read_json(const std::string & FILE_NAME);
+    //this function reads data from the csv file; files of several megabytes are split at record
+    //boundaries and parsed on several threads; .gz/.bz2/.zst files are decompressed on a background
+    //thread and parsed as they stream in. options select columns, rows and fixed dtypes
+    void read_csv(const std::string & FILE_NAME, const vegaCsvOptions& options = {});
+    //this function reads an array of json objects or NDJSON (one object per line) into typed columns,
+    //see vegaJson.h; NDJSON files of several megabytes are split at line breaks and parsed on several
+    //threads; .gz/.bz2/.zst files (or an explicit compression) are decompressed on a background thread
+    void read_json(const std::string & FILE_NAME, Compression compression = Compression::AUTO);
+    void read_json(const std::string & FILE_NAME, const vegaJsonOptions& options);
+    //this function loads a .vega file written by to_vega; the file is mapped and only the columns in
+    //usecols (all when empty) are decoded, see vegaFileReader for inspecting a file without loading it
+    void read_vega(const std::string & FILE_NAME, const std::vector<std::string>& usecols = {});
+    //this function loads an Arrow IPC file or stream (e.g. written by pyarrow or to_arrow_ipc), see vegaArrow.h
+    //for the supported types; the file is mapped and every record batch is appended
+    void read_arrow_ipc(const std::string & FILE_NAME);
     //this function displays the information about the file which include
     //size and shape of the data, missing values, possible datatype of the object, null values, data features.
     void info() const;
@@ -59,10 +130,25 @@ public:
     // ============= SHAPE AND STRUCTURE =============
     [[nodiscard]] std::pair<size_t, size_t> shape() const;
     [[nodiscard]] std::vector<DataType> dtypes() const;
+    // per-column null / non-null counts, computed from the validity bitmaps
     [[nodiscard]] std::vector<size_t> isnull() const;
     [[nodiscard]] std::vector<size_t> notnull() const;
+    // per-row masks of one column, bit i is set when row i is null / non-null
+    [[nodiscard]] vegaBitmap isnull(const std::string& col_name) const;
+    [[nodiscard]] vegaBitmap notnull(const std::string& col_name) const;
     [[nodiscard]] size_t count_nulls() const;
     [[nodiscard]] size_t memory_usage() const;
+    // Re-encodes the columns with the dictionary, run-length or delta encoding picked from their
+    // statistics (see vegaEncoding.h) and returns the bytes saved. sum, value_counts and
+    // filter_rows/query work on encoded columns directly; other operations decode the columns
+    // they touch. read_vega keeps the encodings of the file.
+    size_t encode_columns(size_t num_threads = 0);
+    void decode_columns();
+    [[nodiscard]] std::vector<Encoding> encodings() const;
+    // Converts the STRING columns whose distinct values number at most max_unique_ratio of their
+    // non-null cells to CATEGORY and returns how many were converted. value_counts, groupby,
+    // label/one-hot encoding and filter_rows run on the category codes.
+    size_t infer_categories(double max_unique_ratio = 0.5);
 
     // ============= COLUMN OPERATIONS =============
     [[nodiscard]] std::vector<std::string> get_column(const std::string& col_name) const;
@@ -77,8 +163,20 @@ public:
 
     // ============= ROW OPERATIONS =============
     vegaDataframe filter_rows(const std::string& col_name, const std::string& value) const;
+    // rows whose cell satisfies "cell op value" (==, !=, <, <=, >, >=), skipping row groups whose
+    // zone map rules out a match; an empty value matches nulls with == and non-nulls with !=.
+    // The value is read as vegaCompareValue and numbers compare as in query (a NaN only matches !=)
+    vegaDataframe filter_rows(const std::string& col_name, const std::string& op, const std::string& value) const;
     vegaDataframe filter_rows(const std::function<bool(const std::vector<std::string>&)>& condition) const;
+    // rows whose bit is set in mask (one bit per row), e.g. from compare or query_mask
+    vegaDataframe filter_rows(const vegaBitmap& mask) const;
+    // rows satisfying an expression such as "age >= 30 and (city in ('Oslo', 'Rome') or score / 2 > 40)",
+    // see vegaExpr.h for the grammar; the expression is compiled once into column kernels
     vegaDataframe query(const std::string& expression) const;
+    [[nodiscard]] vegaBitmap query_mask(const std::string& expression) const;
+    // appends the rows of a frame with the same columns, widening column types where needed;
+    // the zone maps are extended rather than rebuilt
+    void append_rows(const vegaDataframe& other);
     void drop_row(size_t row_index);
     void drop_rows(const std::vector<size_t>& row_indices);
     vegaDataframe sample(size_t n, bool replace = false) const;
@@ -125,6 +223,14 @@ public:
     std::map<std::string, vegaDataframe> groupby(const std::string& col_name) const;
     std::map<std::vector<std::string>, vegaDataframe> groupby(const std::vector<std::string>& col_names) const;
     vegaDataframe aggregate(const std::map<std::string, std::string>& agg_funcs) const;
+    // Buckets rows by time_col rounded down to a multiple of rule (see parse_duration, e.g. "1min",
+    // "1h", "1d") and aggregates each bucket with agg_funcs (column -> mean, sum, min, max, count,
+    // std, first or last). The result holds the bucket start in time_col followed by one column
+    // per aggregation named like aggregate's. Empty buckets and rows with a null time are left
+    // out; a time_col that is not DATETIME is parsed as ISO-8601 first. Sorted times are
+    // bucketed in a single pass, unsorted ones fall back to a hash table of buckets.
+    vegaDataframe resample(const std::string& time_col, const std::string& rule,
+                           const std::map<std::string, std::string>& agg_funcs) const;
     vegaDataframe pivot_table(const std::string& values, const std::string& index, const std::string& columns) const;
     vegaDataframe pivot(const std::string& index, const std::string& columns, const std::string& values) const;
     vegaDataframe melt(const std::vector<std::string>& id_vars = {}, const std::vector<std::string>& value_vars = {}) const;
@@ -173,18 +279,33 @@ public:
     vegaDataframe multiply_scalar(double value) const;
 
     // ============= COMPARISON OPERATIONS =============
-    std::vector<std::vector<bool>> eq(const vegaDataframe& other) const;
-    std::vector<std::vector<bool>> ne(const vegaDataframe& other) const;
-    std::vector<std::vector<bool>> lt(const vegaDataframe& other) const;
-    std::vector<std::vector<bool>> le(const vegaDataframe& other) const;
-    std::vector<std::vector<bool>> gt(const vegaDataframe& other) const;
-    std::vector<std::vector<bool>> ge(const vegaDataframe& other) const;
+    // One mask per column, bit i set when row i of this frame compares true against row i of
+    // other (see compare_columns in vegaCompare.h); a pair involving a null is only unequal.
+    // The masks combine with & | ~, count() their rows and feed filter_rows and where.
+    [[nodiscard]] std::vector<vegaBitmap> eq(const vegaDataframe& other) const;
+    [[nodiscard]] std::vector<vegaBitmap> ne(const vegaDataframe& other) const;
+    [[nodiscard]] std::vector<vegaBitmap> lt(const vegaDataframe& other) const;
+    [[nodiscard]] std::vector<vegaBitmap> le(const vegaDataframe& other) const;
+    [[nodiscard]] std::vector<vegaBitmap> gt(const vegaDataframe& other) const;
+    [[nodiscard]] std::vector<vegaBitmap> ge(const vegaDataframe& other) const;
+    // rows where "cell op value" (==, !=, <, <=, >, >=) holds, matched like filter_rows
+    [[nodiscard]] vegaBitmap compare(const std::string& col_name, const std::string& op, const std::string& value) const;
+    // rows where "left_col op right_col" holds; nulls never match
+    [[nodiscard]] vegaBitmap compare_columns(const std::string& left_col, const std::string& op,
+                                             const std::string& right_col) const;
 
     // ============= DATETIME OPERATIONS =============
-    vegaDataframe to_datetime(const std::string& col_name, const std::string& format = "%Y-%m-%d") const;
+    // Converts a column to DATETIME. An empty format parses ISO-8601, any other one is a
+    // strptime-style format (see vegaDatetimeFormat); numbers are taken as nanoseconds since
+    // the epoch. A cell that does not parse throws.
+    vegaDataframe to_datetime(const std::string& col_name, const std::string& format = "") const;
+    // One field per row, 0 for nulls. DATETIME columns are read directly, other columns are
+    // parsed as ISO-8601 with 0 for cells that do not parse. dt_dayofweek counts Monday as 0.
+    std::vector<int> dt_field(const std::string& col_name, DatetimeField field) const;
     std::vector<int> dt_year(const std::string& col_name) const;
     std::vector<int> dt_month(const std::string& col_name) const;
     std::vector<int> dt_day(const std::string& col_name) const;
+    std::vector<int> dt_hour(const std::string& col_name) const;
     std::vector<int> dt_dayofweek(const std::string& col_name) const;
 
     // ============= WINDOW FUNCTIONS =============
@@ -197,22 +318,67 @@ public:
     std::vector<double> pct_change(const std::string& col_name, size_t periods = 1) const;
 
     // ============= EXPORT OPERATIONS =============
-    void to_csv(const std::string& filename, bool index = false, char sep = ',') const;
-    void to_json(const std::string& filename) const;
+    // output is compressed when the file name ends in .gz/.bz2/.zst or a compression is given
+    void to_csv(const std::string& filename, bool index = false, char sep = ',',
+                Compression compression = Compression::AUTO) const;
+    // buffered parallel writer, see vegaCsvWriteOptions (e.g. append for incremental exports)
+    void to_csv(const std::string& filename, const vegaCsvWriteOptions& options) const;
+    void to_json(const std::string& filename, Compression compression = Compression::AUTO) const;
+    // compact writer, as an array of objects or NDJSON (options.lines), see vegaJsonWriteOptions
+    void to_json(const std::string& filename, const vegaJsonWriteOptions& options) const;
+    // binary columnar copy of the frame (typed columns, null bitmaps, statistics), see vegaFormat.h
+    void to_vega(const std::string& filename) const;
+    // Arrow IPC file (.arrow / .feather v2) or stream, written straight from the column buffers
+    void to_arrow_ipc(const std::string& filename, ArrowIpcFormat format = ArrowIpcFormat::FILE) const;
     void to_html(const std::string& filename) const;
     void to_excel(const std::string& filename) const;
 
     // ============= UTILITY OPERATIONS =============
+    // records operations on this frame as a plan that is optimized and run by collect(), see
+    // vegaLazy.h; the frame must outlive the lazy frame
+    vegaLazyFrame lazy() const;
+    // all rows as a view, see vegaView.h: its filters narrow a row mask over this frame's
+    // buffers and only materialize() copies cells; the frame must outlive the view
+    vegaFrameView view() const;
     vegaDataframe copy() const;
     bool empty() const;
     bool equals(const vegaDataframe& other) const;
     std::vector<std::string> unique(const std::string& col_name) const;
     vegaDataframe where(const std::function<bool(const std::vector<std::string>&)>& condition, const std::string& other = "") const;
+    // every cell of the rows whose bit is clear in mask replaced by other
+    vegaDataframe where(const vegaBitmap& mask, const std::string& other = "") const;
+    // converts a column in place (DataType::CATEGORY builds the dictionary and codes)
     vegaDataframe astype(const std::string& col_name, DataType dtype);
 
     // ============= HELPER METHODS =============
     size_t find_column_index(const std::string& col_name) const;
+    size_t num_rows() const;
+    std::vector<std::string> get_row(size_t row) const;
+    // creates empty data_columns matching column_types
+    void init_columns();
+    // parses one row of cells into data_columns; missing trailing cells become nulls
+    void append_row(const std::vector<std::string>& row);
+    // new dataframe with the same schema holding the given rows (npos rows become nulls)
+    vegaDataframe take_rows(const std::vector<size_t>& row_indices) const;
+    // must be called after data_columns are modified directly; drops the zone maps, which
+    // append_row and append_rows keep
     void update_stats_after_modification();
+    // Zone maps of data_columns, updated first for the columns modified (see
+    // vegaColumnStore::version) and the rows appended since they were built.
+    // Built when a file is loaded; otherwise on first use, which several threads reading the
+    // same frame may share.
+    const vegaZoneMap& zone_maps() const;
+    // Count, sum, mean/M2, min and max of a numeric column from one pass over its cells, and
+    // with with_quartiles the quartiles from one selection over the parsed values. Cached per
+    // column until its vegaColumnStore::version changes, so repeated describe() and statistics
+    // calls do not rescan. Safe to call from several threads; two first uses of a column may
+    // both compute it.
+    vegaColumnSummary column_summary(size_t col_idx, bool with_quartiles = false) const;
+    // rows of one column satisfying "cell op value", see filter_rows
+    std::vector<size_t> matching_rows(size_t col_idx, CompareOp op, const std::string& value) const;
+    // zone maps of a freshly read file: taken from its sidecar when that matches the file,
+    // otherwise built and, with save_sidecar, written next to the file
+    void load_zone_map(const std::string& source_file, bool save_sidecar);
     void print_memory_usage() const;
     void validate_dataframe() const;
 };
@@ -258,7 +424,7 @@ public:
 // ============= UTILITY FUNCTIONS =============
 bool is_csv_file_valid(const std::string & file_name);
 std::string data_type_to_string(DataType dt);
-DataType infer_data_type(const std::string& value);
+DataType infer_data_type(std::string_view value);
 std::vector<std::string> split_string(const std::string& str, char delimiter);
 std::string join_strings(const std::vector<std::string>& strings, const std::string& delimiter);
 double safe_stod(const std::string& str, double default_val = 0.0);
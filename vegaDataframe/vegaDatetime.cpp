@@ -0,0 +1,391 @@
+#include "vegaDatetime.h"
+#include <array>
+#include <stdexcept>
+
+// ============= FIELD HELPERS =============
+
+static bool is_leap_year(int64_t year) {
+    return year % 4 == 0 && (year % 100 != 0 || year % 400 == 0);
+}
+
+static unsigned days_in_month(int64_t year, unsigned month) {
+    static constexpr std::array<unsigned, 12> days = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    return month == 2 && is_leap_year(year) ? 29 : days[month - 1];
+}
+
+static bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+// exactly count digits at pos
+static bool fixed_digits(std::string_view text, size_t pos, size_t count, unsigned& value) {
+    if (pos + count > text.size()) return false;
+    value = 0;
+    for (size_t i = pos; i < pos + count; ++i) {
+        if (!is_digit(text[i])) return false;
+        value = value * 10 + static_cast<unsigned>(text[i] - '0');
+    }
+    return true;
+}
+
+// min_count to max_count digits at pos, advancing pos past them
+static bool read_digits(std::string_view text, size_t& pos, size_t min_count, size_t max_count, unsigned& value) {
+    size_t begin = pos;
+    value = 0;
+    while (pos < text.size() && pos - begin < max_count && is_digit(text[pos])) {
+        value = value * 10 + static_cast<unsigned>(text[pos++] - '0');
+    }
+    return pos - begin >= min_count;
+}
+
+// up to 9 fraction digits at pos, scaled to nanoseconds
+static bool read_fraction(std::string_view text, size_t& pos, int64_t& ns) {
+    unsigned digits;
+    size_t begin = pos;
+    if (!read_digits(text, pos, 1, 9, digits)) return false;
+    if (pos < text.size() && is_digit(text[pos])) return false;
+    ns = digits;
+    for (size_t scale = pos - begin; scale < 9; ++scale) ns *= 10;
+    return true;
+}
+
+// 'Z', +HH, +HHMM or +HH:MM at pos (nothing when pos is at the end or at no sign)
+static bool read_offset(std::string_view text, size_t& pos, int64_t& offset_ns) {
+    offset_ns = 0;
+    if (pos >= text.size()) return true;
+    if (text[pos] == 'Z') {
+        ++pos;
+        return true;
+    }
+    if (text[pos] != '+' && text[pos] != '-') return true;
+    int64_t sign = text[pos] == '-' ? -1 : 1;
+    unsigned hours, minutes = 0;
+    if (!fixed_digits(text, pos + 1, 2, hours)) return false;
+    pos += 3;
+    if (pos < text.size() && text[pos] == ':') {
+        if (!fixed_digits(text, pos + 1, 2, minutes)) return false;
+        pos += 3;
+    } else if (fixed_digits(text, pos, 2, minutes)) {
+        pos += 2;
+    }
+    if (hours > 23 || minutes > 59) return false;
+    offset_ns = sign * (static_cast<int64_t>(hours) * NS_PER_HOUR + static_cast<int64_t>(minutes) * NS_PER_MINUTE);
+    return true;
+}
+
+// validated fields -> nanoseconds since the epoch, false when out of range
+static bool make_timestamp(int64_t days, unsigned hour, unsigned minute, unsigned second, int64_t fraction_ns,
+                           int64_t offset_ns, int64_t& ns) {
+    if (hour > 23 || minute > 59 || second > 59) return false;
+    int64_t time_ns = static_cast<int64_t>(hour) * NS_PER_HOUR + static_cast<int64_t>(minute) * NS_PER_MINUTE +
+                      static_cast<int64_t>(second) * NS_PER_SECOND + fraction_ns - offset_ns;
+    // the earliest day only fits together with its time of day
+    if (days < 0) {
+        days += 1;
+        time_ns -= NS_PER_DAY;
+    }
+    int64_t day_ns;
+    return checked_mul(days, NS_PER_DAY, day_ns) && checked_add(day_ns, time_ns, ns);
+}
+
+static bool valid_date(int64_t year, unsigned month, unsigned day) {
+    return month >= 1 && month <= 12 && day >= 1 && day <= days_in_month(year, month);
+}
+
+// ============= PARSING AND FORMATTING =============
+
+bool parse_datetime(std::string_view text, int64_t& ns) {
+    unsigned year, month, day;
+    if (!fixed_digits(text, 0, 4, year) || !fixed_digits(text, 5, 2, month) || !fixed_digits(text, 8, 2, day)) {
+        return false;
+    }
+    char separator = text[4];
+    if ((separator != '-' && separator != '/') || text[7] != separator || !valid_date(year, month, day)) return false;
+
+    unsigned hour = 0, minute = 0, second = 0;
+    int64_t fraction_ns = 0, offset_ns = 0;
+    size_t pos = 10;
+    if (pos < text.size() && (text[pos] == 'T' || text[pos] == ' ')) {
+        if (!fixed_digits(text, pos + 1, 2, hour) || pos + 3 >= text.size() || text[pos + 3] != ':' ||
+            !fixed_digits(text, pos + 4, 2, minute)) {
+            return false;
+        }
+        pos += 6;
+        if (pos < text.size() && text[pos] == ':') {
+            if (!fixed_digits(text, pos + 1, 2, second)) return false;
+            pos += 3;
+            if (pos < text.size() && (text[pos] == '.' || text[pos] == ',')) {
+                if (!read_fraction(text, ++pos, fraction_ns)) return false;
+            }
+        }
+        if (!read_offset(text, pos, offset_ns)) return false;
+    }
+    if (pos != text.size()) return false;
+    return make_timestamp(days_from_civil(year, month, day), hour, minute, second, fraction_ns, offset_ns, ns);
+}
+
+static char* put_digits(char* out, uint64_t value, int count) {
+    for (int i = count - 1; i >= 0; --i) {
+        out[i] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    }
+    return out + count;
+}
+
+void format_datetime(int64_t ns, std::string& out) {
+    int64_t days = floor_days(ns);
+    auto time_ns = static_cast<uint64_t>(time_of_day(ns));
+    vegaCivilDate date = civil_from_days(days);
+
+    char buffer[40];
+    char* p = put_digits(buffer, static_cast<uint64_t>(date.year), 4);
+    *p++ = '-';
+    p = put_digits(p, date.month, 2);
+    *p++ = '-';
+    p = put_digits(p, date.day, 2);
+    if (time_ns != 0) {
+        *p++ = ' ';
+        p = put_digits(p, time_ns / NS_PER_HOUR, 2);
+        *p++ = ':';
+        p = put_digits(p, time_ns / NS_PER_MINUTE % 60, 2);
+        *p++ = ':';
+        p = put_digits(p, time_ns / NS_PER_SECOND % 60, 2);
+        uint64_t fraction = time_ns % NS_PER_SECOND;
+        if (fraction != 0) {
+            *p++ = '.';
+            int digits = 9;
+            while (fraction % 10 == 0) {
+                fraction /= 10;
+                --digits;
+            }
+            p = put_digits(p, fraction, digits);
+        }
+    }
+    out.append(buffer, p);
+}
+
+std::string format_datetime(int64_t ns) {
+    std::string out;
+    format_datetime(ns, out);
+    return out;
+}
+
+bool parse_duration(std::string_view text, int64_t& ns) {
+    size_t pos = 0;
+    int64_t count = 1;
+    if (pos < text.size() && text[pos] >= '0' && text[pos] <= '9') {
+        count = 0;
+        while (pos < text.size() && text[pos] >= '0' && text[pos] <= '9') {
+            if (!checked_mul(count, 10, count) || !checked_add(count, text[pos] - '0', count)) {
+                return false;
+            }
+            ++pos;
+        }
+    }
+    std::string_view unit = text.substr(pos);
+    int64_t unit_ns;
+    if (unit == "ns") unit_ns = 1;
+    else if (unit == "us") unit_ns = 1000;
+    else if (unit == "ms") unit_ns = 1000 * 1000;
+    else if (unit == "s" || unit == "S") unit_ns = NS_PER_SECOND;
+    else if (unit == "min" || unit == "T") unit_ns = NS_PER_MINUTE;
+    else if (unit == "h" || unit == "H") unit_ns = NS_PER_HOUR;
+    else if (unit == "d" || unit == "D") unit_ns = NS_PER_DAY;
+    else if (unit == "w" || unit == "W") unit_ns = 7 * NS_PER_DAY;
+    else return false;
+    return count > 0 && checked_mul(count, unit_ns, ns);
+}
+
+// ============= FORMATS =============
+
+static constexpr std::array<std::string_view, 12> MONTH_NAMES = {
+    "january", "february", "march", "april", "may", "june",
+    "july", "august", "september", "october", "november", "december"};
+static constexpr std::array<std::string_view, 7> WEEKDAY_NAMES = {
+    "monday", "tuesday", "wednesday", "thursday", "friday", "saturday", "sunday"};
+
+static bool iequals_prefix(std::string_view text, size_t pos, std::string_view word) {
+    if (pos + word.size() > text.size()) return false;
+    for (size_t i = 0; i < word.size(); ++i) {
+        char c = text[pos + i];
+        if (c >= 'A' && c <= 'Z') c = static_cast<char>(c - 'A' + 'a');
+        if (c != word[i]) return false;
+    }
+    return true;
+}
+
+// index of the full or three-letter name at pos, advancing pos past it; -1 when none matches
+template <size_t N>
+static int read_name(std::string_view text, size_t& pos, const std::array<std::string_view, N>& names) {
+    for (size_t i = 0; i < N; ++i) {
+        if (iequals_prefix(text, pos, names[i])) {
+            pos += names[i].size();
+            return static_cast<int>(i);
+        }
+        if (iequals_prefix(text, pos, names[i].substr(0, 3))) {
+            pos += 3;
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+vegaDatetimeFormat::vegaDatetimeFormat(std::string_view format) {
+    auto add_literal = [this](char c) {
+        if (tokens.empty() || tokens.back().directive != 0) tokens.emplace_back();
+        tokens.back().literal.push_back(c);
+    };
+    for (size_t i = 0; i < format.size(); ++i) {
+        char c = format[i];
+        if (c == ' ' || c == '\t') {
+            if (tokens.empty() || tokens.back().directive != ' ') tokens.push_back({' ', {}});
+            continue;
+        }
+        if (c != '%') {
+            add_literal(c);
+            continue;
+        }
+        if (++i == format.size()) throw std::runtime_error("Datetime format ends with '%'");
+        switch (char directive = format[i]) {
+            case '%': add_literal('%'); break;
+            case 'F':
+                tokens.push_back({'Y', {}});
+                add_literal('-');
+                tokens.push_back({'m', {}});
+                add_literal('-');
+                tokens.push_back({'d', {}});
+                break;
+            case 'T':
+                tokens.push_back({'H', {}});
+                add_literal(':');
+                tokens.push_back({'M', {}});
+                add_literal(':');
+                tokens.push_back({'S', {}});
+                break;
+            case 'Y': case 'm': case 'd': case 'H': case 'M': case 'S': case 'y': case 'j': case 'f':
+            case 'I': case 'p': case 'b': case 'h': case 'B': case 'a': case 'A': case 'z':
+                tokens.push_back({directive, {}});
+                break;
+            default:
+                throw std::runtime_error(std::string("Unsupported datetime format directive: %") + directive);
+        }
+    }
+}
+
+bool vegaDatetimeFormat::parse(std::string_view text, int64_t& ns) const {
+    int64_t year = 1970;
+    unsigned month = 1, day = 1, day_of_year = 0, hour = 0, minute = 0, second = 0, value = 0;
+    int64_t fraction_ns = 0, offset_ns = 0;
+    bool twelve_hour = false, pm = false;
+
+    size_t pos = 0;
+    for (const Token& token : tokens) {
+        switch (token.directive) {
+            case 0:
+                if (text.substr(pos, token.literal.size()) != token.literal) return false;
+                pos += token.literal.size();
+                break;
+            case ' ':
+                while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t')) ++pos;
+                break;
+            case 'Y':
+                if (!read_digits(text, pos, 4, 4, value)) return false;
+                year = value;
+                break;
+            case 'y':
+                if (!read_digits(text, pos, 2, 2, value)) return false;
+                year = value < 69 ? 2000 + value : 1900 + value;
+                break;
+            case 'm': if (!read_digits(text, pos, 1, 2, month)) return false; break;
+            case 'd': if (!read_digits(text, pos, 1, 2, day)) return false; break;
+            case 'j': if (!read_digits(text, pos, 1, 3, day_of_year) || day_of_year == 0) return false; break;
+            case 'H': if (!read_digits(text, pos, 1, 2, hour)) return false; break;
+            case 'I':
+                if (!read_digits(text, pos, 1, 2, hour) || hour == 0 || hour > 12) return false;
+                twelve_hour = true;
+                break;
+            case 'M': if (!read_digits(text, pos, 1, 2, minute)) return false; break;
+            case 'S': if (!read_digits(text, pos, 1, 2, second)) return false; break;
+            case 'f': if (!read_fraction(text, pos, fraction_ns)) return false; break;
+            case 'p':
+                if (iequals_prefix(text, pos, "am")) pm = false;
+                else if (iequals_prefix(text, pos, "pm")) pm = true;
+                else return false;
+                pos += 2;
+                break;
+            case 'b': case 'h': case 'B': {
+                int index = read_name(text, pos, MONTH_NAMES);
+                if (index < 0) return false;
+                month = static_cast<unsigned>(index) + 1;
+                break;
+            }
+            case 'a': case 'A':
+                if (read_name(text, pos, WEEKDAY_NAMES) < 0) return false;
+                break;
+            case 'z':
+                if (pos >= text.size() || !read_offset(text, pos, offset_ns)) return false;
+                break;
+        }
+    }
+    if (pos != text.size()) return false;
+
+    if (twelve_hour) hour = hour % 12 + (pm ? 12 : 0);
+    int64_t days;
+    if (day_of_year > 0) {
+        if (day_of_year > (is_leap_year(year) ? 366u : 365u)) return false;
+        days = days_from_civil(year, 1, 1) + day_of_year - 1;
+    } else {
+        if (!valid_date(year, month, day)) return false;
+        days = days_from_civil(year, month, day);
+    }
+    return make_timestamp(days, hour, minute, second, fraction_ns, offset_ns, ns);
+}
+
+// ============= FIELD EXTRACTION =============
+
+void extract_datetime_field(const int64_t* ns, size_t count, DatetimeField field, int* out) {
+    switch (field) {
+        case DatetimeField::HOUR:
+            for (size_t i = 0; i < count; ++i) out[i] = static_cast<int>(time_of_day(ns[i]) / NS_PER_HOUR);
+            return;
+        case DatetimeField::MINUTE:
+            for (size_t i = 0; i < count; ++i) {
+                out[i] = static_cast<int>(time_of_day(ns[i]) / NS_PER_MINUTE % 60);
+            }
+            return;
+        case DatetimeField::SECOND:
+            for (size_t i = 0; i < count; ++i) {
+                out[i] = static_cast<int>(time_of_day(ns[i]) / NS_PER_SECOND % 60);
+            }
+            return;
+        case DatetimeField::WEEKDAY:
+            // 1970-01-01 was a Thursday
+            for (size_t i = 0; i < count; ++i) {
+                int64_t weekday = (floor_days(ns[i]) + 3) % 7;
+                out[i] = static_cast<int>(weekday < 0 ? weekday + 7 : weekday);
+            }
+            return;
+        default:
+            break;
+    }
+
+    // calendar fields; timestamps are usually sorted, so a run within one day converts once
+    int64_t last_day = 0;
+    int last_value = 0;
+    bool has_last = false;
+    for (size_t i = 0; i < count; ++i) {
+        int64_t days = floor_days(ns[i]);
+        if (!has_last || days != last_day) {
+            vegaCivilDate date = civil_from_days(days);
+            switch (field) {
+                case DatetimeField::YEAR: last_value = static_cast<int>(date.year); break;
+                case DatetimeField::MONTH: last_value = static_cast<int>(date.month); break;
+                case DatetimeField::DAY: last_value = static_cast<int>(date.day); break;
+                default: last_value = static_cast<int>(days - days_from_civil(date.year, 1, 1) + 1); break;
+            }
+            last_day = days;
+            has_last = true;
+        }
+        out[i] = last_value;
+    }
+}
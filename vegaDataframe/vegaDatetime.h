@@ -0,0 +1,112 @@
+#ifndef VEGA_VEGADATETIME_H
+#define VEGA_VEGADATETIME_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// DATETIME cells are int64 nanoseconds since 1970-01-01T00:00:00 (no time zone; parsed UTC
+// offsets are applied), which covers the years 1677 to 2262. Dates are converted with the
+// days-from-civil / civil-from-days algorithms of the proleptic Gregorian calendar.
+
+constexpr int64_t NS_PER_SECOND = 1'000'000'000;
+constexpr int64_t NS_PER_MINUTE = 60 * NS_PER_SECOND;
+constexpr int64_t NS_PER_HOUR = 60 * NS_PER_MINUTE;
+constexpr int64_t NS_PER_DAY = 24 * NS_PER_HOUR;
+
+struct vegaCivilDate {
+    int64_t year;
+    unsigned month;
+    unsigned day;
+};
+
+// days since 1970-01-01 of a proleptic Gregorian date
+constexpr int64_t days_from_civil(int64_t year, unsigned month, unsigned day) {
+    year -= month <= 2;
+    int64_t era = (year >= 0 ? year : year - 399) / 400;
+    auto year_of_era = static_cast<unsigned>(year - era * 400);
+    unsigned day_of_year = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    unsigned day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+    return era * 146097 + static_cast<int64_t>(day_of_era) - 719468;
+}
+
+constexpr vegaCivilDate civil_from_days(int64_t days) {
+    days += 719468;
+    int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    auto day_of_era = static_cast<unsigned>(days - era * 146097);
+    unsigned year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+    unsigned day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+    unsigned mp = (5 * day_of_year + 2) / 153;
+    unsigned day = day_of_year - (153 * mp + 2) / 5 + 1;
+    unsigned month = mp < 10 ? mp + 3 : mp - 9;
+    return {static_cast<int64_t>(year_of_era) + era * 400 + (month <= 2), month, day};
+}
+
+// days since the epoch of a timestamp, rounded towards the past
+constexpr int64_t floor_days(int64_t ns) {
+    return ns / NS_PER_DAY - (ns % NS_PER_DAY < 0);
+}
+
+// nanoseconds since midnight of a timestamp
+constexpr int64_t time_of_day(int64_t ns) {
+    int64_t remainder = ns % NS_PER_DAY;
+    return remainder < 0 ? remainder + NS_PER_DAY : remainder;
+}
+
+// a * b and a + b into out, false (out untouched) when the result does not fit in int64
+constexpr bool checked_mul(int64_t a, int64_t b, int64_t& out) {
+    constexpr int64_t max = INT64_MAX, min = INT64_MIN;
+    if (a > 0 ? (b > 0 ? a > max / b : b < min / a) : (b > 0 ? a < min / b : a != 0 && b < max / a)) return false;
+    out = a * b;
+    return true;
+}
+
+constexpr bool checked_add(int64_t a, int64_t b, int64_t& out) {
+    if (b > 0 ? a > INT64_MAX - b : a < INT64_MIN - b) return false;
+    out = a + b;
+    return true;
+}
+
+// ============= PARSING AND FORMATTING =============
+// ISO-8601: YYYY-MM-DD (or YYYY/MM/DD), optionally followed by 'T' or ' ' and HH:MM,
+// HH:MM:SS or HH:MM:SS.fraction (up to 9 digits), and then 'Z' or an offset +HH, +HHMM
+// or +HH:MM. Out-of-range fields and timestamps outside the int64 range fail.
+bool parse_datetime(std::string_view text, int64_t& ns);
+// "YYYY-MM-DD" at midnight, otherwise "YYYY-MM-DD HH:MM:SS" with the shortest fraction
+void format_datetime(int64_t ns, std::string& out);
+std::string format_datetime(int64_t ns);
+// a fixed length such as "30s", "15min", "1h", "1d" or "2w": an optional positive count and
+// one of the units ns, us, ms, s, min (or T), h, d, w
+bool parse_duration(std::string_view text, int64_t& ns);
+
+// A strptime-style format compiled once and applied to many cells. Supported directives:
+// %Y %m %d %H %M %S, %y (69-99 -> 19xx, 00-68 -> 20xx), %j (day of year), %f (fraction
+// of a second, up to 9 digits), %I with %p (12-hour clock), %b %h %B (month names),
+// %a %A (weekday names, checked for form only), %z (Z, +HH, +HHMM or +HH:MM), %F (%Y-%m-%d),
+// %T (%H:%M:%S) and %%. Whitespace matches any run of whitespace, other characters
+// themselves. Missing date fields default to 1970-01-01, missing time fields to zero.
+class vegaDatetimeFormat {
+public:
+    explicit vegaDatetimeFormat(std::string_view format);
+
+    // true when the whole text matches the format and names a valid timestamp
+    bool parse(std::string_view text, int64_t& ns) const;
+
+private:
+    struct Token {
+        // directive letter, or 0 for a literal and ' ' for a whitespace run
+        char directive = 0;
+        std::string literal;
+    };
+    std::vector<Token> tokens;
+};
+
+// ============= FIELD EXTRACTION =============
+enum class DatetimeField { YEAR, MONTH, DAY, HOUR, MINUTE, SECOND, WEEKDAY, DAYOFYEAR };
+
+// field of count timestamps into out; WEEKDAY counts Monday as 0
+void extract_datetime_field(const int64_t* ns, size_t count, DatetimeField field, int* out);
+
+#endif // VEGA_VEGADATETIME_H
@@ -0,0 +1,936 @@
+#include "vegaEncoding.h"
+#include "vegaCompare.h"
+#include "vegaCsv.h"
+#include "vegaDatetime.h"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+
+std::string encoding_to_string(Encoding encoding) {
+    switch (encoding) {
+        case Encoding::PLAIN: return "plain";
+        case Encoding::DICTIONARY: return "dictionary";
+        case Encoding::RLE: return "rle";
+        case Encoding::DELTA: return "delta";
+    }
+    return "unknown";
+}
+
+// ============= BIT PACKING =============
+
+static size_t packed_words(size_t count, uint32_t width) {
+    return (count * width + 63) / 64;
+}
+
+static uint32_t width_of(uint64_t max_value) {
+    return static_cast<uint32_t>(std::bit_width(max_value));
+}
+
+// words must be zeroed where value goes
+static void pack_bits(uint64_t* words, size_t index, uint32_t width, uint64_t value) {
+    if (width == 0) return;
+    size_t bit = index * width;
+    size_t word = bit >> 6;
+    unsigned shift = bit & 63;
+    words[word] |= value << shift;
+    if (shift + width > 64) words[word + 1] |= value >> (64 - shift);
+}
+
+static uint64_t unpack_bits(const uint64_t* words, size_t index, uint32_t width) {
+    if (width == 0) return 0;
+    size_t bit = index * width;
+    size_t word = bit >> 6;
+    unsigned shift = bit & 63;
+    uint64_t value = words[word] >> shift;
+    if (shift + width > 64) value |= words[word + 1] << (64 - shift);
+    return width == 64 ? value : value & ((uint64_t{1} << width) - 1);
+}
+
+// ============= ROW HELPERS =============
+
+// number of set bits in [begin, end)
+static size_t count_valid(const vegaBitmap& bits, size_t begin, size_t end) {
+    size_t total = 0;
+    while (begin < end) {
+        size_t word = begin >> 6;
+        size_t stop = std::min(end, (word + 1) << 6);
+        uint64_t mask = ~uint64_t{0} << (begin & 63);
+        if ((stop & 63) != 0) mask &= (uint64_t{1} << (stop & 63)) - 1;
+        total += static_cast<size_t>(std::popcount(bits.word(word) & mask));
+        begin = stop;
+    }
+    return total;
+}
+
+// appends the set rows of [begin, end) to rows
+static void append_valid_rows(const vegaBitmap& bits, size_t begin, size_t end, std::vector<size_t>& rows) {
+    for (size_t row = begin; row < end; ++row) {
+        if (bits.get(row)) rows.push_back(row);
+    }
+}
+
+// whether the cells at a and b of a column hold the same slot value (nulls are zero or empty)
+static bool same_slot(const vegaColumn& column, size_t a, size_t b) {
+    switch (column.type) {
+        case DataType::INT:
+        case DataType::DATETIME: return column.int_data[a] == column.int_data[b];
+        case DataType::FLOAT: return std::memcmp(&column.float_data[a], &column.float_data[b], sizeof(double)) == 0;
+        default: return column.string_at(a) == column.string_at(b);
+    }
+}
+
+// ============= PREDICATES =============
+
+// "cell op value" with the parsing rules of vegaDataframe::matching_rows, see vegaCompareValue
+struct CellPredicate {
+    CompareOp op;
+    const std::string& text;
+    vegaCompareValue value;
+
+    CellPredicate(CompareOp op, const std::string& text, DataType dtype) : op(op), text(text), value(op, text, dtype) {}
+
+    [[nodiscard]] bool matches_int(int64_t cell) const { return value.matches_int(cell); }
+
+    // for a non-null cell
+    [[nodiscard]] bool matches(const vegaColumn& column, size_t row) const {
+        switch (column.type) {
+            case DataType::INT:
+            case DataType::DATETIME: return value.matches_int(column.int_data[row]);
+            case DataType::FLOAT: return value.matches_double(column.float_data[row]);
+            default: return compare_result(op, column.string_at(row).compare(text));
+        }
+    }
+
+    // 1 when every integer in [low, high] matches, -1 when none does, 0 otherwise
+    [[nodiscard]] int range_verdict(int64_t low, int64_t high) const {
+        if (value.has_int) return verdict(low, high, value.int_value);
+        // a NaN value, like no number, only differs from every cell
+        if (value.has_number && !std::isnan(value.number)) {
+            return verdict(static_cast<double>(low), static_cast<double>(high), value.number);
+        }
+        return op == CompareOp::NE ? 1 : -1;
+    }
+
+    template <typename T>
+    [[nodiscard]] int verdict(T low, T high, T bound) const {
+        switch (op) {
+            case CompareOp::EQ:
+                if (bound < low || bound > high) return -1;
+                return low == high ? 1 : 0;
+            case CompareOp::NE:
+                if (bound < low || bound > high) return 1;
+                return low == high ? -1 : 0;
+            case CompareOp::LT: return high < bound ? 1 : (low >= bound ? -1 : 0);
+            case CompareOp::LE: return high <= bound ? 1 : (low > bound ? -1 : 0);
+            case CompareOp::GT: return low > bound ? 1 : (high <= bound ? -1 : 0);
+            case CompareOp::GE: return low >= bound ? 1 : (high < bound ? -1 : 0);
+        }
+        return 0;
+    }
+};
+
+// ============= ENCODING =============
+
+// the slot values of an INT column in block order, null slots holding the previous value
+// (the first non-null value of the block for leading nulls)
+static void filled_block(const vegaColumn& column, size_t begin, size_t end, std::vector<int64_t>& out) {
+    out.assign(column.int_data.begin() + static_cast<std::ptrdiff_t>(begin),
+               column.int_data.begin() + static_cast<std::ptrdiff_t>(end));
+    size_t first_valid = begin;
+    while (first_valid < end && column.is_null(first_valid)) ++first_valid;
+    int64_t previous = first_valid < end ? column.int_data[first_valid] : 0;
+    for (size_t row = begin; row < end; ++row) {
+        if (column.is_null(row)) out[row - begin] = previous;
+        previous = out[row - begin];
+    }
+}
+
+// smallest difference and bit width of a filled block
+static std::pair<uint64_t, uint32_t> delta_frame(const std::vector<int64_t>& values) {
+    if (values.size() < 2) return {0, 0};
+    int64_t min_delta = std::numeric_limits<int64_t>::max();
+    for (size_t i = 1; i < values.size(); ++i) {
+        min_delta = std::min(min_delta, static_cast<int64_t>(static_cast<uint64_t>(values[i]) - static_cast<uint64_t>(values[i - 1])));
+    }
+    uint64_t spread = 0;
+    for (size_t i = 1; i < values.size(); ++i) {
+        uint64_t delta = static_cast<uint64_t>(values[i]) - static_cast<uint64_t>(values[i - 1]);
+        spread = std::max(spread, delta - static_cast<uint64_t>(min_delta));
+    }
+    return {static_cast<uint64_t>(min_delta), width_of(spread)};
+}
+
+Encoding vegaEncodedColumn::choose(const vegaColumn& column) {
+    size_t rows = column.size();
+    // a CATEGORY column already is dictionary encoded
+    if (rows == 0 || column.type == DataType::CATEGORY) return Encoding::PLAIN;
+    bool is_string = column.type == DataType::STRING;
+    size_t plain_bytes = is_string ? (rows + 1) * sizeof(uint64_t) + column.string_data.size() : rows * sizeof(int64_t);
+
+    // runs of equal slots
+    size_t rle_bytes = 0;
+    for (size_t row = 0; row < rows; ++row) {
+        if (row > 0 && same_slot(column, row - 1, row)) continue;
+        rle_bytes += 2 * sizeof(uint64_t) + (is_string ? column.string_at(row).size() : 0);
+    }
+
+    std::vector<std::pair<size_t, Encoding>> candidates{{plain_bytes, Encoding::PLAIN}};
+    // DATETIME only delta encodes
+    bool is_datetime = column.type == DataType::DATETIME;
+    if (!is_datetime) candidates.emplace_back(rle_bytes, Encoding::RLE);
+
+    // distinct values, given up on once the dictionary would be larger than half the rows
+    if (column.type != DataType::FLOAT && !is_datetime) {
+        size_t limit = rows / 2 + 1;
+        size_t dictionary_bytes = 0;
+        bool small = true;
+        if (is_string) {
+            std::unordered_map<std::string_view, bool> seen;
+            for (size_t row = 0; row < rows && small; ++row) {
+                if (column.is_null(row)) continue;
+                auto value = column.string_at(row);
+                if (seen.emplace(value, true).second) dictionary_bytes += sizeof(uint64_t) + value.size();
+                small = seen.size() <= limit;
+            }
+            if (small) dictionary_bytes += packed_words(rows, width_of(seen.size())) * sizeof(uint64_t);
+        } else {
+            std::unordered_map<int64_t, bool> seen;
+            for (size_t row = 0; row < rows && small; ++row) {
+                if (!column.is_null(row)) seen.emplace(column.int_data[row], true);
+                small = seen.size() <= limit;
+            }
+            if (small) {
+                dictionary_bytes = seen.size() * sizeof(int64_t) + packed_words(rows, width_of(seen.size())) * sizeof(uint64_t);
+            }
+        }
+        if (small) candidates.emplace_back(dictionary_bytes, Encoding::DICTIONARY);
+    }
+
+    if (column.type == DataType::INT || is_datetime) {
+        size_t delta_bytes = 0;
+        std::vector<int64_t> values;
+        for (size_t begin = 0; begin < rows; begin += BLOCK_ROWS) {
+            size_t end = std::min(rows, begin + BLOCK_ROWS);
+            filled_block(column, begin, end, values);
+            delta_bytes += sizeof(DeltaBlock) + packed_words(end - begin - 1, delta_frame(values).second) * sizeof(uint64_t);
+        }
+        candidates.emplace_back(delta_bytes, Encoding::DELTA);
+    }
+
+    auto best = *std::min_element(candidates.begin(), candidates.end());
+    // a small saving does not pay for the slower access
+    return best.first * 10 < plain_bytes * 9 ? best.second : Encoding::PLAIN;
+}
+
+vegaEncodedColumn vegaEncodedColumn::encode(const vegaColumn& column, Encoding encoding) {
+    vegaEncodedColumn result;
+    result.kind = encoding;
+    result.dtype = column.type;
+    result.valid = column.validity;
+    size_t rows = column.size();
+    if (column.type == DataType::CATEGORY && encoding != Encoding::PLAIN) {
+        throw std::runtime_error("CATEGORY columns are only stored plain");
+    }
+    if (column.type == DataType::DATETIME && encoding != Encoding::PLAIN && encoding != Encoding::DELTA) {
+        throw std::runtime_error("DATETIME columns are only stored plain or delta encoded");
+    }
+
+    switch (encoding) {
+        case Encoding::PLAIN:
+            result.values = column;
+            break;
+
+        case Encoding::DICTIONARY: {
+            if (column.type == DataType::FLOAT) throw std::runtime_error("Dictionary encoding needs an INT or STRING column");
+            std::vector<uint64_t> codes(rows, 0);
+            result.values = vegaColumn(column.type);
+            if (column.type == DataType::INT) {
+                std::vector<int64_t> distinct;
+                for (size_t row = 0; row < rows; ++row) {
+                    if (!column.is_null(row)) distinct.push_back(column.int_data[row]);
+                }
+                std::sort(distinct.begin(), distinct.end());
+                distinct.erase(std::unique(distinct.begin(), distinct.end()), distinct.end());
+                std::unordered_map<int64_t, uint64_t> code_of;
+                for (size_t i = 0; i < distinct.size(); ++i) {
+                    code_of.emplace(distinct[i], i);
+                    result.values.append_int(distinct[i]);
+                }
+                for (size_t row = 0; row < rows; ++row) {
+                    if (!column.is_null(row)) codes[row] = code_of[column.int_data[row]];
+                }
+            } else {
+                std::unordered_map<std::string_view, uint64_t> code_of;
+                for (size_t row = 0; row < rows; ++row) {
+                    if (!column.is_null(row)) code_of.emplace(column.string_at(row), 0);
+                }
+                std::vector<std::string_view> distinct;
+                distinct.reserve(code_of.size());
+                for (const auto& entry : code_of) distinct.push_back(entry.first);
+                std::sort(distinct.begin(), distinct.end());
+                for (size_t i = 0; i < distinct.size(); ++i) {
+                    code_of[distinct[i]] = i;
+                    result.values.append_string(distinct[i]);
+                }
+                for (size_t row = 0; row < rows; ++row) {
+                    if (!column.is_null(row)) codes[row] = code_of[column.string_at(row)];
+                }
+            }
+            size_t entries = result.values.size();
+            result.bit_width = entries <= 1 ? 0 : width_of(entries - 1);
+            result.packed.assign(packed_words(rows, result.bit_width), 0);
+            for (size_t row = 0; row < rows; ++row) pack_bits(result.packed.data(), row, result.bit_width, codes[row]);
+            break;
+        }
+
+        case Encoding::RLE: {
+            result.values = vegaColumn(column.type);
+            for (size_t row = 0; row < rows; ++row) {
+                if (row > 0 && same_slot(column, row - 1, row)) {
+                    result.run_ends.back() = row + 1;
+                    continue;
+                }
+                result.run_ends.push_back(row + 1);
+                // run values are the slot values, so a null cell only shares a run with zeros
+                if (column.type == DataType::INT) result.values.append_int(column.int_data[row]);
+                else if (column.type == DataType::FLOAT) result.values.append_float(column.float_data[row]);
+                else result.values.append_string(column.string_at(row));
+            }
+            break;
+        }
+
+        case Encoding::DELTA: {
+            if (column.type != DataType::INT && column.type != DataType::DATETIME) {
+                throw std::runtime_error("Delta encoding needs an INT or DATETIME column");
+            }
+            std::vector<int64_t> values;
+            for (size_t begin = 0; begin < rows; begin += BLOCK_ROWS) {
+                size_t end = std::min(rows, begin + BLOCK_ROWS);
+                filled_block(column, begin, end, values);
+                DeltaBlock block;
+                block.first = values.front();
+                std::tie(block.min_delta, block.bit_width) = delta_frame(values);
+                block.word_offset = result.packed.size();
+                for (size_t row = begin; row < end; ++row) {
+                    if (column.is_null(row)) continue;
+                    int64_t value = column.int_data[row];
+                    block.min = block.has_values ? std::min(block.min, value) : value;
+                    block.max = block.has_values ? std::max(block.max, value) : value;
+                    block.has_values = true;
+                }
+                result.packed.resize(result.packed.size() + packed_words(values.size() - 1, block.bit_width), 0);
+                uint64_t* words = result.packed.data() + block.word_offset;
+                for (size_t i = 1; i < values.size(); ++i) {
+                    uint64_t delta = static_cast<uint64_t>(values[i]) - static_cast<uint64_t>(values[i - 1]);
+                    pack_bits(words, i - 1, block.bit_width, delta - block.min_delta);
+                }
+                result.blocks.push_back(block);
+            }
+            break;
+        }
+    }
+    return result;
+}
+
+// ============= DECODING =============
+
+size_t vegaEncodedColumn::memory_usage() const {
+    return values.memory_usage() + valid.memory_usage() + packed.capacity() * sizeof(uint64_t) +
+           run_ends.capacity() * sizeof(uint64_t) + blocks.capacity() * sizeof(DeltaBlock);
+}
+
+void vegaEncodedColumn::decode_block(size_t block, int64_t* out) const {
+    const DeltaBlock& header = blocks[block];
+    size_t count = std::min(BLOCK_ROWS, size() - block * BLOCK_ROWS);
+    const uint64_t* words = packed.data() + header.word_offset;
+    auto value = static_cast<uint64_t>(header.first);
+    out[0] = header.first;
+    for (size_t i = 1; i < count; ++i) {
+        value += header.min_delta + unpack_bits(words, i - 1, header.bit_width);
+        out[i] = static_cast<int64_t>(value);
+    }
+}
+
+std::vector<size_t> vegaEncodedColumn::value_indices(const std::vector<size_t>& rows) const {
+    std::vector<size_t> indices(rows.size(), vegaColumn::npos);
+    size_t run = 0;
+    for (size_t i = 0; i < rows.size(); ++i) {
+        size_t row = rows[i];
+        if (row == vegaColumn::npos || !valid.get(row)) continue;
+        if (kind == Encoding::DICTIONARY) {
+            indices[i] = unpack_bits(packed.data(), row, bit_width);
+            continue;
+        }
+        // rows usually come in increasing order, so try the current run first
+        bool in_run = run < run_ends.size() && row < run_ends[run] && (run == 0 || row >= run_ends[run - 1]);
+        if (!in_run) {
+            run = static_cast<size_t>(std::upper_bound(run_ends.begin(), run_ends.end(), row) - run_ends.begin());
+        }
+        indices[i] = run;
+    }
+    return indices;
+}
+
+vegaColumn vegaEncodedColumn::take(const std::vector<size_t>& indices) const {
+    if (kind == Encoding::PLAIN) return values.take(indices);
+    if (kind != Encoding::DELTA) return values.take(value_indices(indices));
+
+    vegaColumn result(dtype);
+    result.reserve(indices.size());
+    std::vector<int64_t> block_values(BLOCK_ROWS);
+    size_t loaded = static_cast<size_t>(-1);
+    for (size_t row : indices) {
+        if (row == vegaColumn::npos || !valid.get(row)) {
+            result.append_null();
+            continue;
+        }
+        if (row / BLOCK_ROWS != loaded) {
+            loaded = row / BLOCK_ROWS;
+            decode_block(loaded, block_values.data());
+        }
+        result.int_data.push_back(block_values[row % BLOCK_ROWS]);
+        result.validity.push_back(true);
+    }
+    return result;
+}
+
+vegaColumn vegaEncodedColumn::decode() const {
+    if (kind == Encoding::PLAIN) return values;
+    size_t rows = size();
+    if (kind != Encoding::DELTA) {
+        std::vector<size_t> all(rows);
+        for (size_t row = 0; row < rows; ++row) all[row] = row;
+        return values.take(value_indices(all));
+    }
+
+    vegaColumn result(dtype);
+    result.int_data.resize(rows);
+    for (size_t block = 0; block < blocks.size(); ++block) decode_block(block, result.int_data.data() + block * BLOCK_ROWS);
+    for (size_t row = 0; row < rows; ++row) {
+        if (!valid.get(row)) result.int_data[row] = 0;
+    }
+    result.validity = valid;
+    return result;
+}
+
+// ============= KERNELS =============
+
+double vegaEncodedColumn::sum() const {
+    if (!is_numeric_type(dtype)) throw std::runtime_error("Cannot compute sum for string column");
+    double total = 0;
+    switch (kind) {
+        case Encoding::PLAIN:
+            values.for_each_numeric([&total](size_t, double value) { total += value; });
+            break;
+        case Encoding::DICTIONARY: {
+            std::vector<size_t> counts(values.size(), 0);
+            valid.for_each_set([&](size_t row) { ++counts[unpack_bits(packed.data(), row, bit_width)]; });
+            for (size_t code = 0; code < counts.size(); ++code) {
+                if (counts[code] > 0) total += values.numeric_at(code) * static_cast<double>(counts[code]);
+            }
+            break;
+        }
+        case Encoding::RLE: {
+            size_t begin = 0;
+            for (size_t run = 0; run < run_ends.size(); ++run) {
+                size_t count = count_valid(valid, begin, run_ends[run]);
+                if (count > 0) total += values.numeric_at(run) * static_cast<double>(count);
+                begin = run_ends[run];
+            }
+            break;
+        }
+        case Encoding::DELTA: {
+            std::vector<int64_t> block_values(BLOCK_ROWS);
+            for (size_t block = 0; block < blocks.size(); ++block) {
+                if (!blocks[block].has_values) continue;
+                decode_block(block, block_values.data());
+                size_t begin = block * BLOCK_ROWS;
+                size_t end = std::min(size(), begin + BLOCK_ROWS);
+                for (size_t row = begin; row < end; ++row) {
+                    if (valid.get(row)) total += static_cast<double>(block_values[row - begin]);
+                }
+            }
+            break;
+        }
+    }
+    return total;
+}
+
+std::map<std::string, size_t> vegaEncodedColumn::value_counts() const {
+    std::map<std::string, size_t> counts;
+    switch (kind) {
+        case Encoding::PLAIN:
+            for (size_t row = 0; row < values.size(); ++row) {
+                if (!values.is_null(row)) counts[values.to_string(row)]++;
+            }
+            break;
+        case Encoding::DICTIONARY: {
+            std::vector<size_t> code_counts(values.size(), 0);
+            valid.for_each_set([&](size_t row) { ++code_counts[unpack_bits(packed.data(), row, bit_width)]; });
+            for (size_t code = 0; code < code_counts.size(); ++code) {
+                if (code_counts[code] > 0) counts[values.to_string(code)] += code_counts[code];
+            }
+            break;
+        }
+        case Encoding::RLE: {
+            size_t begin = 0;
+            for (size_t run = 0; run < run_ends.size(); ++run) {
+                size_t count = count_valid(valid, begin, run_ends[run]);
+                if (count > 0) counts[values.to_string(run)] += count;
+                begin = run_ends[run];
+            }
+            break;
+        }
+        case Encoding::DELTA: {
+            std::unordered_map<int64_t, size_t> int_counts;
+            std::vector<int64_t> block_values(BLOCK_ROWS);
+            for (size_t block = 0; block < blocks.size(); ++block) {
+                if (!blocks[block].has_values) continue;
+                decode_block(block, block_values.data());
+                size_t begin = block * BLOCK_ROWS;
+                size_t end = std::min(size(), begin + BLOCK_ROWS);
+                for (size_t row = begin; row < end; ++row) {
+                    if (valid.get(row)) int_counts[block_values[row - begin]]++;
+                }
+            }
+            for (const auto& [value, count] : int_counts) {
+                counts[dtype == DataType::DATETIME ? format_datetime(value) : format_int64(value)] += count;
+            }
+            break;
+        }
+    }
+    return counts;
+}
+
+std::vector<size_t> vegaEncodedColumn::matching_rows(CompareOp op, const std::string& value) const {
+    CellPredicate predicate(op, value, dtype);
+    std::vector<size_t> matches;
+    switch (kind) {
+        case Encoding::PLAIN:
+            for (size_t row = 0; row < values.size(); ++row) {
+                if (!values.is_null(row) && predicate.matches(values, row)) matches.push_back(row);
+            }
+            break;
+        case Encoding::DICTIONARY: {
+            // the predicate runs once per dictionary entry
+            std::vector<char> hits(values.size());
+            bool any = false;
+            for (size_t code = 0; code < values.size(); ++code) {
+                hits[code] = predicate.matches(values, code);
+                any = any || hits[code];
+            }
+            if (!any) break;
+            valid.for_each_set([&](size_t row) {
+                if (hits[unpack_bits(packed.data(), row, bit_width)]) matches.push_back(row);
+            });
+            break;
+        }
+        case Encoding::RLE: {
+            size_t begin = 0;
+            for (size_t run = 0; run < run_ends.size(); ++run) {
+                if (!values.is_null(run) && predicate.matches(values, run)) {
+                    append_valid_rows(valid, begin, run_ends[run], matches);
+                }
+                begin = run_ends[run];
+            }
+            break;
+        }
+        case Encoding::DELTA: {
+            std::vector<int64_t> block_values(BLOCK_ROWS);
+            for (size_t block = 0; block < blocks.size(); ++block) {
+                const DeltaBlock& header = blocks[block];
+                if (!header.has_values) continue;
+                size_t begin = block * BLOCK_ROWS;
+                size_t end = std::min(size(), begin + BLOCK_ROWS);
+                // the value range of a block often decides it without decoding
+                int verdict = predicate.range_verdict(header.min, header.max);
+                if (verdict < 0) continue;
+                if (verdict > 0) {
+                    append_valid_rows(valid, begin, end, matches);
+                    continue;
+                }
+                decode_block(block, block_values.data());
+                for (size_t row = begin; row < end; ++row) {
+                    if (valid.get(row) && predicate.matches_int(block_values[row - begin])) matches.push_back(row);
+                }
+            }
+            break;
+        }
+    }
+    return matches;
+}
+
+// ============= SERIALIZATION =============
+
+template <typename T>
+static void put(std::string& out, T value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+static void put_vector(std::string& out, const std::vector<T>& values) {
+    put<uint64_t>(out, values.size());
+    out.append(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+}
+
+// bounds-checked reads from a payload
+class PayloadReader {
+public:
+    explicit PayloadReader(std::string_view data) : data(data) {}
+
+    template <typename T>
+    T get() {
+        T value;
+        take(&value, sizeof(T));
+        return value;
+    }
+
+    template <typename T>
+    void get_vector(std::vector<T>& values) {
+        auto count = get<uint64_t>();
+        if (count > (data.size() - pos) / sizeof(T)) corrupt();
+        values.resize(count);
+        take(values.data(), count * sizeof(T));
+    }
+
+    [[noreturn]] static void corrupt() { throw std::runtime_error("Corrupt encoded column"); }
+
+private:
+    void take(void* out, size_t length) {
+        if (length > data.size() - pos) corrupt();
+        if (length > 0) std::memcpy(out, data.data() + pos, length);
+        pos += length;
+    }
+
+    std::string_view data;
+    size_t pos = 0;
+};
+
+void vegaEncodedColumn::write_payload(std::string& out) const {
+    put<uint8_t>(out, static_cast<uint8_t>(values.type));
+    put_vector(out, values.validity.words);
+    put<uint64_t>(out, values.size());
+    put_vector(out, values.int_data);
+    put_vector(out, values.float_data);
+    put_vector(out, values.string_offsets);
+    put_vector(out, values.string_data);
+    put<uint32_t>(out, bit_width);
+    put_vector(out, packed);
+    put_vector(out, run_ends);
+    put<uint64_t>(out, blocks.size());
+    for (const auto& block : blocks) {
+        put<int64_t>(out, block.first);
+        put<uint64_t>(out, block.min_delta);
+        put<uint64_t>(out, block.word_offset);
+        put<uint32_t>(out, block.bit_width);
+        put<uint8_t>(out, block.has_values);
+        put<int64_t>(out, block.min);
+        put<int64_t>(out, block.max);
+    }
+}
+
+vegaEncodedColumn vegaEncodedColumn::read_payload(std::string_view payload, Encoding encoding, DataType dtype,
+                                                  vegaBitmap validity) {
+    PayloadReader reader(payload);
+    if (dtype == DataType::CATEGORY || (dtype == DataType::DATETIME && encoding != Encoding::PLAIN &&
+                                        encoding != Encoding::DELTA)) {
+        PayloadReader::corrupt();
+    }
+    vegaEncodedColumn result;
+    result.kind = encoding;
+    result.dtype = dtype;
+    result.valid = std::move(validity);
+
+    auto value_type = reader.get<uint8_t>();
+    if (value_type > static_cast<uint8_t>(DataType::DATETIME) || value_type == static_cast<uint8_t>(DataType::CATEGORY)) {
+        PayloadReader::corrupt();
+    }
+    result.values.type = static_cast<DataType>(value_type);
+    reader.get_vector(result.values.validity.words);
+    result.values.validity.length = reader.get<uint64_t>();
+    reader.get_vector(result.values.int_data);
+    reader.get_vector(result.values.float_data);
+    reader.get_vector(result.values.string_offsets);
+    reader.get_vector(result.values.string_data);
+    result.bit_width = reader.get<uint32_t>();
+    reader.get_vector(result.packed);
+    reader.get_vector(result.run_ends);
+    auto block_count = reader.get<uint64_t>();
+    if (block_count > payload.size()) PayloadReader::corrupt();
+    for (uint64_t i = 0; i < block_count; ++i) {
+        DeltaBlock block;
+        block.first = reader.get<int64_t>();
+        block.min_delta = reader.get<uint64_t>();
+        block.word_offset = reader.get<uint64_t>();
+        block.bit_width = reader.get<uint32_t>();
+        block.has_values = reader.get<uint8_t>() != 0;
+        block.min = reader.get<int64_t>();
+        block.max = reader.get<int64_t>();
+        result.blocks.push_back(block);
+    }
+
+    // everything decoding relies on
+    const vegaColumn& values = result.values;
+    size_t value_rows = values.size();
+    size_t rows = result.size();
+    bool ok = values.validity.words.size() == (value_rows + 63) / 64 && result.bit_width <= 64;
+    if (values.type == DataType::STRING) {
+        ok = ok && values.string_offsets.size() == value_rows + 1 && values.string_offsets.front() == 0 &&
+             std::is_sorted(values.string_offsets.begin(), values.string_offsets.end()) &&
+             values.string_offsets.back() == values.string_data.size();
+    } else {
+        ok = ok && (values.has_int_data() ? values.int_data.size() : values.float_data.size()) == value_rows;
+    }
+    switch (encoding) {
+        case Encoding::PLAIN:
+            ok = ok && values.type == dtype;
+            break;
+        case Encoding::DICTIONARY:
+            ok = ok && values.type == dtype && result.packed.size() >= packed_words(rows, result.bit_width);
+            for (size_t row = 0; ok && row < rows; ++row) {
+                ok = unpack_bits(result.packed.data(), row, result.bit_width) < value_rows;
+            }
+            break;
+        case Encoding::RLE:
+            ok = ok && values.type == dtype && result.run_ends.size() == value_rows &&
+                 std::is_sorted(result.run_ends.begin(), result.run_ends.end()) &&
+                 (rows == 0 ? value_rows == 0 : result.run_ends.back() == rows);
+            break;
+        case Encoding::DELTA:
+            ok = ok && (dtype == DataType::INT || dtype == DataType::DATETIME) && result.blocks.size() == (rows + BLOCK_ROWS - 1) / BLOCK_ROWS;
+            for (size_t b = 0; ok && b < result.blocks.size(); ++b) {
+                const DeltaBlock& block = result.blocks[b];
+                size_t count = std::min(BLOCK_ROWS, rows - b * BLOCK_ROWS);
+                ok = block.bit_width <= 64 && block.word_offset <= result.packed.size() &&
+                     packed_words(count - 1, block.bit_width) <= result.packed.size() - block.word_offset;
+            }
+            break;
+    }
+    if (!ok || (encoding == Encoding::PLAIN && result.values.validity != result.valid)) PayloadReader::corrupt();
+    return result;
+}
+
+// ============= COLUMN STORE =============
+
+// source of column versions, shared by all stores so that a version is never reused
+static std::atomic<uint64_t> next_column_version{0};
+
+vegaColumnStore::vegaColumnStore(std::vector<vegaColumn> columns) {
+    *this = std::move(columns);
+}
+
+vegaColumnStore::vegaColumnStore(const vegaColumnStore& other) {
+    *this = other;
+}
+
+vegaColumnStore::vegaColumnStore(vegaColumnStore&& other) noexcept {
+    *this = std::move(other);
+}
+
+vegaColumnStore& vegaColumnStore::operator=(const vegaColumnStore& other) {
+    if (this == &other) return *this;
+    std::lock_guard<std::mutex> lock(other.decode_mutex);
+    columns = other.columns;
+    encoded_columns.assign(columns.size(), nullptr);
+    for (size_t i = 0; i < columns.size(); ++i) {
+        if (other.encoded_flags[i].load(std::memory_order_acquire)) encoded_columns[i] = other.encoded_columns[i];
+    }
+    reset_flags();
+    // the copy holds the same cells
+    versions = other.versions;
+    return *this;
+}
+
+vegaColumnStore& vegaColumnStore::operator=(vegaColumnStore&& other) noexcept {
+    columns = std::move(other.columns);
+    encoded_columns = std::move(other.encoded_columns);
+    encoded_flags = std::move(other.encoded_flags);
+    versions = std::move(other.versions);
+    other.columns.clear();
+    other.encoded_columns.clear();
+    other.reset_flags();
+    return *this;
+}
+
+vegaColumnStore& vegaColumnStore::operator=(std::vector<vegaColumn> plain) {
+    columns = std::move(plain);
+    encoded_columns.assign(columns.size(), nullptr);
+    reset_flags();
+    return *this;
+}
+
+void vegaColumnStore::drop_decoded() {
+    for (size_t i = 0; i < encoded_columns.size(); ++i) {
+        if (!encoded_flags || !encoded_flags[i].load(std::memory_order_relaxed)) encoded_columns[i].reset();
+    }
+}
+
+void vegaColumnStore::reset_flags() {
+    encoded_columns.resize(columns.size());
+    encoded_flags = std::make_unique<std::atomic<bool>[]>(columns.size());
+    for (size_t i = 0; i < columns.size(); ++i) encoded_flags[i].store(encoded_columns[i] != nullptr);
+    versions.resize(columns.size());
+    for (size_t i = 0; i < columns.size(); ++i) touch(i);
+}
+
+void vegaColumnStore::touch(size_t i) {
+    versions[i] = ++next_column_version;
+}
+
+size_t vegaColumnStore::rows() const {
+    return columns.empty() ? 0 : validity(0).size();
+}
+
+const vegaEncodedColumn* vegaColumnStore::encoded(size_t i) const {
+    return encoded_flags[i].load(std::memory_order_acquire) ? encoded_columns[i].get() : nullptr;
+}
+
+const vegaBitmap& vegaColumnStore::validity(size_t i) const {
+    const vegaEncodedColumn* column = encoded(i);
+    return column ? column->validity() : columns[i].validity;
+}
+
+size_t vegaColumnStore::memory_usage(size_t i) const {
+    const vegaEncodedColumn* column = encoded(i);
+    return column ? column->memory_usage() : columns[i].memory_usage();
+}
+
+Encoding vegaColumnStore::encoding(size_t i) const {
+    const vegaEncodedColumn* column = encoded(i);
+    return column ? column->encoding() : Encoding::PLAIN;
+}
+
+vegaColumn vegaColumnStore::take(size_t i, const std::vector<size_t>& indices) const {
+    const vegaEncodedColumn* column = encoded(i);
+    return column ? column->take(indices) : columns[i].take(indices);
+}
+
+void vegaColumnStore::decode(size_t i) const {
+    if (!encoded_flags[i].load(std::memory_order_acquire)) return;
+    std::lock_guard<std::mutex> lock(decode_mutex);
+    if (!encoded_flags[i].load(std::memory_order_relaxed)) return;
+    columns[i] = encoded_columns[i]->decode();
+    encoded_flags[i].store(false, std::memory_order_release);
+}
+
+void vegaColumnStore::decode_all() const {
+    for (size_t i = 0; i < columns.size(); ++i) decode(i);
+}
+
+const vegaColumn& vegaColumnStore::operator[](size_t i) const {
+    decode(i);
+    return columns[i];
+}
+
+vegaColumn& vegaColumnStore::operator[](size_t i) {
+    decode(i);
+    touch(i);
+    return columns[i];
+}
+
+vegaColumnStore::const_iterator vegaColumnStore::begin() const {
+    decode_all();
+    return columns.cbegin();
+}
+
+vegaColumnStore::const_iterator vegaColumnStore::end() const {
+    decode_all();
+    return columns.cend();
+}
+
+vegaColumnStore::iterator vegaColumnStore::begin() {
+    decode_all();
+    for (size_t i = 0; i < columns.size(); ++i) touch(i);
+    return columns.begin();
+}
+
+vegaColumnStore::iterator vegaColumnStore::end() {
+    decode_all();
+    for (size_t i = 0; i < columns.size(); ++i) touch(i);
+    return columns.end();
+}
+
+vegaColumnStore::operator const std::vector<vegaColumn>&() const {
+    decode_all();
+    return columns;
+}
+
+bool operator==(const vegaColumnStore& a, const vegaColumnStore& b) {
+    a.decode_all();
+    b.decode_all();
+    return a.columns == b.columns;
+}
+
+void vegaColumnStore::clear() {
+    columns.clear();
+    encoded_columns.clear();
+    reset_flags();
+}
+
+void vegaColumnStore::reserve(size_t count) {
+    columns.reserve(count);
+    encoded_columns.reserve(count);
+}
+
+void vegaColumnStore::push_back(vegaColumn column) {
+    drop_decoded();
+    columns.push_back(std::move(column));
+    reset_flags();
+}
+
+void vegaColumnStore::insert(const_iterator pos, vegaColumn column) {
+    auto index = pos - columns.cbegin();
+    drop_decoded();
+    columns.insert(columns.begin() + index, std::move(column));
+    encoded_columns.insert(encoded_columns.begin() + index, nullptr);
+    reset_flags();
+}
+
+void vegaColumnStore::erase(const_iterator pos) {
+    auto index = pos - columns.cbegin();
+    drop_decoded();
+    columns.erase(columns.begin() + index);
+    encoded_columns.erase(encoded_columns.begin() + index);
+    reset_flags();
+}
+
+void vegaColumnStore::assign(size_t count, const vegaColumn& column) {
+    columns.assign(count, column);
+    encoded_columns.assign(count, nullptr);
+    reset_flags();
+}
+
+void vegaColumnStore::set_encoded(size_t i, vegaEncodedColumn column) {
+    touch(i);
+    if (column.encoding() == Encoding::PLAIN) {
+        columns[i] = column.decode();
+        encoded_flags[i].store(false, std::memory_order_release);
+        encoded_columns[i].reset();
+        return;
+    }
+    columns[i] = vegaColumn(column.type());
+    encoded_columns[i] = std::make_shared<const vegaEncodedColumn>(std::move(column));
+    encoded_flags[i].store(true, std::memory_order_release);
+}
+
+size_t vegaColumnStore::encode_all(size_t num_threads) {
+    if (num_threads == 0) num_threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+    std::atomic<size_t> saved{0};
+    parallel_for(columns.size(), num_threads, [&](size_t i) {
+        if (encoded(i)) return;
+        Encoding encoding = vegaEncodedColumn::choose(columns[i]);
+        if (encoding == Encoding::PLAIN) return;
+        vegaEncodedColumn column = vegaEncodedColumn::encode(columns[i], encoding);
+        size_t before = columns[i].memory_usage();
+        size_t after = column.memory_usage();
+        if (after < before) saved += before - after;
+        set_encoded(i, std::move(column));
+    });
+    return saved;
+}
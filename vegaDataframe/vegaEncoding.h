@@ -0,0 +1,176 @@
+#ifndef VEGA_VEGAENCODING_H
+#define VEGA_VEGAENCODING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "vegaColumn.h"
+
+// Lightweight column encodings. The validity bitmap is always kept as is; only the values
+// are encoded:
+//   DICTIONARY  INT/STRING: sorted distinct values plus one bit-packed code per row
+//   RLE         INT/FLOAT/STRING: one value per run of equal cells plus the row where each run ends
+//   DELTA       INT/DATETIME: blocks of BLOCK_ROWS rows holding the first value and the
+//               bit-packed differences to the previous row (sorted ids and timestamps pack to
+//               a few bits)
+// CATEGORY columns carry their own dictionary and are always PLAIN.
+enum class Encoding { PLAIN, DICTIONARY, RLE, DELTA };
+
+std::string encoding_to_string(Encoding encoding);
+
+// An immutable encoded copy of a vegaColumn with kernels that run on the encoded values.
+class vegaEncodedColumn {
+public:
+    static constexpr size_t BLOCK_ROWS = 1024;
+
+    vegaEncodedColumn() = default;
+    // picks the smallest encoding from one pass over the column (PLAIN unless an encoding saves
+    // at least 10% of the value storage)
+    static Encoding choose(const vegaColumn& column);
+    static vegaEncodedColumn encode(const vegaColumn& column, Encoding encoding);
+    static vegaEncodedColumn encode(const vegaColumn& column) { return encode(column, choose(column)); }
+
+    [[nodiscard]] Encoding encoding() const { return kind; }
+    [[nodiscard]] DataType type() const { return dtype; }
+    [[nodiscard]] size_t size() const { return valid.size(); }
+    [[nodiscard]] const vegaBitmap& validity() const { return valid; }
+    [[nodiscard]] size_t memory_usage() const;
+    [[nodiscard]] vegaColumn decode() const;
+    // gathers rows like vegaColumn::take without decoding the whole column
+    [[nodiscard]] vegaColumn take(const std::vector<size_t>& indices) const;
+
+    // ============= KERNELS =============
+    // sum of the non-null cells of an INT or FLOAT column
+    [[nodiscard]] double sum() const;
+    // textual value -> number of non-null cells
+    [[nodiscard]] std::map<std::string, size_t> value_counts() const;
+    // rows whose non-null cell satisfies "cell op value" with the semantics of
+    // vegaDataframe::filter_rows; value must not be empty (null tests only need validity())
+    [[nodiscard]] std::vector<size_t> matching_rows(CompareOp op, const std::string& value) const;
+
+    // ============= SERIALIZATION =============
+    // appends everything but the validity bitmap to out
+    void write_payload(std::string& out) const;
+    static vegaEncodedColumn read_payload(std::string_view payload, Encoding encoding, DataType dtype,
+                                          vegaBitmap validity);
+
+private:
+    struct DeltaBlock {
+        int64_t first = 0;
+        uint64_t min_delta = 0;
+        uint64_t word_offset = 0;
+        uint32_t bit_width = 0;
+        // range of the non-null values, used to skip or accept whole blocks
+        bool has_values = false;
+        int64_t min = 0;
+        int64_t max = 0;
+    };
+
+    // the rows of a DELTA block with null slots holding the previous value
+    void decode_block(size_t block, int64_t* out) const;
+    // run index of every row (npos for null rows), as indices into values
+    [[nodiscard]] std::vector<size_t> value_indices(const std::vector<size_t>& rows) const;
+
+    Encoding kind = Encoding::PLAIN;
+    DataType dtype = DataType::STRING;
+    vegaBitmap valid;
+    // PLAIN: a copy of the column; DICTIONARY: the sorted dictionary; RLE: the value of each run
+    vegaColumn values;
+    // DICTIONARY codes and DELTA differences, bit_width bits each
+    std::vector<uint64_t> packed;
+    uint32_t bit_width = 0;
+    // RLE: exclusive end row of every run
+    std::vector<uint64_t> run_ends;
+    std::vector<DeltaBlock> blocks;
+};
+
+// ============= COLUMN STORE =============
+// The columns of a dataframe, each held either plain or encoded. Kernels that understand the
+// encodings reach encoded columns through encoded(); any other access decodes the column
+// first and keeps it plain until it is encoded again, so code written against plain
+// vegaColumns keeps working. Decoding through a const accessor is safe from several threads.
+class vegaColumnStore {
+public:
+    using iterator = std::vector<vegaColumn>::iterator;
+    using const_iterator = std::vector<vegaColumn>::const_iterator;
+
+    vegaColumnStore() = default;
+    explicit vegaColumnStore(std::vector<vegaColumn> columns);
+    vegaColumnStore(const vegaColumnStore& other);
+    vegaColumnStore(vegaColumnStore&& other) noexcept;
+    vegaColumnStore& operator=(const vegaColumnStore& other);
+    vegaColumnStore& operator=(vegaColumnStore&& other) noexcept;
+    vegaColumnStore& operator=(std::vector<vegaColumn> columns);
+
+    // ============= ACCESS =============
+    [[nodiscard]] size_t size() const { return columns.size(); }
+    [[nodiscard]] bool empty() const { return columns.empty(); }
+    // row count, read without decoding
+    [[nodiscard]] size_t rows() const;
+    [[nodiscard]] DataType type(size_t i) const { return columns[i].type; }
+    [[nodiscard]] const vegaBitmap& validity(size_t i) const;
+    [[nodiscard]] size_t memory_usage(size_t i) const;
+    // the encoded form of a column, nullptr when it is plain
+    [[nodiscard]] const vegaEncodedColumn* encoded(size_t i) const;
+    [[nodiscard]] Encoding encoding(size_t i) const;
+    // rows of one column (see vegaColumn::take), without decoding an encoded column
+    [[nodiscard]] vegaColumn take(size_t i, const std::vector<size_t>& indices) const;
+    // changes whenever column i may have been modified (mutable access, replacement, inserts
+    // and erases); never repeats, so results cached against it stay valid while it is unchanged
+    [[nodiscard]] uint64_t version(size_t i) const { return versions[i]; }
+
+    // the plain column, decoding it first when it is encoded
+    const vegaColumn& operator[](size_t i) const;
+    vegaColumn& operator[](size_t i);
+    const vegaColumn& front() const { return (*this)[0]; }
+    const vegaColumn& back() const { return (*this)[size() - 1]; }
+    vegaColumn& back() { return (*this)[size() - 1]; }
+    // whole-store access decodes every column
+    const_iterator begin() const;
+    const_iterator end() const;
+    iterator begin();
+    iterator end();
+    operator const std::vector<vegaColumn>&() const;
+    friend bool operator==(const vegaColumnStore& a, const vegaColumnStore& b);
+
+    // ============= MODIFICATION =============
+    void clear();
+    void reserve(size_t count);
+    void push_back(vegaColumn column);
+    template <typename... Args>
+    void emplace_back(Args&&... args) { push_back(vegaColumn(std::forward<Args>(args)...)); }
+    void insert(const_iterator pos, vegaColumn column);
+    void erase(const_iterator pos);
+    void assign(size_t count, const vegaColumn& column);
+    // stores an encoded column (PLAIN ones are stored decoded)
+    void set_encoded(size_t i, vegaEncodedColumn column);
+    // encodes every plain column whose chosen encoding is not PLAIN; returns the bytes saved
+    size_t encode_all(size_t num_threads = 0);
+    void decode_all() const;
+
+private:
+    void decode(size_t i) const;
+    // releases the encoded form of the columns decoded since the last modification
+    void drop_decoded();
+    // sizes encoded_columns and the flags to the columns and sets the flags from encoded_columns;
+    // gives every column a new version
+    void reset_flags();
+    void touch(size_t i);
+
+    // an encoded column leaves only its type here
+    mutable std::vector<vegaColumn> columns;
+    // kept after decoding (it is small) until the store is modified
+    std::vector<std::shared_ptr<const vegaEncodedColumn>> encoded_columns;
+    // whether columns[i] is still to be decoded
+    std::unique_ptr<std::atomic<bool>[]> encoded_flags;
+    std::vector<uint64_t> versions;
+    mutable std::mutex decode_mutex;
+};
+
+#endif // VEGA_VEGAENCODING_H
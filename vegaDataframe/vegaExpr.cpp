@@ -0,0 +1,1089 @@
+#include "vegaExpr.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <functional>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <unordered_set>
+#include "vegaCompare.h"
+#include "vegaCsv.h"
+#include "vegaDatetime.h"
+#include "vegaEncoding.h"
+
+bool vegaExprNode::is_predicate() const {
+    return kind == Kind::COMPARE || kind == Kind::IN || kind == Kind::IS_NULL || kind == Kind::NOT ||
+           kind == Kind::AND || kind == Kind::OR;
+}
+
+std::string vegaExprNode::to_string() const {
+    static constexpr std::array<std::string_view, 6> OPS = {"==", "!=", "<", "<=", ">", ">="};
+    auto quoted = [](const std::string& value, char quote) {
+        std::string out(1, quote);
+        for (char c : value) {
+            if (c == quote || c == '\\') out += '\\';
+            out += c;
+        }
+        return out + quote;
+    };
+    auto binary = [this](std::string_view op) {
+        return "(" + children[0]->to_string() + " " + std::string(op) + " " + children[1]->to_string() + ")";
+    };
+
+    switch (kind) {
+        case Kind::COLUMN: {
+            bool plain = !text.empty() && !std::isdigit(static_cast<unsigned char>(text[0])) &&
+                         std::all_of(text.begin(), text.end(), [](char c) {
+                             return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+                         });
+            return plain ? text : quoted(text, '`');
+        }
+        case Kind::NUMBER: return text;
+        case Kind::STRING: return quoted(text, '\'');
+        case Kind::NEGATE: return "-" + children[0]->to_string();
+        case Kind::ARITHMETIC: return binary(std::string(1, arithmetic));
+        case Kind::COMPARE: return binary(OPS[static_cast<size_t>(op)]);
+        case Kind::IN: {
+            std::string out = children[0]->to_string() + (negated ? " not in (" : " in (");
+            for (size_t i = 1; i < children.size(); ++i) out += (i > 1 ? ", " : "") + children[i]->to_string();
+            return out + ")";
+        }
+        case Kind::IS_NULL: return children[0]->to_string() + (negated ? " is not null" : " is null");
+        case Kind::NOT: return "not " + children[0]->to_string();
+        case Kind::AND: return binary("and");
+        case Kind::OR: return binary("or");
+    }
+    return {};
+}
+
+// ============= PARSING =============
+
+namespace {
+
+enum class TokenKind { END, NAME, QUOTED_NAME, NUMBER, STRING, SYMBOL };
+
+struct ExprToken {
+    TokenKind kind = TokenKind::END;
+    std::string text;
+    size_t pos = 0;
+};
+
+[[noreturn]] void syntax_error(size_t pos, const std::string& message) {
+    throw std::runtime_error("Invalid query at position " + std::to_string(pos) + ": " + message);
+}
+
+bool is_name_char(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+std::vector<ExprToken> tokenize(std::string_view text) {
+    std::vector<ExprToken> tokens;
+    size_t pos = 0;
+    while (true) {
+        while (pos < text.size() && std::isspace(static_cast<unsigned char>(text[pos]))) ++pos;
+        if (pos == text.size()) break;
+
+        ExprToken token;
+        token.pos = pos;
+        char c = text[pos];
+        if (is_digit(c) || (c == '.' && pos + 1 < text.size() && is_digit(text[pos + 1]))) {
+            size_t start = pos;
+            while (pos < text.size() && is_digit(text[pos])) ++pos;
+            if (pos < text.size() && text[pos] == '.') {
+                ++pos;
+                while (pos < text.size() && is_digit(text[pos])) ++pos;
+            }
+            if (pos < text.size() && (text[pos] == 'e' || text[pos] == 'E')) {
+                size_t exponent = pos + 1;
+                if (exponent < text.size() && (text[exponent] == '+' || text[exponent] == '-')) ++exponent;
+                if (exponent < text.size() && is_digit(text[exponent])) {
+                    pos = exponent;
+                    while (pos < text.size() && is_digit(text[pos])) ++pos;
+                }
+            }
+            token.kind = TokenKind::NUMBER;
+            token.text = text.substr(start, pos - start);
+        } else if (is_name_char(c)) {
+            size_t start = pos;
+            while (pos < text.size() && is_name_char(text[pos])) ++pos;
+            token.kind = TokenKind::NAME;
+            token.text = text.substr(start, pos - start);
+        } else if (c == '\'' || c == '"' || c == '`') {
+            // strings and quoted names end at the matching quote; a backslash escapes the next character
+            ++pos;
+            while (pos < text.size() && text[pos] != c) {
+                if (text[pos] == '\\' && pos + 1 < text.size()) ++pos;
+                token.text += text[pos++];
+            }
+            if (pos == text.size()) syntax_error(token.pos, "unterminated quote");
+            ++pos;
+            token.kind = c == '`' ? TokenKind::QUOTED_NAME : TokenKind::STRING;
+        } else {
+            static constexpr std::array<std::string_view, 16> SYMBOLS = {
+                "==", "!=", "<=", ">=", "&&", "||", "<", ">", "!", "(", ")", ",", "+", "-", "*", "/"};
+            auto symbol = std::find_if(SYMBOLS.begin(), SYMBOLS.end(),
+                                       [&](std::string_view s) { return text.substr(pos, s.size()) == s; });
+            if (symbol != SYMBOLS.end()) {
+                token.text = *symbol;
+            } else if (c == '%') {
+                token.text = "%";
+            } else if (c == '=') {
+                syntax_error(pos, "use '==' for equality");
+            } else {
+                syntax_error(pos, std::string("unexpected character '") + c + "'");
+            }
+            pos += token.text.size();
+            token.kind = TokenKind::SYMBOL;
+        }
+        tokens.push_back(std::move(token));
+    }
+
+    ExprToken end;
+    end.pos = text.size();
+    tokens.push_back(std::move(end));
+    return tokens;
+}
+
+bool iequals(std::string_view a, std::string_view b) {
+    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+               return std::tolower(static_cast<unsigned char>(x)) == y;
+           });
+}
+
+using NodePtr = std::unique_ptr<vegaExprNode>;
+
+NodePtr make_node(vegaExprNode::Kind kind) {
+    auto node = std::make_unique<vegaExprNode>();
+    node->kind = kind;
+    return node;
+}
+
+NodePtr make_node(vegaExprNode::Kind kind, NodePtr left, NodePtr right) {
+    NodePtr node = make_node(kind);
+    node->children.push_back(std::move(left));
+    if (right) node->children.push_back(std::move(right));
+    return node;
+}
+
+class ExprParser {
+public:
+    explicit ExprParser(std::string_view text) : tokens(tokenize(text)) {}
+
+    NodePtr parse() {
+        NodePtr node = parse_or();
+        if (peek().kind != TokenKind::END) syntax_error(peek().pos, "unexpected '" + peek().text + "'");
+        require_predicate(*node, 0);
+        return node;
+    }
+
+private:
+    std::vector<ExprToken> tokens;
+    size_t next = 0;
+
+    const ExprToken& peek(size_t ahead = 0) const { return tokens[std::min(next + ahead, tokens.size() - 1)]; }
+
+    // keywords are unquoted names compared without case
+    bool is_keyword(const ExprToken& token, std::string_view word) const {
+        return token.kind == TokenKind::NAME && iequals(token.text, word);
+    }
+
+    bool accept_keyword(std::string_view word) {
+        if (!is_keyword(peek(), word)) return false;
+        ++next;
+        return true;
+    }
+
+    bool accept_symbol(std::string_view symbol) {
+        if (peek().kind != TokenKind::SYMBOL || peek().text != symbol) return false;
+        ++next;
+        return true;
+    }
+
+    void expect_symbol(std::string_view symbol) {
+        if (!accept_symbol(symbol)) syntax_error(peek().pos, "expected '" + std::string(symbol) + "'");
+    }
+
+    static void require_predicate(const vegaExprNode& node, size_t pos) {
+        if (!node.is_predicate()) syntax_error(pos, "expected a condition");
+    }
+
+    static void require_value(const vegaExprNode& node, size_t pos) {
+        if (node.is_predicate()) syntax_error(pos, "expected a value, not a condition");
+    }
+
+    NodePtr parse_or() {
+        size_t pos = peek().pos;
+        NodePtr left = parse_and();
+        while (accept_keyword("or") || accept_symbol("||")) {
+            size_t right_pos = peek().pos;
+            NodePtr right = parse_and();
+            require_predicate(*left, pos);
+            require_predicate(*right, right_pos);
+            left = make_node(vegaExprNode::Kind::OR, std::move(left), std::move(right));
+        }
+        return left;
+    }
+
+    NodePtr parse_and() {
+        size_t pos = peek().pos;
+        NodePtr left = parse_not();
+        while (accept_keyword("and") || accept_symbol("&&")) {
+            size_t right_pos = peek().pos;
+            NodePtr right = parse_not();
+            require_predicate(*left, pos);
+            require_predicate(*right, right_pos);
+            left = make_node(vegaExprNode::Kind::AND, std::move(left), std::move(right));
+        }
+        return left;
+    }
+
+    NodePtr parse_not() {
+        if (accept_keyword("not") || accept_symbol("!")) {
+            size_t pos = peek().pos;
+            NodePtr operand = parse_not();
+            require_predicate(*operand, pos);
+            return make_node(vegaExprNode::Kind::NOT, std::move(operand), nullptr);
+        }
+        return parse_comparison();
+    }
+
+    NodePtr parse_comparison() {
+        size_t pos = peek().pos;
+        NodePtr left = parse_sum();
+
+        if (peek().kind == TokenKind::SYMBOL) {
+            static constexpr std::array<std::string_view, 6> OPS = {"==", "!=", "<", "<=", ">", ">="};
+            auto op = std::find(OPS.begin(), OPS.end(), peek().text);
+            if (op != OPS.end()) {
+                ++next;
+                size_t right_pos = peek().pos;
+                NodePtr right = parse_sum();
+                require_value(*left, pos);
+                require_value(*right, right_pos);
+                NodePtr node = make_node(vegaExprNode::Kind::COMPARE, std::move(left), std::move(right));
+                node->op = parse_compare_op(std::string(*op));
+                return node;
+            }
+        }
+
+        bool negated = is_keyword(peek(), "not") && is_keyword(peek(1), "in");
+        if (negated) ++next;
+        if (accept_keyword("in")) {
+            require_value(*left, pos);
+            NodePtr node = make_node(vegaExprNode::Kind::IN, std::move(left), nullptr);
+            node->negated = negated;
+            expect_symbol("(");
+            do {
+                node->children.push_back(parse_literal());
+            } while (accept_symbol(","));
+            expect_symbol(")");
+            return node;
+        }
+
+        if (accept_keyword("is")) {
+            require_value(*left, pos);
+            NodePtr node = make_node(vegaExprNode::Kind::IS_NULL, std::move(left), nullptr);
+            node->negated = accept_keyword("not");
+            if (!accept_keyword("null")) syntax_error(peek().pos, "expected 'null'");
+            return node;
+        }
+        return left;
+    }
+
+    NodePtr parse_sum() {
+        size_t pos = peek().pos;
+        NodePtr left = parse_product();
+        while (peek().kind == TokenKind::SYMBOL && (peek().text == "+" || peek().text == "-")) {
+            char op = peek().text[0];
+            ++next;
+            size_t right_pos = peek().pos;
+            NodePtr right = parse_product();
+            require_value(*left, pos);
+            require_value(*right, right_pos);
+            left = make_node(vegaExprNode::Kind::ARITHMETIC, std::move(left), std::move(right));
+            left->arithmetic = op;
+        }
+        return left;
+    }
+
+    NodePtr parse_product() {
+        size_t pos = peek().pos;
+        NodePtr left = parse_unary();
+        while (peek().kind == TokenKind::SYMBOL &&
+               (peek().text == "*" || peek().text == "/" || peek().text == "%")) {
+            char op = peek().text[0];
+            ++next;
+            size_t right_pos = peek().pos;
+            NodePtr right = parse_unary();
+            require_value(*left, pos);
+            require_value(*right, right_pos);
+            left = make_node(vegaExprNode::Kind::ARITHMETIC, std::move(left), std::move(right));
+            left->arithmetic = op;
+        }
+        return left;
+    }
+
+    NodePtr parse_unary() {
+        if (accept_symbol("-")) {
+            size_t pos = peek().pos;
+            NodePtr operand = parse_unary();
+            require_value(*operand, pos);
+            // a negative number stays a literal
+            if (operand->kind == vegaExprNode::Kind::NUMBER) {
+                operand->number = -operand->number;
+                operand->text = "-" + operand->text;
+                return operand;
+            }
+            return make_node(vegaExprNode::Kind::NEGATE, std::move(operand), nullptr);
+        }
+        if (accept_symbol("(")) {
+            NodePtr inner = parse_or();
+            expect_symbol(")");
+            return inner;
+        }
+
+        const ExprToken& token = peek();
+        if (token.kind == TokenKind::QUOTED_NAME ||
+            (token.kind == TokenKind::NAME && !is_digit(token.text[0]) && !is_reserved(token.text))) {
+            NodePtr node = make_node(vegaExprNode::Kind::COLUMN);
+            node->text = token.text;
+            ++next;
+            return node;
+        }
+        return parse_literal();
+    }
+
+    NodePtr parse_literal() {
+        bool negative = accept_symbol("-");
+        const ExprToken& token = peek();
+        if (token.kind == TokenKind::NUMBER) {
+            NodePtr node = make_node(vegaExprNode::Kind::NUMBER);
+            if (!parse_double(token.text, node->number)) syntax_error(token.pos, "invalid number '" + token.text + "'");
+            node->text = negative ? "-" + token.text : token.text;
+            if (negative) node->number = -node->number;
+            ++next;
+            return node;
+        }
+        if (token.kind == TokenKind::STRING && !negative) {
+            NodePtr node = make_node(vegaExprNode::Kind::STRING);
+            node->text = token.text;
+            ++next;
+            return node;
+        }
+        if (token.kind == TokenKind::END) syntax_error(token.pos, "unexpected end of query");
+        syntax_error(token.pos, "unexpected '" + token.text + "'");
+    }
+
+    static bool is_reserved(std::string_view name) {
+        for (std::string_view word : {"and", "or", "not", "in", "is", "null"}) {
+            if (iequals(name, word)) return true;
+        }
+        return false;
+    }
+};
+
+} // namespace
+
+std::unique_ptr<vegaExprNode> parse_expression(std::string_view text) {
+    return ExprParser(text).parse();
+}
+
+std::vector<std::unique_ptr<vegaExprNode>> split_conjuncts(std::unique_ptr<vegaExprNode> node) {
+    std::vector<std::unique_ptr<vegaExprNode>> conjuncts;
+    if (node->kind != vegaExprNode::Kind::AND) {
+        conjuncts.push_back(std::move(node));
+        return conjuncts;
+    }
+    for (auto& child : node->children) {
+        for (auto& conjunct : split_conjuncts(std::move(child))) conjuncts.push_back(std::move(conjunct));
+    }
+    return conjuncts;
+}
+
+static void collect_columns(const vegaExprNode& node, std::vector<std::string>& names) {
+    if (node.kind == vegaExprNode::Kind::COLUMN && std::find(names.begin(), names.end(), node.text) == names.end()) {
+        names.push_back(node.text);
+    }
+    for (const auto& child : node.children) collect_columns(*child, names);
+}
+
+std::vector<std::string> referenced_columns(const vegaExprNode& node) {
+    std::vector<std::string> names;
+    collect_columns(node, names);
+    return names;
+}
+
+// ============= KERNELS =============
+// Kernels evaluate count rows starting at begin, a multiple of 64, so that row begin + i maps
+// to bit i % 64 of word i / 64 and the words of a block line up with the bitmap words.
+// Bits past count are always left at zero.
+
+// rows per kernel call and per parallel task
+static constexpr size_t QUERY_BLOCK_ROWS = 2048;
+static constexpr size_t QUERY_TASK_ROWS = 1 << 16;
+static constexpr size_t QUERY_BLOCK_WORDS = QUERY_BLOCK_ROWS / 64;
+
+static size_t words_for(size_t rows) {
+    return (rows + 63) / 64;
+}
+
+// mask of the bits of the last word of a block that hold rows
+static uint64_t tail_mask(size_t count) {
+    return count % 64 == 0 ? ~uint64_t{0} : (uint64_t{1} << (count % 64)) - 1;
+}
+
+// packs test(i) for i < count into words, 64 rows per word
+template <typename Test>
+static void pack_bits(size_t count, uint64_t* words, const Test& test) {
+    size_t full = count / 64;
+    for (size_t w = 0; w < full; ++w) {
+        uint64_t bits = 0;
+        for (size_t i = 0; i < 64; ++i) bits |= static_cast<uint64_t>(test(w * 64 + i)) << i;
+        words[w] = bits;
+    }
+    if (count % 64 != 0) {
+        uint64_t bits = 0;
+        for (size_t i = 0; i < count % 64; ++i) bits |= static_cast<uint64_t>(test(full * 64 + i)) << i;
+        words[full] = bits;
+    }
+}
+
+// ands the validity words of rows [begin, begin + count) into words
+static void and_validity(const vegaBitmap& validity, size_t begin, size_t count, uint64_t* words) {
+    const uint64_t* valid = validity.words.data() + begin / 64;
+    for (size_t w = 0; w < words_for(count); ++w) words[w] &= valid[w];
+}
+
+// calls fn with the comparison functor of op, so that kernels are instantiated per operator
+template <typename Fn>
+static void with_compare_op(CompareOp op, Fn&& fn) {
+    switch (op) {
+        case CompareOp::EQ: fn(std::equal_to<>()); break;
+        case CompareOp::NE: fn(std::not_equal_to<>()); break;
+        case CompareOp::LT: fn(std::less<>()); break;
+        case CompareOp::LE: fn(std::less_equal<>()); break;
+        case CompareOp::GT: fn(std::greater<>()); break;
+        case CompareOp::GE: fn(std::greater_equal<>()); break;
+    }
+}
+
+// "a op b" <=> "b mirrored(op) a"
+static CompareOp mirrored(CompareOp op) {
+    switch (op) {
+        case CompareOp::LT: return CompareOp::GT;
+        case CompareOp::LE: return CompareOp::GE;
+        case CompareOp::GT: return CompareOp::LT;
+        case CompareOp::GE: return CompareOp::LE;
+        default: return op;
+    }
+}
+
+class vegaPredicateKernel {
+public:
+    virtual ~vegaPredicateKernel() = default;
+    virtual void eval(size_t begin, size_t count, uint64_t* words) const = 0;
+};
+
+namespace {
+
+using PredicatePtr = std::unique_ptr<vegaPredicateKernel>;
+
+// numeric operand: values as doubles plus validity words
+class NumberKernel {
+public:
+    virtual ~NumberKernel() = default;
+    virtual void eval(size_t begin, size_t count, double* values, uint64_t* valid) const = 0;
+};
+
+using NumberPtr = std::unique_ptr<NumberKernel>;
+
+class ConstantKernel : public vegaPredicateKernel {
+public:
+    explicit ConstantKernel(bool value) : value(value) {}
+    void eval(size_t, size_t count, uint64_t* words) const override {
+        size_t word_count = words_for(count);
+        std::fill(words, words + word_count, value ? ~uint64_t{0} : 0);
+        if (value) words[word_count - 1] &= tail_mask(count);
+    }
+
+private:
+    bool value;
+};
+
+// precomputed rows, e.g. from the kernels of an encoded column
+class BitmapKernel : public vegaPredicateKernel {
+public:
+    explicit BitmapKernel(vegaBitmap rows) : rows(std::move(rows)) {}
+    void eval(size_t begin, size_t count, uint64_t* words) const override {
+        std::copy_n(rows.words.data() + begin / 64, words_for(count), words);
+    }
+
+private:
+    vegaBitmap rows;
+};
+
+class IsNullKernel : public vegaPredicateKernel {
+public:
+    IsNullKernel(const vegaBitmap& validity, bool negated) : validity(validity), negated(negated) {}
+    void eval(size_t begin, size_t count, uint64_t* words) const override {
+        const uint64_t* valid = validity.words.data() + begin / 64;
+        size_t word_count = words_for(count);
+        for (size_t w = 0; w < word_count; ++w) words[w] = negated ? valid[w] : ~valid[w];
+        words[word_count - 1] &= tail_mask(count);
+    }
+
+private:
+    const vegaBitmap& validity;
+    bool negated;
+};
+
+// "expression is [not] null"
+class IsNullExprKernel : public vegaPredicateKernel {
+public:
+    IsNullExprKernel(NumberPtr operand, bool negated) : operand(std::move(operand)), negated(negated) {}
+    void eval(size_t begin, size_t count, uint64_t* words) const override {
+        std::vector<double> values(count);
+        operand->eval(begin, count, values.data(), words);
+        size_t word_count = words_for(count);
+        if (!negated) {
+            for (size_t w = 0; w < word_count; ++w) words[w] = ~words[w];
+            words[word_count - 1] &= tail_mask(count);
+        }
+    }
+
+private:
+    NumberPtr operand;
+    bool negated;
+};
+
+class NotKernel : public vegaPredicateKernel {
+public:
+    explicit NotKernel(PredicatePtr operand) : operand(std::move(operand)) {}
+    void eval(size_t begin, size_t count, uint64_t* words) const override {
+        operand->eval(begin, count, words);
+        size_t word_count = words_for(count);
+        for (size_t w = 0; w < word_count; ++w) words[w] = ~words[w];
+        words[word_count - 1] &= tail_mask(count);
+    }
+
+private:
+    PredicatePtr operand;
+};
+
+// and/or; the right side is skipped when the left one already decides the whole block
+class LogicalKernel : public vegaPredicateKernel {
+public:
+    LogicalKernel(bool is_and, PredicatePtr left, PredicatePtr right)
+        : is_and(is_and), left(std::move(left)), right(std::move(right)) {}
+    void eval(size_t begin, size_t count, uint64_t* words) const override {
+        left->eval(begin, count, words);
+        size_t word_count = words_for(count);
+        bool decided = true;
+        for (size_t w = 0; w < word_count && decided; ++w) {
+            uint64_t full = w + 1 == word_count ? tail_mask(count) : ~uint64_t{0};
+            decided = is_and ? words[w] == 0 : words[w] == full;
+        }
+        if (decided) return;
+
+        std::array<uint64_t, QUERY_BLOCK_WORDS> other{};
+        right->eval(begin, count, other.data());
+        for (size_t w = 0; w < word_count; ++w) words[w] = is_and ? words[w] & other[w] : words[w] | other[w];
+    }
+
+private:
+    bool is_and;
+    PredicatePtr left;
+    PredicatePtr right;
+};
+
+// "column op scalar" on the int_data or float_data of a column
+template <typename T, typename S>
+class ScalarCompareKernel : public vegaPredicateKernel {
+public:
+    ScalarCompareKernel(const std::vector<T>& values, const vegaBitmap& validity, CompareOp op, S scalar)
+        : values(values), validity(validity), op(op), scalar(scalar) {}
+    void eval(size_t begin, size_t count, uint64_t* words) const override {
+        const T* data = values.data() + begin;
+        S value = scalar;
+        if constexpr (std::is_same_v<T, S>) {
+            if constexpr (std::is_same_v<T, int64_t>) compare_int64(op, data, value, count, words);
+            else compare_double(op, data, value, count, words);
+        } else {
+            with_compare_op(op, [&](auto compare) {
+                pack_bits(count, words, [&](size_t i) { return compare(static_cast<S>(data[i]), value); });
+            });
+        }
+        and_validity(validity, begin, count, words);
+    }
+
+private:
+    const std::vector<T>& values;
+    const vegaBitmap& validity;
+    CompareOp op;
+    S scalar;
+};
+
+// "column op column" on the int_data of two INT/DATETIME columns
+class IntColumnsCompareKernel : public vegaPredicateKernel {
+public:
+    IntColumnsCompareKernel(const vegaColumn& left, const vegaColumn& right, CompareOp op)
+        : left(left), right(right), op(op) {}
+    void eval(size_t begin, size_t count, uint64_t* words) const override {
+        const int64_t* a = left.int_data.data() + begin;
+        const int64_t* b = right.int_data.data() + begin;
+        compare_int64(op, a, b, count, words);
+        and_validity(left.validity, begin, count, words);
+        and_validity(right.validity, begin, count, words);
+    }
+
+private:
+    const vegaColumn& left;
+    const vegaColumn& right;
+    CompareOp op;
+};
+
+// "text column op string"; text column against text column when right is set
+class TextCompareKernel : public vegaPredicateKernel {
+public:
+    TextCompareKernel(const vegaColumn& left, const vegaColumn* right, CompareOp op, std::string value)
+        : left(left), right(right), op(op), value(std::move(value)) {}
+    void eval(size_t begin, size_t count, uint64_t* words) const override {
+        with_compare_op(op, [&](auto compare) {
+            pack_bits(count, words, [&](size_t i) {
+                size_t row = begin + i;
+                if (left.is_null(row) || (right && right->is_null(row))) return false;
+                return compare(left.string_at(row).compare(right ? right->string_at(row) : value), 0);
+            });
+        });
+    }
+
+private:
+    const vegaColumn& left;
+    const vegaColumn* right;
+    CompareOp op;
+    std::string value;
+};
+
+// CATEGORY column against a per-code verdict
+class CategoryKernel : public vegaPredicateKernel {
+public:
+    CategoryKernel(const vegaColumn& column, std::vector<char> hits) : column(column), hits(std::move(hits)) {}
+    void eval(size_t begin, size_t count, uint64_t* words) const override {
+        const int64_t* codes = column.int_data.data() + begin;
+        // null slots hold code 0, which is always in range when the column has a category
+        if (hits.empty()) {
+            std::fill(words, words + words_for(count), 0);
+            return;
+        }
+        pack_bits(count, words, [&](size_t i) { return hits[static_cast<size_t>(codes[i])] != 0; });
+        and_validity(column.validity, begin, count, words);
+    }
+
+private:
+    const vegaColumn& column;
+    std::vector<char> hits;
+};
+
+// "column [not] in (...)" against a sorted list of values
+template <typename T>
+class InKernel : public vegaPredicateKernel {
+public:
+    InKernel(const std::vector<T>& values, const vegaBitmap& validity, std::vector<T> list, bool negated)
+        : values(values), validity(validity), list(std::move(list)), negated(negated) {
+        std::sort(this->list.begin(), this->list.end());
+    }
+    void eval(size_t begin, size_t count, uint64_t* words) const override {
+        const T* data = values.data() + begin;
+        pack_bits(count, words, [&](size_t i) { return std::binary_search(list.begin(), list.end(), data[i]) != negated; });
+        and_validity(validity, begin, count, words);
+    }
+
+private:
+    const std::vector<T>& values;
+    const vegaBitmap& validity;
+    std::vector<T> list;
+    bool negated;
+};
+
+class TextInKernel : public vegaPredicateKernel {
+public:
+    TextInKernel(const vegaColumn& column, std::vector<std::string> list, bool negated)
+        : column(column), list(std::move(list)), negated(negated), lookup(this->list.begin(), this->list.end()) {}
+    void eval(size_t begin, size_t count, uint64_t* words) const override {
+        pack_bits(count, words, [&](size_t i) {
+            size_t row = begin + i;
+            return !column.is_null(row) && lookup.contains(column.string_at(row)) != negated;
+        });
+    }
+
+private:
+    const vegaColumn& column;
+    std::vector<std::string> list;
+    bool negated;
+    std::unordered_set<std::string_view> lookup;
+};
+
+// "expression op expression" on doubles
+class NumberCompareKernel : public vegaPredicateKernel {
+public:
+    NumberCompareKernel(NumberPtr left, NumberPtr right, CompareOp op)
+        : left(std::move(left)), right(std::move(right)), op(op) {}
+    void eval(size_t begin, size_t count, uint64_t* words) const override {
+        std::vector<double> a(count);
+        std::vector<double> b(count);
+        std::array<uint64_t, QUERY_BLOCK_WORDS> valid{};
+        left->eval(begin, count, a.data(), words);
+        right->eval(begin, count, b.data(), valid.data());
+        for (size_t w = 0; w < words_for(count); ++w) valid[w] &= words[w];
+        compare_double(op, a.data(), b.data(), count, words);
+        for (size_t w = 0; w < words_for(count); ++w) words[w] &= valid[w];
+    }
+
+private:
+    NumberPtr left;
+    NumberPtr right;
+    CompareOp op;
+};
+
+// "expression [not] in (...)" on doubles
+class NumberInKernel : public vegaPredicateKernel {
+public:
+    NumberInKernel(NumberPtr operand, std::vector<double> list, bool negated)
+        : operand(std::move(operand)), list(std::move(list)), negated(negated) {
+        std::sort(this->list.begin(), this->list.end());
+    }
+    void eval(size_t begin, size_t count, uint64_t* words) const override {
+        std::vector<double> values(count);
+        std::array<uint64_t, QUERY_BLOCK_WORDS> valid{};
+        operand->eval(begin, count, values.data(), valid.data());
+        pack_bits(count, words, [&](size_t i) {
+            return std::binary_search(list.begin(), list.end(), values[i]) != negated;
+        });
+        for (size_t w = 0; w < words_for(count); ++w) words[w] &= valid[w];
+    }
+
+private:
+    NumberPtr operand;
+    std::vector<double> list;
+    bool negated;
+};
+
+class ColumnNumberKernel : public NumberKernel {
+public:
+    explicit ColumnNumberKernel(const vegaColumn& column) : column(column) {}
+    void eval(size_t begin, size_t count, double* values, uint64_t* valid) const override {
+        if (column.type == DataType::FLOAT) {
+            std::copy_n(column.float_data.data() + begin, count, values);
+        } else {
+            const int64_t* data = column.int_data.data() + begin;
+            for (size_t i = 0; i < count; ++i) values[i] = static_cast<double>(data[i]);
+        }
+        std::copy_n(column.validity.words.data() + begin / 64, words_for(count), valid);
+    }
+
+private:
+    const vegaColumn& column;
+};
+
+class ConstantNumberKernel : public NumberKernel {
+public:
+    explicit ConstantNumberKernel(double value) : value(value) {}
+    void eval(size_t, size_t count, double* values, uint64_t* valid) const override {
+        std::fill(values, values + count, value);
+        size_t word_count = words_for(count);
+        std::fill(valid, valid + word_count, ~uint64_t{0});
+        valid[word_count - 1] &= tail_mask(count);
+    }
+
+private:
+    double value;
+};
+
+class NegateKernel : public NumberKernel {
+public:
+    explicit NegateKernel(NumberPtr operand) : operand(std::move(operand)) {}
+    void eval(size_t begin, size_t count, double* values, uint64_t* valid) const override {
+        operand->eval(begin, count, values, valid);
+        for (size_t i = 0; i < count; ++i) values[i] = -values[i];
+    }
+
+private:
+    NumberPtr operand;
+};
+
+class ArithmeticKernel : public NumberKernel {
+public:
+    ArithmeticKernel(char op, NumberPtr left, NumberPtr right)
+        : op(op), left(std::move(left)), right(std::move(right)) {}
+    void eval(size_t begin, size_t count, double* values, uint64_t* valid) const override {
+        std::vector<double> other(count);
+        std::array<uint64_t, QUERY_BLOCK_WORDS> other_valid{};
+        left->eval(begin, count, values, valid);
+        right->eval(begin, count, other.data(), other_valid.data());
+        for (size_t w = 0; w < words_for(count); ++w) valid[w] &= other_valid[w];
+        switch (op) {
+            case '+': for (size_t i = 0; i < count; ++i) values[i] += other[i]; break;
+            case '-': for (size_t i = 0; i < count; ++i) values[i] -= other[i]; break;
+            case '*': for (size_t i = 0; i < count; ++i) values[i] *= other[i]; break;
+            case '/': for (size_t i = 0; i < count; ++i) values[i] /= other[i]; break;
+            default: for (size_t i = 0; i < count; ++i) values[i] = std::fmod(values[i], other[i]); break;
+        }
+    }
+
+private:
+    char op;
+    NumberPtr left;
+    NumberPtr right;
+};
+
+// ============= COMPILATION =============
+
+class QueryCompiler {
+public:
+    QueryCompiler(const std::vector<std::string>& names, const vegaColumnStore& columns)
+        : names(names), columns(columns) {}
+
+    PredicatePtr predicate(const vegaExprNode& node) const {
+        using Kind = vegaExprNode::Kind;
+        switch (node.kind) {
+            case Kind::AND:
+            case Kind::OR:
+                return std::make_unique<LogicalKernel>(node.kind == Kind::AND, predicate(*node.children[0]),
+                                                       predicate(*node.children[1]));
+            case Kind::NOT: return std::make_unique<NotKernel>(predicate(*node.children[0]));
+            case Kind::IS_NULL: return is_null(node);
+            case Kind::IN: return in(node);
+            default: return compare(node);
+        }
+    }
+
+private:
+    const std::vector<std::string>& names;
+    const vegaColumnStore& columns;
+
+    size_t column_index(const std::string& name) const {
+        auto it = std::find(names.begin(), names.end(), name);
+        if (it == names.end()) throw std::runtime_error("Column not found: " + name);
+        return static_cast<size_t>(it - names.begin());
+    }
+
+    static bool is_literal(const vegaExprNode& node) {
+        return node.kind == vegaExprNode::Kind::NUMBER || node.kind == vegaExprNode::Kind::STRING;
+    }
+
+    // an integral number that fits int64
+    static bool exact_int(double number, int64_t& value) {
+        if (std::trunc(number) != number || number < -9.2e18 || number > 9.2e18) return false;
+        value = static_cast<int64_t>(number);
+        return true;
+    }
+
+    NumberPtr number(const vegaExprNode& node) const {
+        using Kind = vegaExprNode::Kind;
+        switch (node.kind) {
+            case Kind::NUMBER: return std::make_unique<ConstantNumberKernel>(node.number);
+            case Kind::NEGATE: return std::make_unique<NegateKernel>(number(*node.children[0]));
+            case Kind::ARITHMETIC:
+                return std::make_unique<ArithmeticKernel>(node.arithmetic, number(*node.children[0]),
+                                                          number(*node.children[1]));
+            case Kind::COLUMN: {
+                const vegaColumn& column = columns[column_index(node.text)];
+                if (!is_numeric_type(column.type) && column.type != DataType::DATETIME)
+                    throw std::runtime_error("Column '" + node.text + "' is not numeric");
+                return std::make_unique<ColumnNumberKernel>(column);
+            }
+            default: throw std::runtime_error("Cannot use '" + node.text + "' as a number");
+        }
+    }
+
+    PredicatePtr is_null(const vegaExprNode& node) const {
+        const vegaExprNode& operand = *node.children[0];
+        if (operand.kind == vegaExprNode::Kind::COLUMN) {
+            return std::make_unique<IsNullKernel>(columns.validity(column_index(operand.text)), node.negated);
+        }
+        if (operand.kind == vegaExprNode::Kind::STRING) return std::make_unique<ConstantKernel>(node.negated);
+        return std::make_unique<IsNullExprKernel>(number(operand), node.negated);
+    }
+
+    // rows of an encoded column matching "cell op value" for each value, or-ed together
+    vegaBitmap encoded_matches(const vegaEncodedColumn& encoded, CompareOp op,
+                               const std::vector<std::string>& values) const {
+        vegaBitmap rows(encoded.size());
+        for (const std::string& value : values) {
+            for (size_t row : encoded.matching_rows(op, value)) rows.set(row);
+        }
+        return rows;
+    }
+
+    PredicatePtr compare(const vegaExprNode& node) const {
+        const vegaExprNode* left = node.children[0].get();
+        const vegaExprNode* right = node.children[1].get();
+        CompareOp op = node.op;
+        if (is_literal(*left) && right->kind == vegaExprNode::Kind::COLUMN) {
+            std::swap(left, right);
+            op = mirrored(op);
+        }
+
+        if (left->kind == vegaExprNode::Kind::COLUMN && is_literal(*right)) {
+            return column_compare(column_index(left->text), op, *right);
+        }
+        if (left->kind == vegaExprNode::Kind::COLUMN && right->kind == vegaExprNode::Kind::COLUMN) {
+            const vegaColumn& a = columns[column_index(left->text)];
+            const vegaColumn& b = columns[column_index(right->text)];
+            if (a.is_text() && b.is_text()) return std::make_unique<TextCompareKernel>(a, &b, op, std::string());
+            if (a.is_text() || b.is_text())
+                throw std::runtime_error("Cannot compare text column with numeric column: " + left->text + ", " + right->text);
+            if (a.type != DataType::FLOAT && b.type != DataType::FLOAT)
+                return std::make_unique<IntColumnsCompareKernel>(a, b, op);
+        }
+        if (left->kind == vegaExprNode::Kind::STRING && right->kind == vegaExprNode::Kind::STRING) {
+            return std::make_unique<ConstantKernel>(compare_result(op, left->text.compare(right->text)));
+        }
+        return std::make_unique<NumberCompareKernel>(number(*left), number(*right), op);
+    }
+
+    PredicatePtr column_compare(size_t col_idx, CompareOp op, const vegaExprNode& literal) const {
+        const std::string& text = literal.text;
+        bool is_string = literal.kind == vegaExprNode::Kind::STRING;
+
+        // a numeric or datetime column rejects strings that are not its values whether it is
+        // encoded or not
+        DataType type = columns.type(col_idx);
+        int64_t int_value;
+        double value = literal.number;
+        if (type == DataType::DATETIME && is_string && !parse_datetime(text, int_value))
+            throw std::runtime_error("Cannot convert value '" + text + "' to datetime");
+        if (is_numeric_type(type) && is_string && !parse_double(text, value))
+            throw std::runtime_error("Cannot compare numeric column '" + names[col_idx] + "' with '" + text + "'");
+
+        // encoded columns are scanned without decoding
+        if (const vegaEncodedColumn* encoded = columns.encoded(col_idx); encoded && !text.empty()) {
+            return std::make_unique<BitmapKernel>(encoded_matches(*encoded, op, {text}));
+        }
+
+        const vegaColumn& column = columns[col_idx];
+        if (column.type == DataType::CATEGORY) {
+            std::vector<char> hits(column.category_count());
+            for (size_t code = 0; code < hits.size(); ++code) {
+                hits[code] = compare_result(op, column.category(static_cast<int64_t>(code)).compare(text));
+            }
+            return std::make_unique<CategoryKernel>(column, std::move(hits));
+        }
+        if (column.type == DataType::STRING) return std::make_unique<TextCompareKernel>(column, nullptr, op, text);
+
+        // numeric and datetime columns take numbers, and strings that parse as their values
+        if (column.type == DataType::DATETIME && is_string) {
+            return std::make_unique<ScalarCompareKernel<int64_t, int64_t>>(column.int_data, column.validity, op, int_value);
+        }
+        if (column.type == DataType::FLOAT) {
+            return std::make_unique<ScalarCompareKernel<double, double>>(column.float_data, column.validity, op, value);
+        }
+        if (exact_int(value, int_value)) {
+            return std::make_unique<ScalarCompareKernel<int64_t, int64_t>>(column.int_data, column.validity, op, int_value);
+        }
+        return std::make_unique<ScalarCompareKernel<int64_t, double>>(column.int_data, column.validity, op, value);
+    }
+
+    PredicatePtr in(const vegaExprNode& node) const {
+        const vegaExprNode& operand = *node.children[0];
+        std::vector<const vegaExprNode*> literals;
+        for (size_t i = 1; i < node.children.size(); ++i) literals.push_back(node.children[i].get());
+
+        if (operand.kind != vegaExprNode::Kind::COLUMN) {
+            std::vector<double> list;
+            for (const vegaExprNode* literal : literals) {
+                if (literal->kind != vegaExprNode::Kind::NUMBER)
+                    throw std::runtime_error("Cannot use '" + literal->text + "' as a number");
+                list.push_back(literal->number);
+            }
+            return std::make_unique<NumberInKernel>(number(operand), std::move(list), node.negated);
+        }
+
+        size_t col_idx = column_index(operand.text);
+        std::vector<std::string> texts;
+        for (const vegaExprNode* literal : literals) texts.push_back(literal->text);
+
+        if (const vegaEncodedColumn* encoded = columns.encoded(col_idx)) {
+            std::erase(texts, std::string());
+            vegaBitmap rows = encoded_matches(*encoded, CompareOp::EQ, texts);
+            if (node.negated) rows = encoded->validity() & ~rows;
+            return std::make_unique<BitmapKernel>(std::move(rows));
+        }
+
+        const vegaColumn& column = columns[col_idx];
+        if (column.type == DataType::CATEGORY) {
+            std::vector<char> hits(column.category_count(), node.negated);
+            for (const std::string& text : texts) {
+                int64_t code = column.find_category(text);
+                if (code >= 0) hits[static_cast<size_t>(code)] = !node.negated;
+            }
+            return std::make_unique<CategoryKernel>(column, std::move(hits));
+        }
+        if (column.type == DataType::STRING) return std::make_unique<TextInKernel>(column, std::move(texts), node.negated);
+
+        // list entries that cannot equal a cell of the column are dropped
+        if (column.type == DataType::FLOAT) {
+            std::vector<double> list;
+            for (const vegaExprNode* literal : literals) {
+                double value = literal->number;
+                if (literal->kind == vegaExprNode::Kind::NUMBER || parse_double(literal->text, value)) list.push_back(value);
+            }
+            return std::make_unique<InKernel<double>>(column.float_data, column.validity, std::move(list), node.negated);
+        }
+        std::vector<int64_t> list;
+        for (const vegaExprNode* literal : literals) {
+            int64_t value;
+            bool is_string = literal->kind == vegaExprNode::Kind::STRING;
+            bool valid = !is_string                             ? exact_int(literal->number, value)
+                         : column.type == DataType::DATETIME ? parse_datetime(literal->text, value)
+                                                             : parse_int64(literal->text, value);
+            if (valid) list.push_back(value);
+        }
+        return std::make_unique<InKernel<int64_t>>(column.int_data, column.validity, std::move(list), node.negated);
+    }
+};
+
+} // namespace
+
+// ============= QUERY =============
+
+vegaQuery::vegaQuery(std::string_view expression, const std::vector<std::string>& names,
+                     const vegaColumnStore& columns)
+    : rows(columns.rows()) {
+    std::unique_ptr<vegaExprNode> ast = parse_expression(expression);
+    root = QueryCompiler(names, columns).predicate(*ast);
+}
+
+vegaQuery::vegaQuery(const std::vector<const vegaExprNode*>& conjuncts, const std::vector<std::string>& names,
+                     const vegaColumnStore& columns)
+    : rows(columns.rows()) {
+    QueryCompiler compiler(names, columns);
+    for (const vegaExprNode* conjunct : conjuncts) {
+        PredicatePtr kernel = compiler.predicate(*conjunct);
+        root = root ? std::make_unique<LogicalKernel>(true, std::move(root), std::move(kernel)) : std::move(kernel);
+    }
+    if (!root) root = std::make_unique<ConstantKernel>(true);
+}
+
+vegaQuery::~vegaQuery() = default;
+vegaQuery::vegaQuery(vegaQuery&&) noexcept = default;
+vegaQuery& vegaQuery::operator=(vegaQuery&&) noexcept = default;
+
+vegaBitmap vegaQuery::evaluate(size_t num_threads) const {
+    vegaBitmap mask(rows);
+    if (num_threads == 0) num_threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+    // blocks start on word boundaries, so every task writes its own words of the mask
+    size_t tasks = (rows + QUERY_TASK_ROWS - 1) / QUERY_TASK_ROWS;
+    parallel_for(tasks, num_threads, [&](size_t task) {
+        size_t end = std::min(rows, (task + 1) * QUERY_TASK_ROWS);
+        for (size_t begin = task * QUERY_TASK_ROWS; begin < end; begin += QUERY_BLOCK_ROWS) {
+            root->eval(begin, std::min(QUERY_BLOCK_ROWS, end - begin), mask.words.data() + begin / 64);
+        }
+    });
+    return mask;
+}
@@ -0,0 +1,80 @@
+#ifndef VEGA_VEGAEXPR_H
+#define VEGA_VEGAEXPR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "vegaBitmap.h"
+#include "vegaColumn.h"
+
+class vegaColumnStore;
+
+// Row predicates for vegaDataframe::query. Grammar, loosest binding first:
+//   expr       := and_expr ("or" and_expr)*
+//   and_expr   := not_expr ("and" not_expr)*
+//   not_expr   := "not" not_expr | comparison
+//   comparison := sum [("==" | "!=" | "<" | "<=" | ">" | ">=") sum
+//                      | ["not"] "in" "(" literal ("," literal)* ")"
+//                      | "is" ["not"] "null"]
+//   sum        := product (("+" | "-") product)*
+//   product    := unary (("*" | "/" | "%") unary)*
+//   unary      := "-" unary | "(" expr ")" | column | number | string
+// Columns are bare names or `quoted with backticks`, strings use single or double quotes and
+// keywords are case-insensitive ("&&", "||" and "!" also work). A comparison involving a null
+// cell is false. Strings compare with text columns, and with DATETIME columns as timestamps;
+// arithmetic runs on doubles.
+struct vegaExprNode {
+    enum class Kind { COLUMN, NUMBER, STRING, NEGATE, ARITHMETIC, COMPARE, IN, IS_NULL, NOT, AND, OR };
+
+    Kind kind = Kind::NUMBER;
+    // column name or string literal; for NUMBER the literal as written
+    std::string text;
+    double number = 0;
+    CompareOp op = CompareOp::EQ;
+    // '+', '-', '*', '/' or '%' for ARITHMETIC
+    char arithmetic = 0;
+    // "not in" / "is not null"
+    bool negated = false;
+    // operands; the literals of IN follow the tested value
+    std::vector<std::unique_ptr<vegaExprNode>> children;
+
+    [[nodiscard]] bool is_predicate() const;
+    // the expression as query text, with binary operations in parentheses
+    [[nodiscard]] std::string to_string() const;
+};
+
+// parses text into an AST; syntax errors throw
+std::unique_ptr<vegaExprNode> parse_expression(std::string_view text);
+// the operands of the top-level "and"s of node from left to right (node itself when it is no "and")
+std::vector<std::unique_ptr<vegaExprNode>> split_conjuncts(std::unique_ptr<vegaExprNode> node);
+// names of the columns node refers to, in order of first appearance
+std::vector<std::string> referenced_columns(const vegaExprNode& node);
+
+// kernel of one compiled predicate node, see vegaExpr.cpp
+class vegaPredicateKernel;
+
+// An expression compiled against the columns of a frame into a tree of typed kernels. The
+// kernels scan the columns in blocks of rows and produce selection masks 64 rows per word;
+// blocks are evaluated in parallel. The columns must outlive the query.
+class vegaQuery {
+public:
+    vegaQuery(std::string_view expression, const std::vector<std::string>& names, const vegaColumnStore& columns);
+    // the rows satisfying every one of the conjuncts
+    vegaQuery(const std::vector<const vegaExprNode*>& conjuncts, const std::vector<std::string>& names,
+              const vegaColumnStore& columns);
+    ~vegaQuery();
+    vegaQuery(vegaQuery&&) noexcept;
+    vegaQuery& operator=(vegaQuery&&) noexcept;
+
+    // the rows satisfying the expression (num_threads = 0 uses every hardware thread)
+    [[nodiscard]] vegaBitmap evaluate(size_t num_threads = 0) const;
+
+private:
+    std::unique_ptr<vegaPredicateKernel> root;
+    size_t rows = 0;
+};
+
+#endif // VEGA_VEGAEXPR_H
@@ -0,0 +1,536 @@
+#include "vegaFormat.h"
+#include "vegaDataframe.h"
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+// ============= COLUMN STATISTICS =============
+
+vegaColumnStats vegaColumnStats::compute(const vegaColumn& column, size_t begin, size_t end) {
+    vegaColumnStats stats;
+    bool exact = column.type == DataType::INT || column.type == DataType::DATETIME;
+    for (size_t row = begin; row < end; ++row) {
+        if (column.is_null(row)) {
+            ++stats.null_count;
+            continue;
+        }
+        if (exact) {
+            int64_t value = column.int_data[row];
+            if (!stats.has_int_range) {
+                stats.int_min = stats.int_max = value;
+                stats.has_int_range = true;
+            } else {
+                stats.int_min = std::min(stats.int_min, value);
+                stats.int_max = std::max(stats.int_max, value);
+            }
+        }
+        if (!column.is_numeric()) continue;
+
+        double value = column.numeric_at(row);
+        if (std::isnan(value)) continue;
+        if (!stats.has_range) {
+            stats.min = stats.max = value;
+            stats.has_range = true;
+        } else {
+            stats.min = std::min(stats.min, value);
+            stats.max = std::max(stats.max, value);
+        }
+    }
+    return stats;
+}
+
+// ============= FILE LAYOUT =============
+
+static constexpr char VEGA_MAGIC[8] = {'V', 'E', 'G', 'A', 'D', 'F', '0', '1'};
+// version 1 files have no encodings
+static constexpr uint32_t VEGA_VERSION = 2;
+static constexpr uint64_t VEGA_ALIGNMENT = 64;
+
+static uint64_t align_up(uint64_t offset) {
+    return (offset + VEGA_ALIGNMENT - 1) / VEGA_ALIGNMENT * VEGA_ALIGNMENT;
+}
+
+template <typename T>
+static void put(std::string& out, T value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+static void check_byte_order() {
+    if constexpr (std::endian::native != std::endian::little) {
+        throw std::runtime_error(".vega files are only supported on little-endian hosts");
+    }
+}
+
+// ============= ZONE MAPS =============
+
+vegaZoneMap::vegaZoneMap(const vegaZoneMap& other) {
+    *this = other;
+}
+
+vegaZoneMap::vegaZoneMap(vegaZoneMap&& other) noexcept {
+    *this = std::move(other);
+}
+
+vegaZoneMap& vegaZoneMap::operator=(const vegaZoneMap& other) {
+    if (this == &other) return *this;
+    // the source may be built by a const reader of its frame meanwhile
+    std::lock_guard<std::mutex> lock(other.update_mutex);
+    rows_per_group = other.rows_per_group;
+    covered_rows = other.covered_rows;
+    types = other.types;
+    versions = other.versions;
+    groups = other.groups;
+    return *this;
+}
+
+vegaZoneMap& vegaZoneMap::operator=(vegaZoneMap&& other) noexcept {
+    rows_per_group = other.rows_per_group;
+    covered_rows = other.covered_rows;
+    types = std::move(other.types);
+    versions = std::move(other.versions);
+    groups = std::move(other.groups);
+    other.clear();
+    return *this;
+}
+
+template <typename TypeOf, typename VersionOf, typename WithColumn>
+void vegaZoneMap::update_columns(size_t count, size_t rows, TypeOf type_of, VersionOf version_of,
+                                 WithColumn with_column, size_t num_threads) {
+    std::lock_guard<std::mutex> lock(update_mutex);
+    if (count != groups.size() || rows < covered_rows) clear();
+
+    // a column whose cells may have changed is recomputed from its first group; an up-to-date
+    // map is left untouched, as other threads may be reading it
+    std::vector<char> changed(count, 1);
+    bool current = rows == covered_rows && types.size() == count;
+    for (size_t i = 0; i < types.size(); ++i) {
+        changed[i] = types[i] != type_of(i) || versions[i] != version_of(i);
+        current = current && !changed[i];
+    }
+    if (current) return;
+
+    groups.resize(count);
+    types.resize(count, DataType::STRING);
+    versions.resize(count, 0);
+
+    size_t first_group = covered_rows / rows_per_group;
+    size_t group_total = (rows + rows_per_group - 1) / rows_per_group;
+    if (num_threads == 0) num_threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+    parallel_for(count, num_threads, [&](size_t i) {
+        size_t start = changed[i] ? 0 : first_group;
+        groups[i].resize(group_total);
+        if (start < group_total) {
+            with_column(i, [&](const vegaColumn& column) {
+                for (size_t g = start; g < group_total; ++g) {
+                    groups[i][g] = vegaColumnStats::compute(column, g * rows_per_group,
+                                                            std::min(rows, (g + 1) * rows_per_group));
+                }
+            });
+        }
+        types[i] = type_of(i);
+        versions[i] = version_of(i);
+    });
+    covered_rows = rows;
+}
+
+void vegaZoneMap::update(const vegaColumnStore& columns, size_t num_threads) {
+    update_columns(columns.size(), columns.rows(), [&](size_t i) { return columns.type(i); },
+                   [&](size_t i) { return columns.version(i); },
+                   [&](size_t i, const auto& fn) {
+                       if (const vegaEncodedColumn* encoded = columns.encoded(i)) fn(encoded->decode());
+                       else fn(columns[i]);
+                   }, num_threads);
+}
+
+void vegaZoneMap::update(const std::vector<vegaColumn>& columns, size_t num_threads) {
+    update_columns(columns.size(), columns.empty() ? 0 : columns.front().size(),
+                   [&](size_t i) { return columns[i].type; }, [](size_t) { return uint64_t{0}; },
+                   [&](size_t i, const auto& fn) { fn(columns[i]); }, num_threads);
+}
+
+void vegaZoneMap::carry_over(size_t column, uint64_t old_version, uint64_t new_version) {
+    if (column < versions.size() && versions[column] == old_version) versions[column] = new_version;
+}
+
+void vegaZoneMap::clear() {
+    covered_rows = 0;
+    types.clear();
+    versions.clear();
+    groups.clear();
+}
+
+bool vegaZoneMap::has_values(size_t column, size_t group) const {
+    auto [begin, end] = group_range(group);
+    return groups[column][group].null_count < end - begin;
+}
+
+bool vegaZoneMap::may_match(size_t column, size_t group, CompareOp op, double value) const {
+    if (!has_values(column, group)) return false;
+    if (!is_numeric_type(types[column])) return true;
+
+    const vegaColumnStats& stats = groups[column][group];
+    // only NaN cells
+    if (!stats.has_range) return op == CompareOp::NE;
+    switch (op) {
+        case CompareOp::EQ: return stats.min <= value && value <= stats.max;
+        case CompareOp::NE: return true;
+        case CompareOp::LT: return stats.min < value;
+        case CompareOp::LE: return stats.min <= value;
+        case CompareOp::GT: return stats.max > value;
+        case CompareOp::GE: return stats.max >= value;
+    }
+    return true;
+}
+
+bool vegaZoneMap::may_match(size_t column, size_t group, CompareOp op, int64_t value) const {
+    if (!has_values(column, group)) return false;
+    const vegaColumnStats& stats = groups[column][group];
+    if (!stats.has_int_range) return true;
+    switch (op) {
+        case CompareOp::EQ: return stats.int_min <= value && value <= stats.int_max;
+        case CompareOp::NE: return stats.int_min != value || stats.int_max != value;
+        case CompareOp::LT: return stats.int_min < value;
+        case CompareOp::LE: return stats.int_min <= value;
+        case CompareOp::GT: return stats.int_max > value;
+        case CompareOp::GE: return stats.int_max >= value;
+    }
+    return true;
+}
+
+// version 1 sidecars have no int64 ranges
+static constexpr char ZONE_MAP_MAGIC[8] = {'V', 'E', 'G', 'A', 'Z', 'M', '0', '2'};
+
+void vegaZoneMap::save(const std::string& path, uint64_t source_stamp,
+                       const std::vector<std::string>& features) const {
+    std::string out(ZONE_MAP_MAGIC, sizeof(ZONE_MAP_MAGIC));
+    put<uint64_t>(out, source_stamp);
+    put<uint64_t>(out, rows_per_group);
+    put<uint64_t>(out, covered_rows);
+    put<uint32_t>(out, static_cast<uint32_t>(groups.size()));
+    for (size_t i = 0; i < groups.size(); ++i) {
+        put<uint32_t>(out, static_cast<uint32_t>(features[i].size()));
+        out += features[i];
+        put<uint8_t>(out, static_cast<uint8_t>(types[i]));
+        for (const auto& stats : groups[i]) {
+            put<uint64_t>(out, stats.null_count);
+            put<uint8_t>(out, stats.has_range);
+            put<double>(out, stats.min);
+            put<double>(out, stats.max);
+            put<uint8_t>(out, stats.has_int_range);
+            put<int64_t>(out, stats.int_min);
+            put<int64_t>(out, stats.int_max);
+        }
+    }
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) throw FILE_ERROR("Cannot create output file: " + path);
+    file.write(out.data(), static_cast<std::streamsize>(out.size()));
+    if (!file) throw FILE_ERROR("Cannot write output file: " + path);
+}
+
+bool vegaZoneMap::load(const std::string& path, uint64_t source_stamp, const std::vector<std::string>& features,
+                       const vegaColumnStore& columns) {
+    check_byte_order();
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return false;
+    std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    size_t pos = 0;
+    auto take = [&](void* out, size_t length) {
+        if (pos + length > data.size()) return false;
+        std::memcpy(out, data.data() + pos, length);
+        pos += length;
+        return true;
+    };
+    auto get = [&]<typename T>(T& value) { return take(&value, sizeof(T)); };
+
+    char magic[sizeof(ZONE_MAP_MAGIC)];
+    uint64_t stamp, group_rows, rows;
+    uint32_t column_count;
+    if (!take(magic, sizeof(magic)) || std::memcmp(magic, ZONE_MAP_MAGIC, sizeof(magic)) != 0) return false;
+    if (!get(stamp) || !get(group_rows) || !get(rows) || !get(column_count)) return false;
+    size_t expected_rows = columns.rows();
+    if (stamp != source_stamp || group_rows == 0 || rows != expected_rows || column_count != columns.size()) {
+        return false;
+    }
+
+    vegaZoneMap loaded(group_rows);
+    loaded.covered_rows = rows;
+    loaded.groups.resize(column_count);
+    for (uint32_t i = 0; i < column_count; ++i) {
+        uint32_t name_length;
+        uint8_t type;
+        if (!get(name_length) || name_length > data.size() - pos) return false;
+        std::string name(data.data() + pos, name_length);
+        pos += name_length;
+        if (!get(type) || name != features[i] || type != static_cast<uint8_t>(columns.type(i))) return false;
+        loaded.types.push_back(columns.type(i));
+        loaded.versions.push_back(columns.version(i));
+
+        loaded.groups[i].resize(loaded.group_count());
+        for (auto& stats : loaded.groups[i]) {
+            uint64_t null_count;
+            uint8_t has_range, has_int_range;
+            if (!get(null_count) || !get(has_range) || !get(stats.min) || !get(stats.max) || !get(has_int_range) ||
+                !get(stats.int_min) || !get(stats.int_max)) {
+                return false;
+            }
+            stats.null_count = null_count;
+            stats.has_range = has_range != 0;
+            stats.has_int_range = has_int_range != 0;
+        }
+    }
+    *this = std::move(loaded);
+    return true;
+}
+
+uint64_t vegaZoneMap::file_stamp(const std::string& path) {
+    std::error_code error;
+    auto size = std::filesystem::file_size(path, error);
+    if (error) return 0;
+    auto modified = std::filesystem::last_write_time(path, error);
+    if (error) return 0;
+    auto ticks = static_cast<uint64_t>(modified.time_since_epoch().count());
+    return (static_cast<uint64_t>(size) * 0x9E3779B97F4A7C15ULL) ^ ticks;
+}
+
+// ============= WRITING =============
+
+void write_vega_file(const std::string& path, const std::vector<std::string>& features,
+                     const vegaColumnStore& columns) {
+    check_byte_order();
+    size_t rows = columns.rows();
+
+    // every block as (data, length) in file order: validity, values, offsets, bytes per column;
+    // an encoded column stores its payload as the values block
+    std::vector<std::pair<const char*, uint64_t>> blocks;
+    std::vector<vegaColumnStats> stats(columns.size());
+    std::vector<Encoding> encodings(columns.size(), Encoding::PLAIN);
+    std::vector<std::string> payloads(columns.size());
+    for (size_t i = 0; i < columns.size(); ++i) {
+        const vegaBitmap& validity = columns.validity(i);
+        blocks.emplace_back(reinterpret_cast<const char*>(validity.words.data()),
+                            validity.words.size() * sizeof(uint64_t));
+
+        vegaEncodedColumn fresh;
+        const vegaEncodedColumn* encoded = columns.encoded(i);
+        if (encoded) {
+            stats[i] = vegaColumnStats::compute(encoded->decode());
+        } else {
+            stats[i] = vegaColumnStats::compute(columns[i]);
+            Encoding encoding = vegaEncodedColumn::choose(columns[i]);
+            if (encoding != Encoding::PLAIN) {
+                fresh = vegaEncodedColumn::encode(columns[i], encoding);
+                encoded = &fresh;
+            }
+        }
+        if (encoded) {
+            encodings[i] = encoded->encoding();
+            encoded->write_payload(payloads[i]);
+            blocks.emplace_back(payloads[i].data(), payloads[i].size());
+            blocks.emplace_back(nullptr, 0);
+            blocks.emplace_back(nullptr, 0);
+            continue;
+        }
+
+        // a CATEGORY column stores its codes as the values and its dictionary as the strings
+        const vegaColumn& column = columns[i];
+        if (column.has_int_data()) {
+            blocks.emplace_back(reinterpret_cast<const char*>(column.int_data.data()),
+                                column.int_data.size() * sizeof(int64_t));
+        } else if (column.type == DataType::FLOAT) {
+            blocks.emplace_back(reinterpret_cast<const char*>(column.float_data.data()),
+                                column.float_data.size() * sizeof(double));
+        } else {
+            blocks.emplace_back(nullptr, 0);
+        }
+        if (column.is_text()) {
+            blocks.emplace_back(reinterpret_cast<const char*>(column.string_offsets.data()),
+                                column.string_offsets.size() * sizeof(uint64_t));
+            blocks.emplace_back(column.string_data.data(), column.string_data.size());
+        } else {
+            blocks.emplace_back(nullptr, 0);
+            blocks.emplace_back(nullptr, 0);
+        }
+    }
+
+    // the header size does not depend on the offsets, so lay it out once to measure it
+    auto build_header = [&](const std::vector<uint64_t>& offsets) {
+        std::string header(VEGA_MAGIC, sizeof(VEGA_MAGIC));
+        put<uint32_t>(header, VEGA_VERSION);
+        put<uint32_t>(header, static_cast<uint32_t>(columns.size()));
+        put<uint64_t>(header, rows);
+        for (size_t i = 0; i < columns.size(); ++i) {
+            put<uint32_t>(header, static_cast<uint32_t>(features[i].size()));
+            header += features[i];
+            put<uint8_t>(header, static_cast<uint8_t>(columns.type(i)));
+            put<uint8_t>(header, static_cast<uint8_t>(encodings[i]));
+            put<uint8_t>(header, stats[i].has_range);
+            put<uint64_t>(header, stats[i].null_count);
+            put<double>(header, stats[i].min);
+            put<double>(header, stats[i].max);
+            for (size_t b = i * 4; b < i * 4 + 4; ++b) {
+                put<uint64_t>(header, offsets.empty() ? 0 : offsets[b]);
+                put<uint64_t>(header, blocks[b].second);
+            }
+        }
+        return header;
+    };
+
+    std::vector<uint64_t> offsets;
+    uint64_t offset = align_up(build_header({}).size());
+    for (const auto& block : blocks) {
+        offsets.push_back(offset);
+        offset = align_up(offset + block.second);
+    }
+    std::string header = build_header(offsets);
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) throw FILE_ERROR("Cannot create output file: " + path);
+    file.write(header.data(), static_cast<std::streamsize>(header.size()));
+    uint64_t written = header.size();
+    static constexpr char padding[VEGA_ALIGNMENT] = {};
+    for (size_t b = 0; b < blocks.size(); ++b) {
+        file.write(padding, static_cast<std::streamsize>(offsets[b] - written));
+        file.write(blocks[b].first, static_cast<std::streamsize>(blocks[b].second));
+        written = offsets[b] + blocks[b].second;
+    }
+    if (!file) throw FILE_ERROR("Cannot write output file: " + path);
+}
+
+// ============= READING =============
+
+vegaFileReader::vegaFileReader(const std::string& path) : file(path), file_name(path) {
+    check_byte_order();
+    std::string_view data = file.view();
+    size_t pos = 0;
+    auto take = [&](void* out, size_t length) {
+        if (pos + length > data.size()) throw FILE_ERROR("Truncated .vega file: " + file_name);
+        std::memcpy(out, data.data() + pos, length);
+        pos += length;
+    };
+    auto get = [&]<typename T>(T& value) { take(&value, sizeof(T)); };
+
+    char magic[sizeof(VEGA_MAGIC)];
+    take(magic, sizeof(magic));
+    if (std::memcmp(magic, VEGA_MAGIC, sizeof(magic)) != 0) throw FILE_ERROR("Not a .vega file: " + file_name);
+    uint32_t version;
+    uint32_t column_count;
+    uint64_t rows;
+    get(version);
+    if (version != 1 && version != VEGA_VERSION) throw FILE_ERROR("Unsupported .vega version in " + file_name);
+    get(column_count);
+    get(rows);
+    row_count = rows;
+
+    for (uint32_t i = 0; i < column_count; ++i) {
+        uint32_t name_length;
+        get(name_length);
+        std::string name(name_length, '\0');
+        take(name.data(), name_length);
+        uint8_t type;
+        uint8_t has_range;
+        get(type);
+        if (type > static_cast<uint8_t>(DataType::DATETIME)) throw FILE_ERROR("Unknown column type in " + file_name);
+        uint8_t encoding = 0;
+        if (version > 1) get(encoding);
+        if (encoding > static_cast<uint8_t>(Encoding::DELTA)) throw FILE_ERROR("Unknown column encoding in " + file_name);
+        get(has_range);
+
+        vegaColumnStats stats;
+        uint64_t null_count;
+        get(null_count);
+        stats.null_count = null_count;
+        stats.has_range = has_range != 0;
+        get(stats.min);
+        get(stats.max);
+
+        ColumnBlocks blocks;
+        for (Block* block : {&blocks.validity, &blocks.values, &blocks.offsets, &blocks.bytes}) {
+            get(block->offset);
+            get(block->length);
+        }
+
+        data_features.push_back(std::move(name));
+        column_types.push_back(static_cast<DataType>(type));
+        column_stats.push_back(stats);
+        column_encodings.push_back(static_cast<Encoding>(encoding));
+        column_blocks.push_back(blocks);
+    }
+}
+
+size_t vegaFileReader::find_column(const std::string& name) const {
+    auto found = std::find(data_features.begin(), data_features.end(), name);
+    if (found == data_features.end()) throw std::runtime_error("Column not found: " + name);
+    return static_cast<size_t>(found - data_features.begin());
+}
+
+const char* vegaFileReader::block_data(const Block& block) const {
+    if (block.offset > file.size() || block.length > file.size() - block.offset) {
+        throw FILE_ERROR("Truncated .vega file: " + file_name);
+    }
+    return file.data() + block.offset;
+}
+
+// copies a block into a vector of expected_count elements
+template <typename T>
+static void copy_block(std::vector<T>& out, const char* data, uint64_t length, size_t expected_count,
+                       const std::string& file_name) {
+    if (length != expected_count * sizeof(T)) throw FILE_ERROR("Corrupt column block in " + file_name);
+    out.resize(expected_count);
+    if (length > 0) std::memcpy(out.data(), data, length);
+}
+
+vegaColumn vegaFileReader::column(size_t index) const {
+    if (column_encodings.at(index) != Encoding::PLAIN) return encoded_column(index).decode();
+    const ColumnBlocks& blocks = column_blocks.at(index);
+    vegaColumn column(column_types[index]);
+
+    copy_block(column.validity.words, block_data(blocks.validity), blocks.validity.length, (row_count + 63) / 64,
+               file_name);
+    column.validity.length = row_count;
+    if (column.type == DataType::INT || column.type == DataType::DATETIME) {
+        copy_block(column.int_data, block_data(blocks.values), blocks.values.length, row_count, file_name);
+    } else if (column.type == DataType::FLOAT) {
+        copy_block(column.float_data, block_data(blocks.values), blocks.values.length, row_count, file_name);
+    } else {
+        // STRING has an offset per row, CATEGORY one per category
+        size_t offset_count = row_count + 1;
+        if (column.type == DataType::CATEGORY) {
+            copy_block(column.int_data, block_data(blocks.values), blocks.values.length, row_count, file_name);
+            offset_count = std::max<uint64_t>(blocks.offsets.length / sizeof(uint64_t), 1);
+        }
+        copy_block(column.string_offsets, block_data(blocks.offsets), blocks.offsets.length, offset_count,
+                   file_name);
+        // every string must lie inside the bytes block
+        if (column.string_offsets.front() != 0 || column.string_offsets.back() != blocks.bytes.length ||
+            !std::is_sorted(column.string_offsets.begin(), column.string_offsets.end())) {
+            throw FILE_ERROR("Corrupt column block in " + file_name);
+        }
+        copy_block(column.string_data, block_data(blocks.bytes), blocks.bytes.length, blocks.bytes.length,
+                   file_name);
+    }
+    if (column.type == DataType::CATEGORY) {
+        bool valid = true;
+        for (size_t row = 0; valid && row < row_count; ++row) {
+            valid = column.is_null(row) || static_cast<uint64_t>(column.int_data[row]) < column.category_count();
+        }
+        if (!valid) throw FILE_ERROR("Corrupt column block in " + file_name);
+    }
+    return column;
+}
+
+vegaEncodedColumn vegaFileReader::encoded_column(size_t index) const {
+    if (column_encodings.at(index) == Encoding::PLAIN) return vegaEncodedColumn::encode(column(index), Encoding::PLAIN);
+    const ColumnBlocks& blocks = column_blocks[index];
+    vegaBitmap validity;
+    copy_block(validity.words, block_data(blocks.validity), blocks.validity.length, (row_count + 63) / 64, file_name);
+    validity.length = row_count;
+    try {
+        return vegaEncodedColumn::read_payload({block_data(blocks.values), blocks.values.length},
+                                               column_encodings[index], column_types[index], std::move(validity));
+    } catch (const std::runtime_error&) {
+        throw FILE_ERROR("Corrupt column block in " + file_name);
+    }
+}
@@ -0,0 +1,162 @@
+#ifndef VEGA_VEGAFORMAT_H
+#define VEGA_VEGAFORMAT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "vegaColumn.h"
+#include "vegaCsv.h"
+#include "vegaEncoding.h"
+
+// Summary of the cells of a column (or of a range of its rows)
+struct vegaColumnStats {
+    size_t null_count = 0;
+    // smallest and largest non-null value (NaN ignored) of an INT or FLOAT column; has_range
+    // is false for non-numeric columns and when there is no such value
+    bool has_range = false;
+    double min = 0.0;
+    double max = 0.0;
+    // exact smallest and largest non-null value of an INT or DATETIME column, which doubles round
+    // beyond 2^53; kept by zone maps but not stored in .vega files
+    bool has_int_range = false;
+    int64_t int_min = 0;
+    int64_t int_max = 0;
+
+    // stats of rows [begin, end) of column
+    static vegaColumnStats compute(const vegaColumn& column, size_t begin, size_t end);
+    static vegaColumnStats compute(const vegaColumn& column) { return compute(column, 0, column.size()); }
+};
+
+// ============= ZONE MAPS =============
+// vegaColumnStats of every column per row group of group_rows rows. Scans with a comparison
+// predicate skip the groups whose statistics rule out a match, so selective filters on
+// clustered data (e.g. time-ordered extracts) only touch a few groups.
+class vegaZoneMap {
+public:
+    static constexpr size_t DEFAULT_GROUP_ROWS = size_t{1} << 16;
+
+    explicit vegaZoneMap(size_t group_rows = DEFAULT_GROUP_ROWS) : rows_per_group(group_rows) {}
+    vegaZoneMap(const vegaZoneMap& other);
+    vegaZoneMap(vegaZoneMap&& other) noexcept;
+    vegaZoneMap& operator=(const vegaZoneMap& other);
+    vegaZoneMap& operator=(vegaZoneMap&& other) noexcept;
+
+    [[nodiscard]] size_t group_rows() const { return rows_per_group; }
+    // rows covered by the statistics
+    [[nodiscard]] size_t rows() const { return covered_rows; }
+    [[nodiscard]] size_t group_count() const { return (covered_rows + rows_per_group - 1) / rows_per_group; }
+    [[nodiscard]] std::pair<size_t, size_t> group_range(size_t group) const {
+        return {group * rows_per_group, std::min(covered_rows, (group + 1) * rows_per_group)};
+    }
+    [[nodiscard]] const vegaColumnStats& stats(size_t column, size_t group) const { return groups[column][group]; }
+
+    // Brings the statistics up to date with a column store: a column whose vegaColumnStore::version
+    // or type changed since its statistics were computed is recomputed, and for the others the
+    // last partial group and any new groups are (rows may only have been appended). Fewer rows or
+    // a different column count start over. Encoded columns are decoded one at a time and stay
+    // encoded. Several threads may update the same map for the same columns at once: one
+    // computes the statistics and the others wait for it.
+    void update(const vegaColumnStore& columns, size_t num_threads = 0);
+    // same for plain columns, which have no versions: only appended rows and type changes are seen
+    void update(const std::vector<vegaColumn>& columns, size_t num_threads = 0);
+    // Records that the rows covered so far of a column are unchanged between two of its versions
+    // (rows were only appended, or the column was re-encoded), so update() keeps their statistics.
+    // No effect unless the statistics were computed at old_version.
+    void carry_over(size_t column, uint64_t old_version, uint64_t new_version);
+    void clear();
+
+    // false when no non-null cell c of the group can satisfy "c op value" (numeric columns only;
+    // groups of non-numeric columns always may match unless they are all null)
+    [[nodiscard]] bool may_match(size_t column, size_t group, CompareOp op, double value) const;
+    // same against the exact int64 range of an INT or DATETIME column (a timestamp for DATETIME)
+    [[nodiscard]] bool may_match(size_t column, size_t group, CompareOp op, int64_t value) const;
+    // false when every cell of the group is null
+    [[nodiscard]] bool has_values(size_t column, size_t group) const;
+
+    // Sidecar persistence. source_stamp identifies the version of the source file (see
+    // file_stamp); load fails (returns false) unless stamp, names, types and row count match.
+    void save(const std::string& path, uint64_t source_stamp, const std::vector<std::string>& features) const;
+    bool load(const std::string& path, uint64_t source_stamp, const std::vector<std::string>& features,
+              const vegaColumnStore& columns);
+    // hash of a file's size and modification time, 0 when it cannot be read
+    static uint64_t file_stamp(const std::string& path);
+    // "data.csv" -> "data.csv.zonemap"
+    static std::string sidecar_path(const std::string& path) { return path + ".zonemap"; }
+
+private:
+    // type_of(i) and version_of(i) give the type and version of column i and with_column(i, fn)
+    // calls fn with the column
+    template <typename TypeOf, typename VersionOf, typename WithColumn>
+    void update_columns(size_t count, size_t rows, TypeOf type_of, VersionOf version_of, WithColumn with_column,
+                        size_t num_threads);
+
+    size_t rows_per_group;
+    size_t covered_rows = 0;
+    std::vector<DataType> types;
+    // version of each column when its statistics were computed (0 for plain columns)
+    std::vector<uint64_t> versions;
+    // held by update() and while the map is copied
+    mutable std::mutex update_mutex;
+    // groups[column][group]
+    std::vector<std::vector<vegaColumnStats>> groups;
+};
+
+// ============= .vega FILES =============
+// Binary columnar file of a dataframe. A header holds the schema, row count, per-column
+// vegaColumnStats and encoding and the position of every column block; the blocks follow, each
+// aligned to 64 bytes. Plain columns keep the exact layout of vegaColumn (validity words, int64
+// or double values, string offsets and string bytes), so decoding one is one copy per block;
+// encoded columns (see vegaEncoding.h) store their validity words and encoded payload. Columns
+// already encoded in the store are written as they are, the others get the encoding picked from
+// their statistics. Numbers are stored in the byte order of the host, which must be little-endian.
+void write_vega_file(const std::string& path, const std::vector<std::string>& features,
+                     const vegaColumnStore& columns);
+
+// Opens a .vega file by mapping it and reading only the header, so schema, row count and
+// statistics are available in constant time whatever the file size. Columns are decoded
+// when asked for and only their blocks are paged in.
+class vegaFileReader {
+public:
+    explicit vegaFileReader(const std::string& path);
+
+    [[nodiscard]] size_t rows() const { return row_count; }
+    [[nodiscard]] const std::vector<std::string>& features() const { return data_features; }
+    [[nodiscard]] const std::vector<DataType>& types() const { return column_types; }
+    [[nodiscard]] const vegaColumnStats& stats(size_t index) const { return column_stats[index]; }
+    [[nodiscard]] Encoding encoding(size_t index) const { return column_encodings[index]; }
+    // index of a column by name; unknown names throw
+    [[nodiscard]] size_t find_column(const std::string& name) const;
+    // copies the blocks of one column out of the mapping, decoding an encoded column
+    [[nodiscard]] vegaColumn column(size_t index) const;
+    // the column in its stored encoding (PLAIN columns are copied as above)
+    [[nodiscard]] vegaEncodedColumn encoded_column(size_t index) const;
+
+private:
+    struct Block {
+        uint64_t offset = 0;
+        uint64_t length = 0;
+    };
+    // validity, values, string offsets, string bytes
+    struct ColumnBlocks {
+        Block validity;
+        Block values;
+        Block offsets;
+        Block bytes;
+    };
+
+    // bytes of a block, checked against the file size
+    [[nodiscard]] const char* block_data(const Block& block) const;
+
+    vegaMappedFile file;
+    std::string file_name;
+    size_t row_count = 0;
+    std::vector<std::string> data_features;
+    std::vector<DataType> column_types;
+    std::vector<vegaColumnStats> column_stats;
+    std::vector<Encoding> column_encodings;
+    std::vector<ColumnBlocks> column_blocks;
+};
+
+#endif // VEGA_VEGAFORMAT_H
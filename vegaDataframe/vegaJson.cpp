@@ -0,0 +1,563 @@
+#include "vegaJson.h"
+#include "vegaCsv.h"
+#include <cmath>
+#include <deque>
+#include <stdexcept>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// ============= COLUMNS =============
+
+size_t vegaJsonColumns::column_for(std::string_view key) {
+    auto found = key_index.find(key);
+    if (found != key_index.end()) return found->second;
+
+    size_t column = columns.size();
+    features.emplace_back(key);
+    key_index.emplace(features.back(), column);
+    columns.emplace_back(DataType::INT);
+    columns.back().reserve(row_count);
+    for (size_t row = 0; row < row_count; ++row) columns.back().append_null();
+    return column;
+}
+
+void vegaJsonColumns::finish() {
+    for (auto& column : columns) {
+        while (column.size() < row_count) column.append_null();
+    }
+}
+
+void vegaJsonColumns::append(vegaJsonColumns&& other) {
+    for (size_t i = 0; i < other.columns.size(); ++i) {
+        vegaColumn& part = other.columns[i];
+        vegaColumn& column = columns[column_for(other.features[i])];
+        DataType merged = common_type(column.type, part.type);
+        column.widen(merged);
+        part.widen(merged);
+        column.append_column(part);
+        part = vegaColumn();
+    }
+    row_count += other.row_count;
+    finish();
+}
+
+// ============= JSON SCANNING =============
+
+// text ends inside a record; only leaves parse_json_records when final is set
+struct JsonIncomplete {};
+
+struct JsonCursor {
+    const char* data;
+    size_t size;
+    size_t pos = 0;
+    // offset of data in the whole input, for error messages
+    size_t base = 0;
+};
+
+// one key and value of the record being parsed
+struct JsonCell {
+    enum class Kind { NUL, INT, FLOAT, STRING };
+
+    std::string_view key;
+    Kind kind = Kind::NUL;
+    int64_t int_value = 0;
+    double float_value = 0.0;
+    std::string_view text;
+};
+
+// unescaped strings of the record being parsed; deque elements never move
+struct JsonScratch {
+    std::deque<std::string> strings;
+    size_t used = 0;
+
+    std::string& next() {
+        if (used == strings.size()) strings.emplace_back();
+        return strings[used++];
+    }
+};
+
+[[noreturn]] static void json_error(const JsonCursor& cursor, const std::string& what) {
+    size_t begin = cursor.pos > 20 ? cursor.pos - 20 : 0;
+    std::string near(cursor.data + begin, std::min(cursor.size, cursor.pos + 20) - begin);
+    std::replace(near.begin(), near.end(), '\n', ' ');
+    throw std::runtime_error("Invalid JSON at byte " + std::to_string(cursor.base + cursor.pos) + ": " + what +
+                             " near '" + near + "'");
+}
+
+static char peek(const JsonCursor& cursor) {
+    if (cursor.pos >= cursor.size) throw JsonIncomplete{};
+    return cursor.data[cursor.pos];
+}
+
+static bool is_json_space(char c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+static void skip_whitespace(JsonCursor& cursor) {
+    while (cursor.pos < cursor.size && is_json_space(cursor.data[cursor.pos])) ++cursor.pos;
+}
+
+// offset of the first '"' or '\\' at or after pos, size when there is none
+static size_t find_quote_or_backslash(const char* data, size_t pos, size_t size) {
+#if defined(__AVX2__)
+    const __m256i quotes = _mm256_set1_epi8('"');
+    const __m256i backslashes = _mm256_set1_epi8('\\');
+    for (; pos + 32 <= size; pos += 32) {
+        __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos));
+        __m256i hits = _mm256_or_si256(_mm256_cmpeq_epi8(bytes, quotes), _mm256_cmpeq_epi8(bytes, backslashes));
+        auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(hits));
+        if (mask) return pos + static_cast<size_t>(std::countr_zero(mask));
+    }
+#elif defined(__SSE2__)
+    const __m128i quotes = _mm_set1_epi8('"');
+    const __m128i backslashes = _mm_set1_epi8('\\');
+    for (; pos + 16 <= size; pos += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+        __m128i hits = _mm_or_si128(_mm_cmpeq_epi8(bytes, quotes), _mm_cmpeq_epi8(bytes, backslashes));
+        auto mask = static_cast<uint32_t>(_mm_movemask_epi8(hits));
+        if (mask) return pos + static_cast<size_t>(std::countr_zero(mask));
+    }
+#endif
+    for (; pos < size; ++pos) {
+        if (data[pos] == '"' || data[pos] == '\\') return pos;
+    }
+    return size;
+}
+
+static uint32_t parse_hex4(const JsonCursor& cursor, size_t pos) {
+    if (pos + 4 > cursor.size) throw JsonIncomplete{};
+    uint32_t value = 0;
+    for (size_t i = pos; i < pos + 4; ++i) {
+        char c = cursor.data[i];
+        value <<= 4;
+        if (c >= '0' && c <= '9') value |= static_cast<uint32_t>(c - '0');
+        else if (c >= 'a' && c <= 'f') value |= static_cast<uint32_t>(c - 'a' + 10);
+        else if (c >= 'A' && c <= 'F') value |= static_cast<uint32_t>(c - 'A' + 10);
+        else json_error(cursor, "invalid \\u escape");
+    }
+    return value;
+}
+
+static void append_utf8(std::string& out, uint32_t code) {
+    if (code < 0x80) {
+        out.push_back(static_cast<char>(code));
+    } else if (code < 0x800) {
+        out.push_back(static_cast<char>(0xC0 | (code >> 6)));
+        out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+    } else if (code < 0x10000) {
+        out.push_back(static_cast<char>(0xE0 | (code >> 12)));
+        out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+    } else {
+        out.push_back(static_cast<char>(0xF0 | (code >> 18)));
+        out.push_back(static_cast<char>(0x80 | ((code >> 12) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+    }
+}
+
+// string starting at the cursor's quote; a view into the text unless it has escapes
+static std::string_view parse_string(JsonCursor& cursor, JsonScratch& scratch) {
+    const char* data = cursor.data;
+    size_t start = cursor.pos + 1;
+    size_t pos = find_quote_or_backslash(data, start, cursor.size);
+    if (pos == cursor.size) throw JsonIncomplete{};
+    if (data[pos] == '"') {
+        cursor.pos = pos + 1;
+        return {data + start, pos - start};
+    }
+
+    std::string& out = scratch.next();
+    out.assign(data + start, pos - start);
+    while (true) {
+        if (data[pos] == '"') {
+            cursor.pos = pos + 1;
+            return out;
+        }
+        if (pos + 1 >= cursor.size) throw JsonIncomplete{};
+        char escaped = data[pos + 1];
+        pos += 2;
+        switch (escaped) {
+            case '"': case '\\': case '/': out.push_back(escaped); break;
+            case 'b': out.push_back('\b'); break;
+            case 'f': out.push_back('\f'); break;
+            case 'n': out.push_back('\n'); break;
+            case 'r': out.push_back('\r'); break;
+            case 't': out.push_back('\t'); break;
+            case 'u': {
+                uint32_t code = parse_hex4(cursor, pos);
+                pos += 4;
+                // a high surrogate followed by \u and a low surrogate is one code point
+                if (code >= 0xD800 && code < 0xDC00) {
+                    if (pos + 6 > cursor.size) throw JsonIncomplete{};
+                    if (data[pos] == '\\' && data[pos + 1] == 'u') {
+                        uint32_t low = parse_hex4(cursor, pos + 2);
+                        if (low >= 0xDC00 && low < 0xE000) {
+                            code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                            pos += 6;
+                        }
+                    }
+                }
+                append_utf8(out, code);
+                break;
+            }
+            default:
+                cursor.pos = pos;
+                json_error(cursor, "invalid escape");
+        }
+
+        size_t next = find_quote_or_backslash(data, pos, cursor.size);
+        if (next == cursor.size) throw JsonIncomplete{};
+        out.append(data + pos, next - pos);
+        pos = next;
+    }
+}
+
+// moves past a nested object or array without interpreting it
+static void skip_nested(JsonCursor& cursor) {
+    size_t depth = 0;
+    while (true) {
+        char c = peek(cursor);
+        if (c == '"') {
+            size_t pos = cursor.pos + 1;
+            while (true) {
+                pos = find_quote_or_backslash(cursor.data, pos, cursor.size);
+                if (pos >= cursor.size) throw JsonIncomplete{};
+                if (cursor.data[pos] == '"') break;
+                pos += 2;
+            }
+            cursor.pos = pos + 1;
+            continue;
+        }
+        ++cursor.pos;
+        if (c == '{' || c == '[') {
+            ++depth;
+        } else if (c == '}' || c == ']') {
+            if (--depth == 0) return;
+        }
+    }
+}
+
+static void expect_literal(JsonCursor& cursor, std::string_view literal) {
+    size_t available = std::min(literal.size(), cursor.size - cursor.pos);
+    if (std::string_view(cursor.data + cursor.pos, available) != literal.substr(0, available)) {
+        json_error(cursor, "unexpected character");
+    }
+    if (available < literal.size()) throw JsonIncomplete{};
+    cursor.pos += literal.size();
+}
+
+static void parse_number(JsonCursor& cursor, JsonCell& cell) {
+    size_t start = cursor.pos;
+    bool integral = true;
+    while (cursor.pos < cursor.size) {
+        char c = cursor.data[cursor.pos];
+        if (c == '.' || c == 'e' || c == 'E' || c == '+') {
+            integral = false;
+        } else if (c != '-' && (c < '0' || c > '9')) {
+            break;
+        }
+        ++cursor.pos;
+    }
+    // a record never ends in a number, so the number may continue in the next block
+    if (cursor.pos == cursor.size) throw JsonIncomplete{};
+    if (cursor.pos == start) json_error(cursor, "unexpected character");
+
+    std::string_view number(cursor.data + start, cursor.pos - start);
+    if (integral && parse_int64(number, cell.int_value)) {
+        cell.kind = JsonCell::Kind::INT;
+    } else if (parse_double(number, cell.float_value)) {
+        cell.kind = JsonCell::Kind::FLOAT;
+    } else {
+        json_error(cursor, "invalid number");
+    }
+}
+
+static void parse_value(JsonCursor& cursor, JsonCell& cell, JsonScratch& scratch) {
+    char c = peek(cursor);
+    cell.kind = JsonCell::Kind::STRING;
+    if (c == '"') {
+        cell.text = parse_string(cursor, scratch);
+    } else if (c == '{' || c == '[') {
+        size_t start = cursor.pos;
+        skip_nested(cursor);
+        cell.text = std::string_view(cursor.data + start, cursor.pos - start);
+    } else if (c == 't') {
+        expect_literal(cursor, "true");
+        cell.text = "true";
+    } else if (c == 'f') {
+        expect_literal(cursor, "false");
+        cell.text = "false";
+    } else if (c == 'n') {
+        expect_literal(cursor, "null");
+        cell.kind = JsonCell::Kind::NUL;
+    } else {
+        parse_number(cursor, cell);
+    }
+}
+
+// parses the object at the cursor into cells
+static void parse_record(JsonCursor& cursor, std::vector<JsonCell>& cells, JsonScratch& scratch) {
+    cells.clear();
+    scratch.used = 0;
+    ++cursor.pos;
+    skip_whitespace(cursor);
+    if (peek(cursor) == '}') {
+        ++cursor.pos;
+        return;
+    }
+
+    while (true) {
+        skip_whitespace(cursor);
+        if (peek(cursor) != '"') json_error(cursor, "expected a key");
+        JsonCell cell;
+        cell.key = parse_string(cursor, scratch);
+        skip_whitespace(cursor);
+        if (peek(cursor) != ':') json_error(cursor, "expected ':'");
+        ++cursor.pos;
+        skip_whitespace(cursor);
+        parse_value(cursor, cell, scratch);
+        cells.push_back(cell);
+
+        skip_whitespace(cursor);
+        char c = peek(cursor);
+        ++cursor.pos;
+        if (c == '}') return;
+        if (c != ',') json_error(cursor, "expected ',' or '}'");
+    }
+}
+
+// ============= JSON PARSING =============
+
+size_t parse_json_records(std::string_view text, vegaJsonColumns& out, bool final, size_t offset) {
+    JsonCursor cursor{text.data(), text.size(), 0, offset};
+    std::vector<JsonCell> cells;
+    JsonScratch scratch;
+    // columns of the previous record by position; records usually repeat the key order
+    std::vector<size_t> previous;
+
+    while (true) {
+        while (cursor.pos < cursor.size) {
+            char c = cursor.data[cursor.pos];
+            if (!is_json_space(c) && c != ',' && c != '[' && c != ']') break;
+            ++cursor.pos;
+        }
+        if (cursor.pos == cursor.size) break;
+        if (cursor.data[cursor.pos] != '{') json_error(cursor, "expected an object");
+
+        size_t record_start = cursor.pos;
+        try {
+            parse_record(cursor, cells, scratch);
+        } catch (const JsonIncomplete&) {
+            if (final) json_error(cursor, "unexpected end of input");
+            out.finish();
+            return record_start;
+        }
+
+        previous.resize(cells.size(), vegaColumn::npos);
+        for (size_t k = 0; k < cells.size(); ++k) {
+            const JsonCell& cell = cells[k];
+            size_t index = previous[k];
+            if (index == vegaColumn::npos || out.features[index] != cell.key) {
+                index = out.column_for(cell.key);
+                previous[k] = index;
+            }
+
+            vegaColumn& column = out.columns[index];
+            while (column.size() < out.row_count) column.append_null();
+            // a repeated key keeps its first value
+            if (column.size() > out.row_count) continue;
+
+            switch (cell.kind) {
+                case JsonCell::Kind::NUL: column.append_null(); break;
+                case JsonCell::Kind::INT: column.append_int(cell.int_value); break;
+                case JsonCell::Kind::FLOAT: column.append_float(cell.float_value); break;
+                case JsonCell::Kind::STRING: column.append_string(cell.text); break;
+            }
+        }
+        ++out.row_count;
+    }
+    out.finish();
+    return text.size();
+}
+
+// ============= PARALLEL PARSING =============
+
+// true when the line break at pos follows an object and precedes another one
+static bool is_record_break(std::string_view text, size_t pos) {
+    size_t before = pos;
+    while (before > 0 && is_json_space(text[before - 1])) --before;
+    size_t after = pos;
+    while (after < text.size() && is_json_space(text[after])) ++after;
+    return before > 0 && text[before - 1] == '}' && after < text.size() && text[after] == '{';
+}
+
+static std::vector<size_t> split_json_chunks(std::string_view text, size_t chunk_count) {
+    std::vector<size_t> bounds{0};
+    size_t step = text.size() / chunk_count;
+    for (size_t c = 1; c < chunk_count; ++c) {
+        size_t pos = std::max(c * step, bounds.back());
+        while ((pos = text.find('\n', pos)) != std::string_view::npos && !is_record_break(text, pos)) ++pos;
+        // no later break either (e.g. a pretty-printed array), the rest stays in one piece
+        if (pos == std::string_view::npos) break;
+        bounds.push_back(pos + 1);
+    }
+    bounds.push_back(text.size());
+    return bounds;
+}
+
+vegaJsonColumns parse_json_parallel(std::string_view text, size_t num_threads) {
+    if (num_threads == 0) num_threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+    size_t chunk_count = std::clamp<size_t>(text.size() / MIN_CHUNK_BYTES, 1, num_threads);
+
+    vegaJsonColumns result;
+    if (chunk_count == 1) {
+        parse_json_records(text, result);
+        return result;
+    }
+
+    std::vector<size_t> bounds = split_json_chunks(text, chunk_count);
+    chunk_count = bounds.size() - 1;
+    std::vector<vegaJsonColumns> chunks(chunk_count);
+    parallel_for(chunk_count, num_threads, [&](size_t c) {
+        parse_json_records(text.substr(bounds[c], bounds[c + 1] - bounds[c]), chunks[c], true, bounds[c]);
+    });
+
+    result = std::move(chunks.front());
+    for (size_t c = 1; c < chunk_count; ++c) result.append(std::move(chunks[c]));
+    return result;
+}
+
+// ============= STREAMED PARSING =============
+
+vegaJsonColumns read_json_stream(std::istream& input) {
+    // errors of the underlying buffer (e.g. a corrupt archive) surface as their own exceptions
+    input.exceptions(std::ios::badbit);
+
+    vegaJsonColumns result;
+    std::string pending;
+    // bytes of the input before pending
+    size_t consumed = 0;
+    std::vector<char> block(size_t{1} << 20);
+    bool at_end = false;
+    while (!at_end) {
+        input.read(block.data(), static_cast<std::streamsize>(block.size()));
+        pending.append(block.data(), static_cast<size_t>(input.gcount()));
+        at_end = input.eof();
+        if (pending.size() < MIN_CHUNK_BYTES && !at_end) continue;
+
+        size_t parsed = parse_json_records(pending, result, at_end, consumed);
+        pending.erase(0, parsed);
+        consumed += parsed;
+    }
+    return result;
+}
+
+// ============= JSON WRITING =============
+
+// offset of the first byte at or after pos that needs escaping ('"', '\\' or a control
+// character), size when there is none
+static size_t find_json_escape(const char* data, size_t pos, size_t size) {
+#if defined(__AVX2__)
+    const __m256i quotes = _mm256_set1_epi8('"');
+    const __m256i backslashes = _mm256_set1_epi8('\\');
+    const __m256i last_control = _mm256_set1_epi8(0x1F);
+    for (; pos + 32 <= size; pos += 32) {
+        __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos));
+        __m256i controls = _mm256_cmpeq_epi8(_mm256_max_epu8(bytes, last_control), last_control);
+        __m256i hits = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(bytes, quotes),
+                                                       _mm256_cmpeq_epi8(bytes, backslashes)), controls);
+        auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(hits));
+        if (mask) return pos + static_cast<size_t>(std::countr_zero(mask));
+    }
+#elif defined(__SSE2__)
+    const __m128i quotes = _mm_set1_epi8('"');
+    const __m128i backslashes = _mm_set1_epi8('\\');
+    const __m128i last_control = _mm_set1_epi8(0x1F);
+    for (; pos + 16 <= size; pos += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+        __m128i controls = _mm_cmpeq_epi8(_mm_max_epu8(bytes, last_control), last_control);
+        __m128i hits = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(bytes, quotes), _mm_cmpeq_epi8(bytes, backslashes)),
+                                    controls);
+        auto mask = static_cast<uint32_t>(_mm_movemask_epi8(hits));
+        if (mask) return pos + static_cast<size_t>(std::countr_zero(mask));
+    }
+#endif
+    for (; pos < size; ++pos) {
+        auto c = static_cast<unsigned char>(data[pos]);
+        if (c == '"' || c == '\\' || c < 0x20) return pos;
+    }
+    return size;
+}
+
+void append_json_string(std::string& out, std::string_view text) {
+    static constexpr char hex_digits[] = "0123456789abcdef";
+    out.push_back('"');
+    size_t pos = 0;
+    while (true) {
+        size_t next = find_json_escape(text.data(), pos, text.size());
+        out.append(text.data() + pos, next - pos);
+        if (next == text.size()) break;
+
+        auto c = static_cast<unsigned char>(text[next]);
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\b': out += "\\b"; break;
+            case '\f': out += "\\f"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                out += "\\u00";
+                out.push_back(hex_digits[c >> 4]);
+                out.push_back(hex_digits[c & 0xF]);
+        }
+        pos = next + 1;
+    }
+    out.push_back('"');
+}
+
+void write_json(std::ostream& out, const std::vector<std::string>& features, const std::vector<vegaColumn>& columns,
+                const vegaJsonWriteOptions& options) {
+    // {"name": for the first column, ,"name": for the others
+    std::vector<std::string> prefixes(features.size());
+    for (size_t i = 0; i < features.size(); ++i) {
+        prefixes[i] = i == 0 ? "{" : ",";
+        append_json_string(prefixes[i], features[i]);
+        prefixes[i].push_back(':');
+    }
+
+    if (!options.lines) out.write("[", 1);
+    size_t rows = columns.empty() ? 0 : columns.front().size();
+    write_row_blocks(out, rows, options.num_threads, [&](std::string& buffer, size_t begin, size_t end) {
+        buffer.reserve((end - begin) * (columns.size() * 16 + 4));
+        for (size_t row = begin; row < end; ++row) {
+            if (!options.lines) buffer += row == 0 ? "\n" : ",\n";
+            if (columns.empty()) buffer.push_back('{');
+            for (size_t i = 0; i < columns.size(); ++i) {
+                buffer += prefixes[i];
+                const vegaColumn& column = columns[i];
+                if (column.is_null(row) || (column.type == DataType::FLOAT && !std::isfinite(column.float_at(row)))) {
+                    buffer += "null";
+                } else if (column.is_text()) {
+                    append_json_string(buffer, column.string_at(row));
+                } else if (column.type == DataType::DATETIME) {
+                    buffer.push_back('"');
+                    column.format_to(row, buffer);
+                    buffer.push_back('"');
+                } else {
+                    column.format_to(row, buffer);
+                }
+            }
+            buffer.push_back('}');
+            if (options.lines) buffer.push_back('\n');
+        }
+    });
+    if (!options.lines) out.write(rows == 0 ? "]\n" : "\n]\n", rows == 0 ? 2 : 3);
+    out.flush();
+}
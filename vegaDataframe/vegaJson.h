@@ -0,0 +1,88 @@
+#ifndef VEGA_VEGAJSON_H
+#define VEGA_VEGAJSON_H
+
+#include <cstddef>
+#include <functional>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "vegaColumn.h"
+#include "vegaCompression.h"
+
+// Options of vegaDataframe::read_json
+struct vegaJsonOptions {
+    // input codec, see vegaCompression.h; compressed input is streamed instead of mapped
+    Compression compression = Compression::AUTO;
+    // parser threads for NDJSON, 0 uses every core
+    size_t num_threads = 0;
+};
+
+// Options of vegaDataframe::to_json
+struct vegaJsonWriteOptions {
+    // NDJSON (one object per line) instead of an array of objects
+    bool lines = false;
+    Compression compression = Compression::AUTO;
+    // formatting threads, 0 uses every core
+    size_t num_threads = 0;
+};
+
+// Typed columns built from a sequence of JSON objects, one row per object.
+// Keys become columns in order of first appearance and a record without a key gets a null
+// there. Numbers load as INT (integer literals that fit) or FLOAT, strings as STRING,
+// true/false as the strings "true"/"false", null as null and nested objects or arrays as
+// their JSON text. A column widens INT -> FLOAT -> STRING like a CSV column.
+// A key repeated within one object keeps its first value.
+class vegaJsonColumns {
+public:
+    std::vector<std::string> features;
+    std::vector<vegaColumn> columns;
+
+    [[nodiscard]] size_t rows() const { return row_count; }
+    // column of a key, created (null for every earlier row) when it is new
+    size_t column_for(std::string_view key);
+    // appends the rows of other, matching its columns by name
+    void append(vegaJsonColumns&& other);
+
+private:
+    friend size_t parse_json_records(std::string_view text, vegaJsonColumns& out, bool final, size_t offset);
+    // pads the columns that missed the last rows with nulls
+    void finish();
+
+    struct KeyHash {
+        using is_transparent = void;
+        size_t operator()(std::string_view key) const { return std::hash<std::string_view>{}(key); }
+    };
+    std::unordered_map<std::string, size_t, KeyHash, std::equal_to<>> key_index;
+    size_t row_count = 0;
+};
+
+// ============= JSON PARSING =============
+// Parses the objects of a JSON array ("[{...}, {...}]"), of NDJSON (one object per line) or
+// of objects simply following each other; top-level brackets, commas and whitespace only
+// separate records. Strings are scanned 32 (AVX2) or 16 (SSE2) bytes at a time up to the next
+// quote or backslash. Malformed input throws std::runtime_error with the byte offset, counted
+// from offset (the position of text in the whole input).
+// With final false a record cut off by the end of text is left for the next call.
+// Returns the number of bytes consumed.
+size_t parse_json_records(std::string_view text, vegaJsonColumns& out, bool final = true, size_t offset = 0);
+// Splits text where one line ends an object and the next line starts one (every line break
+// of NDJSON, none inside a pretty-printed array) and parses the pieces on up to num_threads
+// threads (0 uses every core).
+vegaJsonColumns parse_json_parallel(std::string_view text, size_t num_threads = 0);
+// parses a stream block by block, e.g. the output of a vegaDecompressBuffer
+vegaJsonColumns read_json_stream(std::istream& input);
+
+// ============= JSON WRITING =============
+// appends text as a quoted JSON string; runs without characters to escape are found 32 (AVX2)
+// or 16 (SSE2) bytes at a time and copied whole
+void append_json_string(std::string& out, std::string_view text);
+// Writes one compact object per row, as NDJSON or as an array with one object per line.
+// Nulls and non-finite floats are written as null. The "name": prefix of every column is
+// built once and row blocks are formatted in parallel, see write_row_blocks.
+void write_json(std::ostream& out, const std::vector<std::string>& features, const std::vector<vegaColumn>& columns,
+                const vegaJsonWriteOptions& options);
+
+#endif // VEGA_VEGAJSON_H
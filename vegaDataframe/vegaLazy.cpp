@@ -0,0 +1,541 @@
+#include "vegaLazy.h"
+#include <algorithm>
+#include <array>
+#include <numeric>
+#include <stdexcept>
+#include "vegaCsvBatchReader.h"
+
+using PlanPtr = std::shared_ptr<vegaPlanNode>;
+using Predicate = std::shared_ptr<const vegaExprNode>;
+using Kind = vegaPlanNode::Kind;
+
+static constexpr std::array<std::string_view, 6> COMPARE_OPS = {"==", "!=", "<", "<=", ">", ">="};
+
+static bool contains(const std::vector<std::string>& names, const std::string& name) {
+    return std::find(names.begin(), names.end(), name) != names.end();
+}
+
+static void add_unique(std::vector<std::string>& names, const std::string& name) {
+    if (!contains(names, name)) names.push_back(name);
+}
+
+static void require_columns(const std::vector<std::string>& available, const std::vector<std::string>& names) {
+    for (const auto& name : names) {
+        if (!contains(available, name)) throw std::runtime_error("Column not found: " + name);
+    }
+}
+
+// ============= SCHEMA =============
+
+static std::vector<std::string> output_columns(const vegaPlanNode& node) {
+    switch (node.kind) {
+        case Kind::FILTER:
+        case Kind::SORT:
+        case Kind::LIMIT:
+            return output_columns(*node.inputs[0]);
+        case Kind::JOIN: {
+            // every left column, then the right ones but the right key (see vegaDataframe::merge)
+            std::vector<std::string> columns = output_columns(*node.inputs[0]);
+            std::vector<std::string> right = output_columns(*node.inputs[1]);
+            right.erase(std::find(right.begin(), right.end(), node.columns[1]));
+            columns.insert(columns.end(), right.begin(), right.end());
+            return columns;
+        }
+        default:
+            return node.columns;
+    }
+}
+
+// ============= BUILDING =============
+
+vegaLazyFrame vegaLazyFrame::from(const vegaDataframe& frame) {
+    auto node = std::make_shared<vegaPlanNode>();
+    node->kind = Kind::SCAN_FRAME;
+    node->frame = &frame;
+    node->columns = frame.data_features;
+    return vegaLazyFrame(std::move(node));
+}
+
+vegaLazyFrame vegaLazyFrame::scan_csv(const std::string& file_name, const vegaCsvOptions& options) {
+    auto node = std::make_shared<vegaPlanNode>();
+    node->kind = Kind::SCAN_CSV;
+    node->path = file_name;
+    node->csv_options = options;
+    // the reader resolves the header and usecols without parsing any rows
+    node->columns = vegaCsvBatchReader(file_name, 1, options).features();
+    return vegaLazyFrame(std::move(node));
+}
+
+vegaLazyFrame vegaLazyFrame::scan_vega(const std::string& file_name) {
+    auto node = std::make_shared<vegaPlanNode>();
+    node->kind = Kind::SCAN_VEGA;
+    node->path = file_name;
+    node->columns = vegaFileReader(file_name).features();
+    return vegaLazyFrame(std::move(node));
+}
+
+vegaLazyFrame vegaDataframe::lazy() const {
+    return vegaLazyFrame::from(*this);
+}
+
+vegaLazyFrame vegaLazyFrame::then(vegaPlanNode node) const {
+    node.inputs.insert(node.inputs.begin(), plan);
+    return vegaLazyFrame(std::make_shared<vegaPlanNode>(std::move(node)));
+}
+
+vegaLazyFrame vegaLazyFrame::filter(const std::string& expression) const {
+    std::unique_ptr<vegaExprNode> ast = parse_expression(expression);
+    require_columns(columns(), referenced_columns(*ast));
+
+    vegaPlanNode node;
+    node.kind = Kind::FILTER;
+    for (auto& conjunct : split_conjuncts(std::move(ast))) node.predicates.push_back(std::move(conjunct));
+    return then(std::move(node));
+}
+
+vegaLazyFrame vegaLazyFrame::select(const std::vector<std::string>& columns) const {
+    require_columns(this->columns(), columns);
+    vegaPlanNode node;
+    node.kind = Kind::SELECT;
+    node.columns = columns;
+    return then(std::move(node));
+}
+
+vegaLazyFrame vegaLazyFrame::sort_values(const std::string& column, bool ascending) const {
+    return sort_values(std::vector<std::string>{column}, std::vector<bool>{ascending});
+}
+
+vegaLazyFrame vegaLazyFrame::sort_values(const std::vector<std::string>& columns, const std::vector<bool>& ascending) const {
+    if (columns.size() != ascending.size()) {
+        throw std::runtime_error("Column names and ascending vectors must have same size");
+    }
+    require_columns(this->columns(), columns);
+    vegaPlanNode node;
+    node.kind = Kind::SORT;
+    node.columns = columns;
+    node.ascending = ascending;
+    return then(std::move(node));
+}
+
+vegaLazyFrame vegaLazyFrame::limit(size_t n) const {
+    vegaPlanNode node;
+    node.kind = Kind::LIMIT;
+    node.limit = n;
+    return then(std::move(node));
+}
+
+vegaLazyFrame vegaLazyFrame::merge(const vegaLazyFrame& other, const std::string& left_col,
+                                   const std::string& right_col, const std::string& how) const {
+    if (how != "inner" && how != "left") throw std::runtime_error("Unsupported join type: " + how);
+    require_columns(columns(), {left_col});
+    require_columns(other.columns(), {right_col});
+    vegaPlanNode node;
+    node.kind = Kind::JOIN;
+    node.inputs.push_back(other.plan);
+    node.columns = {left_col, right_col};
+    node.how = how;
+    return then(std::move(node));
+}
+
+std::vector<std::string> vegaLazyFrame::columns() const {
+    return output_columns(*plan);
+}
+
+// ============= OPTIMIZATION =============
+
+// copies the nodes (plans may share inputs, the optimizer rewrites them in place)
+static PlanPtr clone_plan(const PlanPtr& node) {
+    auto copy = std::make_shared<vegaPlanNode>(*node);
+    for (auto& input : copy->inputs) input = clone_plan(input);
+    return copy;
+}
+
+static PlanPtr with_filter(PlanPtr node, std::vector<Predicate> predicates) {
+    if (predicates.empty()) return node;
+    auto filter = std::make_shared<vegaPlanNode>();
+    filter->kind = Kind::FILTER;
+    filter->predicates = std::move(predicates);
+    filter->inputs.push_back(std::move(node));
+    return filter;
+}
+
+// Adds "column op literal" as a read filter of a CSV scan when the reader decides it like the
+// query: equality with a non-numeric string on a text column, or any comparison with a number
+// on a column with an INT or FLOAT dtype. The predicate still runs above the scan.
+static void push_csv_filter(vegaPlanNode& scan, const vegaExprNode& predicate) {
+    if (predicate.kind != vegaExprNode::Kind::COMPARE) return;
+    const vegaExprNode* column = predicate.children[0].get();
+    const vegaExprNode* literal = predicate.children[1].get();
+    CompareOp op = predicate.op;
+    if (column->kind != vegaExprNode::Kind::COLUMN) {
+        std::swap(column, literal);
+        if (op == CompareOp::LT) op = CompareOp::GT;
+        else if (op == CompareOp::LE) op = CompareOp::GE;
+        else if (op == CompareOp::GT) op = CompareOp::LT;
+        else if (op == CompareOp::GE) op = CompareOp::LE;
+    }
+    if (column->kind != vegaExprNode::Kind::COLUMN) return;
+
+    auto dtype = scan.csv_options.dtype.find(column->text);
+    bool has_dtype = dtype != scan.csv_options.dtype.end();
+    double number;
+    bool decided_alike = false;
+    if (literal->kind == vegaExprNode::Kind::NUMBER) {
+        decided_alike = has_dtype && is_numeric_type(dtype->second);
+    } else if (literal->kind == vegaExprNode::Kind::STRING) {
+        bool text_column = !has_dtype || dtype->second == DataType::STRING || dtype->second == DataType::CATEGORY;
+        decided_alike = op == CompareOp::EQ && text_column && !literal->text.empty() && !parse_double(literal->text, number);
+    }
+    if (decided_alike) {
+        scan.csv_options.filters.push_back({column->text, std::string(COMPARE_OPS[static_cast<size_t>(op)]), literal->text});
+    }
+}
+
+// moves the conjuncts in predicates, and those of the filters below node, as far down as they go
+static PlanPtr push_filters(PlanPtr node, std::vector<Predicate> predicates) {
+    switch (node->kind) {
+        case Kind::FILTER: {
+            std::vector<Predicate> fused = node->predicates;
+            fused.insert(fused.end(), predicates.begin(), predicates.end());
+            return push_filters(node->inputs[0], std::move(fused));
+        }
+        case Kind::SELECT:
+        case Kind::SORT:
+            node->inputs[0] = push_filters(node->inputs[0], std::move(predicates));
+            return node;
+        case Kind::JOIN: {
+            std::vector<std::string> left_columns = output_columns(*node->inputs[0]);
+            std::vector<std::string> right_columns = output_columns(*node->inputs[1]);
+            std::vector<Predicate> left, right, above;
+            for (auto& predicate : predicates) {
+                std::vector<std::string> names = referenced_columns(*predicate);
+                bool left_only = std::all_of(names.begin(), names.end(),
+                                             [&](const std::string& name) { return contains(left_columns, name); });
+                // a name of both sides refers to the left column
+                bool right_only = std::all_of(names.begin(), names.end(), [&](const std::string& name) {
+                    return contains(right_columns, name) && !contains(left_columns, name);
+                });
+                if (left_only) left.push_back(std::move(predicate));
+                else if (right_only && node->how == "inner") right.push_back(std::move(predicate));
+                else above.push_back(std::move(predicate));
+            }
+            node->inputs[0] = push_filters(node->inputs[0], std::move(left));
+            node->inputs[1] = push_filters(node->inputs[1], std::move(right));
+            return with_filter(node, std::move(above));
+        }
+        case Kind::SCAN_CSV:
+            for (const auto& predicate : predicates) push_csv_filter(*node, *predicate);
+            return with_filter(node, std::move(predicates));
+        case Kind::LIMIT:
+            node->inputs[0] = push_filters(node->inputs[0], {});
+            return with_filter(node, std::move(predicates));
+        default:
+            return with_filter(node, std::move(predicates));
+    }
+}
+
+static PlanPtr push_limits(PlanPtr node) {
+    for (auto& input : node->inputs) input = push_limits(input);
+    if (node->kind != Kind::LIMIT) return node;
+
+    PlanPtr input = node->inputs[0];
+    switch (input->kind) {
+        case Kind::LIMIT:
+        case Kind::SORT:
+        case Kind::SCAN_FRAME:
+        case Kind::SCAN_VEGA:
+            input->limit = std::min(input->limit, node->limit);
+            return input;
+        case Kind::SCAN_CSV:
+            // nrows counts rows before the read filters
+            if (!input->csv_options.filters.empty()) return node;
+            input->limit = std::min(input->limit, node->limit);
+            return input;
+        case Kind::SELECT:
+            node->inputs[0] = input->inputs[0];
+            input->inputs[0] = push_limits(node);
+            return input;
+        default:
+            return node;
+    }
+}
+
+// narrows projections and scans to the columns needed above them
+static void prune_columns(vegaPlanNode& node, std::vector<std::string> required) {
+    switch (node.kind) {
+        case Kind::SELECT:
+            std::erase_if(node.columns, [&](const std::string& name) { return !contains(required, name); });
+            prune_columns(*node.inputs[0], node.columns);
+            return;
+        case Kind::FILTER:
+            for (const auto& predicate : node.predicates) {
+                for (const auto& name : referenced_columns(*predicate)) add_unique(required, name);
+            }
+            prune_columns(*node.inputs[0], std::move(required));
+            return;
+        case Kind::SORT:
+            for (const auto& name : node.columns) add_unique(required, name);
+            prune_columns(*node.inputs[0], std::move(required));
+            return;
+        case Kind::LIMIT:
+            prune_columns(*node.inputs[0], std::move(required));
+            return;
+        case Kind::JOIN: {
+            std::vector<std::string> left = output_columns(*node.inputs[0]);
+            std::vector<std::string> right = output_columns(*node.inputs[1]);
+            std::erase_if(left, [&](const std::string& name) { return !contains(required, name); });
+            std::erase_if(right, [&](const std::string& name) { return !contains(required, name); });
+            add_unique(left, node.columns[0]);
+            add_unique(right, node.columns[1]);
+            prune_columns(*node.inputs[0], std::move(left));
+            prune_columns(*node.inputs[1], std::move(right));
+            return;
+        }
+        default: {
+            // a scan keeps one column when none is needed, so that the row count survives
+            std::string first = node.columns.empty() ? std::string() : node.columns.front();
+            std::erase_if(node.columns, [&](const std::string& name) { return !contains(required, name); });
+            if (node.columns.empty() && !first.empty()) node.columns.push_back(first);
+            return;
+        }
+    }
+}
+
+// drops projections that, once pruned, keep their input as it is
+static PlanPtr remove_projections(PlanPtr node) {
+    for (auto& input : node->inputs) input = remove_projections(input);
+    if (node->kind == Kind::SELECT && node->columns == output_columns(*node->inputs[0])) return node->inputs[0];
+    return node;
+}
+
+static PlanPtr optimize(const PlanPtr& plan) {
+    PlanPtr root = push_filters(clone_plan(plan), {});
+    root = push_limits(root);
+    prune_columns(*root, output_columns(*root));
+    return remove_projections(root);
+}
+
+// ============= EXPLAIN =============
+
+static std::string join_names(const std::vector<std::string>& names) {
+    std::string out = "[";
+    for (size_t i = 0; i < names.size(); ++i) out += (i > 0 ? ", " : "") + names[i];
+    return out + "]";
+}
+
+static void explain_node(const vegaPlanNode& node, size_t depth, std::string& out) {
+    out.append(depth * 2, ' ');
+    std::string limit = node.limit == vegaPlanNode::NO_LIMIT ? "" : " limit " + std::to_string(node.limit);
+    switch (node.kind) {
+        case Kind::SCAN_FRAME:
+            out += "SCAN FRAME " + join_names(node.columns) + limit;
+            break;
+        case Kind::SCAN_CSV:
+            out += "SCAN CSV " + node.path + " " + join_names(node.columns) + limit;
+            for (const auto& filter : node.csv_options.filters) {
+                out += " where " + filter.column + " " + filter.op + " '" + filter.value + "'";
+            }
+            break;
+        case Kind::SCAN_VEGA:
+            out += "SCAN VEGA " + node.path + " " + join_names(node.columns) + limit;
+            break;
+        case Kind::FILTER:
+            out += "FILTER ";
+            for (size_t i = 0; i < node.predicates.size(); ++i) {
+                out += (i > 0 ? " and " : "") + node.predicates[i]->to_string();
+            }
+            break;
+        case Kind::SELECT:
+            out += "SELECT " + join_names(node.columns);
+            break;
+        case Kind::SORT: {
+            std::vector<std::string> keys;
+            for (size_t i = 0; i < node.columns.size(); ++i) {
+                keys.push_back(node.columns[i] + (node.ascending[i] ? " asc" : " desc"));
+            }
+            out += "SORT " + join_names(keys) + limit;
+            break;
+        }
+        case Kind::LIMIT:
+            out += "LIMIT " + std::to_string(node.limit);
+            break;
+        case Kind::JOIN:
+            out += "JOIN " + node.how + " " + node.columns[0] + " = " + node.columns[1];
+            break;
+    }
+    out += '\n';
+    for (const auto& input : node.inputs) explain_node(*input, depth + 1, out);
+}
+
+std::string vegaLazyFrame::explain(bool optimized) const {
+    std::string out;
+    explain_node(optimized ? *optimize(plan) : *plan, 0, out);
+    return out;
+}
+
+// ============= EXECUTION =============
+
+namespace {
+
+// The rows flowing out of a node: columns of a frame and the selected rows in output order
+// (every row in order when all_rows). Frames read or joined during execution are owned here.
+struct Relation {
+    std::shared_ptr<vegaDataframe> owned;
+    const vegaDataframe* frame = nullptr;
+    std::vector<size_t> columns;
+    std::vector<size_t> rows;
+    bool all_rows = true;
+
+    static Relation of(std::shared_ptr<vegaDataframe> frame) {
+        Relation relation;
+        relation.frame = frame.get();
+        relation.columns.resize(frame->data_features.size());
+        std::iota(relation.columns.begin(), relation.columns.end(), 0);
+        relation.owned = std::move(frame);
+        return relation;
+    }
+
+    [[nodiscard]] size_t row_count() const { return all_rows ? frame->num_rows() : rows.size(); }
+
+    // frame column of an output column
+    [[nodiscard]] size_t column(const std::string& name) const {
+        for (size_t col : columns) {
+            if (frame->data_features[col] == name) return col;
+        }
+        throw std::runtime_error("Column not found: " + name);
+    }
+
+    void select_rows() {
+        if (!all_rows) return;
+        rows.resize(frame->num_rows());
+        std::iota(rows.begin(), rows.end(), 0);
+        all_rows = false;
+    }
+
+    void keep_first(size_t n) {
+        if (n >= row_count()) return;
+        if (all_rows) {
+            rows.resize(n);
+            std::iota(rows.begin(), rows.end(), 0);
+            all_rows = false;
+        } else {
+            rows.resize(n);
+        }
+    }
+
+    vegaDataframe materialize() {
+        bool whole = all_rows && columns.size() == frame->data_features.size();
+        for (size_t i = 0; i < columns.size() && whole; ++i) whole = columns[i] == i;
+        if (whole && owned && owned.use_count() == 1) return std::move(*owned);
+
+        vegaDataframe result;
+        for (size_t col : columns) {
+            result.data_features.push_back(frame->data_features[col]);
+            result.data_columns.push_back(all_rows ? frame->data_columns[col] : frame->data_columns.take(col, rows));
+        }
+        result.update_stats_after_modification();
+        return result;
+    }
+};
+
+Relation execute(const vegaPlanNode& node);
+
+Relation execute_sort(const vegaPlanNode& node) {
+    Relation relation = execute(*node.inputs[0]);
+    std::vector<const vegaColumn*> keys;
+    for (const auto& name : node.columns) keys.push_back(&relation.frame->data_columns[relation.column(name)]);
+    auto before = [&](size_t a, size_t b) {
+        for (size_t i = 0; i < keys.size(); ++i) {
+            int cmp = keys[i]->compare(a, b);
+            if (cmp != 0) return node.ascending[i] ? cmp < 0 : cmp > 0;
+        }
+        return false;
+    };
+
+    relation.select_rows();
+    std::vector<size_t>& rows = relation.rows;
+    if (node.limit < rows.size()) {
+        // top-n by position so that equal rows keep their order, as in the stable full sort
+        std::vector<size_t> positions(rows.size());
+        std::iota(positions.begin(), positions.end(), 0);
+        std::partial_sort(positions.begin(), positions.begin() + static_cast<std::ptrdiff_t>(node.limit), positions.end(),
+                          [&](size_t a, size_t b) {
+                              if (before(rows[a], rows[b])) return true;
+                              if (before(rows[b], rows[a])) return false;
+                              return a < b;
+                          });
+        std::vector<size_t> top;
+        for (size_t i = 0; i < node.limit; ++i) top.push_back(rows[positions[i]]);
+        rows = std::move(top);
+    } else {
+        std::stable_sort(rows.begin(), rows.end(), before);
+    }
+    return relation;
+}
+
+Relation execute(const vegaPlanNode& node) {
+    switch (node.kind) {
+        case Kind::SCAN_FRAME: {
+            Relation relation;
+            relation.frame = node.frame;
+            for (const auto& name : node.columns) relation.columns.push_back(node.frame->find_column_index(name));
+            relation.keep_first(node.limit);
+            return relation;
+        }
+        case Kind::SCAN_CSV: {
+            vegaCsvOptions options = node.csv_options;
+            options.usecols = node.columns;
+            options.usecols_index.clear();
+            options.nrows = std::min(options.nrows, node.limit);
+            auto frame = std::make_shared<vegaDataframe>();
+            frame->read_csv(node.path, options);
+            return Relation::of(std::move(frame));
+        }
+        case Kind::SCAN_VEGA: {
+            auto frame = std::make_shared<vegaDataframe>();
+            frame->read_vega(node.path, node.columns);
+            Relation relation = Relation::of(std::move(frame));
+            relation.keep_first(node.limit);
+            return relation;
+        }
+        case Kind::FILTER: {
+            Relation relation = execute(*node.inputs[0]);
+            std::vector<const vegaExprNode*> conjuncts;
+            for (const auto& predicate : node.predicates) conjuncts.push_back(predicate.get());
+            vegaBitmap mask = vegaQuery(conjuncts, relation.frame->data_features, relation.frame->data_columns).evaluate();
+            if (relation.all_rows) {
+                relation.rows = mask.set_indices();
+                relation.all_rows = false;
+            } else {
+                std::erase_if(relation.rows, [&mask](size_t row) { return !mask.get(row); });
+            }
+            return relation;
+        }
+        case Kind::SELECT: {
+            Relation relation = execute(*node.inputs[0]);
+            std::vector<size_t> columns;
+            for (const auto& name : node.columns) columns.push_back(relation.column(name));
+            relation.columns = std::move(columns);
+            return relation;
+        }
+        case Kind::SORT:
+            return execute_sort(node);
+        case Kind::LIMIT: {
+            Relation relation = execute(*node.inputs[0]);
+            relation.keep_first(node.limit);
+            return relation;
+        }
+        case Kind::JOIN: {
+            vegaDataframe left = execute(*node.inputs[0]).materialize();
+            vegaDataframe right = execute(*node.inputs[1]).materialize();
+            return Relation::of(std::make_shared<vegaDataframe>(left.merge(right, node.columns[0], node.columns[1], node.how)));
+        }
+    }
+    throw std::runtime_error("Unknown plan node");
+}
+
+} // namespace
+
+vegaDataframe vegaLazyFrame::collect() const {
+    return execute(*optimize(plan)).materialize();
+}
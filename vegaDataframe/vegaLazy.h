@@ -0,0 +1,79 @@
+#ifndef VEGA_VEGALAZY_H
+#define VEGA_VEGALAZY_H
+
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+#include "vegaDataframe.h"
+
+// One operation of a logical plan. Scans read a frame or a file; the other nodes take the
+// output of inputs[0], and JOIN also that of inputs[1].
+struct vegaPlanNode {
+    enum class Kind { SCAN_FRAME, SCAN_CSV, SCAN_VEGA, FILTER, SELECT, SORT, LIMIT, JOIN };
+    static constexpr size_t NO_LIMIT = std::numeric_limits<size_t>::max();
+
+    Kind kind = Kind::SCAN_FRAME;
+    std::vector<std::shared_ptr<vegaPlanNode>> inputs;
+    // SCAN_FRAME: the source, which must outlive the plan
+    const vegaDataframe* frame = nullptr;
+    // SCAN_CSV / SCAN_VEGA
+    std::string path;
+    vegaCsvOptions csv_options;
+    // scans: the columns read, in source order; SELECT: the output columns;
+    // SORT: the keys; JOIN: the left and the right key
+    std::vector<std::string> columns;
+    std::vector<bool> ascending;
+    // FILTER: conjuncts that must all hold
+    std::vector<std::shared_ptr<const vegaExprNode>> predicates;
+    // LIMIT, SORT (keeps the first rows only) and scans: the most rows produced
+    size_t limit = NO_LIMIT;
+    // JOIN: "inner" or "left", see vegaDataframe::merge
+    std::string how;
+};
+
+// A chain of operations recorded as a logical plan and run by collect(). Before it runs, the
+// plan is optimized:
+//   - consecutive filters are fused into one compiled predicate (see vegaQuery)
+//   - filters move below projections and sorts; conjuncts that only use the columns of one
+//     side of a join move to that side (the left side of a left join)
+//   - comparisons that a CSV reader filter decides the same way are also pushed into scan_csv
+//   - each scan only reads or takes the columns needed above it, and projections that then
+//     keep their input unchanged are dropped
+//   - a limit moves below projections and into a sort (a partial top-n sort) or a scan
+// Execution passes (source, columns, selected rows) along and copies the cells once at the
+// end or at a join, instead of building a frame per operation.
+class vegaLazyFrame {
+public:
+    // frame must outlive the lazy frame and every frame derived from it
+    static vegaLazyFrame from(const vegaDataframe& frame);
+    // options.usecols/usecols_index, dtype, nrows and filters apply as in read_csv
+    static vegaLazyFrame scan_csv(const std::string& file_name, const vegaCsvOptions& options = {});
+    static vegaLazyFrame scan_vega(const std::string& file_name);
+
+    // ============= OPERATIONS =============
+    // rows satisfying an expression, see vegaExpr.h
+    [[nodiscard]] vegaLazyFrame filter(const std::string& expression) const;
+    [[nodiscard]] vegaLazyFrame select(const std::vector<std::string>& columns) const;
+    [[nodiscard]] vegaLazyFrame sort_values(const std::string& column, bool ascending = true) const;
+    [[nodiscard]] vegaLazyFrame sort_values(const std::vector<std::string>& columns, const std::vector<bool>& ascending) const;
+    [[nodiscard]] vegaLazyFrame limit(size_t n) const;
+    [[nodiscard]] vegaLazyFrame merge(const vegaLazyFrame& other, const std::string& left_col,
+                                      const std::string& right_col, const std::string& how = "inner") const;
+
+    // ============= EXECUTION =============
+    // output columns of the plan
+    [[nodiscard]] std::vector<std::string> columns() const;
+    // the plan, one node per line with inputs indented below it
+    [[nodiscard]] std::string explain(bool optimized = true) const;
+    [[nodiscard]] vegaDataframe collect() const;
+
+private:
+    explicit vegaLazyFrame(std::shared_ptr<vegaPlanNode> plan) : plan(std::move(plan)) {}
+    [[nodiscard]] vegaLazyFrame then(vegaPlanNode node) const;
+
+    std::shared_ptr<vegaPlanNode> plan;
+};
+
+#endif // VEGA_VEGALAZY_H
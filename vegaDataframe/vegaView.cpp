@@ -0,0 +1,296 @@
+#include "vegaView.h"
+#include <algorithm>
+#include <bit>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include "vegaExpr.h"
+
+vegaFrameView::vegaFrameView(const vegaDataframe& frame) : vegaFrameView(frame, vegaBitmap(frame.num_rows(), true)) {}
+
+vegaFrameView::vegaFrameView(const vegaDataframe& frame, vegaBitmap selection)
+    : frame(&frame), column_indices(frame.data_features.size()), selected(std::move(selection)) {
+    if (selected.size() != frame.num_rows()) {
+        throw std::runtime_error("Selection has " + std::to_string(selected.size()) + " rows, the frame " +
+                                 std::to_string(frame.num_rows()));
+    }
+    std::iota(column_indices.begin(), column_indices.end(), size_t{0});
+}
+
+vegaFrameView vegaDataframe::view() const {
+    return vegaFrameView(*this);
+}
+
+// ============= HELPERS =============
+
+size_t vegaFrameView::column_index(const std::string& col_name) const {
+    for (size_t col : column_indices) {
+        if (frame->data_features[col] == col_name) return col;
+    }
+    throw std::runtime_error("Column not found: " + col_name);
+}
+
+size_t vegaFrameView::numeric_column(const std::string& col_name, const char* operation) const {
+    size_t col = column_index(col_name);
+    if (!is_numeric_type(frame->data_columns.type(col))) {
+        throw std::runtime_error(std::string("Cannot compute ") + operation + " for string column");
+    }
+    return col;
+}
+
+std::vector<std::string> vegaFrameView::get_row(size_t row) const {
+    std::vector<std::string> values;
+    values.reserve(column_indices.size());
+    for (size_t col : column_indices) {
+        values.push_back(frame->data_columns[col].to_string(row));
+    }
+    return values;
+}
+
+vegaFrameView vegaFrameView::narrowed(const vegaBitmap& mask) const {
+    vegaFrameView result = *this;
+    result.selected &= mask;
+    return result;
+}
+
+vegaFrameView vegaFrameView::matching_text(const std::string& col_name,
+                                           const std::function<bool(std::string_view)>& match) const {
+    const vegaColumn& column = frame->data_columns[column_index(col_name)];
+    vegaFrameView result = *this;
+    result.selected &= column.validity;
+
+    // categories are matched once per code
+    if (column.type == DataType::CATEGORY) {
+        std::vector<char> hits(column.category_count());
+        for (size_t code = 0; code < hits.size(); ++code) hits[code] = match(column.category(static_cast<int64_t>(code)));
+        selected.for_each_set([&](size_t row) {
+            if (!column.is_null(row) && !hits[static_cast<size_t>(column.int_data[row])]) result.selected.reset(row);
+        });
+        return result;
+    }
+    std::string buffer;
+    result.selected.for_each_set([&](size_t row) {
+        std::string_view text = column.type == DataType::STRING ? column.string_at(row)
+                                                                 : std::string_view(buffer = column.to_string(row));
+        if (!match(text)) result.selected.reset(row);
+    });
+    return result;
+}
+
+// ============= FILTERS =============
+
+vegaFrameView vegaFrameView::filter_rows(const std::string& col_name, const std::string& value) const {
+    return filter_rows(col_name, "==", value);
+}
+
+vegaFrameView vegaFrameView::filter_rows(const std::string& col_name, const std::string& op,
+                                         const std::string& value) const {
+    vegaBitmap mask(selected.size());
+    for (size_t row : frame->matching_rows(column_index(col_name), parse_compare_op(op), value)) mask.set(row);
+    return narrowed(mask);
+}
+
+vegaFrameView vegaFrameView::filter_rows(const std::function<bool(const std::vector<std::string>&)>& condition) const {
+    vegaFrameView result = *this;
+    selected.for_each_set([&](size_t row) {
+        if (!condition(get_row(row))) result.selected.reset(row);
+    });
+    return result;
+}
+
+vegaFrameView vegaFrameView::query(const std::string& expression) const {
+    std::unique_ptr<vegaExprNode> node = parse_expression(expression);
+    // the expression may only use the view's columns
+    for (const auto& name : referenced_columns(*node)) static_cast<void>(column_index(name));
+    return narrowed(vegaQuery({node.get()}, frame->data_features, frame->data_columns).evaluate());
+}
+
+vegaFrameView vegaFrameView::filter_rows(const vegaBitmap& mask) const {
+    if (mask.size() != selected.size()) {
+        throw std::runtime_error("Mask has " + std::to_string(mask.size()) + " rows, the frame " +
+                                 std::to_string(selected.size()));
+    }
+    return narrowed(mask);
+}
+
+vegaFrameView vegaFrameView::str_contains(const std::string& col_name, const std::string& pattern) const {
+    return matching_text(col_name, [&pattern](std::string_view text) { return text.find(pattern) != std::string_view::npos; });
+}
+
+vegaFrameView vegaFrameView::str_startswith(const std::string& col_name, const std::string& prefix) const {
+    return matching_text(col_name, [&prefix](std::string_view text) { return text.starts_with(prefix); });
+}
+
+vegaFrameView vegaFrameView::str_endswith(const std::string& col_name, const std::string& suffix) const {
+    return matching_text(col_name, [&suffix](std::string_view text) { return text.ends_with(suffix); });
+}
+
+vegaFrameView vegaFrameView::dropna(const std::string& how) const {
+    // whole-word ANDs / ORs of the validity bitmaps, as in vegaDataframe::dropna
+    vegaBitmap kept(selected.size(), how == "any");
+    for (size_t col : column_indices) {
+        if (how == "any") {
+            kept &= frame->data_columns.validity(col);
+        } else if (how == "all") {
+            kept |= frame->data_columns.validity(col);
+        }
+    }
+    return narrowed(kept);
+}
+
+vegaFrameView vegaFrameView::select(const std::vector<std::string>& col_names) const {
+    vegaFrameView result = *this;
+    result.column_indices.clear();
+    for (const auto& name : col_names) result.column_indices.push_back(column_index(name));
+    return result;
+}
+
+// ============= ACCESS =============
+
+std::vector<std::string> vegaFrameView::columns() const {
+    std::vector<std::string> names;
+    names.reserve(column_indices.size());
+    for (size_t col : column_indices) names.push_back(frame->data_features[col]);
+    return names;
+}
+
+void vegaFrameView::head(size_t n) const {
+    std::vector<size_t> shown;
+    for (size_t w = 0; w < selected.word_count() && shown.size() < n; ++w) {
+        for (uint64_t bits = selected.word(w); bits && shown.size() < n; bits &= bits - 1) {
+            shown.push_back((w << 6) + static_cast<size_t>(std::countr_zero(bits)));
+        }
+    }
+    if (shown.empty()) {
+        std::cout << "No data rows to display.\n";
+        return;
+    }
+
+    for (size_t col : column_indices) {
+        std::cout << std::setw(15) << frame->data_features[col] << " ";
+    }
+    std::cout << "\n";
+
+    for (size_t row : shown) {
+        for (size_t col : column_indices) {
+            std::cout << std::setw(15) << frame->data_columns[col].to_string(row) << " ";
+        }
+        std::cout << "\n";
+    }
+}
+
+// ============= STATISTICS =============
+
+double vegaFrameView::mean(const std::string& col_name) const {
+    size_t col = numeric_column(col_name, "mean");
+    const vegaColumn& column = frame->data_columns[col];
+    double sum = 0;
+    size_t count = 0;
+    (selected & column.validity).for_each_set([&](size_t row) {
+        sum += column.numeric_at(row);
+        count++;
+    });
+
+    if (count == 0) throw std::runtime_error("No valid values to compute mean");
+    return sum / count;
+}
+
+double vegaFrameView::sum(const std::string& col_name) const {
+    size_t col = numeric_column(col_name, "sum");
+    const vegaColumn& column = frame->data_columns[col];
+    double total = 0;
+    (selected & column.validity).for_each_set([&](size_t row) { total += column.numeric_at(row); });
+    return total;
+}
+
+double vegaFrameView::min(const std::string& col_name) const {
+    size_t col = numeric_column(col_name, "min");
+    const vegaColumn& column = frame->data_columns[col];
+    vegaBitmap valid = selected & column.validity;
+    if (valid.none()) throw std::runtime_error("No valid values to compute min");
+
+    double min_val = std::numeric_limits<double>::max();
+    valid.for_each_set([&](size_t row) { min_val = std::min(min_val, column.numeric_at(row)); });
+    return min_val;
+}
+
+double vegaFrameView::max(const std::string& col_name) const {
+    size_t col = numeric_column(col_name, "max");
+    const vegaColumn& column = frame->data_columns[col];
+    vegaBitmap valid = selected & column.validity;
+    if (valid.none()) throw std::runtime_error("No valid values to compute max");
+
+    double max_val = std::numeric_limits<double>::lowest();
+    valid.for_each_set([&](size_t row) { max_val = std::max(max_val, column.numeric_at(row)); });
+    return max_val;
+}
+
+size_t vegaFrameView::count(const std::string& col_name) const {
+    return (selected & frame->data_columns.validity(column_index(col_name))).count();
+}
+
+std::map<std::string, size_t> vegaFrameView::value_counts(const std::string& col_name) const {
+    const vegaColumn& column = frame->data_columns[column_index(col_name)];
+    vegaBitmap valid = selected & column.validity;
+
+    std::map<std::string, size_t> counts;
+    if (column.type == DataType::CATEGORY) {
+        std::vector<size_t> code_counts(column.category_count(), 0);
+        valid.for_each_set([&](size_t row) { code_counts[static_cast<size_t>(column.int_data[row])]++; });
+        for (size_t code = 0; code < code_counts.size(); ++code) {
+            if (code_counts[code] > 0) counts.emplace(column.category(static_cast<int64_t>(code)), code_counts[code]);
+        }
+        return counts;
+    }
+    valid.for_each_set([&](size_t row) { counts[column.to_string(row)]++; });
+    return counts;
+}
+
+// ============= MATERIALIZATION =============
+
+vegaDataframe vegaFrameView::materialize() const {
+    std::vector<size_t> row_indices = rows();
+    vegaDataframe result;
+    result.data_features = columns();
+    result.data_columns.reserve(column_indices.size());
+    for (size_t col : column_indices) {
+        result.data_columns.push_back(frame->data_columns.take(col, row_indices));
+    }
+    result.update_stats_after_modification();
+    return result;
+}
+
+vegaDataframe vegaFrameView::where(const std::function<bool(const std::vector<std::string>&)>& condition,
+                                   const std::string& other) const {
+    vegaBitmap kept(selected.size());
+    selected.for_each_set([&](size_t row) {
+        if (condition(get_row(row))) kept.set(row);
+    });
+    return where(kept, other);
+}
+
+vegaDataframe vegaFrameView::where(const vegaBitmap& mask, const std::string& other) const {
+    if (mask.size() != selected.size()) {
+        throw std::runtime_error("Mask has " + std::to_string(mask.size()) + " rows, the frame " +
+                                 std::to_string(selected.size()));
+    }
+    std::vector<size_t> row_indices = rows();
+
+    vegaDataframe result;
+    result.data_features = columns();
+    result.data_columns.reserve(column_indices.size());
+    for (size_t col : column_indices) {
+        const vegaColumn& column = frame->data_columns[col];
+        vegaColumn replaced(column.type);
+        replaced.reserve(row_indices.size());
+        for (size_t row : row_indices) {
+            if (mask.get(row)) replaced.append_from(column, row);
+            else replaced.append_value(other);
+        }
+        result.data_columns.push_back(std::move(replaced));
+    }
+    result.update_stats_after_modification();
+    return result;
+}
@@ -0,0 +1,87 @@
+#ifndef VEGA_VEGAVIEW_H
+#define VEGA_VEGAVIEW_H
+
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "vegaDataframe.h"
+
+// Rows of a frame picked by a selection mask, read through the frame's own column buffers.
+// The filters narrow the mask, so a chain of them copies no cells; the statistics and head()
+// read the selected rows in place, and materialize() copies them once. The frame must outlive
+// the view and stay unmodified while the view is used.
+class vegaFrameView {
+public:
+    // every row and column of frame
+    explicit vegaFrameView(const vegaDataframe& frame);
+    // the rows of frame whose bit is set in selection (one bit per row of frame)
+    vegaFrameView(const vegaDataframe& frame, vegaBitmap selection);
+
+    // ============= FILTERS =============
+    // same matching as vegaDataframe::filter_rows and query, restricted to the selected rows
+    [[nodiscard]] vegaFrameView filter_rows(const std::string& col_name, const std::string& value) const;
+    [[nodiscard]] vegaFrameView filter_rows(const std::string& col_name, const std::string& op, const std::string& value) const;
+    // condition sees the cells of the view's columns
+    [[nodiscard]] vegaFrameView filter_rows(const std::function<bool(const std::vector<std::string>&)>& condition) const;
+    [[nodiscard]] vegaFrameView query(const std::string& expression) const;
+    // rows whose bit is set in mask (one bit per row of the frame, e.g. from vegaDataframe::compare)
+    [[nodiscard]] vegaFrameView filter_rows(const vegaBitmap& mask) const;
+    // rows whose cell contains / starts with / ends with the text (vegaDataframe::str_contains
+    // instead adds a flag column); null cells never match
+    [[nodiscard]] vegaFrameView str_contains(const std::string& col_name, const std::string& pattern) const;
+    [[nodiscard]] vegaFrameView str_startswith(const std::string& col_name, const std::string& prefix) const;
+    [[nodiscard]] vegaFrameView str_endswith(const std::string& col_name, const std::string& suffix) const;
+    // rows with no null ("any") or at least one non-null ("all") in the view's columns
+    [[nodiscard]] vegaFrameView dropna(const std::string& how = "any") const;
+    [[nodiscard]] vegaFrameView select(const std::vector<std::string>& col_names) const;
+
+    // ============= ACCESS =============
+    [[nodiscard]] size_t num_rows() const { return selected.count(); }
+    [[nodiscard]] std::pair<size_t, size_t> shape() const { return {num_rows(), column_indices.size()}; }
+    [[nodiscard]] std::vector<std::string> columns() const;
+    // one bit per row of the frame
+    [[nodiscard]] const vegaBitmap& selection() const { return selected; }
+    // the selected rows as row numbers of the frame
+    [[nodiscard]] std::vector<size_t> rows() const { return selected.set_indices(); }
+    [[nodiscard]] const vegaDataframe& source() const { return *frame; }
+    void head(size_t n = 5) const;
+
+    // ============= STATISTICS =============
+    // as the vegaDataframe functions of the same name, over the selected rows
+    [[nodiscard]] double mean(const std::string& col_name) const;
+    [[nodiscard]] double sum(const std::string& col_name) const;
+    [[nodiscard]] double min(const std::string& col_name) const;
+    [[nodiscard]] double max(const std::string& col_name) const;
+    [[nodiscard]] size_t count(const std::string& col_name) const;
+    [[nodiscard]] std::map<std::string, size_t> value_counts(const std::string& col_name) const;
+
+    // ============= MATERIALIZATION =============
+    // a frame holding copies of the selected rows of the view's columns
+    [[nodiscard]] vegaDataframe materialize() const;
+    // materialize() with every cell of the rows failing condition replaced by other
+    [[nodiscard]] vegaDataframe where(const std::function<bool(const std::vector<std::string>&)>& condition,
+                                      const std::string& other = "") const;
+    // materialize() with every cell of the rows whose bit is clear in mask replaced by other
+    [[nodiscard]] vegaDataframe where(const vegaBitmap& mask, const std::string& other = "") const;
+
+private:
+    // index in the frame of a column of the view
+    [[nodiscard]] size_t column_index(const std::string& col_name) const;
+    [[nodiscard]] size_t numeric_column(const std::string& col_name, const char* operation) const;
+    [[nodiscard]] std::vector<std::string> get_row(size_t row) const;
+    // the view with the selected rows narrowed to those in mask
+    [[nodiscard]] vegaFrameView narrowed(const vegaBitmap& mask) const;
+    // the view keeping the selected rows whose text in col_name satisfies match
+    [[nodiscard]] vegaFrameView matching_text(const std::string& col_name,
+                                              const std::function<bool(std::string_view)>& match) const;
+
+    const vegaDataframe* frame;
+    std::vector<size_t> column_indices;
+    vegaBitmap selected;
+};
+
+#endif // VEGA_VEGAVIEW_H